@@ -28,6 +28,11 @@ message(STATUS "ENABLE_GCOV = ${ENABLE_GCOV}")
 option(ENABLE_GPERF "Enable gperftools (for tcmalloc)" ON)
 message(STATUS "ENABLE_GPERF = ${ENABLE_GPERF}")
 
+# Enable the lz4 and zstd codecs of dsn/utility/compression.h, both libraries are required,
+# which are not in thirdparty, so it's off by default.
+option(ENABLE_COMPRESSION "Enable the lz4 and zstd codecs" OFF)
+message(STATUS "ENABLE_COMPRESSION = ${ENABLE_COMPRESSION}")
+
 # ================================================================== #
 
 
@@ -268,6 +273,34 @@ function(dsn_setup_system_libs)
         add_definitions(-DDSN_ENABLE_GPERF)
     endif()
 
+    # io_uring_aio_provider is only built with the io_uring kernel headers
+    include(CheckIncludeFile)
+    check_include_file(linux/io_uring.h HAVE_LINUX_IO_URING_H)
+    if(HAVE_LINUX_IO_URING_H)
+        add_definitions(-DDSN_HAS_IO_URING)
+    else()
+        message(STATUS "linux/io_uring.h is not found, io_uring_aio_provider is disabled")
+    endif()
+
+    if(ENABLE_COMPRESSION)
+        find_path(LZ4_INCLUDE_DIR lz4.h PATHS ${DSN_THIRDPARTY_ROOT}/include)
+        find_library(LZ4_LIBRARY NAMES lz4 PATHS ${DSN_THIRDPARTY_ROOT}/lib)
+        if(NOT LZ4_INCLUDE_DIR OR NOT LZ4_LIBRARY)
+            message(FATAL_ERROR "lz4 is not found, install it or build with -DENABLE_COMPRESSION=OFF")
+        endif()
+        message(STATUS "LZ4_LIBRARY = ${LZ4_LIBRARY}")
+
+        find_path(ZSTD_INCLUDE_DIR zstd.h PATHS ${DSN_THIRDPARTY_ROOT}/include)
+        find_library(ZSTD_LIBRARY NAMES zstd PATHS ${DSN_THIRDPARTY_ROOT}/lib)
+        if(NOT ZSTD_INCLUDE_DIR OR NOT ZSTD_LIBRARY)
+            message(FATAL_ERROR "zstd is not found, install it or build with -DENABLE_COMPRESSION=OFF")
+        endif()
+        message(STATUS "ZSTD_LIBRARY = ${ZSTD_LIBRARY}")
+
+        set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${LZ4_LIBRARY} ${ZSTD_LIBRARY})
+        add_definitions(-DDSN_ENABLE_COMPRESSION)
+    endif()
+
     set(DSN_SYSTEM_LIBS
         ${DSN_SYSTEM_LIBS}
         ${CMAKE_THREAD_LIBS_INIT} # the thread library found by FindThreads
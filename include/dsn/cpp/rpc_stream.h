@@ -49,11 +49,12 @@ public:
     {
         _msg = msg;
 
-        ::dsn::blob bb;
-        bool r = ((::dsn::message_ex *)_msg)->read_next(bb);
+        // the received data may be in multiple segments
+        std::vector<::dsn::blob> bbs;
+        bool r = ((::dsn::message_ex *)_msg)->read_next(bbs);
         dassert(r, "read msg must have one segment of buffer ready");
 
-        init(std::move(bb));
+        init(std::move(bbs));
     }
 
     ~rpc_read_stream()
@@ -100,6 +101,21 @@ public:
         commit_buffer();
     }
 
+    // large blobs with managed memory are appended to the message without copying,
+    // so that the data is sent to the network directly from their own memory
+    virtual void write_data(const blob &bb) override
+    {
+        if (bb.length() < ZERO_COPY_MIN_BYTES || bb.buffer() == nullptr) {
+            binary_writer::write_data(bb);
+            return;
+        }
+
+        flush();
+        _msg->write_append(bb);
+    }
+
+    static const unsigned int ZERO_COPY_MIN_BYTES = 64 * 1024;
+
 private:
     virtual void create_new_buffer(size_t size, /*out*/ blob &bb) override
     {
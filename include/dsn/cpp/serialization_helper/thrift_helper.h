@@ -91,6 +91,8 @@ public:
         _writer.write((const char *)buf, static_cast<int>(len));
     }
 
+    void write_data(const blob &bb) { _writer.write_data(bb); }
+
 private:
     binary_writer &_writer;
 };
@@ -462,6 +464,16 @@ inline uint32_t blob::write(apache::thrift::protocol::TProtocol *oprot) const
 {
     apache::thrift::protocol::TBinaryProtocol *binary_proto =
         static_cast<apache::thrift::protocol::TBinaryProtocol *>(oprot);
+
+    // pass the blob to the writer as a whole, so that the writer may avoid copying it
+    auto trans = dynamic_cast<apache::thrift::protocol::TBinaryProtocol *>(oprot) != nullptr
+                     ? dynamic_cast<binary_writer_transport *>(binary_proto->getTransport().get())
+                     : nullptr;
+    if (trans != nullptr) {
+        uint32_t xfer = binary_proto->writeI32(static_cast<int32_t>(length()));
+        trans->write_data(*this);
+        return xfer + length();
+    }
     return binary_proto->writeString<blob_string>(blob_string(const_cast<blob &>(*this)));
 }
 
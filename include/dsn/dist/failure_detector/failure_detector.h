@@ -122,6 +122,10 @@ public:
 
     virtual bool is_master_connected(::dsn::rpc_address node) const;
 
+    // Returns the time (in milliseconds) until which this worker is regarded as alive by
+    // the connected masters, or 0 if no master is connected.
+    uint64_t get_master_lease_expire_ms() const;
+
     // ATTENTION: be very careful to set is_connected to false as
     // workers are always considered *connected* initially which is ok even when workers think
     // master is disconnected
@@ -44,7 +44,14 @@ public:
     /// Duplicate the provided mutations to the remote cluster.
     /// The implementation must be non-blocking.
     ///
-    /// \param cb: Call it when all the given mutations were sent successfully
+    /// By default a batch is only duplicated after the callback of the previous one is
+    /// called. If `dup_max_inflight_batches` is raised above 1, multiple batches may be
+    /// in flight at the same time, i.e. `duplicate` can be called again before the
+    /// callbacks of the previous batches are called, so the implementation must be safe
+    /// to ship them concurrently before the option is raised.
+    ///
+    /// \param cb: Call it when all the given mutations were sent successfully.
+    ///            It must be called in the environment given by `set_task_environment`.
     virtual void duplicate(mutation_tuple_set mutations, callback cb) = 0;
 
     // Singleton creator of mutation_duplicator.
@@ -137,6 +137,11 @@ MAKE_EVENT_CODE_RPC(RPC_QUERY_PN_DECREE, TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_RPC(RPC_QUERY_REPLICA_INFO, TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_RPC(RPC_PREPARE, TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE(LPC_DELAY_PREPARE, TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE_RPC(RPC_PREPARE_BATCH, TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE_RPC(RPC_PREPARE_ACK_BATCH, TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE(LPC_COALESCED_PREPARE, TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE(LPC_PREPARE_COALESCE_FLUSH, TASK_PRIORITY_HIGH)
+MAKE_EVENT_CODE(LPC_PREPARE_COALESCE_TIMEOUT_CHECK, TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE_RPC(RPC_GROUP_CHECK, TASK_PRIORITY_HIGH)
 MAKE_EVENT_CODE_RPC(RPC_QUERY_APP_INFO, TASK_PRIORITY_COMMON)
 MAKE_EVENT_CODE_RPC(RPC_LEARN, TASK_PRIORITY_HIGH)
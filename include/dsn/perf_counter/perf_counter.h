@@ -38,6 +38,7 @@ typedef enum dsn_perf_counter_type_t {
     COUNTER_TYPE_VOLATILE_NUMBER, // special kind of NUMBER which will be reset on get
     COUNTER_TYPE_RATE,
     COUNTER_TYPE_NUMBER_PERCENTILES,
+    COUNTER_TYPE_NUMBER_HISTOGRAM, // NUMBER_PERCENTILES backed by a log-linear histogram
     COUNTER_TYPE_COUNT,
     COUNTER_TYPE_INVALID
 } dsn_perf_counter_type_t;
@@ -59,6 +60,12 @@ dsn_perf_counter_type_t dsn_counter_type_from_string(const char *str);
 const char *dsn_percentile_type_to_string(dsn_perf_counter_percentile_type_t t);
 dsn_perf_counter_percentile_type_t dsn_percentile_type_from_string(const char *str);
 
+// whether the counter is read by get_percentile()
+inline bool dsn_counter_type_has_percentiles(dsn_perf_counter_type_t t)
+{
+    return t == COUNTER_TYPE_NUMBER_PERCENTILES || t == COUNTER_TYPE_NUMBER_HISTOGRAM;
+}
+
 namespace dsn {
 
 class perf_counter : public ref_counter
@@ -84,6 +91,22 @@ public:
     virtual int64_t get_integer_value() = 0;
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type) = 0;
 
+    // return the value as get_value() does, but without resetting the counters whose value is
+    // reset when it's got, e.g. VOLATILE_NUMBER and RATE, so it can be read by any observer
+    virtual double peek_value() { return get_value(); }
+
+    // return the q-quantile (0 < q <= 1) of the recent samples, only supported by
+    // NUMBER_HISTOGRAM counters
+    virtual double get_quantile(double q) { return 0.0; }
+
+    // return the count and the sum of all the samples recorded so far, only supported by the
+    // counters with percentiles
+    virtual void get_summary(/*out*/ uint64_t &count, /*out*/ double &sum)
+    {
+        count = 0;
+        sum = 0.0;
+    }
+
     typedef std::vector<std::pair<int64_t *, int>> samples_t;
 
     // return actual sample count, must <= required_sample_count
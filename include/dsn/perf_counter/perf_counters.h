@@ -74,6 +74,13 @@ public:
 
     perf_counter_ptr get_counter(const std::string &full_name);
 
+    ///
+    /// visit all the registered counters, which are read directly rather than from the snapshot.
+    /// the visitor is called outside of the lock of the registry.
+    ///
+    typedef std::function<void(const perf_counter_ptr &)> counter_visitor;
+    void iterate_counters(const counter_visitor &v) const;
+
     struct counter_snapshot
     {
         double value{0.0};
@@ -34,45 +34,72 @@
 #include <dsn/utility/utils.h>
 #include <dsn/utility/blob.h>
 #include <dsn/utility/dlib.h>
+#include <deque>
 #include <vector>
 
 namespace dsn {
 
-// TODO(wutao1): call it read_buffer, and make it an utility
+// message_reader keeps the received data in a chain of blocks. Blocks of the default size are
+// recycled through a process-wide pool, because they are referenced by the received messages
+// after the reader moves on.
+//
+// The data already read is never moved when the read buffer is extended, so a message which
+// spans blocks is seen by the parsers as multiple blobs, see get_buffers().
+//
 // Not-Thread-Safe.
 class message_reader
 {
 public:
     explicit message_reader(int buffer_block_size)
-        : _buffer_occupied(0), _buffer_block_size(buffer_block_size)
+        : _tail_occupied(0), _length(0), _copied_bytes(0), _buffer_block_size(buffer_block_size)
     {
     }
 
-    // called before read to extend read buffer
+    // called before read to extend read buffer,
+    // the returned buffer has at least `read_next` bytes of capacity
     DSN_API char *read_buffer_ptr(unsigned int read_next);
 
     // get remaining buffer capacity
-    unsigned int read_buffer_capacity() const { return _buffer.length() - _buffer_occupied; }
+    unsigned int read_buffer_capacity() const { return _tail.length() - _tail_occupied; }
 
     // called after read to mark data occupied
-    void mark_read(unsigned int read_length) { _buffer_occupied += read_length; }
+    void mark_read(unsigned int read_length)
+    {
+        _tail_occupied += read_length;
+        _length += read_length;
+    }
 
     // discard read data
-    void truncate_read() { _buffer_occupied = 0; }
+    DSN_API void truncate_read();
 
-    // mark the tailing `sz` of bytes are consumed and discardable.
-    void consume_buffer(size_t sz)
-    {
-        _buffer = _buffer.range(sz);
-        _buffer_occupied -= sz;
-    }
+    // mark the leading `sz` of bytes are consumed and discardable.
+    DSN_API void consume_buffer(size_t sz);
 
-    blob buffer() const { return _buffer.range(0, _buffer_occupied); }
+    // total size of the unconsumed data
+    unsigned int length() const { return _length; }
 
-public:
-    // TODO(wutao1): make them private members
-    blob _buffer;
-    unsigned int _buffer_occupied;
+    // the leading `sz` bytes as a contiguous blob, which are copied only if they span blocks.
+    DSN_API blob front(size_t sz);
+
+    // all the unconsumed data as a contiguous blob.
+    blob buffer() { return front(_length); }
+
+    // views of the leading `sz` bytes, one for each block they span, without copy.
+    DSN_API void get_buffers(size_t sz, /*out*/ std::vector<blob> &buffers) const;
+
+    // total bytes copied to make the data contiguous.
+    uint64_t copied_bytes() const { return _copied_bytes; }
+
+    unsigned int buffer_block_size() const { return _buffer_block_size; }
+
+private:
+    friend class message_reader_test;
+
+    std::deque<blob> _blocks;    // the data in the blocks before _tail
+    blob _tail;                  // the block being read into
+    unsigned int _tail_occupied; // the data in _tail is [0, _tail_occupied)
+    unsigned int _length;
+    uint64_t _copied_bytes;
     const unsigned int _buffer_block_size;
 };
 
@@ -32,6 +32,7 @@
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/utility/exp_delay.h>
 #include <dsn/utility/dlib.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <atomic>
 
 namespace dsn {
@@ -174,6 +175,9 @@ public:
     // to be defined
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) = 0;
 
+    // bytes copied on receiving a message, to make the data spanning read blocks contiguous
+    void on_recv_copied_bytes(uint64_t bytes) { _recv_copied_bytes_per_message->set(bytes); }
+
 protected:
     typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> client_sessions;
     client_sessions _clients; // to_address => rpc_session
@@ -186,6 +190,8 @@ protected:
     utils::rw_lock_nr _servers_lock;
 
     uint32_t _cfg_conn_threshold_per_ip;
+
+    perf_counter_wrapper _recv_copied_bytes_per_message;
 };
 
 /*!
@@ -297,6 +303,7 @@ protected:
     dsn::rpc_address _remote_addr;
     int _max_buffer_block_count_per_send;
     message_reader _reader;
+    uint64_t _reader_copied_bytes; // _reader.copied_bytes() when the last message is received
     message_parser_ptr _parser;
 
 private:
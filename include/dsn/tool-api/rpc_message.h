@@ -67,7 +67,8 @@ typedef union msg_context
     {
         uint64_t is_request : 1;           ///< whether the RPC message is a request or response
         uint64_t is_forwarded : 1;         ///< whether the msg is forwarded or not
-        uint64_t unused : 4;               ///< not used yet
+        uint64_t compression_type : 2;     ///< utils::compression_type of the body
+        uint64_t unused : 2;               ///< not used yet
         uint64_t serialize_format : 4;     ///< dsn_msg_serialize_format
         uint64_t is_forward_supported : 1; ///< whether support forwarding a message to real leader
         uint64_t is_backup_request : 1;    ///< whether the RPC is a backup request
@@ -164,6 +165,13 @@ public:
     // routines for create messages
     //
     DSN_API static message_ex *create_receive_message(const blob &data);
+
+    /// Create a received message from the views of its data without copy,
+    /// the whole message_header must be in data[0].
+    /// The returned message:
+    ///   - msg->buffers[0] = data[0] without message_header
+    ///   - msg->buffers[i] = data[i]
+    DSN_API static message_ex *create_receive_message(const std::vector<blob> &data);
     DSN_API static message_ex *create_request(dsn::task_code rpc_code,
                                               int timeout_milliseconds = 0,
                                               int thread_hash = 0,
@@ -182,6 +190,12 @@ public:
     ///   - msg->buffers[1] = data
     DSN_API static message_ex *create_receive_message_with_standalone_header(const blob &data);
 
+    /// The returned message:
+    ///   - msg->buffers[0] = message_header
+    ///   - msg->buffers[i + 1] = data[i]
+    DSN_API static message_ex *
+    create_receive_message_with_standalone_header(const std::vector<blob> &data);
+
     /// copy message without client information, it will not reply
     /// The returned message:
     ///   - msg->buffers[0] = message_header
@@ -203,8 +217,14 @@ public:
     //
     DSN_API void write_next(void **ptr, size_t *size, size_t min_size);
     DSN_API void write_commit(size_t size);
+    // append bb to the body as a standalone buffer without copying,
+    // bb must not be modified until the message is released.
+    DSN_API void write_append(const blob &bb);
     DSN_API bool read_next(void **ptr, size_t *size);
     bool read_next(blob &data);
+    // get all the remaining data, which may be in multiple buffers
+    bool read_next(std::vector<blob> &data);
+    // the committed size may go across buffers if the data is read by read_next(vector)
     DSN_API void read_commit(size_t size);
     size_t body_size() { return (size_t)header->body_length; }
     DSN_API void *rw_ptr(size_t offset_begin);
@@ -42,6 +42,7 @@
 #include <dsn/utility/join_point.h>
 #include <dsn/utility/extensible_object.h>
 #include <dsn/utility/exp_delay.h>
+#include <dsn/utility/compression.h>
 #include <dsn/utility/dlib.h>
 #include <dsn/perf_counter/perf_counter.h>
 #include <dsn/tool-api/auto_codes.h>
@@ -186,6 +187,12 @@ public:
     dsn_msg_serialize_format rpc_msg_payload_serialize_default_format;
     rpc_channel rpc_call_channel;
     bool rpc_message_crc_required;
+    // codec to compress the message bodies with: none, lz4 or zstd.
+    // the receivers must understand the compressed bodies, so only enable it after all the
+    // nodes are upgraded.
+    std::string rpc_message_compression;
+    int32_t rpc_message_compression_min_bytes; // smaller bodies are sent as is
+    utils::compression_type rpc_message_compression_type; // parsed from rpc_message_compression
 
     int32_t rpc_timeout_milliseconds;
     int32_t rpc_request_resend_timeout_milliseconds;  // 0 for no auto-resend
@@ -228,6 +235,8 @@ public:
 
     // message data flow
     join_point<void, message_ex *, message_ex *> on_rpc_create_response;
+    join_point<void, message_ex *, uint32_t, uint64_t>
+        on_rpc_body_compression; // compressed msg, raw body length, (de)compression time (ns)
     /*@}*/
 
 public:
@@ -294,6 +303,14 @@ CONFIG_FLD(bool,
            rpc_message_crc_required,
            false,
            "whether to calculate the crc checksum when send request/response")
+CONFIG_FLD_STRING(rpc_message_compression,
+                  "none",
+                  "the codec to compress the request/response bodies with: none, lz4 or zstd")
+CONFIG_FLD(int32_t,
+           uint64,
+           rpc_message_compression_min_bytes,
+           4096,
+           "the bodies smaller than this won't be compressed")
 CONFIG_FLD(int32_t,
            uint64,
            rpc_timeout_milliseconds,
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstring>
+#include <vector>
 #include <dsn/utility/blob.h>
 
 namespace dsn {
@@ -18,6 +19,9 @@ public:
 
     void init(const blob &bb);
     void init(blob &&bb);
+    // read from the concatenation of the segments, which are copied only
+    // when a single read spans them
+    void init(std::vector<blob> &&segments);
 
     template <typename T>
     int read_pod(/*out*/ T &val);
@@ -43,31 +47,42 @@ public:
     int read(blob &blob);
     int read(blob &blob, int len);
 
-    blob get_buffer() const { return _blob; }
-    blob get_remaining_buffer() const { return _blob.range(static_cast<int>(_ptr - _blob.data())); }
-    bool is_eof() const { return _ptr >= _blob.data() + _size; }
+    blob get_buffer() const;
+    blob get_remaining_buffer() const;
+    bool is_eof() const { return _remaining_size <= 0; }
     int total_size() const { return _size; }
     int get_remaining_size() const { return _remaining_size; }
 
 private:
-    blob _blob;
+    // remaining size in the current segment
+    int segment_remaining_size() const
+    {
+        return static_cast<int>(_blob.data() + _blob.length() - _ptr);
+    }
+    void next_segment();
+
+private:
+    blob _blob; // the current segment
     int _size;
     const char *_ptr;
     int _remaining_size;
+
+    // all the segments if more than one are given, _blob is _segments[_segment_index]
+    std::vector<blob> _segments;
+    size_t _segment_index{0};
 };
 
 template <typename T>
 inline int binary_reader::read_pod(/*out*/ T &val)
 {
-    if (sizeof(T) <= get_remaining_size()) {
+    if (sizeof(T) <= segment_remaining_size()) {
         memcpy((void *)&val, _ptr, sizeof(T));
         _ptr += sizeof(T);
         _remaining_size -= sizeof(T);
         return static_cast<int>(sizeof(T));
     } else {
-        // read beyond the end of buffer
-        assert(false);
-        return 0;
+        // the value spans segments, or read beyond the end of buffer
+        return read((char *)&val, static_cast<int>(sizeof(T)));
     }
 }
 }
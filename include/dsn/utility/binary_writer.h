@@ -37,6 +37,10 @@ public:
     void write(const blob &val);
     void write_empty(int sz);
 
+    // write the data of bb without its length.
+    // the writer may reference bb instead of copying it, see rpc_write_stream.
+    virtual void write_data(const blob &bb) { write(bb.data(), bb.length()); }
+
     bool next(void **data, int *size);
     bool backup(int count);
 
@@ -91,10 +95,9 @@ inline void binary_writer::write(const std::string &val)
 
 inline void binary_writer::write(const blob &val)
 {
-    // TODO: optimization by not memcpy
     int len = val.length();
     write((const char *)&len, sizeof(int));
     if (len > 0)
-        write((const char *)val.data(), len);
+        write_data(val);
 }
 }
@@ -0,0 +1,43 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <dsn/utility/blob.h>
+#include <dsn/utility/string_view.h>
+
+namespace dsn {
+namespace utils {
+
+// The codecs used to compress data blocks. The values are persisted along with the compressed
+// data, so they must never be changed.
+enum class compression_type : uint8_t
+{
+    NONE = 0,
+    LZ4 = 1,
+    ZSTD = 2,
+};
+
+// Parses "none", "lz4" or "zstd".
+bool compression_type_from_string(string_view name, /*out*/ compression_type &type);
+
+const char *compression_type_to_string(compression_type type);
+
+// Returns whether the codec is built in. The codecs other than NONE are only built with
+// the cmake option ENABLE_COMPRESSION, which is off by default.
+bool compression_supported(compression_type type);
+
+// Compresses `input` with codec `type`.
+// Returns false if the codec is not supported, or if the compressed data is no smaller than
+// `input`, in which case it's pointless to compress it.
+bool compress(compression_type type, string_view input, /*out*/ blob &output);
+
+// Decompresses `input`, whose size before compression is `raw_size`.
+// Returns false if the codec is not supported or the data is corrupted, including when
+// `raw_size` is impossible for `input`, which is checked before allocating the output.
+bool decompress(compression_type type, string_view input, size_t raw_size, /*out*/ blob &output);
+
+} // namespace utils
+} // namespace dsn
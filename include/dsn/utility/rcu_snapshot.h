@@ -0,0 +1,165 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace utils {
+
+namespace rcu_detail {
+
+// Each thread owns a reader slot index, which is returned for reuse when the thread exits.
+class reader_slot_allocator
+{
+public:
+    static int allocate()
+    {
+        std::lock_guard<std::mutex> l(lock());
+        auto &free_slots = free_list();
+        if (!free_slots.empty()) {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            return slot;
+        }
+        return next_slot()++;
+    }
+
+    static void release(int slot)
+    {
+        std::lock_guard<std::mutex> l(lock());
+        free_list().push_back(slot);
+    }
+
+private:
+    static std::mutex &lock()
+    {
+        static std::mutex l;
+        return l;
+    }
+    static std::vector<int> &free_list()
+    {
+        static std::vector<int> slots;
+        return slots;
+    }
+    static int &next_slot()
+    {
+        static int slot = 0;
+        return slot;
+    }
+};
+
+struct thread_reader_slot
+{
+    thread_reader_slot() : index(reader_slot_allocator::allocate()) {}
+    ~thread_reader_slot() { reader_slot_allocator::release(index); }
+    const int index;
+};
+
+inline int current_reader_slot()
+{
+    // a plain int is cheaper to access than a thread_local object with a destructor
+    static thread_local int index = -1;
+    if (index < 0) {
+        static thread_local thread_reader_slot slot;
+        index = slot.index;
+    }
+    return index;
+}
+
+} // namespace rcu_detail
+
+//
+// rcu_snapshot holds an immutable version of T, which is read without any shared lock and
+// replaced as a whole by publish().
+//
+// Readers are protected by epochs: a reader records the current epoch in its own cache line
+// while it reads, and publish() doesn't release the old version until every reader that may
+// have seen it is gone. Threads beyond `max_reader_slots` fall back to a read lock.
+//
+// - read() must not be nested on the same rcu_snapshot, and the reader must not block.
+// - publish() must be serialized by the caller, and must not be called inside read().
+//
+template <typename T>
+class rcu_snapshot
+{
+public:
+    static const int max_reader_slots = 512;
+
+    explicit rcu_snapshot(std::shared_ptr<const T> value = std::make_shared<const T>())
+        : _slots(new reader_slot[max_reader_slots])
+    {
+        _holder = std::move(value);
+        _current.store(_holder.get());
+    }
+
+    template <typename Reader>
+    auto read(Reader &&reader) const -> decltype(reader(std::declval<const T &>()))
+    {
+        int index = rcu_detail::current_reader_slot();
+        if (index >= max_reader_slots) {
+            auto_read_lock l(_fallback_lock);
+            return reader(*_current.load());
+        }
+
+        std::atomic<uint64_t> &epoch = _slots[index].epoch;
+        epoch.store(_epoch.load());
+        struct reader_guard
+        {
+            std::atomic<uint64_t> &epoch;
+            ~reader_guard() { epoch.store(0, std::memory_order_release); }
+        } guard{epoch};
+        return reader(*_current.load());
+    }
+
+    // the version last published, only for the writer
+    const std::shared_ptr<const T> &get() const { return _holder; }
+
+    void publish(std::shared_ptr<const T> value)
+    {
+        std::shared_ptr<const T> old = std::move(_holder);
+        _holder = std::move(value);
+        _current.store(_holder.get());
+        uint64_t new_epoch = _epoch.fetch_add(1) + 1;
+
+        // wait for the readers that started in an older epoch, they're short
+        for (int i = 0; i < max_reader_slots; i++) {
+            for (;;) {
+                uint64_t e = _slots[i].epoch.load();
+                if (e == 0 || e >= new_epoch) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        { auto_write_lock l(_fallback_lock); }
+
+        // the old version is released here
+    }
+
+private:
+    // padded so that the slots of different threads are never in the same cache line
+    struct reader_slot
+    {
+        // 0 if not reading, otherwise the epoch when the read starts
+        std::atomic<uint64_t> epoch{0};
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    std::shared_ptr<const T> _holder;
+    std::atomic<const T *> _current{nullptr};
+    std::atomic<uint64_t> _epoch{1};
+    std::unique_ptr<reader_slot[]> _slots;
+    mutable rw_lock_nr _fallback_lock;
+};
+
+} // namespace utils
+} // namespace dsn
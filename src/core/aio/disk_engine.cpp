@@ -26,6 +26,7 @@
 
 #include "disk_engine.h"
 #include "sim_aio_provider.h"
+#include "io_uring_aio_provider.h"
 #include "core/core/service_engine.h"
 
 using namespace dsn::utils;
@@ -141,6 +142,19 @@ disk_engine::disk_engine()
     // use native_linux_aio_provider in default
     if (!strcmp(FLAGS_aio_factory_name, "dsn::tools::sim_aio_provider")) {
         _provider.reset(new aio::sim_aio_provider(this, nullptr));
+    } else if (!strcmp(FLAGS_aio_factory_name, "dsn::tools::io_uring_aio_provider")) {
+#ifdef DSN_HAS_IO_URING
+        std::unique_ptr<io_uring_aio_provider> provider(new io_uring_aio_provider(this, nullptr));
+        if (provider->is_ready()) {
+            _provider = std::move(provider);
+        } else {
+            dwarn("io_uring is not available, fall back to native_linux_aio_provider");
+            _provider.reset(new native_linux_aio_provider(this, nullptr));
+        }
+#else
+        dwarn("io_uring is not supported by this build, fall back to native_linux_aio_provider");
+        _provider.reset(new native_linux_aio_provider(this, nullptr));
+#endif
     } else {
         _provider.reset(new native_linux_aio_provider(this, nullptr));
     }
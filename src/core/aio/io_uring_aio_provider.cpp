@@ -0,0 +1,432 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "io_uring_aio_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <dsn/tool_api.h>
+#include <dsn/utility/flags.h>
+#include <dsn/utility/safe_strerror_posix.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dsn {
+
+DSN_DEFINE_uint32("tools.io_uring_aio_provider",
+                  queue_depth,
+                  256,
+                  "number of submission queue entries of the ring");
+DSN_DEFINE_bool("tools.io_uring_aio_provider",
+                flush_with_fdatasync,
+                false,
+                "whether flush() only syncs the file data (fdatasync) instead of fsync");
+
+namespace {
+const uint64_t SYNC_REQUEST_TAG = 1;
+const uint64_t WAKEUP_USER_DATA = 0;
+
+template <typename T>
+T *ring_field(void *ring, uint32_t offset)
+{
+    return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+} // anonymous namespace
+
+io_uring_aio_provider::io_uring_aio_provider(disk_engine *disk, aio_provider *inner_provider)
+    : aio_provider(disk, inner_provider),
+      _ring_fd(-1),
+      _sq_ptr(MAP_FAILED),
+      _sq_ring_size(0),
+      _cq_ptr(MAP_FAILED),
+      _cq_ring_size(0),
+      _sqes(static_cast<struct io_uring_sqe *>(MAP_FAILED)),
+      _sq_entries(0),
+      _cq_entries(0)
+{
+    if (!setup_ring(FLAGS_queue_depth)) {
+        destroy_ring();
+        return;
+    }
+
+    _is_running = true;
+    _worker = std::thread([this]() {
+        task::set_tls_dsn_context(node(), nullptr);
+
+        const char *name = ::dsn::tools::get_service_node_name(node());
+        char buffer[128];
+        sprintf(buffer, "%s.aio", name);
+        task_worker::set_name(buffer);
+
+        reap_completions();
+    });
+}
+
+io_uring_aio_provider::~io_uring_aio_provider()
+{
+    if (_is_running.exchange(false)) {
+        // wake up the completion thread
+        submit([](struct io_uring_sqe *sqe) {
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = WAKEUP_USER_DATA;
+        });
+        _worker.join();
+    }
+    destroy_ring();
+}
+
+bool io_uring_aio_provider::setup_ring(unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    _ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+    if (_ring_fd < 0) {
+        derror("io_uring_setup failed, err = %s", utils::safe_strerror(errno).c_str());
+        return false;
+    }
+
+    _sq_entries = p.sq_entries;
+    _cq_entries = p.cq_entries;
+    _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+#endif
+
+    _sq_ptr = mmap(nullptr,
+                   _sq_ring_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE,
+                   _ring_fd,
+                   IORING_OFF_SQ_RING);
+    if (_sq_ptr == MAP_FAILED) {
+        derror("mmap io_uring sq ring failed, err = %s", utils::safe_strerror(errno).c_str());
+        return false;
+    }
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _cq_ptr = _sq_ptr;
+    } else
+#endif
+    {
+        _cq_ptr = mmap(nullptr,
+                       _cq_ring_size,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE,
+                       _ring_fd,
+                       IORING_OFF_CQ_RING);
+        if (_cq_ptr == MAP_FAILED) {
+            derror("mmap io_uring cq ring failed, err = %s", utils::safe_strerror(errno).c_str());
+            return false;
+        }
+    }
+
+    _sqes = static_cast<struct io_uring_sqe *>(mmap(nullptr,
+                                                    p.sq_entries * sizeof(struct io_uring_sqe),
+                                                    PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE,
+                                                    _ring_fd,
+                                                    IORING_OFF_SQES));
+    if (_sqes == MAP_FAILED) {
+        derror("mmap io_uring sqes failed, err = %s", utils::safe_strerror(errno).c_str());
+        return false;
+    }
+
+    _sq.head = ring_field<unsigned>(_sq_ptr, p.sq_off.head);
+    _sq.tail = ring_field<unsigned>(_sq_ptr, p.sq_off.tail);
+    _sq.ring_mask = ring_field<unsigned>(_sq_ptr, p.sq_off.ring_mask);
+    _sq.flags = ring_field<unsigned>(_sq_ptr, p.sq_off.flags);
+    _sq.array = ring_field<unsigned>(_sq_ptr, p.sq_off.array);
+    _cq.head = ring_field<unsigned>(_cq_ptr, p.cq_off.head);
+    _cq.tail = ring_field<unsigned>(_cq_ptr, p.cq_off.tail);
+    _cq.ring_mask = ring_field<unsigned>(_cq_ptr, p.cq_off.ring_mask);
+    _cq.overflow = ring_field<unsigned>(_cq_ptr, p.cq_off.overflow);
+    _cq.cqes = ring_field<struct io_uring_cqe>(_cq_ptr, p.cq_off.cqes);
+
+    ddebug("io_uring is set up with %u sq entries and %u cq entries",
+           p.sq_entries,
+           p.cq_entries);
+    return true;
+}
+
+void io_uring_aio_provider::destroy_ring()
+{
+    if (_sqes != MAP_FAILED) {
+        munmap(_sqes, _sq_entries * sizeof(struct io_uring_sqe));
+    }
+    if (_cq_ptr != MAP_FAILED && _cq_ptr != _sq_ptr) {
+        munmap(_cq_ptr, _cq_ring_size);
+    }
+    if (_sq_ptr != MAP_FAILED) {
+        munmap(_sq_ptr, _sq_ring_size);
+    }
+    if (_ring_fd >= 0) {
+        ::close(_ring_fd);
+        _ring_fd = -1;
+    }
+}
+
+dsn_handle_t io_uring_aio_provider::open(const char *file_name, int flag, int pmode)
+{
+    dsn_handle_t fh = (dsn_handle_t)(uintptr_t)::open(file_name, flag, pmode);
+    if (fh == DSN_INVALID_FILE_HANDLE) {
+        derror("create file failed, err = %s", utils::safe_strerror(errno).c_str());
+    }
+    return fh;
+}
+
+error_code io_uring_aio_provider::close(dsn_handle_t fh)
+{
+    if (fh == DSN_INVALID_FILE_HANDLE || ::close((int)(uintptr_t)(fh)) == 0) {
+        return ERR_OK;
+    } else {
+        derror("close file failed, err = %s", utils::safe_strerror(errno).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+}
+
+error_code io_uring_aio_provider::flush(dsn_handle_t fh)
+{
+    if (fh == DSN_INVALID_FILE_HANDLE) {
+        return ERR_OK;
+    }
+
+    sync_request req;
+    submit([fh, &req](struct io_uring_sqe *sqe) {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = (int)(uintptr_t)(fh);
+        sqe->fsync_flags = FLAGS_flush_with_fdatasync ? IORING_FSYNC_DATASYNC : 0;
+        sqe->user_data = reinterpret_cast<uint64_t>(&req) | SYNC_REQUEST_TAG;
+    });
+    req.evt.wait();
+
+    if (req.res < 0) {
+        derror("flush file failed, err = %s", utils::safe_strerror(-req.res).c_str());
+        return ERR_FILE_OPERATION_FAILED;
+    }
+    return ERR_OK;
+}
+
+aio_context *io_uring_aio_provider::prepare_aio_context(aio_task *tsk)
+{
+    return new uring_disk_aio_context(tsk);
+}
+
+void io_uring_aio_provider::aio(aio_task *aio_tsk)
+{
+    auto ctx = static_cast<uring_disk_aio_context *>(aio_tsk->get_aio_context());
+    ctx->iovs.clear();
+
+    uint8_t opcode;
+    switch (ctx->type) {
+    case AIO_Read:
+        opcode = IORING_OP_READV;
+        ctx->iovs.push_back({ctx->buffer, ctx->buffer_size});
+        break;
+    case AIO_Write:
+        opcode = IORING_OP_WRITEV;
+        if (ctx->buffer) {
+            ctx->iovs.push_back({ctx->buffer, ctx->buffer_size});
+        } else {
+            ctx->iovs.reserve(ctx->write_buffer_vec->size());
+            for (const dsn_file_buffer_t &buf : *ctx->write_buffer_vec) {
+                ctx->iovs.push_back({buf.buffer, static_cast<size_t>(buf.size)});
+            }
+        }
+        break;
+    default:
+        derror("unknown aio type %u", static_cast<int>(ctx->type));
+        complete_io(aio_tsk, ERR_FILE_OPERATION_FAILED, 0);
+        return;
+    }
+
+    submit([ctx, opcode](struct io_uring_sqe *sqe) {
+        sqe->opcode = opcode;
+        sqe->fd = static_cast<int>((ssize_t)ctx->file);
+        sqe->off = ctx->file_offset;
+        sqe->addr = reinterpret_cast<uint64_t>(ctx->iovs.data());
+        sqe->len = static_cast<uint32_t>(ctx->iovs.size());
+        sqe->user_data = reinterpret_cast<uint64_t>(ctx);
+    });
+}
+
+template <typename TFill>
+void io_uring_aio_provider::submit(TFill &&fill)
+{
+    while (true) {
+        {
+            std::lock_guard<std::mutex> l(_sq_lock);
+            struct io_uring_sqe *sqe = get_sqe();
+            if (sqe != nullptr) {
+                memset(sqe, 0, sizeof(*sqe));
+                fill(sqe);
+
+                unsigned tail = *_sq.tail;
+                _sq.array[tail & *_sq.ring_mask] = static_cast<unsigned>(sqe - _sqes);
+                __atomic_store_n(_sq.tail, tail + 1, __ATOMIC_RELEASE);
+                _inflight.fetch_add(1);
+                _sq_pending.fetch_add(1);
+                break;
+            }
+        }
+
+        // the ring is full of SQEs not yet seen by the kernel, hand them over right now, or
+        // there're too many requests in flight, wait for the completion thread to reap them
+        submit_pending();
+        std::this_thread::yield();
+    }
+
+    submit_pending();
+}
+
+struct io_uring_sqe *io_uring_aio_provider::get_sqe()
+{
+    if (_inflight.load() >= _cq_entries) {
+        return nullptr;
+    }
+    unsigned head = __atomic_load_n(_sq.head, __ATOMIC_ACQUIRE);
+    unsigned tail = *_sq.tail;
+    if (tail - head >= _sq_entries) {
+        return nullptr;
+    }
+    return &_sqes[tail & *_sq.ring_mask];
+}
+
+void io_uring_aio_provider::submit_pending()
+{
+    // only one thread enters the kernel at a time, it submits the SQEs of all the
+    // threads which arrived meanwhile in one batch
+    while (_sq_pending.load() > 0) {
+        if (_submitting.exchange(true)) {
+            return;
+        }
+
+        unsigned to_submit = _sq_pending.exchange(0);
+        while (to_submit > 0) {
+            int ret = enter(to_submit, 0, 0);
+            if (ret >= 0) {
+                to_submit -= std::min(static_cast<unsigned>(ret), to_submit);
+                if (ret == 0) {
+                    // try again with the other pending SQEs later
+                    break;
+                }
+            } else if (ret == -EINTR || ret == -EAGAIN || ret == -EBUSY) {
+                // EBUSY: the CQ overflowed, the completion thread will flush it
+                std::this_thread::yield();
+            } else {
+                derror("io_uring_enter failed, err = %s", utils::safe_strerror(-ret).c_str());
+                fail_unsubmitted(ret);
+                to_submit = 0;
+            }
+        }
+        _sq_pending.fetch_add(to_submit);
+
+        _submitting.store(false);
+    }
+}
+
+void io_uring_aio_provider::fail_unsubmitted(int res)
+{
+    // only called by the submitting thread, so the kernel won't consume the SQEs meanwhile
+    std::vector<uint64_t> failed;
+    {
+        std::lock_guard<std::mutex> l(_sq_lock);
+        unsigned head = __atomic_load_n(_sq.head, __ATOMIC_ACQUIRE);
+        unsigned tail = *_sq.tail;
+        for (unsigned i = head; i != tail; ++i) {
+            failed.push_back(_sqes[_sq.array[i & *_sq.ring_mask]].user_data);
+        }
+        // take back the SQEs from the ring
+        __atomic_store_n(_sq.tail, head, __ATOMIC_RELEASE);
+        _sq_pending.store(0);
+    }
+
+    for (uint64_t user_data : failed) {
+        complete_request(user_data, res);
+    }
+    _inflight.fetch_sub(static_cast<unsigned>(failed.size()));
+}
+
+int io_uring_aio_provider::enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    int ret = static_cast<int>(
+        syscall(__NR_io_uring_enter, _ring_fd, to_submit, min_complete, flags, nullptr, 0));
+    return ret < 0 ? -errno : ret;
+}
+
+void io_uring_aio_provider::reap_completions()
+{
+    std::vector<struct io_uring_cqe> cqes;
+    unsigned overflow = __atomic_load_n(_cq.overflow, __ATOMIC_ACQUIRE);
+    while (true) {
+        // the CQEs in the overflow backlog (IORING_SQ_CQ_OVERFLOW) are flushed by
+        // IORING_ENTER_GETEVENTS as well
+        int ret = enter(0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && ret != -EINTR && ret != -EBUSY) {
+            dwarn("io_uring_enter returns %d, you probably want to try on another machine:-(", ret);
+        }
+
+        // copy all the available CQEs out first so that the kernel can reuse the slots
+        unsigned head = *_cq.head;
+        unsigned tail = __atomic_load_n(_cq.tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            cqes.push_back(_cq.cqes[head & *_cq.ring_mask]);
+        }
+        __atomic_store_n(_cq.head, head, __ATOMIC_RELEASE);
+
+        // the completions dropped on overflow can't be recovered, and their requests would
+        // never finish, which is prevented by limiting the requests in flight
+        unsigned new_overflow = __atomic_load_n(_cq.overflow, __ATOMIC_ACQUIRE);
+        dassert(new_overflow == overflow,
+                "%u completions are dropped by io_uring on cq overflow",
+                new_overflow - overflow);
+
+        for (const struct io_uring_cqe &cqe : cqes) {
+            complete_request(cqe.user_data, cqe.res);
+        }
+        _inflight.fetch_sub(static_cast<unsigned>(cqes.size()));
+        cqes.clear();
+
+        if (dsn_unlikely(!_is_running.load(std::memory_order_relaxed))) {
+            break;
+        }
+    }
+}
+
+void io_uring_aio_provider::complete_request(uint64_t user_data, int res)
+{
+    if (user_data == WAKEUP_USER_DATA) {
+        return;
+    }
+    if (user_data & SYNC_REQUEST_TAG) {
+        auto req = reinterpret_cast<sync_request *>(user_data & ~SYNC_REQUEST_TAG);
+        req->res = res;
+        req->evt.notify();
+    } else {
+        complete_aio(reinterpret_cast<uring_disk_aio_context *>(user_data), res);
+    }
+}
+
+void io_uring_aio_provider::complete_aio(uring_disk_aio_context *ctx, int res)
+{
+    error_code ec;
+    uint32_t bytes = 0;
+    if (res < 0) {
+        derror("aio error, err = %s", utils::safe_strerror(-res).c_str());
+        ec = ERR_FILE_OPERATION_FAILED;
+    } else {
+        bytes = static_cast<uint32_t>(res);
+        ec = bytes > 0 ? ERR_OK : ERR_HANDLE_EOF;
+    }
+    complete_io(ctx->tsk, ec, bytes);
+}
+
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
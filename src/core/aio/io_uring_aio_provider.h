@@ -0,0 +1,127 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+// DSN_HAS_IO_URING is defined by bin/dsn.cmake if linux/io_uring.h is found
+#ifdef DSN_HAS_IO_URING
+
+#include "aio_provider.h"
+
+#include <dsn/utility/synchronize.h>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+
+// An aio provider built on the io_uring syscalls directly (no liburing is required).
+//
+// Compared with native_linux_aio_provider:
+// - SQEs prepared concurrently are submitted to the kernel in one io_uring_enter by
+//   whichever caller gets there first, instead of one io_submit per request.
+// - The completion thread reaps every available CQE per wakeup instead of one event
+//   per io_getevents.
+// - flush() goes through the ring as IORING_OP_FSYNC (optionally fdatasync), so it is
+//   ordered with the other requests on the ring. It still blocks the caller, as the
+//   aio_provider interface requires.
+//
+// Use `[core] aio_factory_name = dsn::tools::io_uring_aio_provider` to enable it.
+// disk_engine falls back to native_linux_aio_provider if the kernel lacks io_uring.
+class io_uring_aio_provider : public aio_provider
+{
+public:
+    io_uring_aio_provider(disk_engine *disk, aio_provider *inner_provider);
+    ~io_uring_aio_provider() override;
+
+    // false if the ring could not be set up, e.g. the kernel is older than 5.1
+    bool is_ready() const { return _ring_fd >= 0; }
+
+    dsn_handle_t open(const char *file_name, int flag, int pmode) override;
+    error_code close(dsn_handle_t fh) override;
+    error_code flush(dsn_handle_t fh) override;
+    void aio(aio_task *aio) override;
+    aio_context *prepare_aio_context(aio_task *tsk) override;
+
+    class uring_disk_aio_context : public aio_context
+    {
+    public:
+        aio_task *tsk;
+        // must stay valid until the SQE is consumed by the kernel
+        std::vector<struct iovec> iovs;
+
+        explicit uring_disk_aio_context(aio_task *tsk_) : tsk(tsk_) {}
+    };
+
+private:
+    // a synchronous request, e.g. flush, whose caller waits for the completion
+    struct sync_request
+    {
+        utils::notify_event evt;
+        int res = 0;
+    };
+
+    bool setup_ring(unsigned entries);
+    void destroy_ring();
+
+    // prepare the SQE with `fill` and submit the pending SQEs
+    template <typename TFill>
+    void submit(TFill &&fill);
+    struct io_uring_sqe *get_sqe();
+    void submit_pending();
+    // completes the SQEs not yet consumed by the kernel with `res`, when they can't be submitted
+    void fail_unsubmitted(int res);
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+
+    void reap_completions();
+    void complete_request(uint64_t user_data, int res);
+    void complete_aio(uring_disk_aio_context *ctx, int res);
+
+private:
+    int _ring_fd;
+    void *_sq_ptr;
+    size_t _sq_ring_size;
+    void *_cq_ptr;
+    size_t _cq_ring_size;
+    struct io_uring_sqe *_sqes;
+    unsigned _sq_entries;
+    unsigned _cq_entries;
+
+    struct
+    {
+        unsigned *head;
+        unsigned *tail;
+        unsigned *ring_mask;
+        unsigned *flags;
+        unsigned *array;
+    } _sq;
+    struct
+    {
+        unsigned *head;
+        unsigned *tail;
+        unsigned *ring_mask;
+        unsigned *overflow;
+        struct io_uring_cqe *cqes;
+    } _cq;
+
+    // protects the SQ tail and the SQE slots
+    std::mutex _sq_lock;
+    // SQEs published in the ring but not yet passed to io_uring_enter
+    std::atomic<unsigned> _sq_pending{0};
+    // requests published in the ring but not yet reaped, which are no more than _cq_entries,
+    // so that the CQ never overflows
+    std::atomic<unsigned> _inflight{0};
+    // whether a thread is calling io_uring_enter on behalf of the others
+    std::atomic<bool> _submitting{false};
+
+    std::atomic<bool> _is_running{false};
+    std::thread _worker;
+};
+
+} // namespace dsn
+
+#endif // DSN_HAS_IO_URING
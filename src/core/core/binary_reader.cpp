@@ -1,6 +1,7 @@
 #include <dsn/utility/utils.h>
 #include <dsn/utility/binary_reader.h>
 #include <dsn/c/api_utilities.h>
+#include <algorithm>
 
 namespace dsn {
 
@@ -13,6 +14,8 @@ void binary_reader::init(const blob &bb)
     _size = bb.length();
     _ptr = bb.data();
     _remaining_size = _size;
+    _segments.clear();
+    _segment_index = 0;
 }
 
 void binary_reader::init(blob &&bb)
@@ -21,6 +24,64 @@ void binary_reader::init(blob &&bb)
     _size = _blob.length();
     _ptr = _blob.data();
     _remaining_size = _size;
+    _segments.clear();
+    _segment_index = 0;
+}
+
+void binary_reader::init(std::vector<blob> &&segments)
+{
+    if (segments.size() == 1) {
+        init(std::move(segments[0]));
+        return;
+    }
+
+    _segments = std::move(segments);
+    _segment_index = 0;
+    _blob = _segments.empty() ? blob() : _segments[0];
+    _ptr = _blob.data();
+    _size = 0;
+    for (const blob &bb : _segments) {
+        _size += bb.length();
+    }
+    _remaining_size = _size;
+}
+
+void binary_reader::next_segment()
+{
+    dassert(_segment_index + 1 < _segments.size(), "no more segments to read");
+    _blob = _segments[++_segment_index];
+    _ptr = _blob.data();
+}
+
+blob binary_reader::get_buffer() const
+{
+    if (_segments.empty()) {
+        return _blob;
+    }
+
+    std::shared_ptr<char> buffer(::dsn::utils::make_shared_array<char>(_size));
+    int offset = 0;
+    for (const blob &bb : _segments) {
+        memcpy(buffer.get() + offset, bb.data(), bb.length());
+        offset += bb.length();
+    }
+    return blob(std::move(buffer), _size);
+}
+
+blob binary_reader::get_remaining_buffer() const
+{
+    if (_remaining_size <= segment_remaining_size()) {
+        return _blob.range(static_cast<int>(_ptr - _blob.data()));
+    }
+
+    std::shared_ptr<char> buffer(::dsn::utils::make_shared_array<char>(_remaining_size));
+    int offset = segment_remaining_size();
+    memcpy(buffer.get(), _ptr, offset);
+    for (size_t i = _segment_index + 1; i < _segments.size(); i++) {
+        memcpy(buffer.get() + offset, _segments[i].data(), _segments[i].length());
+        offset += _segments[i].length();
+    }
+    return blob(std::move(buffer), _remaining_size);
 }
 
 int binary_reader::read(/*out*/ std::string &s)
@@ -50,7 +111,7 @@ int binary_reader::read(blob &blob)
 
 int binary_reader::read(blob &blob, int len)
 {
-    if (len <= get_remaining_size()) {
+    if (len <= segment_remaining_size()) {
         blob = _blob.range(static_cast<int>(_ptr - _blob.data()), len);
 
         // optimization: zero-copy
@@ -63,6 +124,12 @@ int binary_reader::read(blob &blob, int len)
         _ptr += len;
         _remaining_size -= len;
         return len + sizeof(len);
+    } else if (len <= get_remaining_size()) {
+        // the blob spans segments
+        std::shared_ptr<char> buffer(::dsn::utils::make_shared_array<char>(len));
+        read(buffer.get(), len);
+        blob = ::dsn::blob(std::move(buffer), len);
+        return len + sizeof(len);
     } else {
         assert(false);
         return 0;
@@ -72,8 +139,16 @@ int binary_reader::read(blob &blob, int len)
 int binary_reader::read(char *buffer, int sz)
 {
     if (sz <= get_remaining_size()) {
-        memcpy((void *)buffer, _ptr, sz);
-        _ptr += sz;
+        int copied = 0;
+        while (copied < sz) {
+            if (segment_remaining_size() == 0) {
+                next_segment();
+            }
+            int len = std::min(sz - copied, segment_remaining_size());
+            memcpy((void *)(buffer + copied), _ptr, len);
+            _ptr += len;
+            copied += len;
+        }
         _remaining_size -= sz;
         return sz;
     } else {
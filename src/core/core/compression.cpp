@@ -0,0 +1,189 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/compression.h>
+#include <dsn/utility/utils.h>
+
+#ifdef DSN_ENABLE_COMPRESSION
+#include <lz4.h>
+#include <zstd.h>
+#endif
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+#ifdef DSN_ENABLE_COMPRESSION
+// favor speed over ratio, since the data compressed is on the write path
+const int ZSTD_COMPRESSION_LEVEL = 1;
+
+// LZ4 can't expand the compressed data by more than 255 times
+const size_t LZ4_MAX_DECOMPRESSION_RATIO = 255;
+#endif
+
+} // anonymous namespace
+
+bool compression_type_from_string(string_view name, /*out*/ compression_type &type)
+{
+    if (name == "none") {
+        type = compression_type::NONE;
+    } else if (name == "lz4") {
+        type = compression_type::LZ4;
+    } else if (name == "zstd") {
+        type = compression_type::ZSTD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *compression_type_to_string(compression_type type)
+{
+    switch (type) {
+    case compression_type::NONE:
+        return "none";
+    case compression_type::LZ4:
+        return "lz4";
+    case compression_type::ZSTD:
+        return "zstd";
+    default:
+        return "unknown";
+    }
+}
+
+bool compression_supported(compression_type type)
+{
+    switch (type) {
+    case compression_type::NONE:
+        return true;
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::LZ4:
+        return true;
+#endif
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::ZSTD:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+bool compress(compression_type type, string_view input, /*out*/ blob &output)
+{
+    size_t bound = 0;
+    switch (type) {
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::LZ4:
+        if (input.size() > LZ4_MAX_INPUT_SIZE) {
+            return false;
+        }
+        bound = static_cast<size_t>(LZ4_compressBound(static_cast<int>(input.size())));
+        break;
+#endif
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::ZSTD:
+        bound = ZSTD_compressBound(input.size());
+        break;
+#endif
+    default:
+        return false;
+    }
+
+    std::shared_ptr<char> buffer = make_shared_array<char>(bound);
+    size_t size = 0;
+    switch (type) {
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::LZ4: {
+        int ret = LZ4_compress_default(
+            input.data(), buffer.get(), static_cast<int>(input.size()), static_cast<int>(bound));
+        if (ret <= 0) {
+            return false;
+        }
+        size = static_cast<size_t>(ret);
+        break;
+    }
+#endif
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::ZSTD: {
+        size_t ret =
+            ZSTD_compress(buffer.get(), bound, input.data(), input.size(), ZSTD_COMPRESSION_LEVEL);
+        if (ZSTD_isError(ret)) {
+            return false;
+        }
+        size = ret;
+        break;
+    }
+#endif
+    default:
+        return false;
+    }
+
+    if (size >= input.size()) {
+        return false;
+    }
+    output.assign(std::move(buffer), 0, static_cast<unsigned int>(size));
+    return true;
+}
+
+bool decompress(compression_type type, string_view input, size_t raw_size, /*out*/ blob &output)
+{
+    // raw_size usually comes along with the compressed data, so it's validated against the
+    // input before the buffer is allocated
+    switch (type) {
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::LZ4:
+        if (input.size() > LZ4_MAX_INPUT_SIZE || raw_size > LZ4_MAX_INPUT_SIZE ||
+            raw_size > input.size() * LZ4_MAX_DECOMPRESSION_RATIO) {
+            return false;
+        }
+        break;
+#endif
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::ZSTD:
+        // the content size is always in the frame written by ZSTD_compress(), it's also
+        // unequal if the size is unknown or the frame is corrupted
+        if (ZSTD_getFrameContentSize(input.data(), input.size()) != raw_size) {
+            return false;
+        }
+        break;
+#endif
+    default:
+        return false;
+    }
+
+    std::shared_ptr<char> buffer = make_shared_array<char>(raw_size);
+    switch (type) {
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::LZ4: {
+        int ret = LZ4_decompress_safe(input.data(),
+                                      buffer.get(),
+                                      static_cast<int>(input.size()),
+                                      static_cast<int>(raw_size));
+        if (ret < 0 || static_cast<size_t>(ret) != raw_size) {
+            return false;
+        }
+        break;
+    }
+#endif
+#ifdef DSN_ENABLE_COMPRESSION
+    case compression_type::ZSTD: {
+        size_t ret = ZSTD_decompress(buffer.get(), raw_size, input.data(), input.size());
+        if (ZSTD_isError(ret) || ret != raw_size) {
+            return false;
+        }
+        break;
+    }
+#endif
+    default:
+        return false;
+    }
+
+    output.assign(std::move(buffer), 0, static_cast<unsigned int>(raw_size));
+    return true;
+}
+
+} // namespace utils
+} // namespace dsn
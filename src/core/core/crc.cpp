@@ -1,6 +1,14 @@
 #include <cstdio>
+#include <cstring>
 #include <dsn/utility/crc.h>
 
+#include "crc_impl.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
 namespace dsn {
 namespace utils {
 
@@ -413,6 +421,190 @@ uint64_t crc64::_crc_table[sizeof(crc64::_crc_table) / sizeof(crc64::_crc_table[
 #undef crc64_POLY
 #undef BIT64
 #undef BIT32
+
+namespace crc_internal {
+
+uint32_t crc32_bytewise(const void *ptr, size_t size, uint32_t init_crc)
+{
+    return crc32::compute(ptr, size, init_crc);
+}
+
+namespace {
+
+// _tables[k][i] is the crc of byte i followed by k zero bytes
+struct slicing_by_8_tables
+{
+    uint32_t t[8][256];
+
+    slicing_by_8_tables()
+    {
+        for (int i = 0; i < 256; ++i) {
+            t[0][i] = crc32::_crc_table[i];
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int i = 0; i < 256; ++i) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+const slicing_by_8_tables &get_slicing_by_8_tables()
+{
+    static const slicing_by_8_tables tables;
+    return tables;
+}
+
+} // anonymous namespace
+
+uint32_t crc32_slicing_by_8(const void *ptr, size_t size, uint32_t init_crc)
+{
+    const auto &t = get_slicing_by_8_tables().t;
+    const uint8_t *p = static_cast<const uint8_t *>(ptr);
+    uint32_t crc = ~init_crc;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p) {
+        crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^
+              t[4][lo >> 24] ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+              t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+#endif
+    for (; size > 0; --size, ++p) {
+        crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+
+namespace {
+
+// the bytes of each of the 3 interleaved streams in crc32_hw
+const size_t HW_STREAM_BYTES = 1024;
+
+// returns x**n mod POLY
+uint32_t x_pow_n(uint64_t n)
+{
+    uint32_t r = crc32::MSB;         // x**0
+    uint32_t x2i = crc32::MSB >> 1; // x**(2**i), starting from x**1
+    for (; n != 0; n >>= 1) {
+        if (n & 1) {
+            r = crc32::MulPoly(r, x2i);
+        }
+        x2i = crc32::MulPoly(x2i, x2i);
+    }
+    return r;
+}
+
+// The carry-less product of 2 reflected 32-bit values is a reflected 63-bit value, and
+// feeding it to the crc32 instruction multiplies it by x**33, so shifting a crc state
+// over `n` zero bytes needs the constant x**(8n-33).
+struct hw_shift_constants
+{
+    uint32_t one_stream;
+    uint32_t two_streams;
+
+    hw_shift_constants()
+        : one_stream(x_pow_n(HW_STREAM_BYTES * 8 - 33)),
+          two_streams(x_pow_n(HW_STREAM_BYTES * 2 * 8 - 33))
+    {
+    }
+};
+
+const hw_shift_constants &get_hw_shift_constants()
+{
+    static const hw_shift_constants constants;
+    return constants;
+}
+
+__attribute__((target("sse4.2,pclmul"))) inline uint32_t hw_shift(uint32_t crc, uint32_t k)
+{
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), _mm_cvtsi32_si128(k), 0);
+    return static_cast<uint32_t>(_mm_crc32_u64(0, _mm_cvtsi128_si64(product)));
+}
+
+__attribute__((target("sse4.2"))) inline uint64_t load_u64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+// `crc` is the raw crc state, i.e. without the leading and trailing bitwise NOT
+__attribute__((target("sse4.2"))) uint32_t hw_single_stream(uint32_t crc,
+                                                             const uint8_t *p,
+                                                             size_t size)
+{
+    for (; size > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0; --size, ++p) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        crc64 = _mm_crc32_u64(crc64, load_u64(p));
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; --size, ++p) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+    return crc;
+}
+
+} // anonymous namespace
+
+bool crc32_hw_supported()
+{
+    static const bool supported =
+        __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+    return supported;
+}
+
+// The crc32 instruction has a latency of 3 cycles but a throughput of 1 per cycle, so large
+// buffers are split into 3 streams computed in an interleaved way, and then combined.
+__attribute__((target("sse4.2,pclmul"))) uint32_t
+crc32_hw(const void *ptr, size_t size, uint32_t init_crc)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(ptr);
+    uint32_t crc = ~init_crc;
+
+    if (size >= HW_STREAM_BYTES * 3) {
+        const hw_shift_constants &k = get_hw_shift_constants();
+        do {
+            uint64_t c0 = crc, c1 = 0, c2 = 0;
+            for (size_t i = 0; i < HW_STREAM_BYTES; i += 8) {
+                c0 = _mm_crc32_u64(c0, load_u64(p + i));
+                c1 = _mm_crc32_u64(c1, load_u64(p + HW_STREAM_BYTES + i));
+                c2 = _mm_crc32_u64(c2, load_u64(p + HW_STREAM_BYTES * 2 + i));
+            }
+            crc = hw_shift(static_cast<uint32_t>(c0), k.two_streams) ^
+                  hw_shift(static_cast<uint32_t>(c1), k.one_stream) ^ static_cast<uint32_t>(c2);
+            p += HW_STREAM_BYTES * 3;
+            size -= HW_STREAM_BYTES * 3;
+        } while (size >= HW_STREAM_BYTES * 3);
+    }
+
+    return ~hw_single_stream(crc, p, size);
+}
+
+#else
+
+bool crc32_hw_supported() { return false; }
+
+uint32_t crc32_hw(const void *ptr, size_t size, uint32_t init_crc)
+{
+    return crc32_slicing_by_8(ptr, size, init_crc);
+}
+
+#endif
+
+} // namespace crc_internal
 }
 }
 
@@ -420,7 +612,11 @@ namespace dsn {
 namespace utils {
 uint32_t crc32_calc(const void *ptr, size_t size, uint32_t init_crc)
 {
-    return dsn::utils::crc32::compute(ptr, size, init_crc);
+    typedef uint32_t (*crc32_func)(const void *, size_t, uint32_t);
+    static const crc32_func impl = crc_internal::crc32_hw_supported()
+                                       ? crc_internal::crc32_hw
+                                       : crc_internal::crc32_slicing_by_8;
+    return impl(ptr, size, init_crc);
 }
 
 uint32_t crc32_concat(uint32_t xy_init,
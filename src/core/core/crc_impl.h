@@ -0,0 +1,32 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// The crc32 of rDSN uses the Castagnoli polynomial (CRC32C), which is the one computed by
+// the SSE4.2 crc32 instruction. crc32_calc() picks the fastest implementation at runtime,
+// the ones below are exposed for tests and benchmarks only.
+
+namespace dsn {
+namespace utils {
+namespace crc_internal {
+
+// byte-at-a-time table lookup
+uint32_t crc32_bytewise(const void *ptr, size_t size, uint32_t init_crc);
+
+// 8 bytes per step with 8 lookup tables
+uint32_t crc32_slicing_by_8(const void *ptr, size_t size, uint32_t init_crc);
+
+// whether the cpu supports the SSE4.2 crc32 and PCLMULQDQ instructions
+bool crc32_hw_supported();
+
+// must only be called when crc32_hw_supported() is true
+uint32_t crc32_hw(const void *ptr, size_t size, uint32_t init_crc);
+
+} // namespace crc_internal
+} // namespace utils
+} // namespace dsn
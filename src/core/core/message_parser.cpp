@@ -35,6 +35,8 @@
 
 #include "message_parser_manager.h"
 #include <dsn/service_api_c.h>
+#include <dsn/utility/flags.h>
+#include <algorithm>
 
 namespace dsn {
 
@@ -132,40 +134,146 @@ std::string header_type::debug_string() const
 }
 
 //-------------------- msg reader --------------------
+DSN_DEFINE_uint32("network",
+                  max_idle_message_buffer_blocks,
+                  1024,
+                  "max idle blocks of message_buffer_block_size kept for reading messages");
+
+// blocks are returned to the pool when they are no longer referenced by any reader or message
+struct message_block_pool
+{
+    utils::ex_lock_nr_spin lock;
+    std::unordered_map<unsigned int, std::vector<char *>> idle_blocks;
+
+    ~message_block_pool()
+    {
+        for (auto &kv : idle_blocks) {
+            for (char *b : kv.second) {
+                delete[] b;
+            }
+        }
+    }
+};
+
+static std::shared_ptr<message_block_pool> s_block_pool = std::make_shared<message_block_pool>();
+
+static std::shared_ptr<char> acquire_message_block(unsigned int block_size)
+{
+    char *buf = nullptr;
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(s_block_pool->lock);
+        auto &idle = s_block_pool->idle_blocks[block_size];
+        if (!idle.empty()) {
+            buf = idle.back();
+            idle.pop_back();
+        }
+    }
+    if (buf == nullptr) {
+        buf = new char[block_size];
+    }
+
+    std::shared_ptr<message_block_pool> pool = s_block_pool;
+    return std::shared_ptr<char>(buf, [pool, block_size](char *b) {
+        {
+            utils::auto_lock<utils::ex_lock_nr_spin> l(pool->lock);
+            auto &idle = pool->idle_blocks[block_size];
+            if (idle.size() < FLAGS_max_idle_message_buffer_blocks) {
+                idle.push_back(b);
+                return;
+            }
+        }
+        delete[] b;
+    });
+}
+
 char *message_reader::read_buffer_ptr(unsigned int read_next)
 {
-    if (read_next + _buffer_occupied > _buffer.length()) {
-        // remember currently read content
-        blob rb;
-        if (_buffer_occupied > 0)
-            rb = _buffer.range(0, _buffer_occupied);
-
-        // switch to next
-        unsigned int sz =
-            (read_next + _buffer_occupied > _buffer_block_size ? read_next + _buffer_occupied
-                                                               : _buffer_block_size);
-        // TODO(wutao1): make it a buffer queue like what sofa-pbrpc does
-        //               (https://github.com/baidu/sofa-pbrpc/blob/master/src/sofa/pbrpc/buffer.h)
-        //               to reduce memory copy.
-        _buffer.assign(dsn::utils::make_shared_array<char>(sz), 0, sz);
-        _buffer_occupied = 0;
-
-        // copy
-        if (rb.length() > 0) {
-            // every read buffer_block_size data may cause one copy
-            memcpy((void *)_buffer.data(), (const void *)rb.data(), rb.length());
-            _buffer_occupied = rb.length();
+    if (read_next > read_buffer_capacity()) {
+        // keep the data read into the current block, and switch to the next block
+        if (_tail_occupied > 0) {
+            _blocks.push_back(_tail.range(0, _tail_occupied));
+        }
+
+        if (read_next <= _buffer_block_size) {
+            _tail.assign(acquire_message_block(_buffer_block_size), 0, _buffer_block_size);
+        } else {
+            _tail.assign(dsn::utils::make_shared_array<char>(read_next), 0, read_next);
+        }
+        _tail_occupied = 0;
+    }
+
+    return (char *)(_tail.data() + _tail_occupied);
+}
+
+void message_reader::truncate_read()
+{
+    _blocks.clear();
+    _tail = _tail.range(_tail_occupied);
+    _tail_occupied = 0;
+    _length = 0;
+}
+
+void message_reader::consume_buffer(size_t sz)
+{
+    dassert(sz <= _length, "%u VS %u", (unsigned int)sz, _length);
+    _length -= sz;
+
+    while (sz > 0 && !_blocks.empty()) {
+        blob &front = _blocks.front();
+        if (sz < front.length()) {
+            front = front.range(sz);
+            return;
         }
+        sz -= front.length();
+        _blocks.pop_front();
+    }
+
+    _tail = _tail.range(sz);
+    _tail_occupied -= sz;
+}
+
+blob message_reader::front(size_t sz)
+{
+    dassert(sz <= _length, "%u VS %u", (unsigned int)sz, _length);
+    if (_blocks.empty()) {
+        return _tail.range(0, sz);
+    }
+    if (sz <= _blocks.front().length()) {
+        return _blocks.front().range(0, sz);
+    }
 
-        dassert(read_next + _buffer_occupied <= _buffer.length(),
-                "%u(%u + %u) VS %u",
-                read_next + _buffer_occupied,
-                read_next,
-                _buffer_occupied,
-                _buffer.length());
+    // the data spans blocks, copy it into one block which replaces them
+    std::vector<blob> buffers;
+    get_buffers(sz, buffers);
+    std::shared_ptr<char> buf = dsn::utils::make_shared_array<char>(sz);
+    size_t offset = 0;
+    for (const blob &bb : buffers) {
+        memcpy(buf.get() + offset, bb.data(), bb.length());
+        offset += bb.length();
     }
+    _copied_bytes += sz;
 
-    return (char *)(_buffer.data() + _buffer_occupied);
+    consume_buffer(sz);
+    _blocks.emplace_front(std::move(buf), 0, sz);
+    _length += sz;
+    return _blocks.front();
+}
+
+void message_reader::get_buffers(size_t sz, /*out*/ std::vector<blob> &buffers) const
+{
+    dassert(sz <= _length, "%u VS %u", (unsigned int)sz, _length);
+    buffers.clear();
+    for (const blob &bb : _blocks) {
+        if (sz == 0) {
+            return;
+        }
+        size_t len = std::min(sz, (size_t)bb.length());
+        buffers.push_back(bb.range(0, len));
+        sz -= len;
+    }
+    if (sz > 0) {
+        buffers.push_back(_tail.range(0, sz));
+    }
 }
 
 //-------------------- msg parser manager --------------------
@@ -28,6 +28,7 @@
 #include <dsn/utility/factory_store.h>
 #include "message_parser_manager.h"
 #include "rpc_engine.h"
+#include "service_engine.h"
 
 namespace dsn {
 /*static*/ join_point<void, rpc_session *>
@@ -219,17 +220,18 @@ void rpc_session::start_read_next(int read_next)
 
 int rpc_session::prepare_parser()
 {
-    if (_reader._buffer_occupied < sizeof(uint32_t))
-        return sizeof(uint32_t) - _reader._buffer_occupied;
+    if (_reader.length() < sizeof(uint32_t))
+        return sizeof(uint32_t) - _reader.length();
 
-    auto hdr_format = message_parser::get_header_type(_reader._buffer.data());
+    blob hdr_type_bb = _reader.front(sizeof(uint32_t));
+    auto hdr_format = message_parser::get_header_type(hdr_type_bb.data());
     if (hdr_format == NET_HDR_INVALID) {
         hdr_format = _net.unknown_msg_hdr_format();
 
         if (hdr_format == NET_HDR_INVALID) {
             derror("invalid header type, remote_client = %s, header_type = '%s'",
                    _remote_addr.to_string(),
-                   message_parser::get_debug_string(_reader._buffer.data()).c_str());
+                   message_parser::get_debug_string(hdr_type_bb.data()).c_str());
             return -1;
         }
     }
@@ -338,6 +340,7 @@ rpc_session::rpc_session(connection_oriented_network &net,
       _remote_addr(remote_addr),
       _max_buffer_block_count_per_send(net.max_buffer_block_count_per_send()),
       _reader(net.message_buffer_block_size()),
+      _reader_copied_bytes(0),
       _parser(parser),
 
       _is_client(is_client),
@@ -379,6 +382,9 @@ bool rpc_session::on_recv_message(message_ex *msg, int delay_ms)
     msg->to_address = _net.address();
     msg->io_session = this;
 
+    _net.on_recv_copied_bytes(_reader.copied_bytes() - _reader_copied_bytes);
+    _reader_copied_bytes = _reader.copied_bytes();
+
     if (msg->header->context.u.is_request) {
         // ATTENTION: need to check if self connection occurred.
         //
@@ -502,6 +508,13 @@ connection_oriented_network::connection_oriented_network(rpc_engine *srv, networ
     : network(srv, inner_provider)
 {
     _cfg_conn_threshold_per_ip = 0;
+
+    _recv_copied_bytes_per_message.init_global_counter(
+        node()->full_name(),
+        "eon.network",
+        "recv_copied_bytes_per_message",
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "bytes copied on receiving a message to make its data contiguous");
 }
 
 void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_send)
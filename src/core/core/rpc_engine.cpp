@@ -39,36 +39,33 @@
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/cpp/serialization.h>
 #include <dsn/utility/rand.h>
+#include <dsn/utility/flags.h>
 #include <set>
 
 namespace dsn {
 
 DEFINE_TASK_CODE(LPC_RPC_TIMEOUT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
-class rpc_timeout_task : public task
-{
-public:
-    rpc_timeout_task(rpc_client_matcher *matcher, uint64_t id, service_node *node)
-        : task(LPC_RPC_TIMEOUT, 0, node)
-    {
-        _matcher = matcher;
-        _id = id;
-    }
-
-    virtual void exec() { _matcher->on_rpc_timeout(_id); }
+DSN_DEFINE_uint32("core",
+                  rpc_timeout_sweep_interval_ms,
+                  10,
+                  "interval of sweeping the timed-out rpc calls, which is also the max "
+                  "delay of reporting a timeout");
 
-private:
-    // use the following if the matcher is per rpc session
-    // rpc_client_matcher_ptr _matcher;
-
-    rpc_client_matcher *_matcher;
-    uint64_t _id;
-};
+rpc_client_matcher::rpc_client_matcher(rpc_engine *engine) : _engine(engine)
+{
+    _bucket_count = std::max(MATCHER_BUCKET_NR,
+                             4 * static_cast<int>(std::thread::hardware_concurrency()));
+    _buckets.reset(new match_bucket[_bucket_count]);
+}
 
 rpc_client_matcher::~rpc_client_matcher()
 {
-    for (int i = 0; i < MATCHER_BUCKET_NR; i++) {
-        dassert(_requests[i].size() == 0,
+    if (_sweep_timer != nullptr) {
+        _sweep_timer->cancel(false);
+    }
+    for (int i = 0; i < _bucket_count; i++) {
+        dassert(_buckets[i].requests.size() == 0,
                 "all rpc entries must be removed before the matcher ends");
     }
 }
@@ -76,16 +73,15 @@ rpc_client_matcher::~rpc_client_matcher()
 bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *reply, int delay_ms)
 {
     rpc_response_task_ptr call;
-    task_ptr timeout_task;
-    int bucket_index = key % MATCHER_BUCKET_NR;
+    match_bucket &bucket = _buckets[bucket_index(key)];
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(bucket.lock);
+        auto it = bucket.requests.find(key);
+        if (it != bucket.requests.end()) {
+            // the deadline item is left in the heap, and dropped when it expires
             call = std::move(it->second.resp_task);
-            timeout_task = std::move(it->second.timeout_task);
-            _requests[bucket_index].erase(it);
+            bucket.requests.erase(it);
         } else {
             if (reply) {
                 dassert(reply->get_count() == 0,
@@ -97,11 +93,6 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
     }
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
-    dbg_dassert(timeout_task != nullptr, "rpc timeout task cannot be empty");
-
-    if (timeout_task != task::get_current_task()) {
-        timeout_task->cancel(false); // no need to wait
-    }
 
     auto req = call->get_request();
     auto spec = task_spec::get(req->local_rpc_code);
@@ -196,21 +187,47 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
     return true;
 }
 
+void rpc_client_matcher::on_sweep_timeout()
+{
+    uint64_t now_ts_ms = dsn_now_ms();
+    std::vector<uint64_t> expired_keys;
+
+    for (int i = 0; i < _bucket_count; i++) {
+        match_bucket &bucket = _buckets[i];
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(bucket.lock);
+        while (!bucket.deadlines.empty() && bucket.deadlines.top().first <= now_ts_ms) {
+            deadline_item item = bucket.deadlines.top();
+            bucket.deadlines.pop();
+
+            // skip the stale items of the replied or re-scheduled requests
+            auto it = bucket.requests.find(item.second);
+            if (it != bucket.requests.end() && it->second.deadline_ms == item.first) {
+                expired_keys.push_back(item.second);
+            }
+        }
+    }
+
+    // the timeout callbacks are expensive, do them outside of the locks
+    for (uint64_t key : expired_keys) {
+        on_rpc_timeout(key);
+    }
+}
+
 void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 {
     rpc_response_task_ptr call;
-    int bucket_index = key % MATCHER_BUCKET_NR;
+    match_bucket &bucket = _buckets[bucket_index(key)];
     uint64_t timeout_ts_ms;
     bool resend = false;
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(bucket.lock);
+        auto it = bucket.requests.find(key);
+        if (it != bucket.requests.end()) {
             timeout_ts_ms = it->second.timeout_ts_ms;
             call = it->second.resp_task;
             if (timeout_ts_ms == 0) {
-                _requests[bucket_index].erase(it);
+                bucket.requests.erase(it);
             }
 
             // resend is enabled
@@ -238,26 +255,24 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
     // resend when timeout is not yet, and the call is not cancelled
     // TODO: time overflow
     resend = (now_ts_ms < timeout_ts_ms && call->state() == TASK_STATE_READY);
-
-    // TODO: memory pool for this task
-    task_ptr new_timeout_task;
-    if (resend) {
-        new_timeout_task = new rpc_timeout_task(this, key, call->node());
-    }
+    bool timeout = false;
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(bucket.lock);
+        auto it = bucket.requests.find(key);
+        if (it != bucket.requests.end()) {
             // timeout
             if (!resend) {
-                _requests[bucket_index].erase(it);
+                bucket.requests.erase(it);
+                timeout = true;
             }
 
             // resend
             else {
-                // reset timeout task
-                it->second.timeout_task = new_timeout_task;
+                // use rest of the timeout to resend once only
+                it->second.deadline_ms = timeout_ts_ms;
+                it->second.timeout_ts_ms = 0;
+                bucket.deadlines.emplace(timeout_ts_ms, key);
             }
         }
 
@@ -275,40 +290,56 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 
         // resend without handling rpc_matcher, use the same request_id
         _engine->call_ip(req->to_address, req, nullptr);
+    } else if (timeout) {
+        call->enqueue(ERR_TIMEOUT, nullptr);
+    }
+}
 
-        // use rest of the timeout to resend once only
-        new_timeout_task->set_delay(static_cast<int>(timeout_ts_ms - now_ts_ms));
-        new_timeout_task->enqueue();
+void rpc_client_matcher::start_sweep_timer()
+{
+    // the task engine is not running yet when the rpc engine starts, so the timer is started
+    // by the first call
+    if (_sweep_timer_started.load(std::memory_order_acquire) ||
+        _sweep_timer_started.exchange(true)) {
+        return;
     }
+
+    _sweep_timer = new timer_task(LPC_RPC_TIMEOUT,
+                                  [this]() { on_sweep_timeout(); },
+                                  static_cast<int>(FLAGS_rpc_timeout_sweep_interval_ms),
+                                  0,
+                                  _engine->node());
+    _sweep_timer->set_delay(static_cast<int>(FLAGS_rpc_timeout_sweep_interval_ms));
+    _sweep_timer->enqueue();
 }
 
 void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_ptr &call)
 {
     message_header &hdr = *request->header;
-    int bucket_index = hdr.id % MATCHER_BUCKET_NR;
+    match_bucket &bucket = _buckets[bucket_index(hdr.id)];
     auto sp = task_spec::get(request->local_rpc_code);
     int timeout_ms = hdr.client.timeout_ms;
+    uint64_t now_ts_ms = dsn_now_ms();
     uint64_t timeout_ts_ms = 0;
 
     // reset timeout when resend is enabled
     if (sp->rpc_request_resend_timeout_milliseconds > 0 &&
         timeout_ms > sp->rpc_request_resend_timeout_milliseconds) {
-        timeout_ts_ms = dsn_now_ms() + timeout_ms; // non-zero for resend
+        timeout_ts_ms = now_ts_ms + timeout_ms; // non-zero for resend
         timeout_ms = sp->rpc_request_resend_timeout_milliseconds;
     }
+    uint64_t deadline_ms = now_ts_ms + timeout_ms;
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
-    task *timeout_task(new rpc_timeout_task(this, hdr.id, call->node()));
+    start_sweep_timer();
 
     {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(bucket.lock);
         auto pr =
-            _requests[bucket_index].emplace(hdr.id, match_entry{call, timeout_task, timeout_ts_ms});
+            bucket.requests.emplace(hdr.id, match_entry{call, deadline_ms, timeout_ts_ms});
         dassert(pr.second, "the message is already on the fly!!!");
+        bucket.deadlines.emplace(deadline_ms, hdr.id);
     }
-
-    timeout_task->set_delay(timeout_ms);
-    timeout_task->enqueue();
 }
 
 //----------------------------------------------------------------------------------------------
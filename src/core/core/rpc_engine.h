@@ -30,6 +30,8 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/network.h>
 #include <dsn/tool-api/global_config.h>
+#include <atomic>
+#include <queue>
 
 namespace dsn {
 
@@ -50,17 +52,21 @@ class rpc_engine;
 // (due to
 // less std::shared_ptr<rpc_client_matcher> operations in rpc_timeout_task
 //
+// timeouts are not tracked by a timer per call: each bucket keeps its deadlines in a min-heap,
+// and a single periodic task sweeps the expired ones, so neither on_call nor on_recv_reply
+// schedules or cancels any task.
+//
 #define MATCHER_BUCKET_NR 13
 class rpc_client_matcher : public ref_counter
 {
 public:
-    rpc_client_matcher(rpc_engine *engine) : _engine(engine) {}
+    rpc_client_matcher(rpc_engine *engine);
 
     ~rpc_client_matcher();
 
     //
     // when a two-way RPC call is made, register the requst id and the callback
-    // which also registers a timer for timeout tracking
+    // together with its deadline for timeout tracking
     //
     void on_call(message_ex *request, const rpc_response_task_ptr &call);
 
@@ -75,20 +81,39 @@ public:
     bool on_recv_reply(network *net, uint64_t key, message_ex *reply, int delay_ms);
 
 private:
-    friend class rpc_timeout_task;
+    // called periodically to time out the calls whose deadline has passed
+    void on_sweep_timeout();
     void on_rpc_timeout(uint64_t key);
 
+    void start_sweep_timer();
+
+    int bucket_index(uint64_t key) const { return static_cast<int>(key % _bucket_count); }
+
 private:
     rpc_engine *_engine;
     struct match_entry
     {
         rpc_response_task_ptr resp_task;
-        task_ptr timeout_task;
+        uint64_t deadline_ms;
         uint64_t timeout_ts_ms; // > 0 for auto-resent msgs
     };
-    typedef std::unordered_map<uint64_t, match_entry> rpc_requests;
-    rpc_requests _requests[MATCHER_BUCKET_NR];
-    ::dsn::utils::ex_lock_nr_spin _requests_lock[MATCHER_BUCKET_NR];
+    // <deadline_ms, request id>, with the earliest deadline on top
+    typedef std::pair<uint64_t, uint64_t> deadline_item;
+    struct match_bucket
+    {
+        ::dsn::utils::ex_lock_nr_spin lock;
+        std::unordered_map<uint64_t, match_entry> requests;
+        // items of the replied requests are not removed until they expire, an item is valid
+        // only if its request is still there and has the same deadline
+        std::priority_queue<deadline_item, std::vector<deadline_item>, std::greater<deadline_item>>
+            deadlines;
+    };
+    // scaled with the core count, at least MATCHER_BUCKET_NR
+    int _bucket_count;
+    std::unique_ptr<match_bucket[]> _buckets;
+
+    std::atomic_bool _sweep_timer_started{false};
+    task_ptr _sweep_timer;
 };
 
 class rpc_server_dispatcher
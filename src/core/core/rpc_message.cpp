@@ -133,6 +133,24 @@ message_ex *message_ex::create_receive_message(const blob &data)
     return msg;
 }
 
+message_ex *message_ex::create_receive_message(const std::vector<blob> &data)
+{
+    if (data.size() == 1) {
+        return create_receive_message(data[0]);
+    }
+
+    dassert(!data.empty() && data[0].length() >= sizeof(message_header),
+            "message_header must be in the first buffer");
+    message_ex *msg = new message_ex();
+    msg->header = (message_header *)data[0].data();
+    msg->_is_read = true;
+    // the message_header is hidden ahead of the first buffer
+    msg->buffers.reserve(data.size());
+    msg->buffers.push_back(data[0].range((int)sizeof(message_header)));
+    msg->buffers.insert(msg->buffers.end(), data.begin() + 1, data.end());
+    return msg;
+}
+
 message_ex *message_ex::create_received_request(dsn::task_code code,
                                                 dsn_msg_serialize_format format,
                                                 void *buffer,
@@ -174,6 +192,23 @@ message_ex *message_ex::create_receive_message_with_standalone_header(const blob
     return msg;
 }
 
+message_ex *
+message_ex::create_receive_message_with_standalone_header(const std::vector<blob> &data)
+{
+    if (data.size() <= 1) {
+        return create_receive_message_with_standalone_header(data.empty() ? blob() : data[0]);
+    }
+
+    message_ex *msg = create_receive_message_with_standalone_header(blob());
+    msg->buffers.pop_back();
+    msg->header->body_length = 0;
+    for (const blob &bb : data) {
+        msg->buffers.push_back(bb);
+        msg->header->body_length += bb.length();
+    }
+    return msg;
+}
+
 message_ex *message_ex::copy_message_no_reply(const message_ex &old_msg)
 {
     message_ex *msg = new message_ex();
@@ -188,10 +223,16 @@ message_ex *message_ex::copy_message_no_reply(const message_ex &old_msg)
         // if old_msg only has header, consider its header as data
         msg->buffers.emplace_back(old_msg.buffers[0]);
     } else {
-        msg->buffers.emplace_back(old_msg.buffers[1]);
+        // the data of a received message may be in multiple buffers, and the first buffer
+        // is the message_header if it's standalone
+        size_t i = ((const char *)old_msg.header == old_msg.buffers[0].data() ? 1 : 0);
+        msg->buffers.insert(msg->buffers.end(), old_msg.buffers.begin() + i, old_msg.buffers.end());
     }
 
-    msg->header->body_length = msg->buffers[1].length();
+    msg->header->body_length = 0;
+    for (size_t i = 1; i < msg->buffers.size(); i++) {
+        msg->header->body_length += msg->buffers[i].length();
+    }
     msg->_is_read = true;
     msg->_rw_index = 1;
     msg->local_rpc_code = old_msg.local_rpc_code;
@@ -276,8 +317,7 @@ message_ex *message_ex::copy_and_prepare_send(bool clone_content)
     auto copy = this->copy(clone_content, false);
 
     if (_is_read) {
-        // the message_header is hidden ahead of the buffer, expose it to buffer
-        dassert(buffers.size() == 1, "there must be only one buffer for read msg");
+        // the message_header is hidden ahead of the first buffer, expose it to buffer
         dassert((char *)header + sizeof(message_header) == (char *)buffers[0].data(),
                 "header and content must be contigous");
 
@@ -460,6 +500,21 @@ void message_ex::write_commit(size_t size)
     this->header->body_length += (int)size;
 }
 
+void message_ex::write_append(const blob &bb)
+{
+    dassert(!this->_is_read && this->_rw_committed,
+            "there are pending msg write not committed"
+            ", please invoke dsn_msg_write_next and dsn_msg_write_commit in pairs");
+
+    this->buffers.push_back(bb);
+    this->_rw_index++;
+    this->_rw_offset = (int)bb.length();
+    this->header->body_length += bb.length();
+
+    dassert(this->_rw_index + 1 == (int)this->buffers.size(),
+            "message write buffer count is not right");
+}
+
 bool message_ex::read_next(void **ptr, size_t *size)
 {
     // printf("%p %s %d\n", this, __FUNCTION__, utils::get_current_tid());
@@ -508,6 +563,21 @@ bool message_ex::read_next(blob &data)
     }
 }
 
+bool message_ex::read_next(std::vector<blob> &data)
+{
+    data.clear();
+    blob bb;
+    if (!read_next(bb)) {
+        return false;
+    }
+
+    data.push_back(std::move(bb));
+    for (int i = this->_rw_index + 1; i < (int)this->buffers.size(); i++) {
+        data.push_back(this->buffers[i]);
+    }
+    return true;
+}
+
 void message_ex::read_commit(size_t size)
 {
     // printf("%p %s\n", this, __FUNCTION__);
@@ -517,6 +587,11 @@ void message_ex::read_commit(size_t size)
 
     dassert(-1 != this->_rw_index, "no buffer in curent msg is under read");
     this->_rw_offset += (int)size;
+    while (this->_rw_index + 1 < (int)this->buffers.size() &&
+           this->_rw_offset > (int)this->buffers[this->_rw_index].length()) {
+        this->_rw_offset -= (int)this->buffers[this->_rw_index].length();
+        this->_rw_index++;
+    }
     this->_rw_committed = true;
 }
 
@@ -146,6 +146,8 @@ task_spec::task_spec(int code,
       rpc_call_header_format(NET_HDR_DSN),
       rpc_call_channel(RPC_CHANNEL_TCP),
       rpc_message_crc_required(false),
+      rpc_message_compression_min_bytes(4096),
+      rpc_message_compression_type(utils::compression_type::NONE),
       on_task_create((std::string(name) + std::string(".create")).c_str()),
       on_task_enqueue((std::string(name) + std::string(".enqueue")).c_str()),
       on_task_begin((std::string(name) + std::string(".begin")).c_str()),
@@ -164,7 +166,8 @@ task_spec::task_spec(int code,
       on_rpc_request_enqueue((std::string(name) + std::string(".rpc.request.enqueue")).c_str()),
       on_rpc_reply((std::string(name) + std::string(".rpc.reply")).c_str()),
       on_rpc_response_enqueue((std::string(name) + std::string(".rpc.response.enqueue")).c_str()),
-      on_rpc_create_response((std::string(name) + std::string("rpc.create.response")).c_str())
+      on_rpc_create_response((std::string(name) + std::string("rpc.create.response")).c_str()),
+      on_rpc_body_compression((std::string(name) + std::string(".rpc.body.compression")).c_str())
 {
     dassert(strlen(name) < DSN_MAX_TASK_CODE_NAME_LENGTH,
             "task code name '%s' is too long: length must be smaller than "
@@ -219,6 +222,15 @@ bool task_spec::init()
             spec->rpc_request_delayer.initialize(spec->rpc_request_delays_milliseconds);
         }
 
+        if (!utils::compression_type_from_string(spec->rpc_message_compression,
+                                                 spec->rpc_message_compression_type) ||
+            !utils::compression_supported(spec->rpc_message_compression_type)) {
+            derror("%s: rpc_message_compression '%s' is invalid or not supported by this build",
+                   spec->name.c_str(),
+                   spec->rpc_message_compression.c_str());
+            return false;
+        }
+
         if (spec->rpc_request_throttling_mode != TM_NONE) {
             if (spec->type != TASK_TYPE_RPC_REQUEST) {
                 derror("%s: only rpc request type can have non TM_NONE throttling_mode",
@@ -2,7 +2,7 @@
 #include <dsn/perf_counter/perf_counter.h>
 
 static const char *ctypes[] = {
-    "NUMBER", "VOLATILE_NUMBER", "RATE", "PERCENTILE", "INVALID_COUNTER"};
+    "NUMBER", "VOLATILE_NUMBER", "RATE", "PERCENTILE", "HISTOGRAM", "INVALID_COUNTER"};
 const char *dsn_counter_type_to_string(dsn_perf_counter_type_t t)
 {
     if (t >= COUNTER_TYPE_COUNT)
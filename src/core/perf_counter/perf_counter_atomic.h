@@ -3,6 +3,8 @@
 // can be found in the LICENSE file in the root directory of this source tree.
 
 #include <atomic>
+#include <cmath>
+#include <mutex>
 #include <boost/make_shared.hpp>
 #include <dsn/utility/utils.h>
 #include <dsn/utility/config_api.h>
@@ -116,6 +118,15 @@ public:
         }
         return val;
     }
+    // the value accumulated since it's got last time
+    virtual double peek_value()
+    {
+        double val = 0;
+        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
+            val += static_cast<double>(_val[i].load(std::memory_order_relaxed));
+        }
+        return val;
+    }
 };
 
 // -----------   RATE perf counter ---------------------------------
@@ -170,6 +181,20 @@ public:
         return _rate;
     }
     virtual int64_t get_integer_value() { return (int64_t)get_value(); }
+    // the rate since it's got last time
+    virtual double peek_value()
+    {
+        uint64_t now = utils::get_current_physical_time_ns();
+        double interval = (now - _last_time) / 1e9;
+        if (interval <= 0.1)
+            return _rate;
+
+        double val = 0;
+        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
+            val += _val[i].load(std::memory_order_relaxed);
+        }
+        return val / interval;
+    }
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
     {
         dassert(false, "invalid execution flow");
@@ -198,7 +223,7 @@ public:
                                           const char *name,
                                           dsn_perf_counter_type_t type,
                                           const char *dsptr)
-        : perf_counter(app, section, name, type, dsptr), _tail(0)
+        : perf_counter(app, section, name, type, dsptr), _tail(0), _sum(0)
     {
         _results[COUNTER_PERCENTILE_50] = 0;
         _results[COUNTER_PERCENTILE_90] = 0;
@@ -228,6 +253,7 @@ public:
     {
         uint64_t idx = _tail.fetch_add(1, std::memory_order_relaxed);
         _samples[idx % MAX_QUEUE_LENGTH] = val;
+        _sum.fetch_add(val, std::memory_order_relaxed);
     }
 
     virtual double get_value()
@@ -246,6 +272,12 @@ public:
         return (double)_results[type];
     }
 
+    virtual void get_summary(/*out*/ uint64_t &count, /*out*/ double &sum) override
+    {
+        count = _tail.load(std::memory_order_relaxed);
+        sum = (double)_sum.load(std::memory_order_relaxed);
+    }
+
     virtual int get_latest_samples(int required_sample_count,
                                    /*out*/ samples_t &samples) const override
     {
@@ -431,10 +463,275 @@ private:
 
     std::shared_ptr<boost::asio::deadline_timer> _timer;
     std::atomic<uint64_t> _tail; // should use unsigned int to avoid out of bound
+    std::atomic<int64_t> _sum;
     int64_t _samples[MAX_QUEUE_LENGTH];
     int64_t _results[COUNTER_PERCENTILE_COUNT];
     int _counter_computation_interval_seconds;
 };
 
+// -----------   NUMBER_HISTOGRAM perf counter ---------------------------------
+
+//
+// A log-linear histogram: values below 2 * HISTOGRAM_SUB_BUCKET_COUNT are counted exactly,
+// and every power of two above is split into HISTOGRAM_SUB_BUCKET_COUNT linear sub-buckets, so
+// the relative error of a reported value is below 1 / HISTOGRAM_SUB_BUCKET_COUNT.
+//
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKET_COUNT (1 << HISTOGRAM_SUB_BUCKET_BITS)
+// the highest bit of a non-negative int64 is bit 62
+#define HISTOGRAM_BUCKET_COUNT ((63 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKET_COUNT)
+// the max number of threads recording samples without sharing a shard, the shards are only
+// allocated for the threads which actually record samples into the histogram
+#define HISTOGRAM_SHARD_COUNT 64
+
+// Each thread records samples into its own shard, in the order that the threads record their
+// first samples, so that the worker threads don't contend on the same buckets.
+inline int histogram_shard_index()
+{
+    static std::atomic<int> next_index(0);
+    static thread_local int index = next_index.fetch_add(1) % HISTOGRAM_SHARD_COUNT;
+    return index;
+}
+
+struct histogram_shard
+{
+    histogram_shard()
+    {
+        for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // cumulative count of each bucket
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKET_COUNT];
+    // keeps the buckets of the shards allocated next to each other out of the same cache line
+    char padding[64];
+};
+
+class perf_counter_number_histogram_atomic : public perf_counter
+{
+public:
+    perf_counter_number_histogram_atomic(const char *app,
+                                         const char *section,
+                                         const char *name,
+                                         dsn_perf_counter_type_t type,
+                                         const char *dsptr)
+        : perf_counter(app, section, name, type, dsptr),
+          _rate(0),
+          _total_count(0),
+          _total_sum(0.0)
+    {
+        for (int i = 0; i < HISTOGRAM_SHARD_COUNT; i++) {
+            _shards[i].store(nullptr, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < COUNTER_PERCENTILE_COUNT; i++) {
+            _results[i] = 0;
+        }
+        _window_count = 0;
+        _last_time = utils::get_current_physical_time_ns();
+
+        // share the window with the NUMBER_PERCENTILES counters
+        _counter_computation_interval_seconds = (int)dsn_config_get_value_uint64(
+            "components.pegasus_perf_counter_number_percentile_atomic",
+            "counter_computation_interval_seconds",
+            10,
+            "period (seconds) the system computes the percentiles of the "
+            "pegasus_perf_counter_number_percentile_atomic counters");
+        _timer.reset(new boost::asio::deadline_timer(tools::shared_io_service::instance().ios));
+        _timer->expires_from_now(
+            boost::posix_time::seconds(rand() % _counter_computation_interval_seconds + 1));
+        _timer->async_wait(std::bind(
+            &perf_counter_number_histogram_atomic::on_timer, this, _timer, std::placeholders::_1));
+    }
+
+    ~perf_counter_number_histogram_atomic(void)
+    {
+        _timer->cancel();
+        for (int i = 0; i < HISTOGRAM_SHARD_COUNT; i++) {
+            delete _shards[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    virtual void increment() { dassert(false, "invalid execution flow"); }
+    virtual void decrement() { dassert(false, "invalid execution flow"); }
+    virtual void add(int64_t val) { dassert(false, "invalid execution flow"); }
+
+    // record a sample
+    virtual void set(int64_t val)
+    {
+        histogram_shard *shard = get_shard(histogram_shard_index());
+        shard->buckets[bucket_index(val)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // samples per second in the last window
+    virtual double get_value() { return _rate.load(); }
+    virtual int64_t get_integer_value() { return (int64_t)get_value(); }
+
+    virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
+    {
+        if ((type < 0) || (type >= COUNTER_PERCENTILE_COUNT)) {
+            dassert(false, "send a wrong counter percentile type");
+            return 0.0;
+        }
+        return (double)_results[type];
+    }
+
+    virtual double get_quantile(double q) override
+    {
+        std::lock_guard<std::mutex> l(_window_lock);
+        return (double)quantile_of_window(q);
+    }
+
+    // the sum is estimated by the middles of the buckets
+    virtual void get_summary(/*out*/ uint64_t &count, /*out*/ double &sum) override
+    {
+        std::lock_guard<std::mutex> l(_window_lock);
+        count = _total_count;
+        sum = _total_sum;
+    }
+
+    static int bucket_index(int64_t val)
+    {
+        uint64_t v = val < 0 ? 0 : static_cast<uint64_t>(val);
+        if (v < 2 * HISTOGRAM_SUB_BUCKET_COUNT) {
+            return static_cast<int>(v);
+        }
+        int exp = 63 - __builtin_clzll(v) - HISTOGRAM_SUB_BUCKET_BITS;
+        return static_cast<int>(exp * HISTOGRAM_SUB_BUCKET_COUNT + (v >> exp));
+    }
+
+    // the middle of the values in a bucket
+    static int64_t bucket_value(int index)
+    {
+        if (index < 2 * HISTOGRAM_SUB_BUCKET_COUNT) {
+            return index;
+        }
+        int exp = index / HISTOGRAM_SUB_BUCKET_COUNT - 1;
+        uint64_t lower = static_cast<uint64_t>(index - exp * HISTOGRAM_SUB_BUCKET_COUNT) << exp;
+        uint64_t mid = lower + ((uint64_t(1) << exp) >> 1);
+        return mid > static_cast<uint64_t>(INT64_MAX) ? INT64_MAX : static_cast<int64_t>(mid);
+    }
+
+private:
+    histogram_shard *get_shard(int index)
+    {
+        histogram_shard *shard = _shards[index].load(std::memory_order_acquire);
+        if (dsn_likely(shard != nullptr)) {
+            return shard;
+        }
+
+        // shards are allocated on first use, as most counters are updated by a few threads
+        histogram_shard *new_shard = new histogram_shard();
+        if (_shards[index].compare_exchange_strong(shard, new_shard)) {
+            return new_shard;
+        }
+        delete new_shard;
+        return shard;
+    }
+
+    int64_t quantile_of_window(double q) const
+    {
+        if (_window_count == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * _window_count));
+        rank = std::max<uint64_t>(1, std::min(rank, _window_count));
+        uint64_t seen = 0;
+        for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+            seen += _window[i];
+            if (seen >= rank) {
+                return bucket_value(i);
+            }
+        }
+        return bucket_value(HISTOGRAM_BUCKET_COUNT - 1);
+    }
+
+    // merges the shards, and takes the samples since the last computation as the window
+    void calc()
+    {
+        std::vector<uint64_t> totals;
+        for (int s = 0; s < HISTOGRAM_SHARD_COUNT; s++) {
+            histogram_shard *shard = _shards[s].load(std::memory_order_acquire);
+            if (shard == nullptr) {
+                continue;
+            }
+            if (totals.empty()) {
+                totals.assign(HISTOGRAM_BUCKET_COUNT, 0);
+            }
+            for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+                totals[i] += shard->buckets[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        uint64_t now = utils::get_current_physical_time_ns();
+        double interval = (now - _last_time) / 1e9;
+        _last_time = now;
+
+        std::lock_guard<std::mutex> l(_window_lock);
+        _window_count = 0;
+        if (!totals.empty()) {
+            // the buckets of a counter that never got a sample are not allocated
+            if (_last_totals.empty()) {
+                _last_totals.assign(HISTOGRAM_BUCKET_COUNT, 0);
+                _window.assign(HISTOGRAM_BUCKET_COUNT, 0);
+            }
+            _total_count = 0;
+            _total_sum = 0.0;
+            for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++) {
+                _window[i] = totals[i] - _last_totals[i];
+                _window_count += _window[i];
+                _total_count += totals[i];
+                _total_sum += (double)totals[i] * bucket_value(i);
+            }
+            _last_totals.swap(totals);
+        }
+
+        _results[COUNTER_PERCENTILE_50] = quantile_of_window(0.5);
+        _results[COUNTER_PERCENTILE_90] = quantile_of_window(0.90);
+        _results[COUNTER_PERCENTILE_95] = quantile_of_window(0.95);
+        _results[COUNTER_PERCENTILE_99] = quantile_of_window(0.99);
+        _results[COUNTER_PERCENTILE_999] = quantile_of_window(0.999);
+        _rate = interval > 0 ? _window_count / interval : 0;
+    }
+
+    void on_timer(std::shared_ptr<boost::asio::deadline_timer> timer,
+                  const boost::system::error_code &ec)
+    {
+        // as the callback is not in tls context, so the log system calls like ddebug, dassert will
+        // cause a lock
+        if (!ec) {
+            calc();
+
+            timer->expires_from_now(
+                boost::posix_time::seconds(_counter_computation_interval_seconds));
+            timer->async_wait(std::bind(&perf_counter_number_histogram_atomic::on_timer,
+                                        this,
+                                        timer,
+                                        std::placeholders::_1));
+        } else if (boost::system::errc::operation_canceled != ec) {
+            dassert(false, "on_timer error!!!");
+        }
+    }
+
+    friend class perf_counter_histogram_test;
+
+    std::shared_ptr<boost::asio::deadline_timer> _timer;
+    std::atomic<histogram_shard *> _shards[HISTOGRAM_SHARD_COUNT];
+    int64_t _results[COUNTER_PERCENTILE_COUNT];
+    std::atomic<double> _rate;
+    int _counter_computation_interval_seconds;
+
+    // accessed by calc() only, empty until the first sample
+    std::vector<uint64_t> _last_totals;
+    uint64_t _last_time;
+
+    // counts of the samples in the last window
+    std::mutex _window_lock;
+    std::vector<uint64_t> _window;
+    uint64_t _window_count;
+    uint64_t _total_count;
+    double _total_sum;
+};
+
 #pragma pack(pop)
 } // namespace
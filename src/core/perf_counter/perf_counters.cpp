@@ -184,6 +184,8 @@ perf_counter *perf_counters::new_counter(const char *app,
         return new perf_counter_rate_atomic(app, section, name, type, dsptr);
     else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES)
         return new perf_counter_number_percentile_atomic(app, section, name, type, dsptr);
+    else if (type == dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_HISTOGRAM)
+        return new perf_counter_number_histogram_atomic(app, section, name, type, dsptr);
     else {
         dassert(false, "invalid type(%d)", type);
         return nullptr;
@@ -200,6 +202,15 @@ void perf_counters::get_all_counters(std::vector<perf_counter_ptr> *all) const
     }
 }
 
+void perf_counters::iterate_counters(const counter_visitor &v) const
+{
+    std::vector<perf_counter_ptr> all_counters;
+    get_all_counters(&all_counters);
+    for (const perf_counter_ptr &c : all_counters) {
+        v(c);
+    }
+}
+
 std::string perf_counters::list_snapshot_by_regexp(const std::vector<std::string> &args) const
 {
     perf_counter_info info;
@@ -303,7 +314,7 @@ void perf_counters::take_snapshot()
             cs.type = c->type();
         }
         cs.updated_recently = true;
-        if (c->type() != COUNTER_TYPE_NUMBER_PERCENTILES) {
+        if (!dsn_counter_type_has_percentiles(c->type())) {
             cs.value = c->get_value();
         } else {
             cs.value = c->get_percentile(COUNTER_PERCENTILE_99);
@@ -0,0 +1,77 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/compression.h>
+#include <gtest/gtest.h>
+#include <limits>
+
+namespace dsn {
+namespace utils {
+
+TEST(core, compression_type_from_string)
+{
+    compression_type type;
+    ASSERT_TRUE(compression_type_from_string("none", type));
+    ASSERT_EQ(compression_type::NONE, type);
+    ASSERT_TRUE(compression_type_from_string("lz4", type));
+    ASSERT_EQ(compression_type::LZ4, type);
+    ASSERT_TRUE(compression_type_from_string("zstd", type));
+    ASSERT_EQ(compression_type::ZSTD, type);
+    ASSERT_FALSE(compression_type_from_string("snappy", type));
+
+    ASSERT_STREQ("lz4", compression_type_to_string(compression_type::LZ4));
+    ASSERT_TRUE(compression_supported(compression_type::NONE));
+}
+
+TEST(core, compress_and_decompress)
+{
+    std::string raw;
+    for (int i = 0; i < 10000; i++) {
+        raw += "key_" + std::to_string(i % 100) + ",value_" + std::to_string(i % 7) + ";";
+    }
+
+    for (auto type : {compression_type::NONE, compression_type::LZ4, compression_type::ZSTD}) {
+        blob compressed;
+        if (type == compression_type::NONE) {
+            ASSERT_FALSE(compress(type, raw, compressed));
+            continue;
+        }
+#ifndef DSN_ENABLE_COMPRESSION
+        // built with ENABLE_COMPRESSION=OFF
+        ASSERT_FALSE(compression_supported(type));
+        ASSERT_FALSE(compress(type, raw, compressed));
+        continue;
+#endif
+        ASSERT_TRUE(compression_supported(type));
+
+        ASSERT_TRUE(compress(type, raw, compressed));
+        ASSERT_LT(compressed.length(), raw.size());
+
+        blob decompressed;
+        ASSERT_TRUE(decompress(
+            type, string_view(compressed.data(), compressed.length()), raw.size(), decompressed));
+        ASSERT_EQ(raw, decompressed.to_string());
+
+        // corrupted data or a wrong size
+        ASSERT_FALSE(decompress(type,
+                                string_view(compressed.data(), compressed.length() / 2),
+                                raw.size(),
+                                decompressed));
+        ASSERT_FALSE(decompress(type,
+                                string_view(compressed.data(), compressed.length()),
+                                raw.size() + 1,
+                                decompressed));
+        // a bogus size is rejected before it's allocated
+        ASSERT_FALSE(decompress(type,
+                                string_view(compressed.data(), compressed.length()),
+                                std::numeric_limits<uint32_t>::max(),
+                                decompressed));
+
+        // it's pointless to compress data that can't be made smaller
+        ASSERT_FALSE(compress(type, "abc", compressed));
+    }
+}
+
+} // namespace utils
+} // namespace dsn
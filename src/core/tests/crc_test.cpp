@@ -0,0 +1,87 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/utility/crc.h>
+#include <dsn/utility/rand.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+
+#include "core/core/crc_impl.h"
+
+namespace dsn {
+namespace utils {
+
+using namespace crc_internal;
+
+TEST(core, crc32_check_value)
+{
+    // the standard check value of CRC32C
+    const char *data = "123456789";
+    ASSERT_EQ(0xe3069283, crc32_bytewise(data, 9, 0));
+    ASSERT_EQ(0xe3069283, crc32_slicing_by_8(data, 9, 0));
+    ASSERT_EQ(0xe3069283, crc32_calc(data, 9, 0));
+    if (crc32_hw_supported()) {
+        ASSERT_EQ(0xe3069283, crc32_hw(data, 9, 0));
+    }
+}
+
+TEST(core, crc32_implementations_agree)
+{
+    std::vector<uint8_t> buffer(64 * 1024);
+    for (auto &b : buffer) {
+        b = static_cast<uint8_t>(rand::next_u32());
+    }
+
+    // cover unaligned heads and tails, and the interleaved path of crc32_hw
+    for (int i = 0; i < 1000; i++) {
+        size_t offset = rand::next_u32(0, 63);
+        size_t size = rand::next_u32(0, static_cast<uint32_t>(buffer.size() - offset));
+        uint32_t init_crc = rand::next_u32();
+        const uint8_t *data = buffer.data() + offset;
+
+        uint32_t expected = crc32_bytewise(data, size, init_crc);
+        ASSERT_EQ(expected, crc32_slicing_by_8(data, size, init_crc));
+        ASSERT_EQ(expected, crc32_calc(data, size, init_crc));
+        if (crc32_hw_supported()) {
+            ASSERT_EQ(expected, crc32_hw(data, size, init_crc));
+        }
+
+        size_t split = rand::next_u32(0, static_cast<uint32_t>(size));
+        uint32_t c1 = crc32_calc(data, split, 0);
+        uint32_t c2 = crc32_calc(data + split, size - split, 0);
+        ASSERT_EQ(crc32_calc(data, size, 0),
+                  crc32_concat(0, 0, c1, split, 0, c2, size - split));
+    }
+}
+
+TEST(core, crc32_benchmark)
+{
+    std::vector<uint8_t> buffer(4 * 1024 * 1024);
+    for (auto &b : buffer) {
+        b = static_cast<uint8_t>(rand::next_u32());
+    }
+
+    auto bench = [&buffer](uint32_t (*func)(const void *, size_t, uint32_t), const char *name) {
+        const int rounds = 32;
+        uint32_t crc = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            crc = func(buffer.data(), buffer.size(), crc);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << buffer.size() * rounds / elapsed.count() / (1 << 20)
+                  << " MB/s, crc = " << crc << std::endl;
+    };
+
+    bench(crc32_bytewise, "crc32_bytewise");
+    bench(crc32_slicing_by_8, "crc32_slicing_by_8");
+    if (crc32_hw_supported()) {
+        bench(crc32_hw, "crc32_hw");
+    }
+}
+
+} // namespace utils
+} // namespace dsn
@@ -0,0 +1,194 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/tool-api/task_spec.h>
+#include <dsn/utility/compression.h>
+
+#include "core/tools/common/dsn_message_parser.h"
+
+namespace dsn {
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_DSN_MESSAGE_PARSER, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
+class dsn_message_parser_test : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        _spec = task_spec::get(RPC_TEST_DSN_MESSAGE_PARSER);
+        _spec->rpc_message_compression_min_bytes = 1024;
+    }
+
+    void TearDown() override
+    {
+        _spec->rpc_message_compression_type = utils::compression_type::NONE;
+    }
+
+    message_ptr create_request(const std::string &body)
+    {
+        message_ptr msg = message_ex::create_request(RPC_TEST_DSN_MESSAGE_PARSER, 1000, 64);
+        rpc_write_stream stream(msg);
+        stream.write(body.data(), static_cast<int>(body.size()));
+        stream.commit_buffer();
+        return msg;
+    }
+
+    // sends msg through a parser, and returns the message received by another parser,
+    // whose data is read in pieces of at most `read_size` bytes
+    message_ptr send_and_receive(message_ex *msg, size_t read_size = 0)
+    {
+        dsn_message_parser sender;
+        sender.prepare_on_send(msg);
+
+        std::unique_ptr<message_parser::send_buf[]> bufs(
+            new message_parser::send_buf[sender.get_buffer_count_on_send(msg)]);
+        int count = sender.get_buffers_on_send(msg, bufs.get());
+        std::string data;
+        for (int i = 0; i < count; i++) {
+            data.append(static_cast<const char *>(bufs[i].buf), bufs[i].sz);
+        }
+        EXPECT_EQ(data.size(), sizeof(message_header) + msg->header->body_length);
+
+        if (read_size == 0) {
+            read_size = data.size();
+        }
+        message_reader reader(4096);
+        dsn_message_parser receiver;
+        message_ptr received;
+        for (size_t offset = 0; offset < data.size(); offset += read_size) {
+            size_t sz = std::min(read_size, data.size() - offset);
+            char *buf = reader.read_buffer_ptr(sz);
+            memcpy(buf, data.data() + offset, sz);
+            reader.mark_read(sz);
+
+            int read_next = 0;
+            received = receiver.get_message_on_receive(&reader, read_next);
+            if (received != nullptr || read_next < 0) {
+                break;
+            }
+        }
+        _copied_bytes = reader.copied_bytes();
+        return received;
+    }
+
+    std::string read_body(message_ex *msg)
+    {
+        std::string body(msg->header->body_length, '\0');
+        rpc_read_stream stream(msg);
+        EXPECT_EQ(stream.read(&body[0], static_cast<int>(body.size())),
+                  static_cast<int>(body.size()));
+        return body;
+    }
+
+    task_spec *_spec;
+    uint64_t _copied_bytes{0};
+};
+
+TEST_F(dsn_message_parser_test, receive_in_multiple_blocks)
+{
+    std::string body;
+    for (int i = 0; i < 1000; i++) {
+        body += "dsn_message_parser_test.receive_in_multiple_blocks ";
+    }
+
+    // the body is received into a chain of blocks without copy
+    message_ptr request = create_request(body);
+    message_ptr received = send_and_receive(request, 1000);
+    ASSERT_NE(received, nullptr);
+    ASSERT_GT(received->buffers.size(), 1);
+    ASSERT_EQ(received->header->body_length, body.size());
+    ASSERT_EQ(read_body(received), body);
+    ASSERT_EQ(_copied_bytes, 0);
+
+    request = create_request(body);
+    received = send_and_receive(request, 30);
+    ASSERT_NE(received, nullptr);
+    ASSERT_GT(received->buffers.size(), 1);
+    ASSERT_EQ(read_body(received), body);
+    ASSERT_EQ(_copied_bytes, 0);
+}
+
+TEST_F(dsn_message_parser_test, compress_body)
+{
+    std::string body;
+    for (int i = 0; i < 10000; i++) {
+        body += "dsn_message_parser_test.compress_body ";
+    }
+
+    for (auto type : {utils::compression_type::LZ4, utils::compression_type::ZSTD}) {
+        if (!utils::compression_supported(type)) {
+            continue;
+        }
+        _spec->rpc_message_compression_type = type;
+
+        message_ptr request = create_request(body);
+        message_ptr received = send_and_receive(request);
+        ASSERT_EQ(request->header->context.u.compression_type, static_cast<uint64_t>(type));
+        ASSERT_LT(request->header->body_length, body.size() / 10);
+
+        ASSERT_NE(received, nullptr);
+        ASSERT_EQ(received->header->context.u.compression_type,
+                  static_cast<uint64_t>(utils::compression_type::NONE));
+        ASSERT_EQ(received->header->body_length, body.size());
+        ASSERT_EQ(received->header->id, request->header->id);
+        ASSERT_EQ(read_body(received), body);
+
+        // the message is compressed only once when it's resent
+        uint32_t compressed_length = request->header->body_length;
+        received = send_and_receive(request);
+        ASSERT_EQ(request->header->body_length, compressed_length);
+        ASSERT_NE(received, nullptr);
+        ASSERT_EQ(read_body(received), body);
+    }
+}
+
+TEST_F(dsn_message_parser_test, compress_body_skipped)
+{
+    if (!utils::compression_supported(utils::compression_type::LZ4)) {
+        return;
+    }
+    _spec->rpc_message_compression_type = utils::compression_type::LZ4;
+
+    // too small to compress
+    std::string body(100, 'a');
+    message_ptr request = create_request(body);
+    message_ptr received = send_and_receive(request);
+    ASSERT_EQ(request->header->context.u.compression_type,
+              static_cast<uint64_t>(utils::compression_type::NONE));
+    ASSERT_NE(received, nullptr);
+    ASSERT_EQ(read_body(received), body);
+
+    // incompressible
+    body.clear();
+    for (int i = 0; i < 4096; i++) {
+        body.push_back(static_cast<char>(rand()));
+    }
+    request = create_request(body);
+    received = send_and_receive(request);
+    ASSERT_EQ(request->header->context.u.compression_type,
+              static_cast<uint64_t>(utils::compression_type::NONE));
+    ASSERT_NE(received, nullptr);
+    ASSERT_EQ(read_body(received), body);
+}
+
+TEST_F(dsn_message_parser_test, corrupted_compressed_body)
+{
+    if (!utils::compression_supported(utils::compression_type::LZ4)) {
+        return;
+    }
+    _spec->rpc_message_compression_type = utils::compression_type::LZ4;
+
+    message_ptr request = create_request(std::string(10000, 'a'));
+    dsn_message_parser::compress_body(request);
+    ASSERT_EQ(request->buffers.size(), 3);
+
+    // claim a wrong raw length
+    uint32_t wrong_length = 20000;
+    memcpy(const_cast<char *>(request->buffers[1].data()), &wrong_length, sizeof(uint32_t));
+    ASSERT_EQ(send_and_receive(request), nullptr);
+}
+
+} // namespace dsn
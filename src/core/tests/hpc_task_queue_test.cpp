@@ -0,0 +1,58 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/task_worker.h>
+#include <gtest/gtest.h>
+
+#include "core/core/service_engine.h"
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_STEALING)
+DEFINE_TASK_CODE(LPC_TEST_WORK_STEALING, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_STEALING)
+
+namespace dsn {
+namespace tools {
+
+static std::vector<int> run_tasks_and_collect_workers(int task_count, int hash)
+{
+    std::vector<int> worker_indexes(task_count, -1);
+    std::vector<task_ptr> tasks;
+    for (int i = 0; i < task_count; i++) {
+        task_ptr t(new raw_task(LPC_TEST_WORK_STEALING,
+                                [&worker_indexes, i]() {
+                                    worker_indexes[i] = task::get_current_worker()->index();
+                                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                                },
+                                hash));
+        t->enqueue();
+        tasks.push_back(t);
+    }
+    for (auto &t : tasks) {
+        t->wait();
+    }
+    return worker_indexes;
+}
+
+TEST(core, hpc_work_stealing_task_queue)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    // tasks without hash are all put into the first queue, idle siblings steal them
+    std::vector<int> workers = run_tasks_and_collect_workers(64, 0);
+    std::set<int> distinct_workers(workers.begin(), workers.end());
+    ASSERT_EQ(0, distinct_workers.count(-1));
+    ASSERT_GT(distinct_workers.size(), 1u);
+
+    // tasks with hash are pinned to the worker they are hashed to
+    for (int hash = 1; hash <= 4; hash++) {
+        workers = run_tasks_and_collect_workers(16, hash);
+        for (int index : workers) {
+            ASSERT_EQ(hash % 4, index);
+        }
+    }
+}
+
+} // namespace tools
+} // namespace dsn
@@ -14,9 +14,10 @@ public:
     void test_init()
     {
         message_reader reader(4096);
-        ASSERT_EQ(reader._buffer_block_size, 4096);
-        ASSERT_EQ(reader._buffer_occupied, 0);
-        ASSERT_EQ(reader._buffer.length(), 0);
+        ASSERT_EQ(reader.buffer_block_size(), 4096);
+        ASSERT_EQ(reader.length(), 0);
+        ASSERT_EQ(reader.read_buffer_capacity(), 0);
+        ASSERT_TRUE(reader._blocks.empty());
     }
 
     void test_read_buffer()
@@ -24,38 +25,42 @@ public:
         message_reader reader(4096);
 
         const char *p1 = reader.read_buffer_ptr(10);
-        ASSERT_EQ(reader._buffer_occupied, 0);
-        ASSERT_EQ(reader._buffer.length(), 4096);
+        ASSERT_EQ(reader.length(), 0);
+        ASSERT_EQ(reader.read_buffer_capacity(), 4096);
         reader.mark_read(10);
-        ASSERT_EQ(reader._buffer_occupied, 10);
+        ASSERT_EQ(reader.length(), 10);
 
         const char *p2 = reader.read_buffer_ptr(10);
-        ASSERT_EQ(reader._buffer_occupied, 10);
-        ASSERT_EQ(reader._buffer.length(), 4096);
+        ASSERT_EQ(reader.length(), 10);
+        ASSERT_EQ(reader.read_buffer_capacity(), 4086);
         reader.mark_read(10);
-        ASSERT_EQ(reader._buffer_occupied, 20);
+        ASSERT_EQ(reader.length(), 20);
         ASSERT_EQ(p2 - p1, 10); // p1, p2 reside on the same allocated memory buffer.
 
         reader.read_buffer_ptr(4076);
-        ASSERT_EQ(reader._buffer_occupied, 20);
-        ASSERT_EQ(reader._buffer.length(), 4096);
+        ASSERT_EQ(reader.length(), 20);
+        ASSERT_EQ(reader.read_buffer_capacity(), 4076);
         reader.mark_read(4076);
-        ASSERT_EQ(reader._buffer_occupied, 4096);
+        ASSERT_EQ(reader.length(), 4096);
+        ASSERT_TRUE(reader._blocks.empty());
 
-        // buffer capacity extends
+        // the full block is kept in the chain, and reading goes on with a new block
         p1 = reader.read_buffer_ptr(1);
-        ASSERT_EQ(reader._buffer_occupied, 4096);
-        ASSERT_EQ(reader._buffer.length(), 4097);
+        ASSERT_EQ(reader.length(), 4096);
+        ASSERT_EQ(reader.read_buffer_capacity(), 4096);
+        ASSERT_EQ(reader._blocks.size(), 1);
         reader.mark_read(1);
-        ASSERT_EQ(reader._buffer_occupied, 4097);
-
-        // if buffer is not consumed in time,
-        // each read will cause one data copy
-        p2 = reader.read_buffer_ptr(3);
-        reader.mark_read(3);
-        ASSERT_EQ(reader._buffer.length(), 4100);
-        ASSERT_EQ(reader._buffer_occupied, 4100);
-        ASSERT_NE(p2 - p1, 3);
+        ASSERT_EQ(reader.length(), 4097);
+
+        // a read larger than the block size gets a block of its own
+        p2 = reader.read_buffer_ptr(8192);
+        ASSERT_EQ(reader.read_buffer_capacity(), 8192);
+        ASSERT_EQ(reader._blocks.size(), 2);
+        reader.mark_read(8192);
+        ASSERT_EQ(reader.length(), 4096 + 1 + 8192);
+
+        // no data is copied when the read buffer is extended
+        ASSERT_EQ(reader.copied_bytes(), 0);
     }
 
     void test_read_data()
@@ -70,6 +75,7 @@ public:
         reader.mark_read(data.length());
         ASSERT_EQ(reader.buffer().size(), data.length());
         ASSERT_EQ(reader.buffer().to_string(), data);
+        ASSERT_EQ(reader.copied_bytes(), 0);
     }
 
     void test_consume_buffer()
@@ -78,13 +84,86 @@ public:
 
         reader.read_buffer_ptr(1000);
         reader.mark_read(1000);
-        ASSERT_EQ(reader._buffer_occupied, 1000);
-        ASSERT_EQ(reader._buffer.length(), 5000);
+        ASSERT_EQ(reader.length(), 1000);
+        ASSERT_EQ(reader.read_buffer_capacity(), 4000);
         ASSERT_EQ(reader.buffer().size(), 1000);
 
         reader.consume_buffer(500);
-        ASSERT_EQ(reader._buffer.length(), 4500);
-        ASSERT_EQ(reader._buffer_occupied, 500);
+        ASSERT_EQ(reader.length(), 500);
+        ASSERT_EQ(reader.read_buffer_capacity(), 4000);
+        ASSERT_EQ(reader.buffer().size(), 500);
+    }
+
+    // writes `data` into the reader in reads of at most `read_size` bytes
+    static void read_data(message_reader &reader, const std::string &data, size_t read_size)
+    {
+        for (size_t offset = 0; offset < data.size(); offset += read_size) {
+            size_t sz = std::min(read_size, data.size() - offset);
+            char *buf = reader.read_buffer_ptr(sz);
+            memcpy(buf, data.data() + offset, sz);
+            reader.mark_read(sz);
+        }
+    }
+
+    void test_multiple_blocks()
+    {
+        message_reader reader(64);
+
+        std::string data;
+        for (int i = 0; i < 200; i++) {
+            data.push_back(static_cast<char>('a' + i % 26));
+        }
+        read_data(reader, data, 48);
+        ASSERT_EQ(reader.length(), data.size());
+
+        // views over the blocks
+        std::vector<blob> buffers;
+        reader.get_buffers(150, buffers);
+        ASSERT_GT(buffers.size(), 1);
+        std::string viewed;
+        for (const blob &bb : buffers) {
+            viewed += bb.to_string();
+        }
+        ASSERT_EQ(viewed, data.substr(0, 150));
+        ASSERT_EQ(reader.copied_bytes(), 0);
+
+        // consume across blocks
+        reader.consume_buffer(100);
+        ASSERT_EQ(reader.length(), 100);
+        reader.get_buffers(100, buffers);
+        viewed.clear();
+        for (const blob &bb : buffers) {
+            viewed += bb.to_string();
+        }
+        ASSERT_EQ(viewed, data.substr(100));
+
+        // the data spanning blocks is copied only once to be contiguous
+        blob bb = reader.front(60);
+        ASSERT_EQ(bb.to_string(), data.substr(100, 60));
+        ASSERT_EQ(reader.copied_bytes(), 60);
+        bb = reader.front(60);
+        ASSERT_EQ(bb.to_string(), data.substr(100, 60));
+        ASSERT_EQ(reader.copied_bytes(), 60);
+        ASSERT_EQ(reader.buffer().to_string(), data.substr(100));
+        ASSERT_EQ(reader.length(), 100);
+
+        reader.consume_buffer(100);
+        ASSERT_EQ(reader.length(), 0);
+        ASSERT_TRUE(reader._blocks.empty());
+    }
+
+    void test_truncate_read()
+    {
+        message_reader reader(64);
+        read_data(reader, std::string(100, 'a'), 30);
+        ASSERT_EQ(reader.length(), 100);
+
+        reader.truncate_read();
+        ASSERT_EQ(reader.length(), 0);
+        ASSERT_TRUE(reader._blocks.empty());
+
+        read_data(reader, "hello", 5);
+        ASSERT_EQ(reader.buffer().to_string(), "hello");
     }
 };
 
@@ -96,4 +175,8 @@ TEST_F(message_reader_test, read_data) { test_read_data(); }
 
 TEST_F(message_reader_test, consume_buffer) { test_consume_buffer(); }
 
+TEST_F(message_reader_test, multiple_blocks) { test_multiple_blocks(); }
+
+TEST_F(message_reader_test, truncate_read) { test_truncate_read(); }
+
 } // namespace dsn
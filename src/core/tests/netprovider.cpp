@@ -35,6 +35,8 @@
 
 #include <memory>
 #include <thread>
+#include <atomic>
+#include <iostream>
 
 #include <gtest/gtest.h>
 
@@ -42,6 +44,7 @@
 
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/task_spec.h>
+#include <dsn/utility/flags.h>
 
 #include "core/tools/common/asio_net_provider.h"
 #include "core/tools/common/network.sim.h"
@@ -303,3 +306,84 @@ TEST(tools_common, asio_network_provider_connection_threshold)
 
     TEST_PORT++;
 }
+
+DSN_DECLARE_bool(io_service_per_worker);
+DSN_DECLARE_bool(io_service_reuse_port);
+
+// sends `count` of requests over `session_count` of sessions in loopback,
+// and returns the throughput in requests per second
+static double asio_net_provider_throughput(int session_count, int count)
+{
+    std::unique_ptr<asio_network_provider> server(
+        new asio_network_provider(task::get_current_rpc(), nullptr));
+    EXPECT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, TEST_PORT, false));
+    std::unique_ptr<asio_network_provider> client(
+        new asio_network_provider(task::get_current_rpc(), nullptr));
+    EXPECT_EQ(ERR_OK, client->start(RPC_CHANNEL_TCP, 0, true));
+
+    std::vector<rpc_session_ptr> sessions;
+    for (int i = 0; i < session_count; i++) {
+        sessions.push_back(client->create_client_session(rpc_address("localhost", TEST_PORT)));
+        sessions.back()->connect();
+    }
+
+    std::atomic<int> ok_count(0), done_count(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        message_ex *msg = message_ex::create_request(RPC_TEST_NETPROVIDER, 0, 0);
+        ::dsn::marshall(msg, std::string("hello world"));
+        rpc_response_task *t = new rpc_response_task(
+            msg,
+            [&ok_count, &done_count](dsn::error_code ec, dsn::message_ex *, dsn::message_ex *) {
+                if (ec == ERR_OK) {
+                    ok_count++;
+                }
+                done_count++;
+            },
+            0);
+        client->engine()->matcher()->on_call(msg, t);
+        sessions[i % session_count]->send_message(msg);
+    }
+    while (done_count.load() < count) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(ok_count.load(), count);
+
+    for (auto &s : sessions) {
+        s->close();
+    }
+    TEST_PORT++;
+    return count / elapsed.count();
+}
+
+TEST(tools_common, asio_net_provider_throughput_benchmark)
+{
+    if (dsn::service_engine::instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    const int session_count = 8;
+    const int count = 20000;
+    struct
+    {
+        const char *name;
+        bool io_service_per_worker;
+        bool io_service_reuse_port;
+    } modes[] = {{"shared io_service", false, false},
+                 {"io_service per worker", true, false},
+                 {"io_service per worker with SO_REUSEPORT", true, true}};
+    for (const auto &mode : modes) {
+        FLAGS_io_service_per_worker = mode.io_service_per_worker;
+        FLAGS_io_service_reuse_port = mode.io_service_reuse_port;
+        double qps = asio_net_provider_throughput(session_count, count);
+        std::cout << mode.name << ": " << qps << " rpc/s" << std::endl;
+    }
+    FLAGS_io_service_per_worker = false;
+    FLAGS_io_service_reuse_port = false;
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+}
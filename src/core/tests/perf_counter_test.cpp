@@ -131,6 +131,7 @@ TEST(perf_counter, print_type)
     ASSERT_STREQ("VOLATILE_NUMBER", dsn_counter_type_to_string(COUNTER_TYPE_VOLATILE_NUMBER));
     ASSERT_STREQ("RATE", dsn_counter_type_to_string(COUNTER_TYPE_RATE));
     ASSERT_STREQ("PERCENTILE", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_PERCENTILES));
+    ASSERT_STREQ("HISTOGRAM", dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_HISTOGRAM));
     ASSERT_STREQ("INVALID_COUNTER", dsn_counter_type_to_string(COUNTER_TYPE_INVALID));
 
     ASSERT_EQ(COUNTER_TYPE_NUMBER,
@@ -143,6 +144,9 @@ TEST(perf_counter, print_type)
     ASSERT_EQ(
         COUNTER_TYPE_NUMBER_PERCENTILES,
         dsn_counter_type_from_string(dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_PERCENTILES)));
+    ASSERT_EQ(
+        COUNTER_TYPE_NUMBER_HISTOGRAM,
+        dsn_counter_type_from_string(dsn_counter_type_to_string(COUNTER_TYPE_NUMBER_HISTOGRAM)));
     ASSERT_EQ(COUNTER_TYPE_INVALID, dsn_counter_type_from_string("xxxx"));
 
     ASSERT_STREQ("P50", dsn_percentile_type_to_string(COUNTER_PERCENTILE_50));
@@ -169,3 +173,85 @@ TEST(perf_counter, print_type)
         dsn_percentile_type_from_string(dsn_percentile_type_to_string(COUNTER_PERCENTILE_999)));
     ASSERT_EQ(COUNTER_PERCENTILE_INVALID, dsn_percentile_type_from_string("afafda"));
 }
+
+namespace dsn {
+class perf_counter_histogram_test : public testing::Test
+{
+public:
+    void calc(perf_counter_number_histogram_atomic *counter) { counter->calc(); }
+};
+
+TEST_F(perf_counter_histogram_test, bucket_index)
+{
+    typedef perf_counter_number_histogram_atomic histogram;
+
+    // small values are exact
+    for (int64_t v = 0; v < 2 * HISTOGRAM_SUB_BUCKET_COUNT; v++) {
+        ASSERT_EQ(v, histogram::bucket_value(histogram::bucket_index(v)));
+    }
+    ASSERT_EQ(0, histogram::bucket_index(-100));
+    ASSERT_EQ(HISTOGRAM_BUCKET_COUNT - 1, histogram::bucket_index(INT64_MAX));
+
+    // the buckets are contiguous, and the relative error is bounded
+    int last_index = histogram::bucket_index(2 * HISTOGRAM_SUB_BUCKET_COUNT - 1);
+    for (int64_t v = 2 * HISTOGRAM_SUB_BUCKET_COUNT; v < (1 << 20); v++) {
+        int index = histogram::bucket_index(v);
+        ASSERT_TRUE(index == last_index || index == last_index + 1) << v;
+        last_index = index;
+
+        double error = std::abs(histogram::bucket_value(index) - v) / (double)v;
+        ASSERT_LE(error, 1.0 / HISTOGRAM_SUB_BUCKET_COUNT) << v;
+    }
+}
+
+TEST_F(perf_counter_histogram_test, percentiles)
+{
+    ref_ptr<perf_counter_number_histogram_atomic> counter =
+        new perf_counter_number_histogram_atomic(
+            "", "", "", COUNTER_TYPE_NUMBER_HISTOGRAM, "");
+
+    // 1..100000 recorded by multiple threads
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([counter, t]() {
+            for (int v = t + 1; v <= 100000; v += 4) {
+                counter->set(v);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    calc(counter.get());
+
+    auto expect_near = [](double expected, double actual) {
+        ASSERT_LE(std::abs(actual - expected) / expected, 1.0 / HISTOGRAM_SUB_BUCKET_COUNT)
+            << expected << " vs " << actual;
+    };
+    expect_near(50000, counter->get_percentile(COUNTER_PERCENTILE_50));
+    expect_near(90000, counter->get_percentile(COUNTER_PERCENTILE_90));
+    expect_near(99000, counter->get_percentile(COUNTER_PERCENTILE_99));
+    expect_near(99900, counter->get_percentile(COUNTER_PERCENTILE_999));
+    expect_near(25000, counter->get_quantile(0.25));
+    ASSERT_GT(counter->get_value(), 0);
+
+    // only the samples since the last computation are taken
+    for (int i = 0; i < 1000; i++) {
+        counter->set(7);
+    }
+    calc(counter.get());
+    ASSERT_EQ(7, counter->get_percentile(COUNTER_PERCENTILE_999));
+    ASSERT_EQ(7, counter->get_quantile(0.01));
+
+    // the summary covers all the samples
+    uint64_t count;
+    double sum;
+    counter->get_summary(count, sum);
+    ASSERT_EQ(101000, count);
+    expect_near(100000.0 * 100001 / 2 + 7000, sum);
+
+    calc(counter.get());
+    ASSERT_EQ(0, counter->get_percentile(COUNTER_PERCENTILE_99));
+    ASSERT_EQ(0, counter->get_value());
+}
+} // namespace dsn
@@ -0,0 +1,162 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+#include <dsn/tool-api/gpid.h>
+#include <dsn/utility/autoref_ptr.h>
+#include <dsn/utility/rand.h>
+#include <dsn/utility/rcu_snapshot.h>
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+struct versioned_map
+{
+    explicit versioned_map(int v) : version(v)
+    {
+        for (int i = 0; i < 100; i++) {
+            values[i] = v;
+        }
+    }
+    ~versioned_map() { version = -1; }
+
+    int version;
+    std::unordered_map<int, int> values;
+};
+
+} // namespace
+
+TEST(rcu_snapshot_test, read_published_version)
+{
+    rcu_snapshot<versioned_map> snapshot(std::make_shared<const versioned_map>(1));
+    ASSERT_EQ(1, snapshot.read([](const versioned_map &m) { return m.version; }));
+
+    snapshot.publish(std::make_shared<const versioned_map>(2));
+    ASSERT_EQ(2, snapshot.read([](const versioned_map &m) { return m.values.at(10); }));
+    ASSERT_EQ(2, snapshot.get()->version);
+}
+
+TEST(rcu_snapshot_test, concurrent_read_and_publish)
+{
+    rcu_snapshot<versioned_map> snapshot(std::make_shared<const versioned_map>(0));
+    std::atomic_bool stop{false};
+    std::atomic<int> torn_reads{0};
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            int last_version = 0;
+            while (!stop.load()) {
+                int version = snapshot.read([&](const versioned_map &m) {
+                    // the version must not be released while it's being read
+                    for (const auto &kv : m.values) {
+                        if (kv.second != m.version) {
+                            torn_reads++;
+                        }
+                    }
+                    return m.version;
+                });
+                if (version < last_version) {
+                    torn_reads++;
+                }
+                last_version = version;
+            }
+        });
+    }
+
+    for (int v = 1; v <= 2000; v++) {
+        snapshot.publish(std::make_shared<const versioned_map>(v));
+    }
+    stop.store(true);
+    for (auto &t : readers) {
+        t.join();
+    }
+
+    ASSERT_EQ(0, torn_reads.load());
+    ASSERT_EQ(2000, snapshot.read([](const versioned_map &m) { return m.version; }));
+}
+
+namespace {
+
+struct mock_replica : public ref_counter
+{
+    explicit mock_replica(gpid p) : pid(p) {}
+    gpid pid;
+};
+typedef ref_ptr<mock_replica> mock_replica_ptr;
+typedef std::unordered_map<gpid, mock_replica_ptr> mock_replicas;
+
+} // namespace
+
+// compares looking up replicas under a shared read lock with looking up an rcu snapshot
+TEST(rcu_snapshot_test, lookup_benchmark)
+{
+    const int partition_count = 4096;
+    mock_replicas replicas;
+    for (int i = 0; i < partition_count; i++) {
+        gpid pid(1 + i / 256, i % 256);
+        replicas.emplace(pid, new mock_replica(pid));
+    }
+
+    rw_lock_nr replicas_lock;
+    rcu_snapshot<mock_replicas> snapshot(std::make_shared<const mock_replicas>(replicas));
+
+    auto bench = [&](int thread_count, const char *name, bool use_snapshot) {
+        const int lookups_per_thread = 100000;
+        std::atomic<int> misses{0};
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < thread_count; t++) {
+            threads.emplace_back([&]() {
+                uint64_t seed = rand::next_u64();
+                for (int i = 0; i < lookups_per_thread; i++) {
+                    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                    int index = static_cast<int>((seed >> 33) % partition_count);
+                    gpid pid(1 + index / 256, index % 256);
+
+                    mock_replica_ptr r;
+                    if (use_snapshot) {
+                        r = snapshot.read([pid](const mock_replicas &rs) -> mock_replica_ptr {
+                            auto it = rs.find(pid);
+                            if (it != rs.end())
+                                return it->second;
+                            else
+                                return nullptr;
+                        });
+                    } else {
+                        auto_read_lock l(replicas_lock);
+                        auto it = replicas.find(pid);
+                        r = (it != replicas.end() ? it->second : nullptr);
+                    }
+                    if (r == nullptr) {
+                        misses++;
+                    }
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << " with " << thread_count << " threads: "
+                  << thread_count * lookups_per_thread / elapsed.count() / 1e6 << " M lookups/s"
+                  << std::endl;
+        ASSERT_EQ(0, misses.load());
+    };
+
+    int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int thread_count : {1, max_threads}) {
+        bench(thread_count, "rw_lock_nr + unordered_map", false);
+        bench(thread_count, "rcu_snapshot", true);
+    }
+}
+
+} // namespace utils
+} // namespace dsn
@@ -245,3 +245,27 @@ TEST(core, send_to_invalid_address)
 
     send_message(group, std::string("echo hehehe"), 1, action_on_succeed, action_on_failure);
 }
+
+TEST(core, rpc_timeout)
+{
+    // the server at TEST_PORT_BEGIN never replies "expect_no_reply"
+    ::dsn::rpc_address server("localhost", TEST_PORT_BEGIN);
+    const int timeout_ms = 300;
+
+    error_code rpc_err;
+    uint64_t start_ms = dsn_now_ms();
+    dsn::message_ex *request =
+        dsn::message_ex::create_request(RPC_TEST_STRING_COMMAND, timeout_ms);
+    ::dsn::marshall(request, std::string("expect_no_reply"));
+    dsn::task_ptr resp_task = ::dsn::rpc::call(
+        server, request, nullptr, [&rpc_err](error_code err, dsn::message_ex *, dsn::message_ex *) {
+            rpc_err = err;
+        });
+    resp_task->wait();
+    uint64_t elapsed_ms = dsn_now_ms() - start_ms;
+
+    ASSERT_EQ(ERR_TIMEOUT, rpc_err);
+    ASSERT_GE(elapsed_ms, timeout_ms);
+    // the timeout is reported by the next sweep after the deadline
+    ASSERT_LT(elapsed_ms, timeout_ms + 1000);
+}
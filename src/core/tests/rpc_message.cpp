@@ -36,6 +36,7 @@
 #include <dsn/utility/crc.h>
 #include <dsn/utility/transient_memory.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <dsn/cpp/rpc_stream.h>
 #include <core/core/message_utils.cpp>
 #include <gtest/gtest.h>
 
@@ -195,3 +196,33 @@ TEST(rpc_message, restore_read)
         msg->restore_read();
     }
 }
+
+TEST(rpc_message, write_large_blob)
+{
+    using namespace dsn;
+    message_ptr request = message_ex::create_request(RPC_CODE_FOR_TEST, 100, 1);
+    blob small = blob::create_from_bytes(std::string(100, 's'));
+    blob large = blob::create_from_bytes(std::string(rpc_write_stream::ZERO_COPY_MIN_BYTES, 'l'));
+    {
+        rpc_write_stream writer(request);
+        writer.write(small);
+        writer.write(large);
+        writer.write(small);
+    }
+
+    // the large blob is referenced by the message rather than copied
+    ASSERT_EQ(1,
+              std::count_if(request->buffers.begin(),
+                            request->buffers.end(),
+                            [&large](const blob &b) { return b.data() == large.data(); }));
+    ASSERT_EQ(sizeof(int) * 3 + small.length() * 2 + large.length(),
+              request->header->body_length);
+
+    message_ptr receive = request->copy(true, true);
+    rpc_read_stream reader(receive);
+    blob bb;
+    for (const blob &expected : {small, large, small}) {
+        ASSERT_EQ(static_cast<int>(sizeof(int) + expected.length()), reader.read(bb));
+        ASSERT_EQ(expected.to_string(), bb.to_string());
+    }
+}
@@ -203,7 +203,7 @@ TEST_F(thrift_message_parser_test, get_message_on_receive_incomplete_second_fiel
         message_reader reader(64);
         data = std::string("THFT") + std::string(i, ' ');
         mock_reader_read_data(reader, data);
-        ASSERT_EQ(reader._buffer_occupied, 4 + i);
+        ASSERT_EQ(reader.length(), 4 + i);
         ASSERT_EQ(reader.buffer().size(), 4 + i);
 
         message_ex *msg = parser.get_message_on_receive(&reader, read_next);
@@ -214,7 +214,7 @@ TEST_F(thrift_message_parser_test, get_message_on_receive_incomplete_second_fiel
         ASSERT_EQ(parser._v1_specific_vars->_meta_length, 0);
 
         // not consumed
-        ASSERT_EQ(reader._buffer_occupied, data.length());
+        ASSERT_EQ(reader.length(), data.length());
         ASSERT_EQ(reader.buffer().size(), data.length());
     }
 }
@@ -0,0 +1,91 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/service_api_cpp.h>
+#include <gtest/gtest.h>
+
+#include "core/core/service_engine.h"
+#include "core/tools/common/simple_task_queue.h"
+#include "core/tools/hpc/timing_wheel_timer_service.h"
+
+DEFINE_TASK_CODE(LPC_TIMER_SERVICE_TEST, TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+
+namespace dsn {
+namespace tools {
+
+// emulates task::enqueue(pool) for a delayed task
+static void add_timer(timer_service &svc, task *t, int delay_ms)
+{
+    t->set_delay(delay_ms);
+    t->add_ref(); // released by the timer service
+    svc.add_timer(t);
+}
+
+TEST(core, timing_wheel_timer_service)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    timing_wheel_timer_service svc(task::get_current_node2(), nullptr);
+    svc.start();
+
+    // the delays cover the root wheel and the first level
+    std::vector<int> delays = {1, 5, 100, 255, 256, 300, 1000, 3000};
+    std::vector<uint64_t> fired_ms(delays.size(), 0);
+    std::vector<task_ptr> tasks;
+    uint64_t start_ms = dsn_now_ms();
+    for (size_t i = 0; i < delays.size(); i++) {
+        task_ptr t(new raw_task(LPC_TIMER_SERVICE_TEST, [&fired_ms, i]() {
+            fired_ms[i] = dsn_now_ms();
+        }));
+        add_timer(svc, t, delays[i]);
+        tasks.push_back(t);
+    }
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+        ASSERT_TRUE(tasks[i]->wait(30000));
+        ASSERT_GE(fired_ms[i] - start_ms, delays[i]);
+    }
+}
+
+// inserts a batch of timers into each service and compares the insertion cost
+TEST(core, timer_service_benchmark)
+{
+    if (dsn::service_engine::instance().spec().tool == "simulator")
+        return;
+
+    const int timer_count = 20000;
+    auto bench = [timer_count](timer_service &svc, const char *name) {
+        std::atomic<int> fired(0);
+        std::vector<task_ptr> tasks;
+        tasks.reserve(timer_count);
+        for (int i = 0; i < timer_count; i++) {
+            tasks.emplace_back(new raw_task(LPC_TIMER_SERVICE_TEST, [&fired]() { fired++; }));
+        }
+
+        uint64_t start_ns = dsn_now_ns();
+        for (int i = 0; i < timer_count; i++) {
+            add_timer(svc, tasks[i], 100 + i % 1000);
+        }
+        uint64_t insert_ns = dsn_now_ns() - start_ns;
+
+        for (auto &t : tasks) {
+            ASSERT_TRUE(t->wait(30000));
+        }
+        ASSERT_EQ(timer_count, fired.load());
+        std::cout << name << ": " << timer_count << " timers inserted in " << insert_ns / 1000
+                  << " us, " << insert_ns / timer_count << " ns per timer" << std::endl;
+    };
+
+    simple_timer_service simple_svc(task::get_current_node2(), nullptr);
+    simple_svc.start();
+    bench(simple_svc, "simple_timer_service");
+
+    timing_wheel_timer_service wheel_svc(task::get_current_node2(), nullptr);
+    wheel_svc.start();
+    bench(wheel_svc, "timing_wheel_timer_service");
+}
+
+} // namespace tools
+} // namespace dsn
@@ -25,6 +25,7 @@
  */
 
 #include <dsn/utility/rand.h>
+#include <dsn/utility/flags.h>
 #include <memory>
 
 #include "asio_net_provider.h"
@@ -33,18 +34,33 @@
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_bool("network",
+                io_service_per_worker,
+                false,
+                "whether each io service worker runs an io_service of its own, to which "
+                "the sessions are pinned, rather than all the workers sharing one io_service");
+DSN_DEFINE_bool("network",
+                io_service_reuse_port,
+                false,
+                "whether each io_service accepts connections by an acceptor of its own with "
+                "SO_REUSEPORT, only valid if io_service_per_worker is true");
+
 asio_network_provider::asio_network_provider(rpc_engine *srv, network *inner_provider)
-    : connection_oriented_network(srv, inner_provider)
+    : connection_oriented_network(srv, inner_provider),
+      _io_service_per_worker(FLAGS_io_service_per_worker),
+      _next_io_service(0)
 {
-    _acceptor = nullptr;
+    _io_services.emplace_back(new boost::asio::io_service());
 }
 
 asio_network_provider::~asio_network_provider()
 {
-    if (_acceptor) {
-        _acceptor->close();
+    for (auto &acceptor : _acceptors) {
+        acceptor->close();
+    }
+    for (auto &ios : _io_services) {
+        ios->stop();
     }
-    _io_service.stop();
     for (auto &w : _workers) {
         w->join();
     }
@@ -52,7 +68,7 @@ asio_network_provider::~asio_network_provider()
 
 error_code asio_network_provider::start(rpc_channel channel, int port, bool client_only)
 {
-    if (_acceptor != nullptr)
+    if (!_acceptors.empty())
         return ERR_SERVICE_ALREADY_RUNNING;
 
     int io_service_worker_count =
@@ -66,7 +82,15 @@ error_code asio_network_provider::start(rpc_channel channel, int port, bool clie
         "network", "conn_threshold_per_ip", 0, "max connection count to each server per ip");
 
     for (int i = 0; i < io_service_worker_count; i++) {
-        _workers.push_back(std::make_shared<std::thread>([this, i]() {
+        boost::asio::io_service *ios = _io_services[0].get();
+        if (_io_service_per_worker) {
+            if (_workers.size() >= _io_services.size()) {
+                _io_services.emplace_back(new boost::asio::io_service());
+            }
+            ios = _io_services[_workers.size()].get();
+        }
+
+        _workers.push_back(std::make_shared<std::thread>([this, i, ios]() {
             task::set_tls_dsn_context(node(), nullptr);
 
             const char *name = ::dsn::tools::get_service_node_name(node());
@@ -74,17 +98,15 @@ error_code asio_network_provider::start(rpc_channel channel, int port, bool clie
             sprintf(buffer, "%s.asio.%d", name, i);
             task_worker::set_name(buffer);
 
-            boost::asio::io_service::work work(_io_service);
+            boost::asio::io_service::work work(*ios);
             boost::system::error_code ec;
-            _io_service.run(ec);
+            ios->run(ec);
             if (ec) {
                 dassert(false, "boost::asio::io_service run failed: err(%s)", ec.message().data());
             }
         }));
     }
 
-    _acceptor = nullptr;
-
     dassert(channel == RPC_CHANNEL_TCP || channel == RPC_CHANNEL_UDP,
             "invalid given channel %s",
             channel.to_string());
@@ -94,48 +116,93 @@ error_code asio_network_provider::start(rpc_channel channel, int port, bool clie
     if (!client_only) {
         auto v4_addr = boost::asio::ip::address_v4::any(); //(ntohl(_address.ip));
         ::boost::asio::ip::tcp::endpoint endpoint(v4_addr, _address.port());
-        boost::system::error_code ec;
-        _acceptor.reset(new boost::asio::ip::tcp::acceptor(_io_service));
-        _acceptor->open(endpoint.protocol(), ec);
-        if (ec) {
-            derror("asio tcp acceptor open failed, error = %s", ec.message().c_str());
-            _acceptor.reset();
-            return ERR_NETWORK_INIT_FAILED;
+
+        // with SO_REUSEPORT, the kernel distributes the connections among the acceptors
+        bool reuse_port = _io_service_per_worker && FLAGS_io_service_reuse_port;
+        size_t acceptor_count = reuse_port ? _io_services.size() : 1;
+        for (size_t i = 0; i < acceptor_count; i++) {
+            error_code err = open_acceptor(*_io_services[i], endpoint, reuse_port);
+            if (err != ERR_OK) {
+                for (auto &acceptor : _acceptors) {
+                    acceptor->close();
+                }
+                _acceptors.clear();
+                return err;
+            }
         }
-        _acceptor->set_option(boost::asio::socket_base::reuse_address(true));
-        _acceptor->bind(endpoint, ec);
-        if (ec) {
-            derror("asio tcp acceptor bind failed, error = %s", ec.message().c_str());
-            _acceptor.reset();
-            return ERR_NETWORK_INIT_FAILED;
+        for (size_t i = 0; i < _acceptors.size(); i++) {
+            do_accept(i);
         }
-        int backlog = boost::asio::socket_base::max_connections;
-        _acceptor->listen(backlog, ec);
+    }
+
+    return ERR_OK;
+}
+
+error_code asio_network_provider::open_acceptor(boost::asio::io_service &ios,
+                                                const boost::asio::ip::tcp::endpoint &endpoint,
+                                                bool reuse_port)
+{
+    boost::system::error_code ec;
+    std::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor(
+        new boost::asio::ip::tcp::acceptor(ios));
+    acceptor->open(endpoint.protocol(), ec);
+    if (ec) {
+        derror("asio tcp acceptor open failed, error = %s", ec.message().c_str());
+        return ERR_NETWORK_INIT_FAILED;
+    }
+    acceptor->set_option(boost::asio::socket_base::reuse_address(true));
+    if (reuse_port) {
+        typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port_t;
+        acceptor->set_option(reuse_port_t(true), ec);
         if (ec) {
-            derror("asio tcp acceptor listen failed, port = %u, error = %s",
-                   _address.port(),
-                   ec.message().c_str());
-            _acceptor.reset();
+            derror("asio tcp acceptor set SO_REUSEPORT failed, error = %s", ec.message().c_str());
             return ERR_NETWORK_INIT_FAILED;
         }
-        do_accept();
     }
-
+    acceptor->bind(endpoint, ec);
+    if (ec) {
+        derror("asio tcp acceptor bind failed, error = %s", ec.message().c_str());
+        return ERR_NETWORK_INIT_FAILED;
+    }
+    int backlog = boost::asio::socket_base::max_connections;
+    acceptor->listen(backlog, ec);
+    if (ec) {
+        derror("asio tcp acceptor listen failed, port = %u, error = %s",
+               _address.port(),
+               ec.message().c_str());
+        return ERR_NETWORK_INIT_FAILED;
+    }
+    _acceptors.push_back(std::move(acceptor));
     return ERR_OK;
 }
 
+boost::asio::io_service &asio_network_provider::next_io_service()
+{
+    if (!_io_service_per_worker) {
+        return *_io_services[0];
+    }
+    return *_io_services[_next_io_service++ % _io_services.size()];
+}
+
 rpc_session_ptr asio_network_provider::create_client_session(::dsn::rpc_address server_addr)
 {
-    auto sock = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
+    boost::asio::io_service &ios = next_io_service();
+    auto sock = std::make_shared<boost::asio::ip::tcp::socket>(ios);
     message_parser_ptr parser(new_message_parser(_client_hdr_format));
-    return rpc_session_ptr(new asio_rpc_session(*this, server_addr, sock, parser, true));
+    return rpc_session_ptr(new asio_rpc_session(
+        *this, server_addr, sock, parser, true, _io_service_per_worker ? &ios : nullptr));
 }
 
-void asio_network_provider::do_accept()
+void asio_network_provider::do_accept(size_t index)
 {
-    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(_io_service);
-
-    _acceptor->async_accept(*socket, [this, socket](boost::system::error_code ec) {
+    // the connection is served by the io_service of the acceptor if there are multiple acceptors
+    boost::asio::io_service &ios =
+        _acceptors.size() > 1 ? *_io_services[index] : next_io_service();
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ios);
+    boost::asio::io_service *loop = _io_service_per_worker ? &ios : nullptr;
+
+    _acceptors[index]->async_accept(*socket, [this, index, socket, loop](
+                                                 boost::system::error_code ec) {
         if (!ec) {
             auto remote = socket->remote_endpoint(ec);
             if (ec) {
@@ -151,7 +218,8 @@ void asio_network_provider::do_accept()
                                          client_addr,
                                          (std::shared_ptr<boost::asio::ip::tcp::socket> &)socket,
                                          null_parser,
-                                         false);
+                                         false,
+                                         loop);
 
                 // when server connection threshold is hit, close the session, otherwise accept it
                 if (check_if_conn_threshold_exceeded(s->remote_address())) {
@@ -169,7 +237,7 @@ void asio_network_provider::do_accept()
             }
         }
 
-        do_accept();
+        do_accept(index);
     });
 }
 
@@ -261,8 +329,8 @@ void asio_udp_provider::do_receive()
     _socket->async_receive_from(
         ::boost::asio::buffer(buffer_ptr, max_udp_packet_size),
         *send_endpoint,
-        [this, send_endpoint](const boost::system::error_code &error,
-                              std::size_t bytes_transferred) {
+        [this, send_endpoint, buffer_ptr](const boost::system::error_code &error,
+                                          std::size_t bytes_transferred) {
             if (!!error) {
                 derror(
                     "%s: asio udp read failed: %s", _address.to_string(), error.message().c_str());
@@ -276,11 +344,11 @@ void asio_udp_provider::do_receive()
                 return;
             }
 
-            auto hdr_format = message_parser::get_header_type(_recv_reader._buffer.data());
+            auto hdr_format = message_parser::get_header_type(buffer_ptr);
             if (NET_HDR_INVALID == hdr_format) {
                 derror("%s: asio udp read failed: invalid header type '%s'",
                        _address.to_string(),
-                       message_parser::get_debug_string(_recv_reader._buffer.data()).c_str());
+                       message_parser::get_debug_string(buffer_ptr).c_str());
                 do_receive();
                 return;
             }
@@ -44,14 +44,27 @@ public:
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
 
 private:
-    void do_accept();
+    // accepts connections with _acceptors[index]
+    void do_accept(size_t index);
+    error_code open_acceptor(boost::asio::io_service &ios,
+                             const boost::asio::ip::tcp::endpoint &endpoint,
+                             bool reuse_port);
+
+    // the io_service which a new session is pinned to, selected in round-robin
+    boost::asio::io_service &next_io_service();
 
 private:
     friend class asio_rpc_session;
     friend class asio_network_provider_test;
 
-    std::shared_ptr<boost::asio::ip::tcp::acceptor> _acceptor;
-    boost::asio::io_service _io_service;
+    // if _io_service_per_worker is false, all the workers run _io_services[0], otherwise each
+    // worker runs an io_service of its own, and each session is served by a single worker
+    bool _io_service_per_worker;
+    std::vector<std::unique_ptr<boost::asio::io_service>> _io_services;
+    std::atomic<uint32_t> _next_io_service;
+
+    // there is one acceptor per io_service when SO_REUSEPORT is used, otherwise only one
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::acceptor>> _acceptors;
     std::vector<std::shared_ptr<std::thread>> _workers;
     ::dsn::rpc_address _address;
 };
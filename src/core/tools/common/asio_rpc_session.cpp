@@ -31,7 +31,10 @@ namespace tools {
 
 void asio_rpc_session::set_options()
 {
-    utils::auto_write_lock socket_guard(_socket_lock);
+    // a pinned session sets options only when it's created or in its loop, without locking
+    if (_loop == nullptr) {
+        _socket_lock.lock_write();
+    }
 
     if (_socket->is_open()) {
         boost::system::error_code ec;
@@ -74,59 +77,63 @@ void asio_rpc_session::set_options()
             dwarn("asio socket set option failed, error = %s", ec.message().c_str());
         dinfo("boost asio set no_delay = true");
     }
+
+    if (_loop == nullptr) {
+        _socket_lock.unlock_write();
+    }
 }
 
 void asio_rpc_session::do_read(int read_next)
 {
     add_ref();
 
-    void *ptr = _reader.read_buffer_ptr(read_next);
-    int remaining = _reader.read_buffer_capacity();
-
-    utils::auto_read_lock socket_guard(_socket_lock);
-
-    _socket->async_read_some(
-        boost::asio::buffer(ptr, remaining),
-        [this](boost::system::error_code ec, std::size_t length) {
-            if (!!ec) {
-                if (ec == boost::asio::error::make_error_code(boost::asio::error::eof)) {
-                    ddebug("asio read from %s failed: %s",
-                           _remote_addr.to_string(),
-                           ec.message().c_str());
+    with_socket(false, [this, read_next]() {
+        void *ptr = _reader.read_buffer_ptr(read_next);
+        int remaining = _reader.read_buffer_capacity();
+
+        _socket->async_read_some(
+            boost::asio::buffer(ptr, remaining),
+            [this](boost::system::error_code ec, std::size_t length) {
+                if (!!ec) {
+                    if (ec == boost::asio::error::make_error_code(boost::asio::error::eof)) {
+                        ddebug("asio read from %s failed: %s",
+                               _remote_addr.to_string(),
+                               ec.message().c_str());
+                    } else {
+                        derror("asio read from %s failed: %s",
+                               _remote_addr.to_string(),
+                               ec.message().c_str());
+                    }
+                    on_failure();
                 } else {
-                    derror("asio read from %s failed: %s",
-                           _remote_addr.to_string(),
-                           ec.message().c_str());
-                }
-                on_failure();
-            } else {
-                _reader.mark_read(length);
+                    _reader.mark_read(length);
 
-                int read_next = -1;
+                    int read_next = -1;
 
-                if (!_parser) {
-                    read_next = prepare_parser();
-                }
+                    if (!_parser) {
+                        read_next = prepare_parser();
+                    }
 
-                if (_parser) {
-                    message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+                    if (_parser) {
+                        message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
 
-                    while (msg != nullptr) {
-                        this->on_message_read(msg);
-                        msg = _parser->get_message_on_receive(&_reader, read_next);
+                        while (msg != nullptr) {
+                            this->on_message_read(msg);
+                            msg = _parser->get_message_on_receive(&_reader, read_next);
+                        }
                     }
-                }
 
-                if (read_next == -1) {
-                    derror("asio read from %s failed", _remote_addr.to_string());
-                    on_failure();
-                } else {
-                    start_read_next(read_next);
+                    if (read_next == -1) {
+                        derror("asio read from %s failed", _remote_addr.to_string());
+                        on_failure();
+                    } else {
+                        start_read_next(read_next);
+                    }
                 }
-            }
 
-            release_ref();
-        });
+                release_ref();
+            });
+    });
 }
 
 void asio_rpc_session::send(uint64_t signature)
@@ -142,27 +149,32 @@ void asio_rpc_session::send(uint64_t signature)
 
     add_ref();
 
-    utils::auto_read_lock socket_guard(_socket_lock);
-    boost::asio::async_write(
-        *_socket, asio_wbufs, [this, signature](boost::system::error_code ec, std::size_t length) {
-            if (ec) {
-                derror(
-                    "asio write to %s failed: %s", _remote_addr.to_string(), ec.message().c_str());
-                on_failure(true);
-            } else {
-                on_send_completed(signature);
-            }
-
-            release_ref();
-        });
+    with_socket(false, [this, signature, asio_wbufs]() {
+        boost::asio::async_write(
+            *_socket,
+            asio_wbufs,
+            [this, signature](boost::system::error_code ec, std::size_t length) {
+                if (ec) {
+                    derror("asio write to %s failed: %s",
+                           _remote_addr.to_string(),
+                           ec.message().c_str());
+                    on_failure(true);
+                } else {
+                    on_send_completed(signature);
+                }
+
+                release_ref();
+            });
+    });
 }
 
 asio_rpc_session::asio_rpc_session(asio_network_provider &net,
                                    ::dsn::rpc_address remote_addr,
                                    std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
                                    message_parser_ptr &parser,
-                                   bool is_client)
-    : rpc_session(net, remote_addr, parser, is_client), _socket(socket)
+                                   bool is_client,
+                                   boost::asio::io_service *loop)
+    : rpc_session(net, remote_addr, parser, is_client), _socket(socket), _loop(loop)
 {
     set_options();
 }
@@ -176,15 +188,15 @@ void asio_rpc_session::on_failure(bool is_write)
 
 void asio_rpc_session::close()
 {
-    utils::auto_write_lock socket_guard(_socket_lock);
-
-    boost::system::error_code ec;
-    _socket->shutdown(boost::asio::socket_base::shutdown_type::shutdown_both, ec);
-    if (ec)
-        dwarn("asio socket shutdown failed, error = %s", ec.message().c_str());
-    _socket->close(ec);
-    if (ec)
-        dwarn("asio socket close failed, error = %s", ec.message().c_str());
+    with_socket(true, [this]() {
+        boost::system::error_code ec;
+        _socket->shutdown(boost::asio::socket_base::shutdown_type::shutdown_both, ec);
+        if (ec)
+            dwarn("asio socket shutdown failed, error = %s", ec.message().c_str());
+        _socket->close(ec);
+        if (ec)
+            dwarn("asio socket close failed, error = %s", ec.message().c_str());
+    });
 }
 
 void asio_rpc_session::connect()
@@ -194,21 +206,23 @@ void asio_rpc_session::connect()
                                           _remote_addr.port());
 
         add_ref();
-        _socket->async_connect(ep, [this](boost::system::error_code ec) {
-            if (!ec) {
-                dinfo("client session %s connected", _remote_addr.to_string());
-
-                set_options();
-                set_connected();
-                on_send_completed();
-                start_read_next();
-            } else {
-                derror("client session connect to %s failed, error = %s",
-                       _remote_addr.to_string(),
-                       ec.message().c_str());
-                on_failure(true);
-            }
-            release_ref();
+        with_socket(false, [this, ep]() {
+            _socket->async_connect(ep, [this](boost::system::error_code ec) {
+                if (!ec) {
+                    dinfo("client session %s connected", _remote_addr.to_string());
+
+                    set_options();
+                    set_connected();
+                    on_send_completed();
+                    start_read_next();
+                } else {
+                    derror("client session connect to %s failed, error = %s",
+                           _remote_addr.to_string(),
+                           ec.message().c_str());
+                    on_failure(true);
+                }
+                release_ref();
+            });
         });
     }
 }
@@ -37,6 +37,10 @@ namespace tools {
 
 // A TCP session implementation based on Boost.Asio.
 // Thread-safe
+//
+// If the session is pinned to a `loop`, which is an io_service run by a single thread, all the
+// operations on the socket are done in the loop without locking, otherwise they are protected
+// by _socket_lock.
 class asio_rpc_session : public rpc_session
 {
 public:
@@ -44,7 +48,8 @@ public:
                      ::dsn::rpc_address remote_addr,
                      std::shared_ptr<boost::asio::ip::tcp::socket> &socket,
                      message_parser_ptr &parser,
-                     bool is_client);
+                     bool is_client,
+                     boost::asio::io_service *loop = nullptr);
 
     ~asio_rpc_session() override = default;
 
@@ -65,11 +70,29 @@ private:
         }
     }
 
+    // runs `op` on the socket, `exclusive` is true if `op` modifies or closes the socket.
+    template <typename Op>
+    void with_socket(bool exclusive, Op &&op)
+    {
+        if (_loop != nullptr) {
+            // run immediately if in the loop already, otherwise queued to the loop
+            rpc_session_ptr self(this);
+            _loop->dispatch([self, op]() { op(); });
+        } else if (exclusive) {
+            utils::auto_write_lock socket_guard(_socket_lock);
+            op();
+        } else {
+            utils::auto_read_lock socket_guard(_socket_lock);
+            op();
+        }
+    }
+
 private:
     // boost::asio::socket is thread-unsafe, must use lock to prevent a
     // reading/writing socket being modified or closed concurrently.
     std::shared_ptr<boost::asio::ip::tcp::socket> _socket;
     ::dsn::utils::rw_lock_nr _socket_lock;
+    boost::asio::io_service *_loop;
 };
 
 } // namespace tools
@@ -36,8 +36,17 @@
 #include "dsn_message_parser.h"
 #include <dsn/service_api_c.h>
 #include <dsn/utility/crc.h>
+#include <dsn/utility/compression.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
+
+DSN_DEFINE_uint32("network",
+                  rpc_message_decompression_max_bytes,
+                  256 * 1024 * 1024,
+                  "max body size of a compressed rpc message after decompression, larger "
+                  "messages are rejected before anything is allocated for them");
+
 void dsn_message_parser::reset() { _header_checked = false; }
 
 message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
@@ -45,11 +54,12 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
 {
     read_next = 4096;
 
-    dsn::blob &buf = reader->_buffer;
-    char *buf_ptr = (char *)buf.data();
-    unsigned int buf_len = reader->_buffer_occupied;
+    unsigned int buf_len = reader->length();
 
     if (buf_len >= sizeof(message_header)) {
+        // the header is made contiguous, while the body is kept in the blocks it's received in
+        dsn::blob hdr_bb = reader->front(sizeof(message_header));
+        char *buf_ptr = (char *)hdr_bb.data();
         if (!_header_checked) {
             if (!is_right_header(buf_ptr)) {
                 derror("dsn message header check failed");
@@ -64,9 +74,20 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
 
         // msg done
         if (buf_len >= msg_sz) {
-            dsn::blob msg_bb = buf.range(0, msg_sz);
-            message_ex *msg = message_ex::create_receive_message(msg_bb);
-            if (!is_right_body(msg)) {
+            std::vector<dsn::blob> msg_bbs;
+            reader->get_buffers(msg_sz, msg_bbs);
+            message_ex *msg = message_ex::create_receive_message(msg_bbs);
+            bool body_ok = is_right_body(msg);
+            if (body_ok && msg->header->context.u.compression_type !=
+                               static_cast<uint64_t>(utils::compression_type::NONE)) {
+                message_ex *raw_msg = decompress_body(msg);
+                if (raw_msg == nullptr) {
+                    body_ok = false;
+                } else {
+                    msg = raw_msg;
+                }
+            }
+            if (!body_ok) {
                 message_header *header = (message_header *)buf_ptr;
                 derror("dsn message body check failed, id = %" PRIu64 ", trace_id = %016" PRIx64
                        ", rpc_name = %s, from_addr = %s",
@@ -78,12 +99,11 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
                 delete msg;
                 return nullptr;
             } else {
-                reader->_buffer = buf.range(msg_sz);
-                reader->_buffer_occupied -= msg_sz;
+                reader->consume_buffer(msg_sz);
                 _header_checked = false;
-                read_next = (reader->_buffer_occupied >= sizeof(message_header)
+                read_next = (reader->length() >= sizeof(message_header)
                                  ? 0
-                                 : sizeof(message_header) - reader->_buffer_occupied);
+                                 : sizeof(message_header) - reader->length());
                 msg->hdr_format = NET_HDR_DSN;
                 return msg;
             }
@@ -111,6 +131,9 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
     dassert(len == (size_t)header->body_length + sizeof(message_header), "data length is wrong");
 #endif
 
+    // the crc is calculated on the compressed body
+    compress_body(msg);
+
     if (task_spec::get(msg->local_rpc_code)->rpc_message_crc_required) {
         // compute data crc if necessary (only once for the first time)
         if (header->body_crc32 == CRC_INVALID) {
@@ -157,6 +180,120 @@ int dsn_message_parser::get_buffers_on_send(message_ex *msg, /*out*/ send_buf *b
     return i;
 }
 
+/*static*/ void dsn_message_parser::compress_body(message_ex *msg)
+{
+    auto &header = msg->header;
+    auto &buffers = msg->buffers;
+
+    if (header->context.u.compression_type !=
+        static_cast<uint64_t>(utils::compression_type::NONE)) {
+        // compressed when it's sent for the first time
+        return;
+    }
+
+    task_spec *spec = task_spec::get(msg->local_rpc_code);
+    if (spec->rpc_message_compression_type == utils::compression_type::NONE ||
+        header->body_length < static_cast<uint32_t>(spec->rpc_message_compression_min_bytes)) {
+        return;
+    }
+
+    uint64_t start = dsn_now_ns();
+
+    // the body is led by the header in the first buffer, and may be scattered in the others
+    blob body;
+    if (buffers.size() == 1) {
+        body = buffers[0].range(sizeof(message_header));
+    } else {
+        std::shared_ptr<char> buffer(utils::make_shared_array<char>(header->body_length));
+        char *ptr = buffer.get();
+        for (int i = 0; i < (int)buffers.size(); i++) {
+            size_t skip = (i == 0 ? sizeof(message_header) : 0);
+            memcpy(ptr, buffers[i].data() + skip, buffers[i].length() - skip);
+            ptr += buffers[i].length() - skip;
+        }
+        body.assign(std::move(buffer), 0, header->body_length);
+    }
+
+    blob compressed;
+    if (!utils::compress(spec->rpc_message_compression_type, body, compressed) ||
+        compressed.length() + sizeof(uint32_t) >= header->body_length) {
+        return;
+    }
+
+    uint32_t raw_length = header->body_length;
+    std::shared_ptr<char> length_holder(utils::make_shared_array<char>(sizeof(uint32_t)));
+    memcpy(length_holder.get(), &raw_length, sizeof(uint32_t));
+
+    blob header_bb = buffers[0].range(0, sizeof(message_header));
+    buffers.clear();
+    buffers.emplace_back(std::move(header_bb));
+    buffers.emplace_back(blob(std::move(length_holder), sizeof(uint32_t)));
+    buffers.emplace_back(std::move(compressed));
+
+    header->body_length = sizeof(uint32_t) + buffers[2].length();
+    header->context.u.compression_type =
+        static_cast<uint64_t>(spec->rpc_message_compression_type);
+    header->body_crc32 = CRC_INVALID;
+
+    spec->on_rpc_body_compression.execute(msg, raw_length, dsn_now_ns() - start);
+}
+
+/*static*/ message_ex *dsn_message_parser::decompress_body(message_ex *msg)
+{
+    auto &header = msg->header;
+    auto type = static_cast<utils::compression_type>(header->context.u.compression_type);
+
+    uint64_t start = dsn_now_ns();
+
+    // the body of a received message may be in multiple buffers
+    blob body;
+    if (msg->buffers.size() == 1) {
+        body = msg->buffers[0];
+    } else {
+        std::shared_ptr<char> buffer(utils::make_shared_array<char>(header->body_length));
+        char *ptr = buffer.get();
+        for (const blob &bb : msg->buffers) {
+            memcpy(ptr, bb.data(), bb.length());
+            ptr += bb.length();
+        }
+        body.assign(std::move(buffer), 0, header->body_length);
+    }
+    if (body.length() < sizeof(uint32_t)) {
+        derror("compressed message body is too short, length = %u", body.length());
+        return nullptr;
+    }
+    uint32_t raw_length;
+    memcpy(&raw_length, body.data(), sizeof(uint32_t));
+    if (raw_length > FLAGS_rpc_message_decompression_max_bytes) {
+        derror("compressed message body is too large, raw_length = %u, max = %u",
+               raw_length,
+               FLAGS_rpc_message_decompression_max_bytes);
+        return nullptr;
+    }
+
+    blob raw;
+    if (!utils::decompress(type, body.range(sizeof(uint32_t)), raw_length, raw)) {
+        derror("decompress message body failed, compression_type = %s, raw_length = %u",
+               utils::compression_type_to_string(type),
+               raw_length);
+        return nullptr;
+    }
+
+    message_ex *raw_msg = message_ex::create_receive_message_with_standalone_header(raw);
+    memcpy(static_cast<void *>(raw_msg->header), header, sizeof(message_header));
+    raw_msg->header->body_length = raw_length;
+    raw_msg->header->context.u.compression_type =
+        static_cast<uint64_t>(utils::compression_type::NONE);
+
+    task_code code = msg->rpc_code();
+    if (code != TASK_CODE_INVALID) {
+        task_spec::get(code)->on_rpc_body_compression.execute(
+            msg, raw_length, dsn_now_ns() - start);
+    }
+    delete msg;
+    return raw_msg;
+}
+
 /*static*/ bool dsn_message_parser::is_right_header(char *hdr)
 {
     uint32_t *pcrc = reinterpret_cast<uint32_t *>(hdr + FIELD_OFFSET(message_header, hdr_crc32));
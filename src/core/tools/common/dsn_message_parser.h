@@ -55,6 +55,15 @@ public:
 
     virtual int get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers) override;
 
+    // compress the body of msg if its task spec asks to, see task_spec::rpc_message_compression.
+    // the compressed body is led by the raw body length (uint32_t).
+    // the message is compressed only once even if it's resent.
+    static void compress_body(message_ex *msg);
+
+    // return a new message with the body of msg decompressed, and msg is deleted.
+    // return nullptr if the body is corrupted, msg is left unchanged then.
+    static message_ex *decompress_body(message_ex *msg);
+
 private:
     static bool is_right_header(char *hdr);
 
@@ -39,6 +39,7 @@
 #include <dsn/utility/rand.h>
 #include <dsn/tool/node_scoper.h>
 #include "network.sim.h"
+#include "dsn_message_parser.h"
 
 namespace dsn {
 namespace tools {
@@ -75,6 +76,12 @@ static message_ex *virtual_send_message(message_ex *msg)
 
     blob bb(buffer, 0, msg->header->body_length + sizeof(message_header));
     message_ex *recv_msg = message_ex::create_receive_message(bb);
+    if (recv_msg->header->context.u.compression_type !=
+        static_cast<uint64_t>(utils::compression_type::NONE)) {
+        // the parser is bypassed in simulation, so decompress the body here
+        recv_msg = dsn_message_parser::decompress_body(recv_msg);
+        dassert(recv_msg != nullptr, "decompress message body failed");
+    }
     recv_msg->to_address = msg->to_address;
 
     msg->copy_to(*recv_msg); // extensible object state move
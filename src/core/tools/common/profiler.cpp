@@ -107,7 +107,22 @@ counter_info *counter_info_ptr[] = {
                      "TIMEOUT(#/s)",
                      "#/s"),
     new counter_info(
-        {"task.inqueue", "tiq"}, TASK_IN_QUEUE, COUNTER_TYPE_NUMBER, "InQueue(#)", "#")};
+        {"task.inqueue", "tiq"}, TASK_IN_QUEUE, COUNTER_TYPE_NUMBER, "InQueue(#)", "#"),
+    new counter_info({"rpc.compression.ratio", "rpccr"},
+                     RPC_COMPRESSION_RATIO_PERCENT,
+                     COUNTER_TYPE_NUMBER_PERCENTILES,
+                     "RPC.COMPRESSION.RATIO(%)",
+                     "%"),
+    new counter_info({"rpc.compression.saved", "rpccs"},
+                     RPC_COMPRESSION_SAVED_BYTES,
+                     COUNTER_TYPE_RATE,
+                     "RPC.COMPRESSION.SAVED(bytes/s)",
+                     "bytes/s"),
+    new counter_info({"rpc.compression.time", "rpcct"},
+                     RPC_COMPRESSION_TIME_NS,
+                     COUNTER_TYPE_NUMBER_PERCENTILES,
+                     "RPC.COMPRESSION(ns)",
+                     "ns")};
 
 // call normal task
 static void profiler_on_task_create(task *caller, task *callee)
@@ -329,6 +344,27 @@ static void profiler_on_rpc_response_enqueue(rpc_response_task *resp)
         ptr->increment();
 }
 
+// msg is in its compressed form
+static void profiler_on_rpc_body_compression(message_ex *msg, uint32_t raw_length, uint64_t time_ns)
+{
+    auto code = msg->local_rpc_code;
+    dassert(code >= 0 && code <= s_task_code_max, "code = %d", code.code());
+
+    uint32_t compressed_length = msg->header->body_length;
+    auto ptr = s_spec_profilers[code].ptr[RPC_COMPRESSION_RATIO_PERCENT].get();
+    if (ptr != nullptr) {
+        ptr->set(compressed_length * 100ULL / raw_length);
+    }
+    ptr = s_spec_profilers[code].ptr[RPC_COMPRESSION_SAVED_BYTES].get();
+    if (ptr != nullptr) {
+        ptr->add(raw_length - compressed_length);
+    }
+    ptr = s_spec_profilers[code].ptr[RPC_COMPRESSION_TIME_NS].get();
+    if (ptr != nullptr) {
+        ptr->set(time_ns);
+    }
+}
+
 void register_command_profiler()
 {
     std::stringstream textp, textpjs, textpd, textquery, textarg;
@@ -579,6 +615,31 @@ void profiler::install(service_spec &)
                     "latency from call point to enqueue point for AIO tasks");
         }
 
+        if (spec->rpc_message_compression_type != utils::compression_type::NONE &&
+            dsn_config_get_value_bool(section_name.c_str(),
+                                      "profiler::compression",
+                                      true,
+                                      "whether to profile the message body compression")) {
+            s_spec_profilers[i].ptr[RPC_COMPRESSION_RATIO_PERCENT].init_global_counter(
+                "zion",
+                "profiler",
+                (name + std::string(".compression.ratio(%)")).c_str(),
+                COUNTER_TYPE_NUMBER_PERCENTILES,
+                "compressed size in percentage of the raw size of the message bodies");
+            s_spec_profilers[i].ptr[RPC_COMPRESSION_SAVED_BYTES].init_global_counter(
+                "zion",
+                "profiler",
+                (name + std::string(".compression.saved(bytes/s)")).c_str(),
+                COUNTER_TYPE_RATE,
+                "network bytes saved per second by compressing the message bodies");
+            s_spec_profilers[i].ptr[RPC_COMPRESSION_TIME_NS].init_global_counter(
+                "zion",
+                "profiler",
+                (name + std::string(".compression.time(ns)")).c_str(),
+                COUNTER_TYPE_NUMBER_PERCENTILES,
+                "time used to compress the message bodies on send and decompress on receive");
+        }
+
         // we don't use perf_counter_ptr but perf_counter* in ptr[xxx] to avoid unnecessary memory
         // access cost
         // we need to add reference so that the counters won't go
@@ -605,6 +666,7 @@ void profiler::install(service_spec &)
         spec->on_rpc_create_response.put_back(profiler_on_rpc_create_response, "profiler");
         spec->on_rpc_reply.put_back(profiler_on_rpc_reply, "profiler");
         spec->on_rpc_response_enqueue.put_back(profiler_on_rpc_response_enqueue, "profiler");
+        spec->on_rpc_body_compression.put_back(profiler_on_rpc_body_compression, "profiler");
     }
 
     register_command_profiler();
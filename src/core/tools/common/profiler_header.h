@@ -51,6 +51,9 @@ enum perf_counter_ptr_type
     RPC_CLIENT_NON_TIMEOUT_LATENCY_NS,
     RPC_CLIENT_TIMEOUT_THROUGHPUT,
     TASK_IN_QUEUE,
+    RPC_COMPRESSION_RATIO_PERCENT,
+    RPC_COMPRESSION_SAVED_BYTES,
+    RPC_COMPRESSION_TIME_NS,
 
     PERF_COUNTER_COUNT,
     PERF_COUNTER_INVALID
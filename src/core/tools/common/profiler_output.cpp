@@ -83,7 +83,7 @@ void profiler_output_top(std::stringstream &ss,
             (s_spec_profilers[i].ptr[counter_type].get() == nullptr))
             continue;
 
-        if (counter_info_ptr[counter_type]->type == COUNTER_TYPE_NUMBER_PERCENTILES) {
+        if (dsn_counter_type_has_percentiles(counter_info_ptr[counter_type]->type)) {
             _tmp[i].val = s_spec_profilers[i].ptr[counter_type]->get_percentile(percentile_type);
         } else {
             _tmp[i].val = s_spec_profilers[i].ptr[counter_type]->get_value();
@@ -141,7 +141,7 @@ void profiler_output_infomation_line(std::stringstream &ss,
         if (full_data == true) {
             if (s_spec_profilers[task_id].ptr[i].get() == nullptr) {
                 ss << profiler_output_data->none;
-            } else if (counter_info_ptr[i]->type == COUNTER_TYPE_NUMBER_PERCENTILES) {
+            } else if (dsn_counter_type_has_percentiles(counter_info_ptr[i]->type)) {
                 ss << std::setw(data_width)
                    << s_spec_profilers[task_id].ptr[i]->get_percentile(percentile_type) << "|";
             } else {
@@ -150,7 +150,7 @@ void profiler_output_infomation_line(std::stringstream &ss,
         }
         // Other line, just print the number_percentile_type data
         else {
-            if (counter_info_ptr[i]->type != COUNTER_TYPE_NUMBER_PERCENTILES) {
+            if (!dsn_counter_type_has_percentiles(counter_info_ptr[i]->type)) {
                 ss << profiler_output_data->blank_data;
             } else if (s_spec_profilers[task_id].ptr[i].get() != nullptr) {
                 ss << std::setw(data_width)
@@ -373,7 +373,7 @@ void profiler_data_top(std::stringstream &ss,
             (s_spec_profilers[i].ptr[counter_type].get() == nullptr))
             continue;
 
-        if (counter_info_ptr[counter_type]->type == COUNTER_TYPE_NUMBER_PERCENTILES) {
+        if (dsn_counter_type_has_percentiles(counter_info_ptr[counter_type]->type)) {
             _tmp[i].val = s_spec_profilers[i].ptr[counter_type]->get_percentile(percentile_type);
         } else {
             _tmp[i].val = s_spec_profilers[i].ptr[counter_type]->get_value();
@@ -76,17 +76,18 @@ raw_message_parser::raw_message_parser()
 message_ex *raw_message_parser::get_message_on_receive(message_reader *reader,
                                                        /*out*/ int &read_next)
 {
-    if (reader->_buffer_occupied == 0) {
-        if (reader->_buffer.length() > 0)
-            read_next = reader->_buffer.length();
+    if (reader->length() == 0) {
+        if (reader->read_buffer_capacity() > 0)
+            read_next = reader->read_buffer_capacity();
         else
-            read_next = reader->_buffer_block_size;
+            read_next = reader->buffer_block_size();
         return nullptr;
     } else {
-        auto msg_length = reader->_buffer_occupied;
-        dsn::blob msg_blob = reader->_buffer.range(0, msg_length);
+        auto msg_length = reader->length();
+        std::vector<dsn::blob> msg_blobs;
+        reader->get_buffers(msg_length, msg_blobs);
         message_ex *new_message =
-            message_ex::create_receive_message_with_standalone_header(msg_blob);
+            message_ex::create_receive_message_with_standalone_header(msg_blobs);
         message_header *header = new_message->header;
 
         header->hdr_length = sizeof(*header);
@@ -98,8 +99,7 @@ message_ex *raw_message_parser::get_message_on_receive(message_reader *reader,
         header->context.u.is_forwarded = 0;
         header->context.u.is_forward_supported = 0;
 
-        reader->_buffer = reader->_buffer.range(msg_length);
-        reader->_buffer_occupied = 0;
+        reader->consume_buffer(msg_length);
         read_next = 0;
 
         new_message->local_rpc_code = RPC_CALL_RAW_MESSAGE;
@@ -34,6 +34,7 @@
 #include <dsn/utility/crc.h>
 #include <dsn/utility/endians.h>
 #include <dsn/tool-api/rpc_message.h>
+#include <algorithm>
 
 namespace dsn {
 
@@ -85,7 +86,8 @@ static int32_t gpid_to_thread_hash(gpid id)
 
 // Reads the requests's name, seqid, and TMessageType from the binary data,
 // and constructs a `message_ex` object.
-static message_ex *create_message_from_request_blob(const blob &body_data)
+// The data may be in multiple blobs, which are used as the message buffers without copy.
+static message_ex *create_message_from_request_blob(const std::vector<blob> &body_data)
 {
     dsn::message_ex *msg = message_ex::create_receive_message_with_standalone_header(body_data);
     dsn::message_header *dsn_hdr = msg->header;
@@ -133,7 +135,8 @@ static message_ex *create_message_from_request_blob(const blob &body_data)
 //
 bool thrift_message_parser::parse_request_header(message_reader *reader, int &read_next)
 {
-    blob buf = reader->buffer();
+    // the header is small, so it's made contiguous
+    blob buf = reader->front(std::min<size_t>(reader->length(), HEADER_LENGTH_V0));
     // make sure there is enough space for 'THFT' and header_version
     if (buf.size() < THFT_HDR_VERSION_LENGTH) {
         read_next = THFT_HDR_VERSION_LENGTH - buf.size();
@@ -187,16 +190,16 @@ bool thrift_message_parser::parse_request_header(message_reader *reader, int &re
 
 message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader, int &read_next)
 {
-    blob buf = reader->buffer();
-
     // Parses request data
     // TODO(wutao1): handle the case where body_length is too short to parse.
-    if (buf.size() < _meta_v0->body_length) {
-        read_next = _meta_v0->body_length - buf.size();
+    if (reader->length() < _meta_v0->body_length) {
+        read_next = _meta_v0->body_length - reader->length();
         return nullptr;
     }
 
-    message_ex *msg = create_message_from_request_blob(buf);
+    std::vector<blob> body_data;
+    reader->get_buffers(_meta_v0->body_length, body_data);
+    message_ex *msg = create_message_from_request_blob(body_data);
     if (msg == nullptr) {
         read_next = -1;
         reset();
@@ -204,9 +207,7 @@ message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader,
     }
 
     reader->consume_buffer(_meta_v0->body_length);
-    read_next = (reader->_buffer_occupied >= HEADER_LENGTH_V0
-                     ? 0
-                     : HEADER_LENGTH_V0 - reader->_buffer_occupied);
+    read_next = (reader->length() >= HEADER_LENGTH_V0 ? 0 : HEADER_LENGTH_V0 - reader->length());
 
     msg->header->body_length = _meta_v0->body_length;
     msg->header->gpid.set_app_id(_meta_v0->app_id);
@@ -221,39 +222,39 @@ message_ex *thrift_message_parser::parse_request_body_v0(message_reader *reader,
 message_ex *thrift_message_parser::parse_request_body_v1(message_reader *reader, int &read_next)
 {
     // Parses request meta
-    blob buf = reader->buffer();
     if (!_v1_specific_vars->_meta_parsed) {
-        if (buf.size() < _v1_specific_vars->_meta_length) {
-            read_next = _v1_specific_vars->_meta_length - buf.size();
+        if (reader->length() < _v1_specific_vars->_meta_length) {
+            read_next = _v1_specific_vars->_meta_length - reader->length();
             return nullptr;
         }
 
-        binary_reader meta_reader(buf);
+        binary_reader meta_reader(reader->front(_v1_specific_vars->_meta_length));
         ::dsn::binary_reader_transport trans(meta_reader);
         boost::shared_ptr<::dsn::binary_reader_transport> transport(
             &trans, [](::dsn::binary_reader_transport *) {});
         ::apache::thrift::protocol::TBinaryProtocol proto(transport);
         _v1_specific_vars->_meta_v1->read(&proto);
         _v1_specific_vars->_meta_parsed = true;
+        reader->consume_buffer(_v1_specific_vars->_meta_length);
     }
-    buf = buf.range(_v1_specific_vars->_meta_length);
 
     // Parses request body
-    if (buf.size() < _v1_specific_vars->_body_length) {
-        read_next = _v1_specific_vars->_body_length - buf.size();
+    if (reader->length() < _v1_specific_vars->_body_length) {
+        read_next = _v1_specific_vars->_body_length - reader->length();
         return nullptr;
     }
-    message_ex *msg = create_message_from_request_blob(buf);
+
+    std::vector<blob> body_data;
+    reader->get_buffers(_v1_specific_vars->_body_length, body_data);
+    message_ex *msg = create_message_from_request_blob(body_data);
     if (msg == nullptr) {
         read_next = -1;
         reset();
         return nullptr;
     }
 
-    reader->consume_buffer(_v1_specific_vars->_meta_length + _v1_specific_vars->_body_length);
-    read_next = (reader->_buffer_occupied >= HEADER_LENGTH_V1
-                     ? 0
-                     : HEADER_LENGTH_V1 - reader->_buffer_occupied);
+    reader->consume_buffer(_v1_specific_vars->_body_length);
+    read_next = (reader->length() >= HEADER_LENGTH_V1 ? 0 : HEADER_LENGTH_V1 - reader->length());
 
     msg->header->body_length = _v1_specific_vars->_body_length;
     msg->header->gpid.set_app_id(_v1_specific_vars->_meta_v1->app_id);
@@ -34,11 +34,41 @@
  */
 
 #include "hpc_task_queue.h"
+#include "core/core/task_engine.h"
+
+#include <dsn/utility/flags.h>
 #include <boost/function_output_iterator.hpp>
 
 namespace dsn {
 namespace tools {
 
+DSN_DEFINE_uint64("tools.hpc_work_stealing_task_queue",
+                  min_stealable_count,
+                  2,
+                  "a sibling queue is only stolen from, or pushes its new stealable tasks to "
+                  "idle siblings, when it has at least this many stealable tasks");
+
+namespace {
+// links the dequeued tasks into the singly-linked list returned by dequeue()
+struct task_chain_appender
+{
+    task *&head;
+    task *&last;
+
+    void operator()(task *in) const
+    {
+        if (last) {
+            last->next = in;
+        } else {
+            head = in;
+        }
+
+        last = in;
+        last->next = nullptr;
+    }
+};
+} // anonymous namespace
+
 hpc_concurrent_task_queue::hpc_concurrent_task_queue(task_worker_pool *pool,
                                                      int index,
                                                      task_queue *inner_provider)
@@ -80,5 +110,165 @@ task *hpc_concurrent_task_queue::dequeue(int &batch_size)
     } while (count != 0);
     return head;
 }
+
+hpc_work_stealing_task_queue::hpc_work_stealing_task_queue(task_worker_pool *pool,
+                                                           int index,
+                                                           task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider), _stealable_count(0), _idle(false)
+{
+    _stolen_counter.init_global_counter(pool->node()->full_name(),
+                                        "engine",
+                                        (get_name() + ".queue.stolen").c_str(),
+                                        COUNTER_TYPE_RATE,
+                                        "tasks taken over from this queue by sibling workers");
+}
+
+void hpc_work_stealing_task_queue::enqueue(task *task)
+{
+    if (!is_pinned(task) &&
+        _stealable_count.load(std::memory_order_relaxed) >=
+            static_cast<int>(FLAGS_min_stealable_count) &&
+        push_to_idle_sibling(task)) {
+        return;
+    }
+    enqueue_local(task);
+}
+
+void hpc_work_stealing_task_queue::enqueue_local(task *task)
+{
+    auto &qs = _queues[task->spec().priority];
+    if (is_pinned(task)) {
+        qs.pinned.enqueue(task);
+    } else {
+        qs.stealable.enqueue(task);
+        _stealable_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    _sema.signal(1);
+}
+
+bool hpc_work_stealing_task_queue::push_to_idle_sibling(task *task)
+{
+    const auto &queues = pool()->queues();
+    int queue_count = static_cast<int>(queues.size());
+    for (int i = 1; i < queue_count; i++) {
+        // queues wrapped by aspects are skipped
+        auto sibling =
+            dynamic_cast<hpc_work_stealing_task_queue *>(queues[(index() + i) % queue_count]);
+        if (sibling == nullptr) {
+            continue;
+        }
+
+        // only one task is pushed to an idle sibling, which is woken up by it
+        bool idle = true;
+        if (!sibling->_idle.compare_exchange_strong(idle, false)) {
+            continue;
+        }
+
+        // the task has been counted in this queue by task_queue::enqueue_internal
+        decrease_count();
+        sibling->increase_count();
+        sibling->enqueue_local(task);
+        _stolen_counter->increment();
+        return true;
+    }
+    return false;
+}
+
+task *hpc_work_stealing_task_queue::dequeue(int &batch_size)
+{
+    task *head = nullptr, *last = nullptr;
+
+    int count = static_cast<int>(_sema.tryWaitMany(batch_size));
+    if (count == 0) {
+        // siblings may push tasks to this queue from now on
+        _idle.store(true);
+        int stolen = steal(head, last, batch_size);
+        if (stolen > 0) {
+            _idle.store(false);
+            batch_size = stolen;
+            return head;
+        }
+        count = static_cast<int>(_sema.waitMany(batch_size));
+        _idle.store(false);
+    }
+
+    batch_size = count == 0 ? 0 : dequeue_local(head, last, count);
+    return head;
+}
+
+int hpc_work_stealing_task_queue::dequeue_local(task *&head, task *&last, int count)
+{
+    // thieves acquire from _sema before they take tasks, so there're always `count` tasks
+    // left for us
+    auto out = boost::make_function_output_iterator(task_chain_appender{head, last});
+    int taken = 0;
+    do {
+        for (auto &qs : _queues) {
+            int n = static_cast<int>(qs.pinned.try_dequeue_bulk(out, count - taken));
+            taken += n;
+            if (taken == count) {
+                break;
+            }
+
+            n = static_cast<int>(qs.stealable.try_dequeue_bulk(out, count - taken));
+            _stealable_count.fetch_sub(n, std::memory_order_relaxed);
+            taken += n;
+            if (taken == count) {
+                break;
+            }
+        }
+    } while (taken != count);
+    return taken;
+}
+
+int hpc_work_stealing_task_queue::steal(task *&head, task *&last, int max_count)
+{
+    const auto &queues = pool()->queues();
+    int queue_count = static_cast<int>(queues.size());
+    for (int i = 1; i < queue_count; i++) {
+        // queues wrapped by aspects are skipped
+        auto victim =
+            dynamic_cast<hpc_work_stealing_task_queue *>(queues[(index() + i) % queue_count]);
+        if (victim == nullptr) {
+            continue;
+        }
+
+        int available = victim->_stealable_count.load(std::memory_order_relaxed);
+        if (available < static_cast<int>(FLAGS_min_stealable_count)) {
+            continue;
+        }
+
+        // leave half of the tasks to the owner, and acquire them from the victim's semaphore
+        // first, so that the owner never waits for the tasks it has acquired
+        int wanted = static_cast<int>(
+            victim->_sema.tryWaitMany(std::min(max_count, (available + 1) / 2)));
+        if (wanted == 0) {
+            continue;
+        }
+        auto out = boost::make_function_output_iterator(task_chain_appender{head, last});
+        int stolen = 0;
+        for (auto &qs : victim->_queues) {
+            stolen += static_cast<int>(qs.stealable.try_dequeue_bulk(out, wanted - stolen));
+            if (stolen == wanted) {
+                break;
+            }
+        }
+        // the owner took the stealable tasks in the meantime
+        if (stolen < wanted) {
+            victim->_sema.signal(wanted - stolen);
+        }
+        if (stolen == 0) {
+            continue;
+        }
+        victim->_stealable_count.fetch_sub(stolen, std::memory_order_relaxed);
+
+        // the worker loop decreases the count of its own queue
+        victim->decrease_count(stolen);
+        increase_count(stolen);
+        victim->_stolen_counter->add(stolen);
+        return stolen;
+    }
+    return 0;
+}
 }
 }
@@ -57,5 +57,54 @@ public:
 
     task *dequeue(/*inout*/ int &batch_size) override;
 };
+
+// A partitioned-pool queue where idle workers take over the unhashed tasks of their siblings.
+//
+// Only tasks with hash 0 are balanced. They carry no ordering requirement and may be taken
+// by any idle worker in the same pool: a worker going idle steals from a loaded sibling once,
+// and then blocks on its own queue, into which loaded siblings push their new stealable tasks.
+//
+// Tasks enqueued with a non-zero hash (e.g. replica tasks keyed on gpid::thread_hash()) are
+// never moved, as the tasks of a hash rely on running one at a time on the same worker, not
+// only on their order. So a hot partition still saturates its worker with this queue; it only
+// keeps the hash-0 tasks (e.g. rpc callbacks without a hash) off the loaded workers.
+class hpc_work_stealing_task_queue : public task_queue
+{
+public:
+    hpc_work_stealing_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+
+    void enqueue(task *task) override;
+
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+private:
+    static bool is_pinned(task *t) { return t->hash() != 0; }
+
+    void enqueue_local(task *task);
+
+    // push the stealable task into an idle sibling queue, returns false if none is idle
+    bool push_to_idle_sibling(task *task);
+
+    // take `count` tasks which have already been acquired from _sema
+    int dequeue_local(task *&head, task *&last, int count);
+
+    // take at most `max_count` stealable tasks from a loaded sibling queue
+    int steal(task *&head, task *&last, int max_count);
+
+private:
+    moodycamel::LightweightSemaphore _sema;
+    struct queue_t
+    {
+        moodycamel::ConcurrentQueue<task *> pinned;
+        moodycamel::ConcurrentQueue<task *> stealable;
+    } _queues[TASK_PRIORITY_COUNT];
+
+    // approximate number of tasks in the stealable queues
+    std::atomic<int> _stealable_count;
+    // whether the worker is blocked (or about to block) on an empty queue
+    std::atomic<bool> _idle;
+
+    perf_counter_wrapper _stolen_counter;
+};
 }
 }
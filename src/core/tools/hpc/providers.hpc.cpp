@@ -35,12 +35,17 @@
 
 #include <dsn/tool/providers.hpc.h>
 #include "hpc_task_queue.h"
+#include "timing_wheel_timer_service.h"
 
 namespace dsn {
 namespace tools {
 void register_hpc_providers()
 {
     register_component_provider<hpc_concurrent_task_queue>("dsn::tools::hpc_concurrent_task_queue");
+    register_component_provider<hpc_work_stealing_task_queue>(
+        "dsn::tools::hpc_work_stealing_task_queue");
+    register_component_provider<timing_wheel_timer_service>(
+        "dsn::tools::timing_wheel_timer_service");
 }
 }
 }
@@ -0,0 +1,169 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include "timing_wheel_timer_service.h"
+
+#include <dsn/tool_api.h>
+#include <dsn/utility/flags.h>
+
+namespace dsn {
+namespace tools {
+
+DSN_DEFINE_uint64("tools.timing_wheel_timer_service",
+                  tick_milliseconds,
+                  1,
+                  "the granularity of the timing wheel, timers are rounded up to it");
+DSN_DEFINE_validator(tick_milliseconds, [](uint64_t value) -> bool { return value > 0; });
+
+timing_wheel_timer_service::timing_wheel_timer_service(service_node *node,
+                                                       timer_service *inner_provider)
+    : timer_service(node, inner_provider),
+      _tick_ms(FLAGS_tick_milliseconds),
+      _running(false),
+      _current_tick(now_tick()),
+      _timer_count(0)
+{
+}
+
+timing_wheel_timer_service::~timing_wheel_timer_service()
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+        _running = false;
+    }
+    _cond.notify_all();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+void timing_wheel_timer_service::start()
+{
+    _running = true;
+    _worker = std::thread([this]() {
+        task::set_tls_dsn_context(node(), nullptr);
+
+        char buffer[128];
+        sprintf(buffer, "%s.timer", get_service_node_name(node()));
+
+        task_worker::set_name(buffer);
+        task_worker::set_priority(worker_priority_t::THREAD_xPRIORITY_ABOVE_NORMAL);
+
+        run();
+    });
+}
+
+void timing_wheel_timer_service::add_timer(task *task)
+{
+    uint64_t delay_ticks = (task->delay_milliseconds() + _tick_ms - 1) / _tick_ms;
+    task->set_delay(0);
+
+    std::lock_guard<std::mutex> l(_lock);
+    uint64_t now = now_tick();
+    if (_timer_count == 0) {
+        // the wheel is empty, skip the idle ticks instead of walking through them
+        _current_tick = std::max(_current_tick, now);
+    }
+    insert({task, now + delay_ticks});
+    if (_timer_count++ == 0) {
+        _cond.notify_one();
+    }
+}
+
+uint64_t timing_wheel_timer_service::now_tick() const { return dsn_now_ms() / _tick_ms; }
+
+void timing_wheel_timer_service::insert(const timer_entry &entry)
+{
+    uint64_t expire = std::max(entry.expire_tick, _current_tick);
+    uint64_t delta = expire - _current_tick;
+    if (delta < ROOT_SIZE) {
+        _root[expire & (ROOT_SIZE - 1)].push_back(entry);
+        return;
+    }
+
+    // too far away, park it in the last slot and re-cascade it until it is due
+    if (delta >= MAX_TICKS) {
+        expire = _current_tick + MAX_TICKS - 1;
+        delta = MAX_TICKS - 1;
+    }
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        int shift = ROOT_BITS + LEVEL_BITS * level;
+        if (delta < (1ULL << (shift + LEVEL_BITS))) {
+            _levels[level][(expire >> shift) & (LEVEL_SIZE - 1)].push_back(entry);
+            return;
+        }
+    }
+    dassert(false, "timer with delta %" PRIu64 " ticks is not placed", delta);
+}
+
+uint64_t timing_wheel_timer_service::cascade(int level, uint64_t index)
+{
+    timer_slot entries;
+    entries.swap(_levels[level][index]);
+    for (const timer_entry &e : entries) {
+        insert(e);
+    }
+
+    // give the capacity back to the slot
+    if (_levels[level][index].empty()) {
+        entries.clear();
+        entries.swap(_levels[level][index]);
+    }
+    return index;
+}
+
+void timing_wheel_timer_service::advance_one_tick(/*out*/ std::vector<task *> &expired)
+{
+    uint64_t index = _current_tick & (ROOT_SIZE - 1);
+    if (index == 0) {
+        for (int level = 0; level < LEVEL_COUNT; ++level) {
+            int shift = ROOT_BITS + LEVEL_BITS * level;
+            if (cascade(level, (_current_tick >> shift) & (LEVEL_SIZE - 1)) != 0) {
+                break;
+            }
+        }
+    }
+
+    timer_slot &slot = _root[index];
+    for (const timer_entry &e : slot) {
+        expired.push_back(e.tsk);
+    }
+    _timer_count -= slot.size();
+    slot.clear();
+    ++_current_tick;
+}
+
+void timing_wheel_timer_service::run()
+{
+    std::vector<task *> expired;
+    std::unique_lock<std::mutex> l(_lock);
+    while (_running) {
+        if (_timer_count == 0) {
+            _cond.wait(l, [this]() { return !_running || _timer_count > 0; });
+            continue;
+        }
+
+        uint64_t now = now_tick();
+        while (_current_tick <= now && _timer_count > 0) {
+            advance_one_tick(expired);
+        }
+
+        if (!expired.empty()) {
+            l.unlock();
+            for (task *t : expired) {
+                t->enqueue();
+                // to consume the added ref count by task::enqueue for add_timer
+                t->release_ref();
+            }
+            expired.clear();
+            l.lock();
+            continue;
+        }
+
+        _cond.wait_for(l, std::chrono::milliseconds(_tick_ms));
+    }
+}
+
+} // namespace tools
+} // namespace dsn
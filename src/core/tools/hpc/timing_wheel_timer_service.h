@@ -0,0 +1,81 @@
+// Copyright (c) 2017, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <dsn/tool-api/timer_service.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dsn {
+namespace tools {
+
+// A hierarchical timing wheel in the style of the classic kernel timer wheel.
+//
+// Timers are kept in per-slot vectors (whose capacity is reused across rounds), so inserting
+// a timer is O(1) and needs no per-timer allocation, unlike simple_timer_service which creates
+// an asio deadline_timer for each delayed task. Cancellation stays what it already is for
+// every timer service: the task state is flipped and the task is dropped when it is executed.
+//
+// task_worker_pool creates one timer service per task queue, so a partitioned pool gets one
+// wheel (and one ticking thread) per worker.
+class timing_wheel_timer_service : public timer_service
+{
+public:
+    timing_wheel_timer_service(service_node *node, timer_service *inner_provider);
+
+    ~timing_wheel_timer_service() override;
+
+    // after milliseconds, the provider should call task->enqueue()
+    void add_timer(task *task) override;
+
+    void start() override;
+
+private:
+    struct timer_entry
+    {
+        task *tsk;
+        uint64_t expire_tick;
+    };
+    typedef std::vector<timer_entry> timer_slot;
+
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int LEVEL_COUNT = 3;
+    static const uint64_t ROOT_SIZE = 1ULL << ROOT_BITS;
+    static const uint64_t LEVEL_SIZE = 1ULL << LEVEL_BITS;
+    static const uint64_t MAX_TICKS = 1ULL << (ROOT_BITS + LEVEL_BITS * LEVEL_COUNT);
+
+    uint64_t now_tick() const;
+
+    // put the entry into the slot matching its remaining ticks, lock must be held
+    void insert(const timer_entry &entry);
+
+    // re-distribute the entries of a higher level slot, returns the slot index
+    uint64_t cascade(int level, uint64_t index);
+
+    // move the entries expiring at _current_tick into `expired`, lock must be held
+    void advance_one_tick(/*out*/ std::vector<task *> &expired);
+
+    void run();
+
+private:
+    const uint64_t _tick_ms;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    bool _running;
+    uint64_t _current_tick; // the next tick to be processed
+    uint64_t _timer_count;
+    timer_slot _root[ROOT_SIZE];
+    timer_slot _levels[LEVEL_COUNT][LEVEL_SIZE];
+
+    std::thread _worker;
+};
+
+} // namespace tools
+} // namespace dsn
@@ -526,6 +526,20 @@ bool failure_detector::is_master_connected(::dsn::rpc_address node) const
         return false;
 }
 
+uint64_t failure_detector::get_master_lease_expire_ms() const
+{
+    zauto_lock l(_lock);
+    uint64_t expire_ms = 0;
+    for (const auto &kv : _masters) {
+        const master_record &record = kv.second;
+        if (record.is_alive) {
+            expire_ms =
+                std::max(expire_ms, record.last_send_time_for_beacon_with_ack + _lease_milliseconds);
+        }
+    }
+    return expire_ms;
+}
+
 void failure_detector::register_worker(::dsn::rpc_address target, bool is_connected)
 {
     /*
@@ -39,7 +39,8 @@ namespace dsn {
 struct parser_context
 {
     http_message_parser *parser;
-    message_reader *reader;
+    // the received data made contiguous, which the http body refers to
+    blob read_buf;
 };
 
 /*extern*/ const char *http_parser_stage_to_string(http_parser_stage s)
@@ -145,14 +146,14 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
 {
     read_next = 4096;
 
-    if (reader->_buffer_occupied > 0) {
-        parser_context ctx{this, reader};
+    if (reader->length() > 0) {
+        parser_context ctx{this, reader->buffer()};
         _parser.data = &ctx;
 
         _parser_setting.on_body = [](http_parser *parser, const char *at, size_t length) -> int {
             auto data = reinterpret_cast<parser_context *>(parser->data);
             auto &msg = data->parser->_current_message;
-            blob read_buf = data->reader->_buffer;
+            const blob &read_buf = data->read_buf;
 
             // set http body
             msg->buffers[1].assign(read_buf.buffer(), at - read_buf.buffer_ptr(), length);
@@ -161,7 +162,7 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
         };
 
         auto nparsed = http_parser_execute(
-            &_parser, &_parser_setting, reader->_buffer.data(), reader->_buffer_occupied);
+            &_parser, &_parser_setting, ctx.read_buf.data(), ctx.read_buf.length());
 
         // error handling
         if (_parser.http_errno != HPE_OK) {
@@ -177,8 +178,7 @@ message_ex *http_message_parser::get_message_on_receive(message_reader *reader,
         _parsed_length += nparsed;
         if (is_complete()) {
             // parsing complete
-            reader->_buffer = reader->_buffer.range(_parsed_length);
-            reader->_buffer_occupied -= _parsed_length;
+            reader->consume_buffer(_parsed_length);
             reset();
         }
     }
@@ -11,6 +11,7 @@
 #include "root_http_service.h"
 #include "pprof_http_service.h"
 #include "perf_counter_http_service.h"
+#include "prometheus_http_service.h"
 #include "uri_decoder.h"
 
 namespace dsn {
@@ -52,6 +53,8 @@ http_server::http_server(bool start /*default=true*/) : serverlet<http_server>("
 #endif // DSN_ENABLE_GPERF
 
     add_service(new perf_counter_http_service());
+
+    add_service(new prometheus_http_service());
 }
 
 void http_server::serve(message_ex *msg)
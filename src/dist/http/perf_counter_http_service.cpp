@@ -27,7 +27,7 @@ void perf_counter_http_service::get_perf_counter_handler(const http_request &req
     dsn::utils::table_printer tp;
     if (perf_counter) {
         tp.add_row_name_and_data("name", perf_counter_name);
-        if (COUNTER_TYPE_NUMBER_PERCENTILES == perf_counter->type()) {
+        if (dsn_counter_type_has_percentiles(perf_counter->type())) {
             tp.add_row_name_and_data("p99", perf_counter->get_percentile(COUNTER_PERCENTILE_99));
             tp.add_row_name_and_data("p999", perf_counter->get_percentile(COUNTER_PERCENTILE_999));
         } else {
@@ -0,0 +1,221 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#include "prometheus_http_service.h"
+
+namespace dsn {
+
+namespace {
+
+// metric names must match [a-zA-Z_:][a-zA-Z0-9_:]*
+std::string sanitize_metric_name(const std::string &name)
+{
+    std::string result;
+    result.reserve(name.size() + 1);
+    if (name.empty() || isdigit(name[0])) {
+        result.push_back('_');
+    }
+    for (char c : name) {
+        result.push_back(isalnum(c) || c == '_' || c == ':' ? c : '_');
+    }
+    return result;
+}
+
+void append_escaped(std::string &out, const std::string &value, bool escape_quote)
+{
+    for (char c : value) {
+        if (c == '\\') {
+            out.append("\\\\");
+        } else if (c == '\n') {
+            out.append("\\n");
+        } else if (c == '"' && escape_quote) {
+            out.append("\\\"");
+        } else {
+            out.push_back(c);
+        }
+    }
+}
+
+void append_value(std::string &out, double value)
+{
+    char buf[64];
+    int len;
+    if (std::isnan(value)) {
+        len = snprintf(buf, sizeof(buf), "NaN");
+    } else if (std::isinf(value)) {
+        len = snprintf(buf, sizeof(buf), value > 0 ? "+Inf" : "-Inf");
+    } else if (value == std::floor(value) && std::fabs(value) < 1e18) {
+        len = snprintf(buf, sizeof(buf), "%" PRId64, static_cast<int64_t>(value));
+    } else {
+        len = snprintf(buf, sizeof(buf), "%.9g", value);
+    }
+    out.append(buf, len);
+}
+
+const struct
+{
+    dsn_perf_counter_percentile_type_t type;
+    const char *label;
+} summary_quantiles[] = {
+    {COUNTER_PERCENTILE_50, ",quantile=\"0.5\"} "},
+    {COUNTER_PERCENTILE_90, ",quantile=\"0.9\"} "},
+    {COUNTER_PERCENTILE_95, ",quantile=\"0.95\"} "},
+    {COUNTER_PERCENTILE_99, ",quantile=\"0.99\"} "},
+    {COUNTER_PERCENTILE_999, ",quantile=\"0.999\"} "},
+};
+
+} // anonymous namespace
+
+void prometheus_http_service::get_metrics_handler(const http_request &req, http_response &resp)
+{
+    render(req.query_args, resp.body);
+    resp.content_type = "text/plain; version=0.0.4";
+    resp.status_code = http_status_code::ok;
+}
+
+prometheus_http_service::metric_series *
+prometheus_http_service::get_series(const perf_counter_ptr &counter)
+{
+    auto it = _series.find(counter.get());
+    if (it != _series.end()) {
+        return it->second.get();
+    }
+
+    std::unique_ptr<metric_series> s(new metric_series());
+    s->counter = counter;
+    s->scrape_round = 0;
+
+    std::string name = counter->name();
+    std::string entity;
+    size_t pos = name.find('@');
+    if (pos != std::string::npos) {
+        entity = name.substr(pos + 1);
+        name.resize(pos);
+    }
+    s->labels["app"] = counter->app();
+    s->labels["section"] = counter->section();
+    if (!entity.empty()) {
+        s->labels["entity"] = entity;
+    }
+
+    s->rendered_labels = "{";
+    for (const auto &kv : s->labels) {
+        if (s->rendered_labels.size() > 1) {
+            s->rendered_labels.push_back(',');
+        }
+        s->rendered_labels.append(kv.first).append("=\"");
+        append_escaped(s->rendered_labels, kv.second, true);
+        s->rendered_labels.push_back('"');
+    }
+
+    bool is_summary = dsn_counter_type_has_percentiles(counter->type());
+    std::string family_name = sanitize_metric_name(name);
+    auto fit = _families.find(family_name);
+    if (fit != _families.end() && fit->second.is_summary != is_summary) {
+        // all the series of a family must be of the same type
+        family_name += is_summary ? "_summary" : "_gauge";
+        fit = _families.find(family_name);
+    }
+    if (fit == _families.end()) {
+        metric_family &f = _families[family_name];
+        f.name = family_name;
+        f.is_summary = is_summary;
+        f.header.append("# HELP ").append(family_name).push_back(' ');
+        append_escaped(f.header, counter->dsptr(), false);
+        f.header.append("\n# TYPE ")
+            .append(family_name)
+            .append(is_summary ? " summary\n" : " gauge\n");
+        fit = _families.find(family_name);
+    }
+    s->family = &fit->second;
+    s->family->series.push_back(s.get());
+
+    metric_series *result = s.get();
+    _series.emplace(counter.get(), std::move(s));
+    return result;
+}
+
+void prometheus_http_service::remove_series(metric_series *s)
+{
+    auto &series = s->family->series;
+    series.erase(std::find(series.begin(), series.end(), s));
+    if (series.empty()) {
+        std::string family_name = s->family->name;
+        _families.erase(family_name);
+    }
+    _series.erase(s->counter.get());
+}
+
+void prometheus_http_service::render(const std::unordered_map<std::string, std::string> &filters,
+                                     std::string &out)
+{
+    std::lock_guard<std::mutex> l(_lock);
+
+    // follow the registered counters
+    _scrape_round++;
+    perf_counters::instance().iterate_counters(
+        [this](const perf_counter_ptr &c) { get_series(c)->scrape_round = _scrape_round; });
+    std::vector<metric_series *> removed;
+    for (const auto &kv : _series) {
+        if (kv.second->scrape_round != _scrape_round) {
+            removed.push_back(kv.second.get());
+        }
+    }
+    for (metric_series *s : removed) {
+        remove_series(s);
+    }
+
+    out.clear();
+    out.reserve(_last_body_size + _last_body_size / 8);
+    for (const auto &kv : _families) {
+        const metric_family &f = kv.second;
+        bool header_rendered = false;
+        for (const metric_series *s : f.series) {
+            bool matched = true;
+            for (const auto &filter : filters) {
+                auto it = s->labels.find(filter.first);
+                if (it == s->labels.end() || it->second != filter.second) {
+                    matched = false;
+                    break;
+                }
+            }
+            if (!matched) {
+                continue;
+            }
+
+            if (!header_rendered) {
+                out.append(f.header);
+                header_rendered = true;
+            }
+            if (f.is_summary) {
+                for (const auto &q : summary_quantiles) {
+                    out.append(f.name).append(s->rendered_labels).append(q.label);
+                    append_value(out, s->counter->get_percentile(q.type));
+                    out.push_back('\n');
+                }
+                uint64_t count;
+                double sum;
+                s->counter->get_summary(count, sum);
+                out.append(f.name).append("_sum").append(s->rendered_labels).append("} ");
+                append_value(out, sum);
+                out.push_back('\n');
+                out.append(f.name).append("_count").append(s->rendered_labels).append("} ");
+                append_value(out, (double)count);
+                out.push_back('\n');
+            } else {
+                out.append(f.name).append(s->rendered_labels).append("} ");
+                // scrapes must not reset the counters read by the others, e.g. take_snapshot()
+                append_value(out, s->counter->peek_value());
+                out.push_back('\n');
+            }
+        }
+    }
+    _last_body_size = out.size();
+}
+
+} // namespace dsn
@@ -0,0 +1,76 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <dsn/perf_counter/perf_counters.h>
+#include <dsn/tool-api/http_server.h>
+
+namespace dsn {
+
+// Exposes all the perf counters in the Prometheus text format, which are read from the live
+// counters rather than a snapshot of them.
+//
+// A counter "app*section*name@entity" is exposed as the metric "name" with the labels app,
+// section and entity (if any). PERCENTILE and HISTOGRAM counters are exposed as summaries with
+// the "_sum" and "_count" series, others as gauges.
+//
+// The metric name and labels of each counter are rendered once when it's first scraped, and
+// the cache follows the registered counters on every scrape.
+class prometheus_http_service : public http_service
+{
+public:
+    prometheus_http_service()
+    {
+        register_handler("",
+                         std::bind(&prometheus_http_service::get_metrics_handler,
+                                   this,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2),
+                         "ip:port/metrics[?{label}={value}[&...]]");
+    }
+
+    std::string path() const override { return "metrics"; }
+
+    // the query args are label filters, only the counters that match all of them are returned
+    void get_metrics_handler(const http_request &req, http_response &resp);
+
+private:
+    struct metric_family;
+    struct metric_series
+    {
+        perf_counter_ptr counter;
+        metric_family *family;
+        std::map<std::string, std::string> labels;
+        // `{label="value",...`, closed by the caller to append more labels
+        std::string rendered_labels;
+        uint64_t scrape_round;
+    };
+    struct metric_family
+    {
+        std::string name;
+        bool is_summary;
+        // the "# HELP" and "# TYPE" lines
+        std::string header;
+        std::vector<metric_series *> series;
+    };
+
+    friend class prometheus_http_service_test;
+
+    metric_series *get_series(const perf_counter_ptr &counter);
+    void remove_series(metric_series *s);
+    void render(const std::unordered_map<std::string, std::string> &filters, std::string &out);
+
+    std::mutex _lock;
+    uint64_t _scrape_round{0};
+    size_t _last_body_size{0};
+    std::unordered_map<perf_counter *, std::unique_ptr<metric_series>> _series;
+    // ordered by name, as the series of a family must be rendered together
+    std::map<std::string, metric_family> _families;
+};
+
+} // namespace dsn
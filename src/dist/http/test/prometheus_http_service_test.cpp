@@ -0,0 +1,142 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/tool-api/http_server.h>
+#include <dist/http/prometheus_http_service.h>
+
+namespace dsn {
+
+class prometheus_http_service_test : public testing::Test
+{
+public:
+    std::string get_metrics(const std::unordered_map<std::string, std::string> &filters)
+    {
+        http_request req;
+        http_response resp;
+        req.query_args = filters;
+        _service.get_metrics_handler(req, resp);
+        EXPECT_EQ(resp.status_code, http_status_code::ok);
+        EXPECT_EQ(resp.content_type, "text/plain; version=0.0.4");
+        return resp.body;
+    }
+
+    size_t cached_series_count() { return _service._series.size(); }
+
+    prometheus_http_service _service;
+};
+
+TEST_F(prometheus_http_service_test, get_metrics)
+{
+    perf_counter_wrapper number;
+    number.init_global_counter(
+        "prometheus_test", "eon.stub", "replica(Count)", COUNTER_TYPE_NUMBER, "# of replicas");
+    number->set(5);
+
+    perf_counter_wrapper qps1, qps2;
+    qps1.init_global_counter(
+        "prometheus_test", "app.pegasus", "get_qps@1.0", COUNTER_TYPE_NUMBER, "get qps");
+    qps2.init_global_counter(
+        "prometheus_test", "app.pegasus", "get_qps@1.1", COUNTER_TYPE_NUMBER, "get qps");
+    qps1->set(10);
+    qps2->set(20);
+
+    perf_counter_wrapper latency;
+    latency.init_global_counter("prometheus_test",
+                                "app.pegasus",
+                                "get_latency@1.0",
+                                COUNTER_TYPE_NUMBER_HISTOGRAM,
+                                "get latency");
+
+    perf_counter_wrapper put_latency;
+    put_latency.init_global_counter("prometheus_test",
+                                    "app.pegasus",
+                                    "put_latency@1.0",
+                                    COUNTER_TYPE_NUMBER_PERCENTILES,
+                                    "put latency");
+    put_latency->set(10);
+    put_latency->set(30);
+
+    std::string body = get_metrics({{"app", "prometheus_test"}});
+    ASSERT_EQ("# HELP get_latency get latency\n"
+              "# TYPE get_latency summary\n"
+              "get_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.5\"} 0\n"
+              "get_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.9\"} 0\n"
+              "get_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.95\"} 0\n"
+              "get_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.99\"} 0\n"
+              "get_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.999\"} 0\n"
+              "get_latency_sum{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\"} 0\n"
+              "get_latency_count{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\"} 0\n"
+              "# HELP get_qps get qps\n"
+              "# TYPE get_qps gauge\n"
+              "get_qps{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\"} 10\n"
+              "get_qps{app=\"prometheus_test\",entity=\"1.1\","
+              "section=\"app.pegasus\"} 20\n"
+              "# HELP put_latency put latency\n"
+              "# TYPE put_latency summary\n"
+              "put_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.5\"} 0\n"
+              "put_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.9\"} 0\n"
+              "put_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.95\"} 0\n"
+              "put_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.99\"} 0\n"
+              "put_latency{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\",quantile=\"0.999\"} 0\n"
+              "put_latency_sum{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\"} 40\n"
+              "put_latency_count{app=\"prometheus_test\",entity=\"1.0\","
+              "section=\"app.pegasus\"} 2\n"
+              "# HELP replica_Count_ # of replicas\n"
+              "# TYPE replica_Count_ gauge\n"
+              "replica_Count_{app=\"prometheus_test\",section=\"eon.stub\"} 5\n",
+              body);
+
+    // filtered by labels
+    body = get_metrics({{"app", "prometheus_test"}, {"entity", "1.1"}});
+    ASSERT_EQ("# HELP get_qps get qps\n"
+              "# TYPE get_qps gauge\n"
+              "get_qps{app=\"prometheus_test\",entity=\"1.1\","
+              "section=\"app.pegasus\"} 20\n",
+              body);
+    ASSERT_EQ("", get_metrics({{"app", "prometheus_test"}, {"no_such_label", "x"}}));
+
+    // the live value is read on every scrape
+    qps2->set(30);
+    body = get_metrics({{"app", "prometheus_test"}, {"entity", "1.1"}});
+    ASSERT_NE(std::string::npos, body.find("section=\"app.pegasus\"} 30\n"));
+
+    // removed counters are dropped from the cache
+    size_t count = cached_series_count();
+    qps2.clear();
+    body = get_metrics({{"app", "prometheus_test"}, {"entity", "1.1"}});
+    ASSERT_EQ("", body);
+    ASSERT_EQ(count - 1, cached_series_count());
+
+    // scrapes don't reset the volatile counters
+    perf_counter_wrapper recent;
+    recent.init_global_counter("prometheus_test",
+                               "app.pegasus",
+                               "recent_put_count@1.2",
+                               COUNTER_TYPE_VOLATILE_NUMBER,
+                               "recent put count");
+    recent->add(7);
+    for (int i = 0; i < 2; i++) {
+        body = get_metrics({{"app", "prometheus_test"}, {"entity", "1.2"}});
+        ASSERT_NE(std::string::npos, body.find("section=\"app.pegasus\"} 7\n"));
+    }
+    ASSERT_EQ(7, recent->get_integer_value());
+}
+
+} // namespace dsn
@@ -12,6 +12,9 @@ struct copy_request
     6: i32 size;
     7: bool is_last;
     8: bool overwrite;
+    // only return the checksum of the block instead of its content, which is used to
+    // verify the blocks copied by a previous try when resuming a copy.
+    9: optional bool checksum_only;
 }
 
 struct copy_response
@@ -20,6 +23,8 @@ struct copy_response
     2: dsn.blob file_content;
     3: i64 offset;
     4: i32 size;
+    // crc32 of the block read from the source file, not set by old servers.
+    5: optional i32 file_crc32;
 }
 
 struct get_file_size_request
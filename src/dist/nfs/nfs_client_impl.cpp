@@ -33,7 +33,10 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/crc.h>
+#include <dsn/utility/fail_point.h>
 #include <queue>
+#include <unistd.h>
 #include <dsn/tool-api/command_manager.h>
 #include "nfs_client_impl.h"
 
@@ -68,6 +71,16 @@ nfs_client_impl::nfs_client_impl(nfs_opts &opts)
         "recent_write_fail_count",
         COUNTER_TYPE_VOLATILE_NUMBER,
         "nfs client write fail count count in the recent period");
+    _recent_checksum_fail_count.init_app_counter(
+        "eon.nfs_client",
+        "recent_checksum_fail_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "nfs client copy checksum mismatch count in the recent period");
+    _recent_resume_data_size.init_app_counter(
+        "eon.nfs_client",
+        "recent_resume_data_size",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "nfs client data size skipped by resuming copies in the recent period");
 
     uint32_t max_copy_rate_bytes = FLAGS_max_copy_rate_megabytes << 20;
     // max_copy_rate_bytes should be greater than nfs_copy_block_bytes which is the max batch copy
@@ -165,6 +178,13 @@ void nfs_client_impl::end_get_file_size(::dsn::error_code err,
             req_size = size > _opts.nfs_copy_block_bytes ? _opts.nfs_copy_block_bytes
                                                          : static_cast<uint32_t>(size);
         }
+
+        // the segments written by a previous copy are only verified by their checksums
+        std::vector<uint32_t> resumed_crcs = take_resume_point(filec);
+        for (size_t j = 0; j < resumed_crcs.size() && j < filec->copy_requests.size(); j++) {
+            filec->copy_requests[j]->checksum_only = true;
+            filec->copy_requests[j]->crc = resumed_crcs[j];
+        }
     }
 
     if (!copy_requests.empty()) {
@@ -232,7 +252,9 @@ void nfs_client_impl::continue_copy()
             zauto_lock l(req->lock);
             const user_request_ptr &ureq = req->file_ctx->user_req;
             if (req->is_valid) {
-                _copy_token_bucket->consumeWithBorrowAndWait(req->size);
+                if (!req->checksum_only) {
+                    _copy_token_bucket->consumeWithBorrowAndWait(req->size);
+                }
 
                 copy_request copy_req;
                 copy_req.source = ureq->file_size_req.source;
@@ -243,6 +265,9 @@ void nfs_client_impl::continue_copy()
                 copy_req.source_dir = ureq->file_size_req.source_dir;
                 copy_req.overwrite = ureq->file_size_req.overwrite;
                 copy_req.is_last = req->is_last;
+                if (req->checksum_only) {
+                    copy_req.__set_checksum_only(true);
+                }
                 req->remote_copy_task = copy(copy_req,
                                              [=](error_code err, copy_response &&resp) {
                                                  end_copy(err, std::move(resp), req);
@@ -287,11 +312,20 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
         err = resp.error;
     }
 
+    // a resumed segment which differs from the source is copied again, without
+    // consuming the retry count
+    bool resume_mismatch = false;
+    if (err == ERR_OK) {
+        bool checksum_only = reqc->checksum_only;
+        err = verify_copy_response(resp, reqc);
+        resume_mismatch = checksum_only && err == ERR_CORRUPTION;
+    }
+
     if (err != ::dsn::ERR_OK) {
         _recent_copy_fail_count->increment();
 
         if (!fc->user_req->is_finished) {
-            if (reqc->retry_count > 0) {
+            if (reqc->retry_count > 0 || resume_mismatch) {
                 dwarn("{nfs_service} remote copy failed, source = %s, dir = %s, file = %s, "
                       "err = %s, retry_count = %d",
                       fc->user_req->file_size_req.source.to_string(),
@@ -301,7 +335,9 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
                       reqc->retry_count);
 
                 // retry copy
-                reqc->retry_count--;
+                if (!resume_mismatch) {
+                    reqc->retry_count--;
+                }
 
                 // put back into copy request queue
                 zauto_lock l(_copy_requests_lock);
@@ -324,7 +360,11 @@ void nfs_client_impl::end_copy(::dsn::error_code err,
     }
 
     else {
-        _recent_copy_data_size->add(resp.size);
+        if (reqc->checksum_only) {
+            _recent_resume_data_size->add(reqc->size);
+        } else {
+            _recent_copy_data_size->add(resp.size);
+        }
 
         reqc->response = resp;
         reqc->is_ready_for_write = true;
@@ -387,10 +427,17 @@ void nfs_client_impl::continue_write()
         {
             // only process valid request, and discard invalid request
             zauto_lock l(reqc->lock);
-            if (reqc->is_valid) {
-                break;
+            if (!reqc->is_valid) {
+                continue;
             }
         }
+
+        if (!reqc->checksum_only) {
+            break;
+        }
+
+        // the segment has been written by a previous copy, and verified with the source
+        finish_segment(reqc);
     }
 
     if (nullptr == reqc) {
@@ -455,7 +502,10 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
 
     const file_context_ptr &fc = reqc->file_ctx;
 
-    bool completed = false;
+    if (err == ERR_OK && sz != (size_t)reqc->response.size) {
+        err = ERR_FILE_OPERATION_FAILED;
+    }
+
     if (err != ERR_OK) {
         _recent_write_fail_count->increment();
 
@@ -463,30 +513,136 @@ void nfs_client_impl::end_write(error_code err, size_t sz, const copy_request_ex
                fc->user_req->file_size_req.dst_dir.c_str(),
                fc->file_name.c_str(),
                err.to_string());
-        completed = true;
+        handle_completion(fc->user_req, err);
     } else {
         _recent_write_data_size->add(sz);
+        finish_segment(reqc);
+    }
+
+    continue_write();
+    continue_copy();
+}
+
+error_code nfs_client_impl::verify_copy_response(const copy_response &resp,
+                                                 const copy_request_ex_ptr &reqc)
+{
+    FAIL_POINT_INJECT_F("nfs_client_verify_copy_response", [&](string_view from_index) {
+        // fails the segments from the given index
+        return reqc->index >= std::stoi(std::string(from_index.data(), from_index.length()))
+                   ? ERR_NETWORK_FAILURE
+                   : verify_checksum(resp, reqc);
+    });
+
+    return verify_checksum(resp, reqc);
+}
+
+error_code nfs_client_impl::verify_checksum(const copy_response &resp,
+                                            const copy_request_ex_ptr &reqc)
+{
+    if (!resp.__isset.file_crc32) {
+        // old servers return the content without checksum, even for checksum-only requests
+        reqc->checksum_only = false;
+        reqc->crc = utils::crc32_calc(resp.file_content.data(), resp.file_content.length(), 0);
+        return ERR_OK;
+    }
 
+    uint32_t source_crc = static_cast<uint32_t>(resp.file_crc32);
+    if (reqc->checksum_only) {
+        if (source_crc == reqc->crc) {
+            return ERR_OK;
+        }
+        // the source file has been changed since the previous copy
+        reqc->checksum_only = false;
+    } else {
+        reqc->crc = utils::crc32_calc(resp.file_content.data(), resp.file_content.length(), 0);
+        if (source_crc == reqc->crc) {
+            return ERR_OK;
+        }
+    }
+
+    _recent_checksum_fail_count->increment();
+    dwarn("{nfs_service} checksum mismatch, source = %s, dir = %s, file = %s, offset = %" PRIu64
+          ", size = %u, source_crc = %u, crc = %u",
+          reqc->file_ctx->user_req->file_size_req.source.to_string(),
+          reqc->file_ctx->user_req->file_size_req.source_dir.c_str(),
+          reqc->file_ctx->file_name.c_str(),
+          reqc->offset,
+          reqc->size,
+          source_crc,
+          reqc->crc);
+    return ERR_CORRUPTION;
+}
+
+void nfs_client_impl::finish_segment(const copy_request_ex_ptr &reqc)
+{
+    const file_context_ptr &fc = reqc->file_ctx;
+    error_code err = ERR_OK;
+    bool file_done = false;
+    int file_count = 0;
+    {
         file_wrapper_ptr temp_holder;
         zauto_lock l(fc->user_req->user_req_lock);
-        if (!fc->user_req->is_finished &&
-            ++fc->finished_segments == (int)fc->copy_requests.size()) {
+        if (fc->user_req->is_finished) {
+            return;
+        }
+
+        // segments may be written out of order, the file crc is accumulated in order
+        reqc->is_written = true;
+        while (fc->written_segments < (int)fc->copy_requests.size() &&
+               fc->copy_requests[fc->written_segments]->is_written) {
+            const copy_request_ex_ptr &r = fc->copy_requests[fc->written_segments++];
+            fc->file_crc =
+                utils::crc32_concat(0, 0, fc->file_crc, fc->written_bytes, 0, r->crc, r->size);
+            fc->written_bytes += r->size;
+        }
+
+        if (++fc->finished_segments == (int)fc->copy_requests.size()) {
             // release file to make it closed immediately after write done.
             // we use temp_holder to make file closing out of lock.
             temp_holder = std::move(fc->file_holder);
+            file_done = true;
+            file_count = (int)fc->user_req->file_contexts.size();
 
-            if (++fc->user_req->finished_files == (int)fc->user_req->file_contexts.size()) {
-                completed = true;
+            if (fc->written_bytes != fc->file_size) {
+                derror("{nfs_service} file size mismatch, dir = %s, file = %s, "
+                       "written_bytes = %" PRIu64 ", file_size = %" PRIu64,
+                       fc->user_req->file_size_req.dst_dir.c_str(),
+                       fc->file_name.c_str(),
+                       fc->written_bytes,
+                       fc->file_size);
+                err = ERR_CORRUPTION;
             }
         }
     }
 
-    if (completed) {
-        handle_completion(fc->user_req, err);
+    if (!file_done) {
+        return;
     }
 
-    continue_write();
-    continue_copy();
+    if (err == ERR_OK) {
+        // the destination file may have been longer than the source, e.g. copied from an older
+        // version of the source, cut off the stale tail
+        std::string file_path = dsn::utils::filesystem::path_combine(
+            fc->user_req->file_size_req.dst_dir, fc->file_name);
+        if (::truncate(file_path.c_str(), static_cast<off_t>(fc->file_size)) != 0) {
+            derror("{nfs_service} truncate file %s to %" PRIu64 " failed, err = %s",
+                   file_path.c_str(),
+                   fc->file_size,
+                   strerror(errno));
+            err = ERR_FILE_OPERATION_FAILED;
+        } else {
+            dinfo("{nfs_service} file copied, dir = %s, file = %s, size = %" PRIu64
+                  ", crc = %u",
+                  fc->user_req->file_size_req.dst_dir.c_str(),
+                  fc->file_name.c_str(),
+                  fc->file_size,
+                  fc->file_crc);
+        }
+    }
+
+    if (err != ERR_OK || ++fc->user_req->finished_files == file_count) {
+        handle_completion(fc->user_req, err);
+    }
 }
 
 void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code err)
@@ -503,6 +659,11 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
     for (file_context_ptr &fc : req->file_contexts) {
         total_size += fc->file_size;
         if (err != ERR_OK) {
+            if (fc->written_segments > 0 &&
+                fc->written_segments < (int)fc->copy_requests.size()) {
+                save_resume_point(fc);
+            }
+
             // mark all copy_requests to be invalid
             for (const copy_request_ex_ptr &rc : fc->copy_requests) {
                 zauto_lock l(rc->lock);
@@ -520,6 +681,83 @@ void nfs_client_impl::handle_completion(const user_request_ptr &req, error_code
     req->nfs_task->enqueue(err, err == ERR_OK ? total_size : 0);
 }
 
+static std::string resume_source(const nfs_client_impl::file_context_ptr &fc)
+{
+    const get_file_size_request &req = fc->user_req->file_size_req;
+    return std::string(req.source.to_string()) + ":" +
+           utils::filesystem::path_combine(req.source_dir, fc->file_name);
+}
+
+std::vector<uint32_t> nfs_client_impl::take_resume_point(const file_context_ptr &fc)
+{
+    std::vector<uint32_t> block_crcs;
+    if (_opts.copy_resume_expire_time_ms == 0) {
+        return block_crcs;
+    }
+
+    std::string dst_path =
+        utils::filesystem::path_combine(fc->user_req->file_size_req.dst_dir, fc->file_name);
+    copy_resume_point point;
+    {
+        zauto_lock l(_resume_points_lock);
+        auto it = _resume_points.find(dst_path);
+        if (it == _resume_points.end()) {
+            return block_crcs;
+        }
+        point = std::move(it->second);
+        _resume_points.erase(it);
+    }
+
+    if (point.source != resume_source(fc) || point.file_size != fc->file_size ||
+        point.block_bytes != _opts.nfs_copy_block_bytes ||
+        dsn_now_ms() - point.create_time_ms > _opts.copy_resume_expire_time_ms) {
+        return block_crcs;
+    }
+
+    // the written segments are lost if the destination file is truncated or removed
+    uint64_t resumed_bytes =
+        std::min((uint64_t)point.block_crcs.size() * point.block_bytes, point.file_size);
+    int64_t dst_size = 0;
+    if (!utils::filesystem::file_size(dst_path, dst_size) || dst_size < (int64_t)resumed_bytes) {
+        return block_crcs;
+    }
+
+    ddebug("{nfs_service} resume copying file %s from offset %" PRIu64,
+           dst_path.c_str(),
+           resumed_bytes);
+    block_crcs = std::move(point.block_crcs);
+    return block_crcs;
+}
+
+void nfs_client_impl::save_resume_point(const file_context_ptr &fc)
+{
+    if (_opts.copy_resume_expire_time_ms == 0) {
+        return;
+    }
+
+    copy_resume_point point;
+    point.source = resume_source(fc);
+    point.file_size = fc->file_size;
+    point.block_bytes = _opts.nfs_copy_block_bytes;
+    point.create_time_ms = dsn_now_ms();
+    point.block_crcs.reserve(fc->written_segments);
+    for (int i = 0; i < fc->written_segments; i++) {
+        point.block_crcs.push_back(fc->copy_requests[i]->crc);
+    }
+
+    std::string dst_path =
+        utils::filesystem::path_combine(fc->user_req->file_size_req.dst_dir, fc->file_name);
+    zauto_lock l(_resume_points_lock);
+    for (auto it = _resume_points.begin(); it != _resume_points.end();) {
+        if (point.create_time_ms - it->second.create_time_ms > _opts.copy_resume_expire_time_ms) {
+            it = _resume_points.erase(it);
+        } else {
+            it++;
+        }
+    }
+    _resume_points[dst_path] = std::move(point);
+}
+
 void nfs_client_impl::register_cli_commands()
 {
     dsn::command_manager::instance().register_app_command(
@@ -35,6 +35,7 @@
 #pragma once
 #include <vector>
 #include <deque>
+#include <map>
 #include <dsn/tool-api/task_tracker.h>
 #include <dsn/tool-api/zlocks.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
@@ -60,9 +61,11 @@ struct nfs_opts
 
     int file_close_expire_time_ms;
     int file_close_timer_interval_ms_on_server;
+    int max_cached_copy_buffers_on_server;
     int max_file_copy_request_count_per_file;
     int max_retry_count_per_copy_request;
     int64_t rpc_timeout_ms;
+    uint64_t copy_resume_expire_time_ms;
 
     void init()
     {
@@ -95,6 +98,11 @@ struct nfs_opts
             "file_close_timer_interval_ms_on_server",
             30 * 1000,
             "time interval for checking whether cached file handles need to be closed");
+        max_cached_copy_buffers_on_server = (int)dsn_config_get_value_uint64(
+            "nfs",
+            "max_cached_copy_buffers_on_server",
+            8,
+            "max idle block buffers cached for reading files on nfs server");
         max_file_copy_request_count_per_file = (int)dsn_config_get_value_uint64(
             "nfs",
             "max_file_copy_request_count_per_file",
@@ -109,6 +117,12 @@ struct nfs_opts
                                              10000,
                                              "rpc timeout in milliseconds for nfs copy, "
                                              "0 means use default timeout of rpc engine");
+        copy_resume_expire_time_ms = dsn_config_get_value_uint64(
+            "nfs",
+            "copy_resume_expire_time_ms",
+            3600 * 1000,
+            "max time to keep the progress of a failed file copy, so that the next copy of the "
+            "same file can resume from it, 0 means never resume");
     }
 };
 
@@ -150,9 +164,13 @@ public:
         ::dsn::task_ptr remote_copy_task;
         ::dsn::task_ptr local_write_task;
         bool is_ready_for_write;
+        bool is_written;
         bool is_valid;
         int retry_count;
-        zlock lock; // to protect is_valid
+        // the segment has been written by a previous copy, so only its checksum is verified
+        bool checksum_only;
+        uint32_t crc; // crc32 of the segment content
+        zlock lock;   // to protect is_valid
 
         copy_request_ex(const file_context_ptr &file, int idx, int try_count)
         {
@@ -162,8 +180,11 @@ public:
             size = 0;
             is_last = false;
             is_ready_for_write = false;
+            is_written = false;
             is_valid = true;
             retry_count = try_count;
+            checksum_only = false;
+            crc = 0;
         }
     };
 
@@ -179,6 +200,13 @@ public:
         int finished_segments;
         std::vector<copy_request_ex_ptr> copy_requests;
 
+        // the leading segments which are all written, and the crc32 of them, which is
+        // combined from the crc32 of each segment verified against the one computed by the
+        // server as it's served, so that neither the source nor the copy is read again
+        int written_segments;
+        uint64_t written_bytes;
+        uint32_t file_crc;
+
         file_context(const user_request_ptr &req, const std::string &file_nm, uint64_t sz)
         {
             user_req = req;
@@ -187,6 +215,9 @@ public:
             file_holder = new file_wrapper();
             current_write_index = -1;
             finished_segments = 0;
+            written_segments = 0;
+            written_bytes = 0;
+            file_crc = 0;
         }
     };
 
@@ -214,6 +245,16 @@ public:
         }
     };
 
+    // the progress of a failed file copy, from which the next copy of the file resumes
+    struct copy_resume_point
+    {
+        std::string source; // source address and file path
+        uint64_t file_size;
+        uint32_t block_bytes;
+        std::vector<uint32_t> block_crcs; // crc32 of the leading written segments
+        uint64_t create_time_ms;
+    };
+
     struct random_robin_queue
     {
         int max_concurrent_copy_count_per_queue;
@@ -312,8 +353,22 @@ private:
 
     void end_write(error_code err, size_t sz, const copy_request_ex_ptr &reqc);
 
+    error_code verify_copy_response(const copy_response &resp, const copy_request_ex_ptr &reqc);
+
+    error_code verify_checksum(const copy_response &resp, const copy_request_ex_ptr &reqc);
+
+    // called when the segment is written into the destination file, or has been written by
+    // a previous copy
+    void finish_segment(const copy_request_ex_ptr &reqc);
+
     void handle_completion(const user_request_ptr &req, error_code err);
 
+    // returns the crcs of the segments written by a previous copy of the file, which are
+    // still valid for resuming
+    std::vector<uint32_t> take_resume_point(const file_context_ptr &fc);
+
+    void save_resume_point(const file_context_ptr &fc);
+
     void register_cli_commands();
 
 private:
@@ -340,6 +395,11 @@ private:
     perf_counter_wrapper _recent_copy_fail_count;
     perf_counter_wrapper _recent_write_data_size;
     perf_counter_wrapper _recent_write_fail_count;
+    perf_counter_wrapper _recent_checksum_fail_count;
+    perf_counter_wrapper _recent_resume_data_size;
+
+    zlock _resume_points_lock;
+    std::map<std::string, copy_resume_point> _resume_points; // dest file path => progress
 
     dsn::task_tracker _tracker;
 };
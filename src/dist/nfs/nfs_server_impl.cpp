@@ -35,6 +35,7 @@
 #include <cstdlib>
 #include <sys/stat.h>
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/crc.h>
 #include <dsn/tool-api/async_calls.h>
 
 #include "nfs_server_impl.h"
@@ -51,6 +52,10 @@ nfs_service_impl::nfs_service_impl(nfs_opts &opts)
         [this] { close_file(); },
         std::chrono::milliseconds(opts.file_close_timer_interval_ms_on_server));
 
+    _buffer_pool = std::make_shared<block_buffer_pool>();
+    _buffer_pool->max_idle_count = opts.max_cached_copy_buffers_on_server;
+    _buffer_pool->block_bytes = opts.nfs_copy_block_bytes;
+
     _recent_copy_data_size.init_app_counter("eon.nfs_server",
                                             "recent_copy_data_size",
                                             COUNTER_TYPE_VOLATILE_NUMBER,
@@ -108,12 +113,13 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
     }
 
     std::shared_ptr<callback_para> cp = std::make_shared<callback_para>(std::move(reply));
-    cp->bb = blob(dsn::utils::make_shared_array<char>(request.size), request.size);
+    cp->bb = blob(acquire_block_buffer(request.size), request.size);
     cp->dst_dir = std::move(request.dst_dir);
     cp->file_path = std::move(file_path);
     cp->hfile = hfile;
     cp->offset = request.offset;
     cp->size = request.size;
+    cp->checksum_only = request.__isset.checksum_only && request.checksum_only;
 
     auto buffer_save = cp->bb.buffer().get();
 
@@ -127,6 +133,37 @@ void nfs_service_impl::on_copy(const ::dsn::service::copy_request &request,
         [this, cp](error_code err, size_t sz) mutable { internal_read_callback(err, sz, *cp); });
 }
 
+std::shared_ptr<char> nfs_service_impl::acquire_block_buffer(uint32_t size)
+{
+    if (size > _buffer_pool->block_bytes) {
+        return dsn::utils::make_shared_array<char>(size);
+    }
+
+    char *buf = nullptr;
+    {
+        zauto_lock l(_buffer_pool->lock);
+        if (!_buffer_pool->idle_buffers.empty()) {
+            buf = _buffer_pool->idle_buffers.back();
+            _buffer_pool->idle_buffers.pop_back();
+        }
+    }
+    if (buf == nullptr) {
+        buf = new char[_buffer_pool->block_bytes];
+    }
+
+    std::shared_ptr<block_buffer_pool> pool = _buffer_pool;
+    return std::shared_ptr<char>(buf, [pool](char *b) {
+        {
+            zauto_lock l(pool->lock);
+            if (pool->idle_buffers.size() < pool->max_idle_count) {
+                pool->idle_buffers.push_back(b);
+                return;
+            }
+        }
+        delete[] b;
+    });
+}
+
 void nfs_service_impl::internal_read_callback(error_code err, size_t sz, callback_para &cp)
 {
     {
@@ -148,9 +185,17 @@ void nfs_service_impl::internal_read_callback(error_code err, size_t sz, callbac
 
     ::dsn::service::copy_response resp;
     resp.error = err;
-    resp.file_content = std::move(cp.bb);
     resp.offset = cp.offset;
     resp.size = cp.size;
+    if (err == ERR_OK) {
+        // the checksum is computed while the block is still hot in cache, so that the client
+        // can verify the block without reading it again from the source or the destination.
+        resp.__set_file_crc32(
+            static_cast<int32_t>(dsn::utils::crc32_calc(cp.bb.data(), sz, 0)));
+        if (!cp.checksum_only) {
+            resp.file_content = std::move(cp.bb);
+        }
+    }
 
     cp.replier(resp);
 }
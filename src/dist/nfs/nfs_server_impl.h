@@ -65,10 +65,11 @@ private:
         blob bb;
         uint64_t offset;
         uint32_t size;
+        bool checksum_only;
         rpc_replier<copy_response> replier;
 
         callback_para(rpc_replier<copy_response> &&r)
-            : hfile(nullptr), offset(0), size(0), replier(std::move(r))
+            : hfile(nullptr), offset(0), size(0), checksum_only(false), replier(std::move(r))
         {
         }
         callback_para(callback_para &&r)
@@ -78,6 +79,7 @@ private:
               bb(std::move(r.bb)),
               offset(r.offset),
               size(r.size),
+              checksum_only(r.checksum_only),
               replier(std::move(r.replier))
         {
             r.hfile = nullptr;
@@ -104,6 +106,26 @@ private:
         }
     };
 
+    // block buffers of nfs_copy_block_bytes to read the files into, reused across the copy
+    // requests to avoid allocating a large buffer for each of them.
+    // a buffer goes back to the pool after the response referencing it is sent.
+    struct block_buffer_pool
+    {
+        zlock lock;
+        std::vector<char *> idle_buffers;
+        size_t max_idle_count;
+        uint32_t block_bytes;
+
+        ~block_buffer_pool()
+        {
+            for (char *buf : idle_buffers) {
+                delete[] buf;
+            }
+        }
+    };
+
+    std::shared_ptr<char> acquire_block_buffer(uint32_t size);
+
     void internal_read_callback(error_code err, size_t sz, callback_para &cp);
 
     void close_file();
@@ -117,6 +139,9 @@ private:
 
     ::dsn::task_ptr _file_close_timer;
 
+    // shared with the buffers in use, which may outlive the service
+    std::shared_ptr<block_buffer_pool> _buffer_pool;
+
     perf_counter_wrapper _recent_copy_data_size;
     perf_counter_wrapper _recent_copy_fail_count;
 
@@ -32,6 +32,12 @@ void copy_request::__set_is_last(const bool val) { this->is_last = val; }
 
 void copy_request::__set_overwrite(const bool val) { this->overwrite = val; }
 
+void copy_request::__set_checksum_only(const bool val)
+{
+    this->checksum_only = val;
+    __isset.checksum_only = true;
+}
+
 uint32_t copy_request::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -115,6 +121,14 @@ uint32_t copy_request::read(::apache::thrift::protocol::TProtocol *iprot)
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 9:
+            if (ftype == ::apache::thrift::protocol::T_BOOL) {
+                xfer += iprot->readBool(this->checksum_only);
+                this->__isset.checksum_only = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -165,6 +179,11 @@ uint32_t copy_request::write(::apache::thrift::protocol::TProtocol *oprot) const
     xfer += oprot->writeBool(this->overwrite);
     xfer += oprot->writeFieldEnd();
 
+    if (this->__isset.checksum_only) {
+        xfer += oprot->writeFieldBegin("checksum_only", ::apache::thrift::protocol::T_BOOL, 9);
+        xfer += oprot->writeBool(this->checksum_only);
+        xfer += oprot->writeFieldEnd();
+    }
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -181,6 +200,7 @@ void swap(copy_request &a, copy_request &b)
     swap(a.size, b.size);
     swap(a.is_last, b.is_last);
     swap(a.overwrite, b.overwrite);
+    swap(a.checksum_only, b.checksum_only);
     swap(a.__isset, b.__isset);
 }
 
@@ -194,6 +214,7 @@ copy_request::copy_request(const copy_request &other0)
     size = other0.size;
     is_last = other0.is_last;
     overwrite = other0.overwrite;
+    checksum_only = other0.checksum_only;
     __isset = other0.__isset;
 }
 copy_request::copy_request(copy_request &&other1)
@@ -206,6 +227,7 @@ copy_request::copy_request(copy_request &&other1)
     size = std::move(other1.size);
     is_last = std::move(other1.is_last);
     overwrite = std::move(other1.overwrite);
+    checksum_only = std::move(other1.checksum_only);
     __isset = std::move(other1.__isset);
 }
 copy_request &copy_request::operator=(const copy_request &other2)
@@ -218,6 +240,7 @@ copy_request &copy_request::operator=(const copy_request &other2)
     size = other2.size;
     is_last = other2.is_last;
     overwrite = other2.overwrite;
+    checksum_only = other2.checksum_only;
     __isset = other2.__isset;
     return *this;
 }
@@ -231,6 +254,7 @@ copy_request &copy_request::operator=(copy_request &&other3)
     size = std::move(other3.size);
     is_last = std::move(other3.is_last);
     overwrite = std::move(other3.overwrite);
+    checksum_only = std::move(other3.checksum_only);
     __isset = std::move(other3.__isset);
     return *this;
 }
@@ -253,6 +277,9 @@ void copy_request::printTo(std::ostream &out) const
         << "is_last=" << to_string(is_last);
     out << ", "
         << "overwrite=" << to_string(overwrite);
+    out << ", "
+        << "checksum_only=";
+    (__isset.checksum_only ? (out << to_string(checksum_only)) : (out << "<null>"));
     out << ")";
 }
 
@@ -266,6 +293,12 @@ void copy_response::__set_offset(const int64_t val) { this->offset = val; }
 
 void copy_response::__set_size(const int32_t val) { this->size = val; }
 
+void copy_response::__set_file_crc32(const int32_t val)
+{
+    this->file_crc32 = val;
+    __isset.file_crc32 = true;
+}
+
 uint32_t copy_response::read(::apache::thrift::protocol::TProtocol *iprot)
 {
 
@@ -317,6 +350,14 @@ uint32_t copy_response::read(::apache::thrift::protocol::TProtocol *iprot)
                 xfer += iprot->skip(ftype);
             }
             break;
+        case 5:
+            if (ftype == ::apache::thrift::protocol::T_I32) {
+                xfer += iprot->readI32(this->file_crc32);
+                this->__isset.file_crc32 = true;
+            } else {
+                xfer += iprot->skip(ftype);
+            }
+            break;
         default:
             xfer += iprot->skip(ftype);
             break;
@@ -351,6 +392,11 @@ uint32_t copy_response::write(::apache::thrift::protocol::TProtocol *oprot) cons
     xfer += oprot->writeI32(this->size);
     xfer += oprot->writeFieldEnd();
 
+    if (this->__isset.file_crc32) {
+        xfer += oprot->writeFieldBegin("file_crc32", ::apache::thrift::protocol::T_I32, 5);
+        xfer += oprot->writeI32(this->file_crc32);
+        xfer += oprot->writeFieldEnd();
+    }
     xfer += oprot->writeFieldStop();
     xfer += oprot->writeStructEnd();
     return xfer;
@@ -363,6 +409,7 @@ void swap(copy_response &a, copy_response &b)
     swap(a.file_content, b.file_content);
     swap(a.offset, b.offset);
     swap(a.size, b.size);
+    swap(a.file_crc32, b.file_crc32);
     swap(a.__isset, b.__isset);
 }
 
@@ -372,6 +419,7 @@ copy_response::copy_response(const copy_response &other4)
     file_content = other4.file_content;
     offset = other4.offset;
     size = other4.size;
+    file_crc32 = other4.file_crc32;
     __isset = other4.__isset;
 }
 copy_response::copy_response(copy_response &&other5)
@@ -380,6 +428,7 @@ copy_response::copy_response(copy_response &&other5)
     file_content = std::move(other5.file_content);
     offset = std::move(other5.offset);
     size = std::move(other5.size);
+    file_crc32 = std::move(other5.file_crc32);
     __isset = std::move(other5.__isset);
 }
 copy_response &copy_response::operator=(const copy_response &other6)
@@ -388,6 +437,7 @@ copy_response &copy_response::operator=(const copy_response &other6)
     file_content = other6.file_content;
     offset = other6.offset;
     size = other6.size;
+    file_crc32 = other6.file_crc32;
     __isset = other6.__isset;
     return *this;
 }
@@ -397,6 +447,7 @@ copy_response &copy_response::operator=(copy_response &&other7)
     file_content = std::move(other7.file_content);
     offset = std::move(other7.offset);
     size = std::move(other7.size);
+    file_crc32 = std::move(other7.file_crc32);
     __isset = std::move(other7.__isset);
     return *this;
 }
@@ -411,6 +462,9 @@ void copy_response::printTo(std::ostream &out) const
         << "offset=" << to_string(offset);
     out << ", "
         << "size=" << to_string(size);
+    out << ", "
+        << "file_crc32=";
+    (__isset.file_crc32 ? (out << to_string(file_crc32)) : (out << "<null>"));
     out << ")";
 }
 
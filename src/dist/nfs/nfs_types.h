@@ -38,7 +38,8 @@ typedef struct _copy_request__isset
           offset(false),
           size(false),
           is_last(false),
-          overwrite(false)
+          overwrite(false),
+          checksum_only(false)
     {
     }
     bool source : 1;
@@ -49,6 +50,7 @@ typedef struct _copy_request__isset
     bool size : 1;
     bool is_last : 1;
     bool overwrite : 1;
+    bool checksum_only : 1;
 } _copy_request__isset;
 
 class copy_request
@@ -59,7 +61,14 @@ public:
     copy_request &operator=(const copy_request &);
     copy_request &operator=(copy_request &&);
     copy_request()
-        : source_dir(), dst_dir(), file_name(), offset(0), size(0), is_last(0), overwrite(0)
+        : source_dir(),
+          dst_dir(),
+          file_name(),
+          offset(0),
+          size(0),
+          is_last(0),
+          overwrite(0),
+          checksum_only(0)
     {
     }
 
@@ -72,6 +81,7 @@ public:
     int32_t size;
     bool is_last;
     bool overwrite;
+    bool checksum_only;
 
     _copy_request__isset __isset;
 
@@ -91,6 +101,8 @@ public:
 
     void __set_overwrite(const bool val);
 
+    void __set_checksum_only(const bool val);
+
     bool operator==(const copy_request &rhs) const
     {
         if (!(source == rhs.source))
@@ -109,6 +121,10 @@ public:
             return false;
         if (!(overwrite == rhs.overwrite))
             return false;
+        if (__isset.checksum_only != rhs.__isset.checksum_only)
+            return false;
+        else if (__isset.checksum_only && !(checksum_only == rhs.checksum_only))
+            return false;
         return true;
     }
     bool operator!=(const copy_request &rhs) const { return !(*this == rhs); }
@@ -131,11 +147,15 @@ inline std::ostream &operator<<(std::ostream &out, const copy_request &obj)
 
 typedef struct _copy_response__isset
 {
-    _copy_response__isset() : error(false), file_content(false), offset(false), size(false) {}
+    _copy_response__isset()
+        : error(false), file_content(false), offset(false), size(false), file_crc32(false)
+    {
+    }
     bool error : 1;
     bool file_content : 1;
     bool offset : 1;
     bool size : 1;
+    bool file_crc32 : 1;
 } _copy_response__isset;
 
 class copy_response
@@ -145,13 +165,14 @@ public:
     copy_response(copy_response &&);
     copy_response &operator=(const copy_response &);
     copy_response &operator=(copy_response &&);
-    copy_response() : offset(0), size(0) {}
+    copy_response() : offset(0), size(0), file_crc32(0) {}
 
     virtual ~copy_response() throw();
     ::dsn::error_code error;
     ::dsn::blob file_content;
     int64_t offset;
     int32_t size;
+    int32_t file_crc32;
 
     _copy_response__isset __isset;
 
@@ -163,6 +184,8 @@ public:
 
     void __set_size(const int32_t val);
 
+    void __set_file_crc32(const int32_t val);
+
     bool operator==(const copy_response &rhs) const
     {
         if (!(error == rhs.error))
@@ -173,6 +196,10 @@ public:
             return false;
         if (!(size == rhs.size))
             return false;
+        if (__isset.file_crc32 != rhs.__isset.file_crc32)
+            return false;
+        else if (__isset.file_crc32 && !(file_crc32 == rhs.file_crc32))
+            return false;
         return true;
     }
     bool operator!=(const copy_response &rhs) const { return !(*this == rhs); }
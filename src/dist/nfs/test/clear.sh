@@ -1,3 +1,3 @@
 #!/bin/sh
 
-rm -rf data nfs_test_dir nfs_test_dir_copy dsn_nfs_test.xml
+rm -rf data nfs_test_dir nfs_test_dir_copy nfs_bench_file nfs_bench_dir nfs_resume_file nfs_resume_dir dsn_nfs_test.xml
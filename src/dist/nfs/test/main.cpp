@@ -1,10 +1,13 @@
 #include <gtest/gtest.h>
+#include <fstream>
 
 #include <dsn/service_api_c.h>
 #include <dsn/utility/filesystem.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/async_calls.h>
 #include <dsn/dist/nfs_node.h>
+#include <dsn/utility/fail_point.h>
+#include <dsn/perf_counter/perf_counters.h>
 
 using namespace dsn;
 
@@ -142,6 +145,159 @@ TEST(nfs, basic)
     }
 }
 
+// copies a file through the loopback network, and prints the throughput
+TEST(nfs, copy_throughput)
+{
+    const int64_t file_size = 8 * 1024 * 1024;
+    const int chunk_size = 1024 * 1024;
+
+    std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+    nfs->start();
+
+    utils::filesystem::remove_path("nfs_bench_dir");
+    {
+        std::ofstream out("nfs_bench_file", std::ios::binary | std::ios::trunc);
+        ASSERT_TRUE(out.is_open());
+        std::string chunk;
+        for (int i = 0; i < chunk_size; i++) {
+            chunk.push_back(static_cast<char>(rand()));
+        }
+        for (int64_t written = 0; written < file_size; written += chunk_size) {
+            out.write(chunk.data(), chunk_size);
+        }
+    }
+
+    std::vector<std::string> files{"nfs_bench_file"};
+    aio_result r;
+    uint64_t start = dsn_now_ns();
+    dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                 ".",
+                                                 files,
+                                                 "nfs_bench_dir",
+                                                 false,
+                                                 true,
+                                                 LPC_AIO_TEST_NFS,
+                                                 nullptr,
+                                                 [&r](dsn::error_code err, size_t sz) {
+                                                     r.err = err;
+                                                     r.sz = sz;
+                                                 },
+                                                 0);
+    ASSERT_NE(nullptr, t);
+    ASSERT_TRUE(t->wait(20000));
+    uint64_t time_used_ns = dsn_now_ns() - start;
+    ASSERT_EQ(ERR_OK, r.err);
+
+    int64_t sz;
+    ASSERT_TRUE(utils::filesystem::file_size("nfs_bench_dir/nfs_bench_file", sz));
+    ASSERT_EQ(file_size, sz);
+
+    std::cout << "copy " << file_size / 1024 / 1024 << " MB in " << time_used_ns / 1000000
+              << " ms, throughput = " << file_size * 1000.0 / time_used_ns << " MB/s"
+              << std::endl;
+
+    utils::filesystem::remove_path("nfs_bench_file");
+    utils::filesystem::remove_path("nfs_bench_dir");
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+}
+
+static dsn::error_code
+copy_file(dsn::nfs_node *nfs, const std::string &file, const std::string &dir)
+{
+    std::vector<std::string> files{file};
+    dsn::aio_task_ptr t = nfs->copy_remote_files(dsn::rpc_address("localhost", 20101),
+                                                 ".",
+                                                 files,
+                                                 dir,
+                                                 false,
+                                                 false,
+                                                 LPC_AIO_TEST_NFS,
+                                                 nullptr,
+                                                 [](dsn::error_code err, size_t sz) {},
+                                                 0);
+    EXPECT_NE(nullptr, t);
+    EXPECT_TRUE(t->wait(60000));
+    return t->error();
+}
+
+// the data size skipped by resuming copies since the last call
+static int64_t resumed_data_size()
+{
+    int64_t size = 0;
+    perf_counters::instance().iterate_counters([&size](const perf_counter_ptr &c) {
+        if (strcmp(c->section(), "eon.nfs_client") == 0 &&
+            strcmp(c->name(), "recent_resume_data_size") == 0) {
+            size += c->get_integer_value();
+        }
+    });
+    return size;
+}
+
+// a failed copy is resumed by the next copy of the same file, and the segments written by
+// the failed copy are copied again if the source file has been changed
+TEST(nfs, resume_copy)
+{
+    // 8 segments with the default nfs_copy_block_bytes
+    const int file_size = 32 * 1024 * 1024;
+    const int block_bytes = 4 * 1024 * 1024;
+
+    std::unique_ptr<dsn::nfs_node> nfs(dsn::nfs_node::create());
+    nfs->start();
+
+    utils::filesystem::remove_path("nfs_resume_dir");
+    std::string data;
+    for (int i = 0; i < file_size; i++) {
+        data.push_back(static_cast<char>(rand()));
+    }
+    write_file("nfs_resume_file", data);
+
+    fail::setup();
+    fail::cfg("nfs_client_verify_copy_response", "return(4)");
+    ASSERT_NE(ERR_OK, copy_file(nfs.get(), "nfs_resume_file", "nfs_resume_dir"));
+    fail::teardown();
+
+    // the segments written before the failed one are verified instead of copied again
+    resumed_data_size();
+    ASSERT_EQ(ERR_OK, copy_file(nfs.get(), "nfs_resume_file", "nfs_resume_dir"));
+    ASSERT_EQ(data, read_file("nfs_resume_dir/nfs_resume_file"));
+    int64_t resumed = resumed_data_size();
+    ASSERT_GT(resumed, 0);
+    ASSERT_LE(resumed, 4 * block_bytes);
+    ASSERT_EQ(0, resumed % block_bytes);
+
+    fail::setup();
+    fail::cfg("nfs_client_verify_copy_response", "return(4)");
+    ASSERT_NE(ERR_OK, copy_file(nfs.get(), "nfs_resume_file", "nfs_resume_dir"));
+    fail::teardown();
+
+    // change the first segment of the source file
+    data[0] = ~data[0];
+    write_file("nfs_resume_file", data);
+    resumed_data_size();
+    ASSERT_EQ(ERR_OK, copy_file(nfs.get(), "nfs_resume_file", "nfs_resume_dir"));
+    ASSERT_EQ(data, read_file("nfs_resume_dir/nfs_resume_file"));
+    ASSERT_LE(resumed_data_size(), 3 * block_bytes);
+
+    // the stale tail of a longer destination file is cut off
+    write_file("nfs_resume_dir/nfs_resume_file", data + "stale tail");
+    ASSERT_EQ(ERR_OK, copy_file(nfs.get(), "nfs_resume_file", "nfs_resume_dir"));
+    ASSERT_EQ(data, read_file("nfs_resume_dir/nfs_resume_file"));
+
+    utils::filesystem::remove_path("nfs_resume_file");
+    utils::filesystem::remove_path("nfs_resume_dir");
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -4,14 +4,23 @@
 
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 
 #include "dist/replication/lib/replica_stub.h"
+#include "dist/replication/lib/prepare_list.h"
 #include "duplication_pipeline.h"
 #include "load_from_private_log.h"
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  dup_max_inflight_batches,
+                  1,
+                  "max number of mutation batches of a duplication being shipped concurrently, "
+                  "only raise it if the mutation_duplicator is safe to ship batches concurrently");
+DSN_DEFINE_validator(dup_max_inflight_batches, [](uint32_t value) -> bool { return value > 0; });
+
 //                     //
 // mutation_duplicator //
 //                     //
@@ -26,7 +35,9 @@ namespace replication {
 
 void load_mutation::run()
 {
-    decree last_decree = _duplicator->progress().last_decree;
+    // continue from the batches still in flight
+    decree last_decree =
+        std::max(_duplicator->progress().last_decree, _duplicator->_ship->last_loaded_decree());
     _start_decree = last_decree + 1;
     if (_replica->private_log()->max_commit_on_disk() < _start_decree) {
         // wait 100ms for next try if no mutation was added.
@@ -34,10 +45,52 @@ void load_mutation::run()
         return;
     }
 
+    mutation_tuple_set mutations;
+    if (load_from_cache(last_decree, mutations)) {
+        _counter_dup_load_cache_hit_count->increment();
+        _log_on_disk_outdated = true;
+        step_down_next_stage(std::move(last_decree), std::move(mutations));
+        return;
+    }
+    _counter_dup_load_cache_miss_count->increment();
+
+    if (_log_on_disk_outdated) {
+        _log_on_disk->seek_to(_start_decree);
+        _log_on_disk_outdated = false;
+    }
     _log_on_disk->set_start_decree(_start_decree);
     _log_on_disk->async();
 }
 
+bool load_mutation::load_from_cache(decree &last_decree, mutation_tuple_set &mutations)
+{
+    prepare_list *plist = _replica->_prepare_list;
+    if (plist->min_decree() > _start_decree) {
+        return false;
+    }
+
+    // only the mutations that are committed on disk are allowed to be duplicated,
+    // so that progress never goes beyond the private log.
+    decree end_decree =
+        std::min(_replica->last_committed_decree(), _replica->private_log()->max_commit_on_disk());
+    end_decree = std::min(end_decree, _start_decree + mutation_batch::PREPARE_LIST_NUM_ENTRIES - 1);
+    if (end_decree < _start_decree) {
+        return false;
+    }
+
+    for (decree d = _start_decree; d <= end_decree; d++) {
+        mutation_ptr mu = plist->get_mutation_by_decree(d);
+        if (mu == nullptr) {
+            mutations.clear();
+            return false;
+        }
+        add_mutation_if_valid(mu, mutations, _start_decree);
+    }
+    _counter_dup_cache_read_mutations_rate->add(end_decree - _start_decree + 1);
+    last_decree = end_decree;
+    return true;
+}
+
 load_mutation::~load_mutation() = default;
 
 load_mutation::load_mutation(replica_duplicator *duplicator,
@@ -45,18 +98,31 @@ load_mutation::load_mutation(replica_duplicator *duplicator,
                              load_from_private_log *load_private)
     : replica_base(r), _log_on_disk(load_private), _replica(r), _duplicator(duplicator)
 {
+    _counter_dup_load_cache_hit_count.init_app_counter(
+        "eon.replica_stub",
+        "dup.load_cache_hit_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "the number of batches loaded from the prepare list during duplication");
+    _counter_dup_load_cache_miss_count.init_app_counter(
+        "eon.replica_stub",
+        "dup.load_cache_miss_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "the number of batches loaded from the private log during duplication");
+    _counter_dup_cache_read_mutations_rate.init_app_counter(
+        "eon.replica_stub",
+        "dup.cache_read_mutations_rate",
+        COUNTER_TYPE_RATE,
+        "reading rate of mutations from the prepare list");
 }
 
 //               //
 // ship_mutation //
 //               //
 
-void ship_mutation::ship(mutation_tuple_set &&in)
+void ship_mutation::ship(uint64_t id, mutation_tuple_set &&in)
 {
-    _mutation_duplicator->duplicate(std::move(in), [this](size_t total_shipped_size) mutable {
-        update_progress();
-        _counter_dup_shipped_bytes_rate->add(total_shipped_size);
-        step_down_next_stage();
+    _mutation_duplicator->duplicate(std::move(in), [this, id](size_t total_shipped_size) mutable {
+        on_batch_shipped(id, total_shipped_size);
     });
 }
 
@@ -64,24 +130,76 @@ void ship_mutation::run(decree &&last_decree, mutation_tuple_set &&in)
 {
     _last_decree = last_decree;
 
-    if (in.empty()) {
-        update_progress();
-        step_down_next_stage();
+    inflight_batch batch;
+    batch.id = _next_batch_id++;
+    batch.last_decree = last_decree;
+    // mutations are sorted by timestamp
+    batch.oldest_timestamp_us = in.empty() ? 0 : std::get<0>(*in.begin());
+    batch.shipped = in.empty();
+    _window.push_back(batch);
+    _counter_dup_inflight_batches_count->increment();
+
+    if (!in.empty()) {
+        ship(batch.id, std::move(in));
+    }
+    ack_shipped_batches();
+
+    if (window_full()) {
+        // wait for the oldest batch to be shipped
+        _load_stalled = true;
         return;
     }
+    step_down_next_stage();
+}
 
-    ship(std::move(in));
+void ship_mutation::on_batch_shipped(uint64_t id, size_t total_shipped_size)
+{
+    _counter_dup_shipped_bytes_rate->add(total_shipped_size);
+
+    auto it = std::find_if(_window.begin(), _window.end(), [id](const inflight_batch &b) {
+        return b.id == id;
+    });
+    dassert_replica(it != _window.end(), "batch {} is not in the window", id);
+    it->shipped = true;
+    ack_shipped_batches();
+
+    if (_load_stalled && !window_full()) {
+        _load_stalled = false;
+        step_down_next_stage();
+    }
 }
 
-void ship_mutation::update_progress()
+void ship_mutation::ack_shipped_batches()
 {
-    dcheck_eq_replica(
-        _duplicator->update_progress(duplication_progress().set_last_decree(_last_decree)),
-        error_s::ok());
+    decree acked_decree = invalid_decree;
+    uint64_t now_us = dsn_now_us();
+    while (!_window.empty() && _window.front().shipped) {
+        const inflight_batch &b = _window.front();
+        acked_decree = b.last_decree;
+        if (b.oldest_timestamp_us > 0 && now_us > b.oldest_timestamp_us) {
+            _counter_dup_shipping_lag_ms->set((now_us - b.oldest_timestamp_us) / 1000);
+        }
+        _window.pop_front();
+        _counter_dup_inflight_batches_count->decrement();
+    }
+    if (acked_decree != invalid_decree) {
+        update_progress(acked_decree);
+    }
+}
+
+bool ship_mutation::window_full() const
+{
+    return _window.size() >= FLAGS_dup_max_inflight_batches;
+}
+
+void ship_mutation::update_progress(decree d)
+{
+    dcheck_eq_replica(_duplicator->update_progress(duplication_progress().set_last_decree(d)),
+                      error_s::ok());
 
     // committed decree never decreases
     decree last_committed_decree = _replica->last_committed_decree();
-    dcheck_ge_replica(last_committed_decree, _last_decree);
+    dcheck_ge_replica(last_committed_decree, d);
 }
 
 ship_mutation::ship_mutation(replica_duplicator *duplicator)
@@ -98,6 +216,22 @@ ship_mutation::ship_mutation(replica_duplicator *duplicator)
                                                      "dup.shipped_bytes_rate",
                                                      COUNTER_TYPE_RATE,
                                                      "shipping rate of private log in bytes");
+    _counter_dup_inflight_batches_count.init_app_counter(
+        "eon.replica_stub",
+        "dup.inflight_batches_count",
+        COUNTER_TYPE_NUMBER,
+        "number of mutation batches being shipped and not yet acknowledged");
+    _counter_dup_shipping_lag_ms.init_app_counter(
+        "eon.replica_stub",
+        "dup.shipping_lag_ms",
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "time from a mutation being written to its batch being acknowledged, in milliseconds");
+}
+
+ship_mutation::~ship_mutation()
+{
+    // the unacknowledged batches will be reloaded from the progress after restart
+    _counter_dup_inflight_batches_count->add(-static_cast<int64_t>(_window.size()));
 }
 
 } // namespace replication
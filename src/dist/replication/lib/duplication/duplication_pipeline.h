@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <deque>
+
 #include <dsn/cpp/pipeline.h>
 #include <dsn/dist/replication/replica_base.h>
 #include <dsn/dist/replication/mutation_duplicator.h>
@@ -18,6 +20,9 @@ using namespace literals::chrono_literals;
 
 // load_mutation is a pipeline stage for loading mutations, aka mutation_tuple_set,
 // to the next stage, `ship_mutation`.
+//
+// The mutations are served from the replica's prepare list as long as they are still
+// cached there, otherwise they are loaded from the private log by `load_from_private_log`.
 // ThreadPool: THREAD_POOL_REPLICATION
 class load_mutation : public replica_base,
                       public pipeline::when<>,
@@ -32,17 +37,35 @@ public:
 
     ~load_mutation();
 
+    // Loads the committed mutations starting from `_start_decree` out of the prepare list.
+    // Returns false if any of them has been evicted from the prepare list.
+    bool load_from_cache(/*out*/ decree &last_decree, /*out*/ mutation_tuple_set &mutations);
+
 private:
+    friend class load_mutation_test;
+
     load_from_private_log *_log_on_disk;
     decree _start_decree{0};
+    // whether the mutations were loaded from cache since the last time from the private log,
+    // in which case the private log must be re-positioned before loading.
+    bool _log_on_disk_outdated{false};
 
     replica *_replica{nullptr};
     replica_duplicator *_duplicator{nullptr};
+
+    perf_counter_wrapper _counter_dup_load_cache_hit_count;
+    perf_counter_wrapper _counter_dup_load_cache_miss_count;
+    perf_counter_wrapper _counter_dup_cache_read_mutations_rate;
 };
 
 // ship_mutation is a pipeline stage receiving a set of mutations,
-// sending them to the remote cluster. After finished, the pipeline
-// will restart from load_mutation.
+// sending them to the remote cluster.
+//
+// Up to `dup_max_inflight_batches` (1 by default) batches are shipped
+// concurrently: the pipeline restarts from load_mutation as soon as a batch is
+// sent out, and only stalls when the window is full. The batches are acknowledged in the
+// order they were loaded, so that the duplication progress only advances to
+// the last decree before which all the mutations have been shipped.
 // ThreadPool: THREAD_POOL_REPLICATION
 class ship_mutation : public replica_base,
                       public pipeline::when<decree, mutation_tuple_set>,
@@ -55,10 +78,33 @@ public:
 
     explicit ship_mutation(replica_duplicator *duplicator);
 
-    void ship(mutation_tuple_set &&in);
+    ~ship_mutation();
+
+    // The last decree that has been loaded into the window, the next batch
+    // should be loaded after it.
+    decree last_loaded_decree() const { return _last_decree; }
 
 private:
-    void update_progress();
+    struct inflight_batch
+    {
+        uint64_t id;
+        decree last_decree;
+        // timestamp in microseconds of the oldest mutation in this batch, 0 if empty
+        uint64_t oldest_timestamp_us;
+        bool shipped;
+    };
+
+    void ship(uint64_t id, mutation_tuple_set &&in);
+
+    void on_batch_shipped(uint64_t id, size_t total_shipped_size);
+
+    // Pops the shipped batches from the front of the window, and
+    // moves the progress forward to the last one of them.
+    void ack_shipped_batches();
+
+    void update_progress(decree d);
+
+    bool window_full() const;
 
     friend struct ship_mutation_test;
     friend class replica_duplicator_test;
@@ -71,7 +117,14 @@ private:
 
     decree _last_decree{invalid_decree};
 
+    std::deque<inflight_batch> _window;
+    uint64_t _next_batch_id{0};
+    // whether the loading stage is held back because the window is full
+    bool _load_stalled{false};
+
     perf_counter_wrapper _counter_dup_shipped_bytes_rate;
+    perf_counter_wrapper _counter_dup_inflight_batches_count;
+    perf_counter_wrapper _counter_dup_shipping_lag_ms;
 };
 
 } // namespace replication
@@ -220,6 +220,13 @@ void load_from_private_log::set_start_decree(decree start_decree)
     _mutation_batch.set_start_decree(start_decree);
 }
 
+void load_from_private_log::seek_to(decree start_decree)
+{
+    set_start_decree(start_decree);
+    _mutation_batch.reset_mutation_buffer(start_decree - 1);
+    _current = nullptr;
+}
+
 void load_from_private_log::start_from_log_file(log_file_ptr f)
 {
     ddebug_replica("start loading from log file {}", f->path());
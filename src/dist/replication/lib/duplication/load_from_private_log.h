@@ -35,6 +35,11 @@ public:
 
     void set_start_decree(decree start_decree);
 
+    // Discards the current reading position and restarts from the log file
+    // containing `start_decree`. It's used when the mutations before `start_decree`
+    // have been loaded from elsewhere.
+    void seek_to(decree start_decree);
+
     /// ==== Implementation ==== ///
 
     /// Find the log file that contains `_start_decree`.
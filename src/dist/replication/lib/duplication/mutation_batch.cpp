@@ -68,6 +68,12 @@ decree mutation_batch::last_decree() const { return _mutation_buffer->last_commi
 
 void mutation_batch::set_start_decree(decree d) { _start_decree = d; }
 
+void mutation_batch::reset_mutation_buffer(decree d)
+{
+    _mutation_buffer->reset(d);
+    _loaded_mutations.clear();
+}
+
 mutation_tuple_set mutation_batch::move_all_mutations()
 {
     // free the internal space
@@ -114,7 +120,9 @@ add_mutation_if_valid(mutation_ptr &mu, mutation_tuple_set &mutations, decree st
         }
         blob bb;
         if (update.data.buffer() != nullptr) {
-            bb = std::move(update.data);
+            // share the buffer rather than moving it, because the mutation
+            // may still be referenced by the prepare list of the replica.
+            bb = update.data;
         } else {
             bb = blob::create_from_bytes(update.data.data(), update.data.length());
         }
@@ -12,6 +12,8 @@
 
 #include "dist/replication/lib/mutation_log_utils.h"
 #include "dist/replication/lib/duplication/load_from_private_log.h"
+#include "dist/replication/lib/duplication/duplication_pipeline.h"
+#include "dist/replication/lib/prepare_list.h"
 #include "duplication_test_base.h"
 
 namespace dsn {
@@ -463,5 +465,67 @@ TEST_F(load_fail_mode_test, fail_skip_real_corrupted_file)
     ASSERT_GT(load->_counter_dup_load_skipped_bytes_count->get_integer_value(), 0);
 }
 
+class load_mutation_test : public duplication_test_base
+{
+public:
+    load_mutation_test()
+    {
+        _replica->init_private_log(_log_dir);
+        duplicator = create_test_duplicator();
+
+        // mutations [1, 10] are committed
+        auto plist = new prepare_list(_replica.get(), 0, 100, [](mutation_ptr &) {});
+        for (int d = 1; d <= 10; d++) {
+            mutation_ptr mu = create_test_mutation(d, "hello");
+            plist->put(mu);
+        }
+        plist->commit(10, COMMIT_TO_DECREE_HARD);
+        _replica->set_plist(plist);
+    }
+
+    bool load_from_cache(load_mutation &load,
+                         decree start_decree,
+                         decree &last_decree,
+                         mutation_tuple_set &mutations)
+    {
+        load._start_decree = start_decree;
+        return load.load_from_cache(last_decree, mutations);
+    }
+
+    std::unique_ptr<replica_duplicator> duplicator;
+};
+
+TEST_F(load_mutation_test, load_from_cache)
+{
+    load_mutation load(duplicator.get(), _replica.get(), nullptr);
+    decree last_decree = invalid_decree;
+    mutation_tuple_set mutations;
+
+    // only the mutations committed on disk are loaded
+    _replica->private_log()->update_max_commit_on_disk(8);
+    ASSERT_TRUE(load_from_cache(load, 3, last_decree, mutations));
+    ASSERT_EQ(last_decree, 8);
+    ASSERT_EQ(mutations.size(), 6);
+    for (const mutation_tuple &mut : mutations) {
+        ASSERT_EQ(std::get<2>(mut).to_string(), "hello");
+    }
+
+    // the mutations in the prepare list are left untouched
+    mutation_ptr mu = _replica->get_plist()->get_mutation_by_decree(3);
+    ASSERT_EQ(mu->data.updates[0].data.to_string(), "hello");
+
+    mutations.clear();
+    ASSERT_FALSE(load_from_cache(load, 9, last_decree, mutations));
+
+    // the mutations have been evicted from the prepare list
+    _replica->private_log()->update_max_commit_on_disk(10);
+    _replica->prepare_list_truncate(5);
+    ASSERT_FALSE(load_from_cache(load, 5, last_decree, mutations));
+    ASSERT_TRUE(mutations.empty());
+    ASSERT_TRUE(load_from_cache(load, 6, last_decree, mutations));
+    ASSERT_EQ(last_decree, 10);
+    ASSERT_EQ(mutations.size(), 5);
+}
+
 } // namespace replication
 } // namespace dsn
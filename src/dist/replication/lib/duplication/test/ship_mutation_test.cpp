@@ -6,9 +6,13 @@
 #include "dist/replication/lib/duplication/duplication_pipeline.h"
 #include "duplication_test_base.h"
 
+#include <dsn/utility/flags.h>
+
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(dup_max_inflight_batches);
+
 /*static*/ mock_mutation_duplicator::duplicate_function mock_mutation_duplicator::_func;
 
 struct mock_stage : pipeline::when<>
@@ -69,14 +73,74 @@ struct ship_mutation_test : public duplication_test_base
     ship_mutation *mock_ship_mutation()
     {
         duplicator->_ship = make_unique<ship_mutation>(duplicator.get());
+        duplicator->from(*duplicator->_ship).link(_end);
         return duplicator->_ship.get();
     }
 
+    mutation_tuple_set create_test_batch()
+    {
+        mutation_tuple_set in;
+        in.emplace(std::make_tuple(dsn_now_us(), RPC_DUPLICATION_IDEMPOTENT_WRITE, blob()));
+        return in;
+    }
+
+    // ensure at most `dup_max_inflight_batches` batches are in flight.
+    // ensure the progress only moves to the last decree of the acknowledged prefix,
+    // even if the batches complete out of order.
+    void test_ship_inflight_batches()
+    {
+        auto shipper = mock_ship_mutation();
+        int loads = 0;
+        pipeline::do_when<> load([&loads]() { loads++; });
+        shipper->__func = [&load](std::tuple<> &&) { load.run(); };
+
+        std::vector<mutation_duplicator::callback> pending;
+        mock_mutation_duplicator::mock(
+            [&pending](mutation_tuple_set, mutation_duplicator::callback cb) {
+                pending.push_back(std::move(cb));
+            });
+        _replica->set_last_committed_decree(FLAGS_dup_max_inflight_batches + 1);
+
+        for (uint32_t d = 1; d <= FLAGS_dup_max_inflight_batches; d++) {
+            shipper->run(d, create_test_batch());
+        }
+        ASSERT_EQ(pending.size(), FLAGS_dup_max_inflight_batches);
+        // the window is full, loading stalls
+        ASSERT_EQ(loads, FLAGS_dup_max_inflight_batches - 1);
+        ASSERT_EQ(shipper->last_loaded_decree(), FLAGS_dup_max_inflight_batches);
+
+        // the second batch completes first, the progress can't move forward
+        pending[1](0);
+        ASSERT_EQ(duplicator->progress().last_decree, invalid_decree);
+        ASSERT_EQ(loads, FLAGS_dup_max_inflight_batches - 1);
+
+        // the first batch completes, both the first and the second are acknowledged
+        pending[0](0);
+        ASSERT_EQ(duplicator->progress().last_decree, 2);
+        ASSERT_EQ(loads, FLAGS_dup_max_inflight_batches);
+
+        for (size_t i = 2; i < pending.size(); i++) {
+            pending[i](0);
+        }
+        ASSERT_EQ(duplicator->progress().last_decree, FLAGS_dup_max_inflight_batches);
+        ASSERT_TRUE(shipper->_window.empty());
+    }
+
     std::unique_ptr<replica_duplicator> duplicator;
+    mock_stage _end;
+
 };
 
 TEST_F(ship_mutation_test, ship_mutation_tuple_set) { test_ship_mutation_tuple_set(); }
 
+TEST_F(ship_mutation_test, ship_inflight_batches)
+{
+    uint32_t old_max_inflight_batches = FLAGS_dup_max_inflight_batches;
+    FLAGS_dup_max_inflight_batches = 4;
+    test_ship_inflight_batches();
+    FLAGS_dup_max_inflight_batches = old_max_inflight_batches;
+}
+
 void retry(pipeline::base *base)
 {
     base->schedule([base]() { retry(base); }, 10_s);
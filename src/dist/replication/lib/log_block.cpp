@@ -4,9 +4,77 @@
 
 #include "log_block.h"
 
+#include <dsn/perf_counter/perf_counter_wrapper.h>
+#include <dsn/utility/singleton.h>
+
 namespace dsn {
 namespace replication {
 
+namespace {
+
+class log_compression_counters : public utils::singleton<log_compression_counters>
+{
+public:
+    log_compression_counters()
+    {
+        input_size.init_app_counter("eon.replica_stub",
+                                    "mutation.log.compress.recent.input.size",
+                                    COUNTER_TYPE_VOLATILE_NUMBER,
+                                    "log block bytes before compression in the recent period");
+        output_size.init_app_counter("eon.replica_stub",
+                                     "mutation.log.compress.recent.output.size",
+                                     COUNTER_TYPE_VOLATILE_NUMBER,
+                                     "log block bytes after compression in the recent period");
+        time_used_us.init_app_counter("eon.replica_stub",
+                                      "mutation.log.compress.recent.time.us",
+                                      COUNTER_TYPE_VOLATILE_NUMBER,
+                                      "time used by log block compression in the recent period");
+    }
+
+    perf_counter_wrapper input_size;
+    perf_counter_wrapper output_size;
+    perf_counter_wrapper time_used_us;
+};
+
+} // anonymous namespace
+
+error_code decode_log_block_body(const log_block_header &hdr, /*inout*/ blob &body)
+{
+    if (hdr.magic != LOG_BLOCK_MAGIC_COMPRESSED) {
+        return ERR_OK;
+    }
+
+    if (body.length() < sizeof(log_block_compression_header)) {
+        derror("invalid compressed log block, length = %u", body.length());
+        return ERR_INVALID_DATA;
+    }
+    const auto *chdr = reinterpret_cast<const log_block_compression_header *>(body.data());
+    auto type = static_cast<utils::compression_type>(chdr->type);
+    blob data = body.range(sizeof(log_block_compression_header));
+
+    if (type == utils::compression_type::NONE) {
+        if (data.length() != chdr->raw_length) {
+            derror("invalid uncompressed log block, length = %u vs %u",
+                   data.length(),
+                   chdr->raw_length);
+            return ERR_INVALID_DATA;
+        }
+        body = std::move(data);
+        return ERR_OK;
+    }
+
+    blob raw;
+    if (!utils::decompress(
+            type, string_view(data.data(), data.length()), chdr->raw_length, raw)) {
+        derror("decompress log block failed, type = %s, supported = %s",
+               utils::compression_type_to_string(type),
+               utils::compression_supported(type) ? "true" : "false");
+        return ERR_INVALID_DATA;
+    }
+    body = std::move(raw);
+    return ERR_OK;
+}
+
 log_block::log_block(int64_t start_offset) : _start_offset(start_offset) { init(); }
 
 log_block::log_block() { init(); }
@@ -20,22 +88,131 @@ void log_block::init()
     add(temp_writer.get_buffer());
 }
 
-void log_appender::append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb)
+void log_block::compress(utils::compression_type type)
+{
+    // merge the serialized mutations into a continuous buffer
+    std::string raw;
+    raw.reserve(_size - _data.front().length());
+    for (size_t i = 1; i < _data.size(); i++) {
+        raw.append(_data[i].data(), _data[i].length());
+    }
+
+    log_block_compression_header chdr;
+    chdr.raw_length = static_cast<uint32_t>(raw.size());
+    blob data;
+    if (utils::compress(type, raw, data)) {
+        chdr.type = static_cast<uint8_t>(type);
+    } else {
+        data = blob::create_from_bytes(std::move(raw));
+    }
+
+    blob header = std::move(_data.front());
+    reinterpret_cast<log_block_header *>(const_cast<char *>(header.data()))->magic =
+        LOG_BLOCK_MAGIC_COMPRESSED;
+    _data.clear();
+    _size = 0;
+    _crc = 0;
+    add(header);
+    add(blob::create_from_bytes(reinterpret_cast<const char *>(&chdr), sizeof(chdr)));
+    add(data);
+}
+
+/*static*/ uint32_t log_appender::payload_crc(const mutation_ptr &mu)
 {
+    uint32_t crc = 0;
+    for (const mutation_update &update : mu->data.updates) {
+        crc = utils::crc32_calc(update.data.data(), update.data.length(), crc);
+    }
+    return crc;
+}
+
+void log_appender::append_mutation(const mutation_ptr &mu,
+                                   const aio_task_ptr &cb,
+                                   uint32_t payload_crc)
+{
+    dassert(!_sealed, "cannot append mutations to a sealed log_appender");
     _mutations.push_back(mu);
     if (cb) {
         _callbacks.push_back(cb);
     }
+    if (_deferred) {
+        _deferred_size += sizeof(mutation_header);
+        for (const mutation_update &update : mu->data.updates) {
+            _deferred_size += update.data.length();
+        }
+        return;
+    }
+    add_to_blocks(mu, payload_crc);
+}
+
+void log_appender::add_to_blocks(const mutation_ptr &mu, uint32_t payload_crc)
+{
     log_block *blk = &_blocks.back();
     if (blk->size() > DEFAULT_MAX_BLOCK_BYTES) {
+        seal_block(*blk);
         _full_blocks_size += blk->size();
         _full_blocks_blob_cnt += blk->data().size();
         int64_t new_block_start_offset = blk->start_offset() + blk->size();
         _blocks.emplace_back(new_block_start_offset);
         blk = &_blocks.back();
     }
+
+    if (_compression != utils::compression_type::NONE) {
+        // the crc is computed after the block is compressed, and the mutation is left
+        // untouched, since it may be serialized by another thread than the replica's
+        mu->write_to([blk](const blob &bb) { blk->add_without_crc(bb); }, blk->start_offset());
+        return;
+    }
+
     mu->data.header.log_offset = blk->start_offset() + blk->size();
-    mu->write_to([blk](const blob &bb) { blk->add(bb); });
+    // the first blob is the mutation header, the others are the update data
+    bool is_header = true;
+    size_t payload_length = 0;
+    mu->write_to([blk, &is_header, &payload_length](const blob &bb) {
+        if (is_header) {
+            blk->add(bb);
+            is_header = false;
+        } else {
+            blk->add_without_crc(bb);
+            payload_length += bb.length();
+        }
+    });
+    blk->concat_crc(payload_crc, payload_length);
+}
+
+void log_appender::seal()
+{
+    dassert(!_deferred, "a deferred log_appender must be sealed with its start offset");
+    if (!_sealed) {
+        seal_block(_blocks.back());
+        _sealed = true;
+    }
+}
+
+void log_appender::seal(int64_t start_offset)
+{
+    dassert(_deferred && !_sealed, "only an unsealed deferred log_appender can be sealed");
+    _blocks.front()._start_offset = start_offset;
+    for (const mutation_ptr &mu : _mutations) {
+        add_to_blocks(mu, 0);
+    }
+    seal_block(_blocks.back());
+    _sealed = true;
+}
+
+void log_appender::seal_block(log_block &blk)
+{
+    if (_compression == utils::compression_type::NONE) {
+        return;
+    }
+
+    auto &counters = log_compression_counters::instance();
+    uint64_t start_ns = dsn_now_ns();
+    size_t input_size = blk.size();
+    blk.compress(_compression);
+    counters.time_used_us->add((dsn_now_ns() - start_ns) / 1000);
+    counters.input_size->add(input_size);
+    counters.output_size->add(blk.size());
 }
 
 } // namespace replication
@@ -6,13 +6,34 @@
 
 #include "mutation.h"
 
+#include <dsn/utility/compression.h>
+#include <dsn/utility/crc.h>
+
 namespace dsn {
 namespace replication {
 
+// The body_crc of the block is computed independently of the other blocks.
+// Blocks are written with this magic only if mutation_log_independent_block_crc is enabled,
+// since old versions can't read them, which makes a downgrade impossible.
+constexpr int32_t LOG_BLOCK_MAGIC = static_cast<int32_t>(0xdeadbeee);
+
+// The block body begins with a log_block_compression_header, followed by the serialized
+// mutations compressed with the codec in it. The body_crc covers the body as stored.
+// The log_offset of each mutation in the block is the start offset of the block, since the
+// positions in the uncompressed data would exceed the range of the block in the log file.
+constexpr int32_t LOG_BLOCK_MAGIC_COMPRESSED = static_cast<int32_t>(0xdeadbeed);
+
+// The body_crc of the block is chained from the body_crc of the previous block in the same
+// log file. It's the default format, which is also written and read by old versions.
+// The chained crc is derived from the independent crc of the block with crc32_concat
+// when the block is committed, so it doesn't take a pass over the data in file order.
+constexpr int32_t LOG_BLOCK_MAGIC_CHAINED_CRC = static_cast<int32_t>(0xdeadbeef);
+
 // each block in log file has a log_block_header
 struct log_block_header
 {
-    int32_t magic{static_cast<int32_t>(0xdeadbeef)}; // 0xdeadbeef
+    int32_t magic{LOG_BLOCK_MAGIC}; // replaced by LOG_BLOCK_MAGIC_CHAINED_CRC on commit if
+                                    // mutation_log_independent_block_crc is disabled
     int32_t length{0};   // block data length (not including log_block_header)
     int32_t body_crc{0}; // block data crc (not including log_block_header)
 
@@ -21,12 +42,25 @@ struct log_block_header
     uint32_t local_offset{0};
 };
 
+struct log_block_compression_header
+{
+    uint8_t type{0}; // utils::compression_type, NONE if the data isn't worth compressing
+    uint8_t reserved[3]{0, 0, 0};
+    uint32_t raw_length{0}; // length of the serialized mutations before compression
+};
+
+// Converts the body of a block read from the log file into the serialized mutations,
+// which is a no-op unless the block is compressed.
+// Returns ERR_INVALID_DATA if the compressed data is corrupted or the codec is not built in.
+error_code decode_log_block_body(const log_block_header &hdr, /*inout*/ blob &body);
+
 // a memory structure holding data which belongs to one block.
 class log_block
 {
     std::vector<blob> _data; // the first blob is log_block_header
     size_t _size{0};         // total data size of all blobs
     int64_t _start_offset{0};
+    uint32_t _crc{0}; // crc of all blobs except log_block_header
 
 public:
     log_block();
@@ -51,9 +85,13 @@ public:
         return _data.front();
     }
 
-    // add a blob into the block
+    // add a blob into the block, the crc of the block body is updated accordingly,
+    // so it's computed by the appending thread rather than under the log file's lock.
     void add(const blob &bb)
     {
+        if (!_data.empty()) {
+            _crc = dsn::utils::crc32_calc(bb.data(), bb.length(), _crc);
+        }
         _size += bb.length();
         _data.push_back(bb);
     }
@@ -61,12 +99,33 @@ public:
     // return total data size in the block
     size_t size() const { return _size; }
 
+    // crc of the block body (not including log_block_header), starting from 0
+    uint32_t crc() const { return _crc; }
+
     // global offset to start writting this block
     int64_t start_offset() const { return _start_offset; }
 
 private:
     friend class log_appender;
     void init();
+
+    // add a blob whose crc is combined later by concat_crc()
+    void add_without_crc(const blob &bb)
+    {
+        _size += bb.length();
+        _data.push_back(bb);
+    }
+
+    // combine the crc of the tailing `length` bytes added by add_without_crc()
+    void concat_crc(uint32_t crc, size_t length)
+    {
+        size_t prefix_length = _size - _data.front().length() - length;
+        _crc = dsn::utils::crc32_concat(0, 0, _crc, prefix_length, 0, crc, length);
+    }
+
+    // replace the body with a log_block_compression_header and the compressed data,
+    // the data is stored as is if compression doesn't make it smaller
+    void compress(utils::compression_type type);
 };
 
 // Append writes into a buffer which consists of one or more fixed-size log blocks,
@@ -75,20 +134,62 @@ private:
 class log_appender
 {
 public:
-    explicit log_appender(int64_t start_offset) { _blocks.emplace_back(start_offset); }
+    explicit log_appender(int64_t start_offset,
+                          utils::compression_type compression = utils::compression_type::NONE)
+        : _compression(compression)
+    {
+        _blocks.emplace_back(start_offset);
+    }
 
     log_appender(int64_t start_offset, log_block &block)
+        : _compression(utils::compression_type::NONE)
     {
         block._start_offset = start_offset;
         _blocks.emplace_back(std::move(block));
     }
 
-    void append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb);
+    // The mutations are kept as they're appended, and serialized and compressed by
+    // seal(start_offset), so that it can be done without the lock of the log, while the
+    // start offset of the blocks isn't known until the previous write is compressed.
+    explicit log_appender(utils::compression_type deferred_compression)
+        : _compression(deferred_compression), _deferred(true)
+    {
+        dassert(_compression != utils::compression_type::NONE,
+                "only compressed mutations can be deferred");
+        _blocks.emplace_back(0);
+    }
+
+    // The crc of the update data of the mutation, which doesn't depend on the position of
+    // the mutation in the log, so it's computed before the lock of the log is taken.
+    static uint32_t payload_crc(const mutation_ptr &mu);
+
+    void append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb)
+    {
+        append_mutation(mu, cb, payload_crc(mu));
+    }
 
-    size_t size() const { return _full_blocks_size + _blocks.crbegin()->size(); }
+    // Only the crc of the mutation header, which holds the log_offset, is computed here.
+    void append_mutation(const mutation_ptr &mu, const aio_task_ptr &cb, uint32_t payload_crc);
+
+    // Compresses the tailing block if compression is enabled, after which size() is the
+    // final size to be written, and no more mutations can be appended.
+    // The full blocks are compressed as soon as they're filled.
+    void seal();
+
+    // Serializes and compresses the mutations of a deferred appender into the blocks
+    // starting from start_offset, after which it's the same as a sealed appender.
+    void seal(int64_t start_offset);
+
+    bool is_deferred() const { return _deferred; }
+
+    // The size of a deferred appender before it's sealed is estimated from the update data.
+    size_t size() const
+    {
+        return _full_blocks_size + _blocks.crbegin()->size() + (_sealed ? 0 : _deferred_size);
+    }
     size_t blob_count() const { return _full_blocks_blob_cnt + _blocks.crbegin()->data().size(); }
 
-    std::vector<mutation_ptr> mutations() const { return _mutations; }
+    const std::vector<mutation_ptr> &mutations() const { return _mutations; }
 
     // The callback registered for each write.
     const std::vector<aio_task_ptr> &callbacks() const { return _callbacks; }
@@ -101,6 +202,10 @@ public:
 protected:
     static constexpr size_t DEFAULT_MAX_BLOCK_BYTES = 1 * 1024 * 1024; // 1MB
 
+    void add_to_blocks(const mutation_ptr &mu, uint32_t payload_crc);
+
+    void seal_block(log_block &blk);
+
     // |---------------------- _blocks ----------------------|
     // | full block 0 | full block 1 | .... | unfilled block |
 
@@ -111,6 +216,10 @@ protected:
     size_t _full_blocks_blob_cnt{0};
     std::vector<aio_task_ptr> _callbacks;
     std::vector<mutation_ptr> _mutations;
+    const utils::compression_type _compression;
+    const bool _deferred{false};
+    size_t _deferred_size{0};
+    bool _sealed{false};
 };
 
 } // namespace replication
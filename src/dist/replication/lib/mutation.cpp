@@ -33,6 +33,8 @@
  *     xxxx-xx-xx, author, fix bug about xxx
  */
 
+#include <dsn/utility/flags.h>
+
 #include "mutation.h"
 #include "mutation_log.h"
 #include "replica.h"
@@ -40,6 +42,17 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_bool("replication",
+                mutation_2pc_adaptive_depth,
+                false,
+                "whether to adjust the max count of mutations in 2pc of each primary by the "
+                "latency of 2pc, up to staleness_for_commit");
+DSN_DEFINE_uint32("replication",
+                  mutation_2pc_min_depth,
+                  2,
+                  "the min count of mutations in 2pc of each primary if the depth is adaptive");
+DSN_DEFINE_validator(mutation_2pc_min_depth, [](uint32_t value) -> bool { return value > 0; });
+
 std::atomic<uint64_t> mutation::s_tid(0);
 
 mutation::mutation()
@@ -48,6 +61,7 @@ mutation::mutation()
     _private0 = 0;
     _not_logged = 1;
     _prepare_ts_ms = 0;
+    _prepare_ts_ns = 0;
     strcpy(_name, "0.0.0.0");
     _appro_data_bytes = sizeof(mutation_header);
     _create_ts_ns = dsn_now_ns();
@@ -146,14 +160,28 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
         update.__set_start_time_ns(dsn_now_ns());
         request->add_ref(); // released on dctor
 
-        void *ptr;
-        size_t size;
-        bool r = request->read_next(&ptr, &size);
+        // the payload may be received in multiple buffers, which are copied only in that case
+        std::vector<blob> buffers;
+        bool r = request->read_next(buffers);
         dassert(r, "payload is not present");
         request->read_commit(0); // so we can re-read the request buffer in replicated app
-        update.data.assign((char *)ptr, 0, (int)size);
+        if (buffers.size() == 1) {
+            update.data = std::move(buffers[0]);
+        } else {
+            size_t size = 0;
+            for (const blob &bb : buffers) {
+                size += bb.length();
+            }
+            std::shared_ptr<char> buffer(utils::make_shared_array<char>(size));
+            size_t offset = 0;
+            for (const blob &bb : buffers) {
+                memcpy(buffer.get() + offset, bb.data(), bb.length());
+                offset += bb.length();
+            }
+            update.data.assign(std::move(buffer), 0, (int)size);
+        }
 
-        _appro_data_bytes += sizeof(int) + (int)size; // data size
+        _appro_data_bytes += sizeof(int) + (int)update.data.length(); // data size
     } else {
         update.code = RPC_REPLICATION_WRITE_EMPTY;
         _appro_data_bytes += sizeof(int); // empty data size
@@ -166,8 +194,17 @@ void mutation::add_client_request(task_code code, dsn::message_ex *request)
 
 void mutation::write_to(const std::function<void(const blob &)> &inserter) const
 {
+    write_to(inserter, data.header.log_offset);
+}
+
+void mutation::write_to(const std::function<void(const blob &)> &inserter,
+                        int64_t log_offset) const
+{
+    mutation_header header = data.header;
+    header.log_offset = log_offset;
+
     binary_writer writer(1024);
-    write_mutation_header(writer, data.header);
+    write_mutation_header(writer, header);
     writer.write_pod(static_cast<int>(data.updates.size()));
     for (const mutation_update &update : data.updates) {
         // write task_code as string to make it cross-process compatible.
@@ -188,7 +225,7 @@ void mutation::write_to(const std::function<void(const blob &)> &inserter) const
     }
 }
 
-void mutation::write_to(binary_writer &writer, dsn::message_ex * /*to*/) const
+void mutation::write_to(binary_writer &writer, dsn::message_ex *to) const
 {
     write_mutation_header(writer, data.header);
     writer.write_pod(static_cast<int>(data.updates.size()));
@@ -205,12 +242,56 @@ void mutation::write_to(binary_writer &writer, dsn::message_ex * /*to*/) const
 
         writer.write_pod(static_cast<int>(update.data.length()));
     }
-    // TODO(qinzuoyan): directly append buffer to message to avoid memory copy
+    if (to != nullptr) {
+        writer.flush();
+        for (const blob &bb : shared_payload()) {
+            to->write_append(bb);
+        }
+        return;
+    }
     for (const mutation_update &update : data.updates) {
         writer.write(update.data.data(), update.data.length());
     }
 }
 
+const std::vector<blob> &mutation::shared_payload() const
+{
+    if (!_shared_payload.empty()) {
+        return _shared_payload;
+    }
+
+    // blobs without managed memory can't outlive the mutation, so they are copied too
+    auto is_referenced = [](const blob &bb) {
+        return bb.length() >= SHARED_PAYLOAD_REFERENCE_MIN_BYTES && bb.buffer() != nullptr;
+    };
+    size_t i = 0;
+    while (i < data.updates.size()) {
+        if (is_referenced(data.updates[i].data)) {
+            _shared_payload.push_back(data.updates[i].data);
+            ++i;
+            continue;
+        }
+
+        size_t end = i, size = 0;
+        while (end < data.updates.size() && !is_referenced(data.updates[end].data)) {
+            size += data.updates[end].data.length();
+            ++end;
+        }
+        if (size > 0) {
+            std::shared_ptr<char> buffer(utils::make_shared_array<char>(size));
+            size_t offset = 0;
+            for (; i < end; ++i) {
+                const blob &bb = data.updates[i].data;
+                memcpy(buffer.get() + offset, bb.data(), bb.length());
+                offset += bb.length();
+            }
+            _shared_payload.emplace_back(std::move(buffer), 0, (int)size);
+        }
+        i = end;
+    }
+    return _shared_payload;
+}
+
 /*static*/ mutation_ptr mutation::read_from(binary_reader &reader, dsn::message_ex *from)
 {
     mutation_ptr mu(new mutation());
@@ -328,7 +409,16 @@ void mutation::wait_log_task() const
 mutation_queue::mutation_queue(gpid gpid,
                                int max_concurrent_op /*= 2*/,
                                bool batch_write_disabled /*= false*/)
-    : _max_concurrent_op(max_concurrent_op), _batch_write_disabled(batch_write_disabled)
+    : _max_concurrent_op(max_concurrent_op),
+      _batch_write_disabled(batch_write_disabled),
+      _adaptive_depth(FLAGS_mutation_2pc_adaptive_depth),
+      _min_depth(std::min(static_cast<int>(FLAGS_mutation_2pc_min_depth), max_concurrent_op)),
+      _max_depth(max_concurrent_op),
+      _depth(max_concurrent_op),
+      _base_latency_us(std::numeric_limits<uint64_t>::max()),
+      _window_min_latency_us(std::numeric_limits<uint64_t>::max()),
+      _window_rounds(0),
+      _rounds_before_decrease(0)
 {
     _current_op_count = 0;
     _pending_mutation = nullptr;
@@ -418,6 +508,37 @@ mutation_ptr mutation_queue::check_possible_work(int current_running_count)
     }
 }
 
+int mutation_queue::on_2pc_round_completed(uint64_t latency_us)
+{
+    if (!_adaptive_depth) {
+        return _max_concurrent_op;
+    }
+
+    latency_us = std::max<uint64_t>(latency_us, 1);
+    _window_min_latency_us = std::min(_window_min_latency_us, latency_us);
+    _base_latency_us = std::min(_base_latency_us, latency_us);
+    if (++_window_rounds >= ADAPTIVE_DEPTH_WINDOW_ROUNDS) {
+        _base_latency_us = _window_min_latency_us;
+        _window_min_latency_us = std::numeric_limits<uint64_t>::max();
+        _window_rounds = 0;
+    }
+
+    if (_rounds_before_decrease > 0) {
+        _rounds_before_decrease--;
+    }
+    if (latency_us > _base_latency_us * 2) {
+        if (_rounds_before_decrease == 0) {
+            _depth = std::max(static_cast<double>(_min_depth), _depth / 2);
+            _rounds_before_decrease = _current_op_count;
+        }
+    } else if (_pending_mutation != nullptr || !_hdr.is_empty()) {
+        _depth = std::min(static_cast<double>(_max_depth), _depth + 1 / _depth);
+    }
+
+    _max_concurrent_op = static_cast<int>(_depth);
+    return _max_concurrent_op;
+}
+
 void mutation_queue::clear()
 {
     if (_pending_mutation != nullptr) {
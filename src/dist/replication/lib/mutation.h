@@ -114,7 +114,12 @@ public:
     int clear_prepare_or_commit_tasks();
     void wait_log_task() const;
     uint64_t prepare_ts_ms() const { return _prepare_ts_ms; }
-    void set_prepare_ts() { _prepare_ts_ms = dsn_now_ms(); }
+    uint64_t prepare_ts_ns() const { return _prepare_ts_ns; }
+    void set_prepare_ts()
+    {
+        _prepare_ts_ns = dsn_now_ns();
+        _prepare_ts_ms = _prepare_ts_ns / 1000000;
+    }
 
     // >= 1 MB
     bool is_full() const { return _appro_data_bytes >= 1024 * 1024; }
@@ -127,9 +132,19 @@ public:
     //   - the private log may be transfered to other node with different program
     //   - the private/shared log may be replayed by different program when server restart
     void write_to(const std::function<void(const blob &)> &inserter) const;
+    // the same as above, but writes the given log_offset instead of data.header.log_offset
+    void write_to(const std::function<void(const blob &)> &inserter, int64_t log_offset) const;
+    // if "to" is not null, "writer" must be writing to it, and the payload of the updates is
+    // appended to "to" as shared_payload() without copying.
     void write_to(binary_writer &writer, dsn::message_ex *to) const;
     static mutation_ptr read_from(binary_reader &reader, dsn::message_ex *from);
 
+    // the payload of the updates shared by the prepare messages to all the secondaries, which is
+    // built only once: the consecutive small updates are merged into one buffer, and the large
+    // ones are referenced directly.
+    const std::vector<blob> &shared_payload() const;
+    static const int SHARED_PAYLOAD_REFERENCE_MIN_BYTES = 4096;
+
     static void write_mutation_header(binary_writer &writer, const mutation_header &header);
     static void read_mutation_header(binary_reader &reader, mutation_header &header);
 
@@ -158,6 +173,7 @@ private:
     };
 
     uint64_t _prepare_ts_ms;
+    uint64_t _prepare_ts_ns;
     ::dsn::task_ptr _log_task;
     node_tasks _prepare_or_commit_tasks;
     std::vector<dsn::message_ex *> _prepare_requests; // may combine duplicate requests
@@ -167,6 +183,7 @@ private:
     uint64_t _tid;          // trace id, unique in process
     static std::atomic<uint64_t> s_tid;
     bool _is_sync_to_child; // for partition split
+    mutable std::vector<blob> _shared_payload;
 };
 
 class replica;
@@ -204,6 +221,22 @@ public:
     // which triggers further round of operations as returned
     mutation_ptr check_possible_work(int current_running_count);
 
+    // If `mutation_2pc_adaptive_depth` is enabled, the max count of concurrent operations is
+    // adjusted between `mutation_2pc_min_depth` and the count given on construction, by the
+    // latency of each 2pc round, which ends when the mutation is logged and acked by all the
+    // secondaries:
+    // - it's halved if the latency is more than twice the base latency, i.e. the min latency
+    //   observed recently, as the mutations are queued in the log or the network.
+    // - otherwise it's increased by 1 per round of all the concurrent operations, if there are
+    //   mutations waiting to send.
+    // Returns the max count of concurrent operations.
+    int on_2pc_round_completed(uint64_t latency_us);
+    int max_concurrent_op() const { return _max_concurrent_op; }
+
+    // the base latency is the min latency of the last and the current windows, so that it
+    // follows the changes of the environment
+    static const int ADAPTIVE_DEPTH_WINDOW_ROUNDS = 1000;
+
 private:
     mutation_ptr unlink_next_workload()
     {
@@ -218,10 +251,23 @@ private:
     void reset_max_concurrent_ops(int max_c) { _max_concurrent_op = max_c; }
 
 private:
+    friend class mutation_queue_test;
+
     int _current_op_count;
     int _max_concurrent_op;
     bool _batch_write_disabled;
 
+    bool _adaptive_depth;
+    int _min_depth;
+    int _max_depth;
+    double _depth;
+    uint64_t _base_latency_us;
+    uint64_t _window_min_latency_us;
+    int _window_rounds;
+    // the rounds to wait before the next decrease, so that the depth is decreased at most once
+    // for the mutations prepared with the same depth
+    int _rounds_before_decrease;
+
     volatile int *_pcount;
     mutation_ptr _pending_mutation;
     slist<mutation> _hdr;
@@ -31,12 +31,28 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/crc.h>
 #include <dsn/utility/fail_point.h>
+#include <dsn/utility/flags.h>
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/tool-api/async_calls.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_string("replication",
+                  mutation_log_compression_type,
+                  "none",
+                  "codec to compress the blocks of shared and private mutation logs, "
+                  "could be none, lz4 or zstd");
+DSN_DEFINE_validator(mutation_log_compression_type, [](const char *value) -> bool {
+    utils::compression_type type;
+    return utils::compression_type_from_string(value, type) && utils::compression_supported(type);
+});
+DSN_DEFINE_bool("replication",
+                mutation_log_independent_block_crc,
+                false,
+                "whether to write the uncompressed log blocks with independent crc, "
+                "which can't be read by old versions");
+
 ::dsn::task_ptr mutation_log_shared::append(mutation_ptr &mu,
                                             dsn::task_code callback_code,
                                             dsn::task_tracker *tracker,
@@ -50,16 +66,27 @@ namespace replication {
                        callback_code, tracker, std::forward<aio_handler>(callback), hash)
                  : nullptr;
 
+    // compressed blocks are checksummed after compression
+    uint32_t payload_crc =
+        (_compression_type == utils::compression_type::NONE ? log_appender::payload_crc(mu) : 0);
+
     _slock.lock();
 
     // init pending buffer
     if (nullptr == _pending_write) {
-        _pending_write = std::make_shared<log_appender>(mark_new_offset(0, true).second);
+        if (_compression_type == utils::compression_type::NONE) {
+            _pending_write = std::make_shared<log_appender>(mark_new_offset(0, true).second);
+        } else {
+            // the offset is decided when the write starts, see write_pending_mutations()
+            _pending_write = std::make_shared<log_appender>(_compression_type);
+        }
     }
-    _pending_write->append_mutation(mu, cb);
+    _pending_write->append_mutation(mu, cb, payload_crc);
 
-    // update meta
-    update_max_decree(mu->data.header.pid, d);
+    // update meta, which is delayed until the write starts for a deferred pending write
+    if (!_pending_write->is_deferred()) {
+        update_max_decree(mu->data.header.pid, d);
+    }
 
     // start to write if possible
     if (!_is_writing.load(std::memory_order_acquire)) {
@@ -110,6 +137,12 @@ void mutation_log_shared::write_pending_mutations(bool release_lock_required)
     dassert(!_is_writing.load(std::memory_order_relaxed), "");
     dassert(_pending_write != nullptr, "");
     dassert(_pending_write->size() > 0, "pending write size = %d", (int)_pending_write->size());
+    if (_pending_write->is_deferred()) {
+        write_deferred_pending_mutations();
+        return;
+    }
+
+    _pending_write->seal();
     auto pr = mark_new_offset(_pending_write->size(), false);
     dcheck_eq(pr.second, _pending_write->start_offset());
 
@@ -123,6 +156,33 @@ void mutation_log_shared::write_pending_mutations(bool release_lock_required)
     commit_pending_mutations(pr.first, pending);
 }
 
+void mutation_log_shared::write_deferred_pending_mutations()
+{
+    // the log file is switched before the max decrees are updated by the pending mutations,
+    // the same as an uncompressed pending write does when it's created
+    int64_t start_offset = mark_new_offset(0, true).second;
+    for (const mutation_ptr &mu : _pending_write->mutations()) {
+        update_max_decree(mu->data.header.pid, mu->data.header.decree);
+    }
+
+    _is_writing.store(true, std::memory_order_release);
+
+    auto pending = std::move(_pending_write);
+
+    // the pending mutations are compressed out of the lock, the offset is reserved after
+    // that, since their size to write is unknown till then. It's safe because no one else
+    // reserves any offset when _is_writing is set: new pending writes are deferred too.
+    _slock.unlock();
+    pending->seal(start_offset);
+
+    _slock.lock();
+    auto pr = mark_new_offset(pending->size(), false);
+    dcheck_eq(pr.second, pending->start_offset());
+    _slock.unlock();
+
+    commit_pending_mutations(pr.first, pending);
+}
+
 void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
                                                    std::shared_ptr<log_appender> &pending)
 {
@@ -135,7 +195,11 @@ void mutation_log_shared::commit_pending_mutations(log_file_ptr &lf,
 
             for (auto &block : pending->all_blocks()) {
                 auto hdr = (log_block_header *)block.front().data();
-                dassert(hdr->magic == 0xdeadbeef, "header magic is changed: 0x%x", hdr->magic);
+                dassert(hdr->magic == LOG_BLOCK_MAGIC ||
+                            hdr->magic == LOG_BLOCK_MAGIC_CHAINED_CRC ||
+                            hdr->magic == LOG_BLOCK_MAGIC_COMPRESSED,
+                        "header magic is changed: 0x%x",
+                        hdr->magic);
             }
 
             if (err == ERR_OK) {
@@ -207,14 +271,19 @@ mutation_log_private::mutation_log_private(const std::string &dir,
 {
     dassert(nullptr == callback, "callback is not needed in private mutation log");
 
+    // compressed blocks are checksummed after compression
+    uint32_t payload_crc =
+        (_compression_type == utils::compression_type::NONE ? log_appender::payload_crc(mu) : 0);
+
     _plock.lock();
 
     // init pending buffer
     if (nullptr == _pending_write) {
-        _pending_write = make_unique<log_appender>(mark_new_offset(0, true).second);
+        _pending_write =
+            make_unique<log_appender>(mark_new_offset(0, true).second, _compression_type);
         _pending_write_start_time_ms = dsn_now_ms();
     }
-    _pending_write->append_mutation(mu, nullptr);
+    _pending_write->append_mutation(mu, nullptr, payload_crc);
 
     // update meta
     _pending_write_max_commit =
@@ -361,6 +430,8 @@ void mutation_log_private::write_pending_mutations(bool release_lock_required)
     dassert(!_is_writing.load(std::memory_order_relaxed), "");
     dassert(_pending_write != nullptr, "");
     dassert(_pending_write->size() > 0, "pending write size = %d", (int)_pending_write->size());
+    // the size to write is only known after the pending mutations are compressed
+    _pending_write->seal();
     auto pr = mark_new_offset(_pending_write->size(), false);
     dcheck_eq_replica(pr.second, _pending_write->start_offset());
 
@@ -395,7 +466,11 @@ void mutation_log_private::commit_pending_mutations(log_file_ptr &lf,
 
             for (auto &block : pending->all_blocks()) {
                 auto hdr = (log_block_header *)block.front().data();
-                dassert(hdr->magic == 0xdeadbeef, "header magic is changed: 0x%x", hdr->magic);
+                dassert(hdr->magic == LOG_BLOCK_MAGIC ||
+                            hdr->magic == LOG_BLOCK_MAGIC_CHAINED_CRC ||
+                            hdr->magic == LOG_BLOCK_MAGIC_COMPRESSED,
+                        "header magic is changed: 0x%x",
+                        hdr->magic);
             }
 
             if (err != ERR_OK) {
@@ -442,6 +517,9 @@ mutation_log::mutation_log(const std::string &dir, int32_t max_log_file_mb, gpid
     _is_private = (gpid.value() != 0);
     _max_log_file_size_in_bytes = static_cast<int64_t>(max_log_file_mb) * 1024L * 1024L;
     _min_log_file_size_in_bytes = _max_log_file_size_in_bytes / 10;
+    bool ok = utils::compression_type_from_string(FLAGS_mutation_log_compression_type,
+                                                  _compression_type);
+    dassert(ok, "invalid mutation_log_compression_type: %s", FLAGS_mutation_log_compression_type);
     _owner_replica = r;
     _private_gpid = gpid;
 
@@ -1968,6 +2046,30 @@ void log_file::flush() const
 }
 
 error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
+{
+    log_block_header hdr;
+    return read_next_log_block(hdr, bb);
+}
+
+error_code log_file::read_next_log_block(/*out*/ log_block_header &hdr, /*out*/ ::dsn::blob &bb)
+{
+    uint32_t init_crc;
+    error_code err = read_next_log_block_unverified(hdr, bb, init_crc);
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    if (!verify_log_block(hdr, bb, init_crc)) {
+        derror("crc checking failed");
+        return ERR_INVALID_DATA;
+    }
+
+    return decode_log_block_body(hdr, bb);
+}
+
+error_code log_file::read_next_log_block_unverified(/*out*/ log_block_header &hdr,
+                                                    /*out*/ ::dsn::blob &bb,
+                                                    /*out*/ uint32_t &init_crc)
 {
     dassert(_is_read, "log file must be of read mode");
     auto err = _stream->read_next(sizeof(log_block_header), bb);
@@ -1984,9 +2086,10 @@ error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
 
         return err;
     }
-    log_block_header hdr = *reinterpret_cast<const log_block_header *>(bb.data());
+    hdr = *reinterpret_cast<const log_block_header *>(bb.data());
 
-    if (hdr.magic != 0xdeadbeef) {
+    if (hdr.magic != LOG_BLOCK_MAGIC && hdr.magic != LOG_BLOCK_MAGIC_CHAINED_CRC &&
+        hdr.magic != LOG_BLOCK_MAGIC_COMPRESSED) {
         derror("invalid data header magic: 0x%x", hdr.magic);
         return ERR_INVALID_DATA;
     }
@@ -2006,17 +2109,21 @@ error_code log_file::read_next_log_block(/*out*/ ::dsn::blob &bb)
         return err;
     }
 
-    auto crc = dsn::utils::crc32_calc(
-        static_cast<const void *>(bb.data()), static_cast<size_t>(hdr.length), _crc32);
-    if (crc != hdr.body_crc) {
-        derror("crc checking failed");
-        return ERR_INVALID_DATA;
-    }
-    _crc32 = crc;
+    // the crc of a chained block starts from the crc of the previous block
+    init_crc = (hdr.magic == LOG_BLOCK_MAGIC_CHAINED_CRC ? _crc32 : 0);
+    _crc32 = static_cast<uint32_t>(hdr.body_crc);
 
     return ERR_OK;
 }
 
+/*static*/ bool
+log_file::verify_log_block(const log_block_header &hdr, const ::dsn::blob &bb, uint32_t init_crc)
+{
+    auto crc = dsn::utils::crc32_calc(
+        static_cast<const void *>(bb.data()), static_cast<size_t>(bb.length()), init_crc);
+    return crc == static_cast<uint32_t>(hdr.body_crc);
+}
+
 aio_task_ptr log_file::commit_log_block(log_block &block,
                                         int64_t offset,
                                         dsn::task_code evt,
@@ -2036,11 +2143,8 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
     dassert(!_is_read, "log file must be of write mode");
     dcheck_gt(pending.size(), 0);
 
-    zauto_lock lock(_write_lock);
-    if (!_handle) {
-        return nullptr;
-    }
-
+    // the block headers are filled without the lock, because the crc of each block is
+    // already computed when appending, only chaining it takes a crc32_concat under the lock.
     auto size = (long long)pending.size();
     size_t vec_size = pending.blob_count();
     std::vector<dsn_file_buffer_t> buffer_vector(vec_size);
@@ -2049,26 +2153,34 @@ aio_task_ptr log_file::commit_log_blocks(log_appender &pending,
         int64_t local_offset = block.start_offset() - start_offset();
         auto hdr = reinterpret_cast<log_block_header *>(const_cast<char *>(block.front().data()));
 
-        dassert(hdr->magic == 0xdeadbeef, "");
+        dassert(hdr->magic == LOG_BLOCK_MAGIC || hdr->magic == LOG_BLOCK_MAGIC_COMPRESSED, "");
         hdr->local_offset = local_offset;
         hdr->length = static_cast<int32_t>(block.size() - sizeof(log_block_header));
-        hdr->body_crc = _crc32;
+        hdr->body_crc = block.crc();
+        if (hdr->magic == LOG_BLOCK_MAGIC && !FLAGS_mutation_log_independent_block_crc) {
+            hdr->magic = LOG_BLOCK_MAGIC_CHAINED_CRC;
+        }
 
-        for (int i = 0; i < block.data().size(); i++) {
-            auto &blk = block.data()[i];
+        for (auto &blk : block.data()) {
             buffer_vector[buffer_idx].buffer =
                 reinterpret_cast<void *>(const_cast<char *>(blk.data()));
             buffer_vector[buffer_idx].size = blk.length();
-
-            // skip block header
-            if (i > 0) {
-                hdr->body_crc = dsn::utils::crc32_calc(static_cast<const void *>(blk.data()),
-                                                       static_cast<size_t>(blk.length()),
-                                                       hdr->body_crc);
-            }
             buffer_idx++;
         }
-        _crc32 = hdr->body_crc;
+    }
+
+    zauto_lock lock(_write_lock);
+    if (!_handle) {
+        return nullptr;
+    }
+
+    // blocks are committed in file order, so the chained crc starts from the previous block
+    for (log_block &block : pending.all_blocks()) {
+        auto hdr = reinterpret_cast<log_block_header *>(const_cast<char *>(block.front().data()));
+        if (hdr->magic == LOG_BLOCK_MAGIC_CHAINED_CRC) {
+            hdr->body_crc = dsn::utils::crc32_concat(0, 0, _crc32, 0, 0, block.crc(), hdr->length);
+        }
+        _crc32 = static_cast<uint32_t>(hdr->body_crc);
     }
 
     aio_task_ptr tsk;
@@ -355,6 +355,18 @@ private:
                              replay_callback callback,
                              /*out*/ int64_t &end_offset);
 
+    static error_code replay_sequential(std::map<int, log_file_ptr> &log_files,
+                                        replay_callback &callback,
+                                        /*inout*/ int64_t &end_offset);
+
+    // replays the log files in order like replay_sequential(), but the blocks are
+    // prefetched by a reader thread, and verified and decoded by a group of workers.
+    // The callback is still executed in the calling thread in log order, so the mutations
+    // of each replica are replayed in decree order.
+    static error_code replay_pipelined(std::map<int, log_file_ptr> &log_files,
+                                       replay_callback &callback,
+                                       /*inout*/ int64_t &end_offset);
+
     // update max decree without lock
     void update_max_decree_no_lock(gpid gpid, decree d);
 
@@ -381,6 +393,7 @@ protected:
     // options
     int64_t _max_log_file_size_in_bytes;
     int64_t _min_log_file_size_in_bytes;
+    utils::compression_type _compression_type; // codec of the log blocks to write
     bool _force_flush;
 
     dsn::task_tracker _tracker;
@@ -461,6 +474,9 @@ private:
     // appropriately for less lock contention
     void write_pending_mutations(bool release_lock_required);
 
+    // compresses the pending mutations after releasing _slock, see log_appender::seal()
+    void write_deferred_pending_mutations();
+
     void commit_pending_mutations(log_file_ptr &lf, std::shared_ptr<log_appender> &pending);
 
     // flush at most count times
@@ -605,7 +621,8 @@ public:
 
     // sync read the next log entry from the file
     // the entry data is start from the 'local_offset' of the file
-    // the result is passed out by 'bb', not including the log_block_header
+    // the result is passed out by 'bb', not including the log_block_header,
+    // and already decompressed if the block is compressed
     // return error codes:
     //  - ERR_OK
     //  - ERR_HANDLE_EOF
@@ -613,6 +630,20 @@ public:
     //  - ERR_INVALID_DATA
     //  - other io errors caused by file read operator
     error_code read_next_log_block(/*out*/ ::dsn::blob &bb);
+    // the same as above, besides returning the header of the block
+    error_code read_next_log_block(/*out*/ log_block_header &hdr, /*out*/ ::dsn::blob &bb);
+
+    // same as read_next_log_block(), but leaves the crc checking and decoding to the caller,
+    // so that blocks can be verified concurrently with verify_log_block() and decoded with
+    // decode_log_block_body().
+    // 'init_crc' is the crc value the body crc of the block should be computed from.
+    error_code read_next_log_block_unverified(/*out*/ log_block_header &hdr,
+                                              /*out*/ ::dsn::blob &bb,
+                                              /*out*/ uint32_t &init_crc);
+
+    // check the body crc of a block read by read_next_log_block_unverified()
+    static bool
+    verify_log_block(const log_block_header &hdr, const ::dsn::blob &bb, uint32_t init_crc);
 
     //
     // write routines
@@ -684,7 +715,7 @@ private:
 private:
     friend class mock_log_file;
 
-    uint32_t _crc32;
+    uint32_t _crc32; // crc of the last read or written block, to chain the crc of next block
     int64_t _start_offset; // start offset in the global space
     std::atomic<int64_t>
         _end_offset; // end offset in the global space: end_offset = start_offset + file_size
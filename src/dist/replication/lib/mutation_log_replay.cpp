@@ -7,10 +7,28 @@
 #include <dsn/utility/fail_point.h>
 #include <dsn/utility/errors.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  mutation_log_replay_threads,
+                  4,
+                  "number of threads to verify and decode log blocks in parallel when replaying "
+                  "mutation logs, 0 means replaying all the blocks in the calling thread");
+DSN_DEFINE_uint32("replication",
+                  mutation_log_replay_prefetch_blocks,
+                  16,
+                  "max number of log blocks read ahead of the replay callbacks when the mutation "
+                  "logs are replayed in parallel");
+DSN_DEFINE_validator(mutation_log_replay_prefetch_blocks,
+                     [](uint32_t value) -> bool { return value > 0; });
+
 /*static*/ error_code mutation_log::replay(log_file_ptr log,
                                            replay_callback callback,
                                            /*out*/ int64_t &end_offset)
@@ -59,7 +77,8 @@ namespace replication {
     end_offset = global_start_offset; // reset end_offset to the start.
 
     // reads the entire block into memory
-    error_code err = log->read_next_log_block(bb);
+    log_block_header hdr;
+    error_code err = log->read_next_log_block(hdr, bb);
     if (err != ERR_OK) {
         return error_s::make(err, "failed to read log block");
     }
@@ -82,10 +101,13 @@ namespace replication {
         dassert(nullptr != mu, "");
         mu->set_logged();
 
-        if (mu->data.header.log_offset != end_offset) {
+        // the mutations in a compressed block are all at the start offset of the block
+        int64_t expected_offset =
+            (hdr.magic == LOG_BLOCK_MAGIC_COMPRESSED ? global_start_offset : end_offset);
+        if (mu->data.header.log_offset != expected_offset) {
             return FMT_ERR(ERR_INVALID_DATA,
                            "offset mismatch in log entry and mutation {} vs {}",
-                           end_offset,
+                           expected_offset,
                            mu->data.header.log_offset);
         }
 
@@ -96,6 +118,8 @@ namespace replication {
         end_offset += log_length;
     }
 
+    // the block may be compressed, so the end offset is decided by its size in the file
+    end_offset = global_start_offset + sizeof(log_block_header) + hdr.length;
     return error_s::ok();
 }
 
@@ -132,7 +156,6 @@ namespace replication {
     int64_t g_start_offset = 0;
     int64_t g_end_offset = 0;
     error_code err = ERR_OK;
-    log_file_ptr last;
 
     if (logs.size() > 0) {
         g_start_offset = logs.begin()->second->start_offset();
@@ -147,6 +170,35 @@ namespace replication {
 
     end_offset = g_start_offset;
 
+    if (FLAGS_mutation_log_replay_threads > 0) {
+        err = replay_pipelined(logs, callback, end_offset);
+    } else {
+        err = replay_sequential(logs, callback, end_offset);
+    }
+
+    if (err == ERR_OK || err == ERR_HANDLE_EOF) {
+        // the log may still be written when used for learning
+        dassert(g_end_offset <= end_offset,
+                "make sure the global end offset is correct: %" PRId64 " vs %" PRId64,
+                g_end_offset,
+                end_offset);
+        err = ERR_OK;
+    } else if (err == ERR_INCOMPLETE_DATA) {
+        // ignore the last incomplate block
+        err = ERR_OK;
+    } else {
+        // bad error
+        derror("replay mutation log failed: %s", err.to_string());
+    }
+
+    return err;
+}
+
+/*static*/ error_code mutation_log::replay_sequential(std::map<int, log_file_ptr> &logs,
+                                                      replay_callback &callback,
+                                                      /*inout*/ int64_t &end_offset)
+{
+    error_code err = ERR_OK;
     for (auto &kv : logs) {
         log_file_ptr &log = kv.second;
 
@@ -157,7 +209,6 @@ namespace replication {
             return ERR_INVALID_DATA;
         }
 
-        last = log;
         err = mutation_log::replay(log, callback, end_offset);
 
         log->close();
@@ -173,20 +224,284 @@ namespace replication {
             break;
         }
     }
+    return err;
+}
 
-    if (err == ERR_OK || err == ERR_HANDLE_EOF) {
-        // the log may still be written when used for learning
-        dassert(g_end_offset <= end_offset,
-                "make sure the global end offset is correct: %" PRId64 " vs %" PRId64,
-                g_end_offset,
-                end_offset);
-        err = ERR_OK;
-    } else if (err == ERR_INCOMPLETE_DATA) {
-        // ignore the last incomplate block
-        err = ERR_OK;
-    } else {
-        // bad error
-        derror("replay mutation log failed: %s", err.to_string());
+namespace {
+
+// A log block read by the reader thread of replay_pipeline, which is then verified
+// and decoded by one of the workers.
+struct replay_block_entry
+{
+    log_file_ptr log;
+    // global offset of the block, including log_block_header
+    int64_t start_offset{0};
+    // the first block of a log file begins with log_file_header
+    bool is_first_block{false};
+
+    // the result of reading the block, any error means there're no more blocks in the file
+    error_code read_err{ERR_OK};
+    log_block_header hdr;
+    blob body;
+    uint32_t init_crc{0};
+
+    // set by the worker
+    bool decoded{false};
+    error_s decode_err;
+    int file_header_size{0};
+    // <log length, mutation> of each mutation in the block
+    std::vector<std::pair<int, mutation_ptr>> mutations;
+};
+
+typedef std::shared_ptr<replay_block_entry> replay_block_entry_ptr;
+
+class replay_pipeline
+{
+public:
+    replay_pipeline(std::map<int, log_file_ptr> &logs, uint32_t worker_count, uint32_t max_blocks)
+        : _logs(logs), _max_blocks(max_blocks)
+    {
+        _reader = std::thread([this]() { read_loop(); });
+        for (uint32_t i = 0; i < worker_count; i++) {
+            _workers.emplace_back([this]() { decode_loop(); });
+        }
+    }
+
+    ~replay_pipeline() { stop(); }
+
+    // Returns the next decoded block in log order, or nullptr if all the blocks are consumed.
+    replay_block_entry_ptr next()
+    {
+        std::unique_lock<std::mutex> l(_lock);
+        _cond.wait(l, [this]() {
+            return (!_window.empty() && _window.front()->decoded) ||
+                   (_window.empty() && _read_done);
+        });
+        if (_window.empty()) {
+            return nullptr;
+        }
+        replay_block_entry_ptr e = std::move(_window.front());
+        _window.pop_front();
+        l.unlock();
+        _cond.notify_all();
+        return e;
+    }
+
+    // Waits for all the threads to exit, the log files are no longer accessed after that.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            _stopped = true;
+        }
+        _cond.notify_all();
+        if (_reader.joinable()) {
+            _reader.join();
+        }
+        for (auto &w : _workers) {
+            w.join();
+        }
+        _workers.clear();
+    }
+
+private:
+    void read_loop()
+    {
+        for (auto &kv : _logs) {
+            log_file_ptr &log = kv.second;
+            log->reset_stream();
+
+            error_code err = ERR_OK;
+            int64_t start_offset = log->start_offset();
+            while (err == ERR_OK) {
+                auto e = std::make_shared<replay_block_entry>();
+                e->log = log;
+                e->start_offset = start_offset;
+                e->is_first_block = (start_offset == log->start_offset());
+                e->read_err = log->read_next_log_block_unverified(e->hdr, e->body, e->init_crc);
+                err = e->read_err;
+                start_offset += sizeof(log_block_header) + e->body.length();
+
+                std::unique_lock<std::mutex> l(_lock);
+                _cond.wait(l, [this]() { return _stopped || _window.size() < _max_blocks; });
+                if (_stopped) {
+                    return;
+                }
+                _window.push_back(e);
+                if (err == ERR_OK) {
+                    _decode_queue.push_back(std::move(e));
+                } else {
+                    e->decoded = true;
+                }
+                l.unlock();
+                _cond.notify_all();
+            }
+
+            // same as replay(), only these errors allow continuing with the next file
+            if (err != ERR_HANDLE_EOF && err != ERR_INCOMPLETE_DATA) {
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> l(_lock);
+            _read_done = true;
+        }
+        _cond.notify_all();
+    }
+
+    void decode_loop()
+    {
+        std::unique_lock<std::mutex> l(_lock);
+        while (true) {
+            _cond.wait(l, [this]() { return _stopped || !_decode_queue.empty(); });
+            if (_stopped) {
+                return;
+            }
+            replay_block_entry_ptr e = std::move(_decode_queue.front());
+            _decode_queue.pop_front();
+
+            l.unlock();
+            decode(*e);
+            l.lock();
+
+            e->decoded = true;
+            _cond.notify_all();
+        }
+    }
+
+    // the same as replay_block() does after reading a block
+    static void decode(replay_block_entry &e)
+    {
+        if (!log_file::verify_log_block(e.hdr, e.body, e.init_crc)) {
+            derror("crc checking failed");
+            e.decode_err = error_s::make(ERR_INVALID_DATA, "failed to read log block");
+            return;
+        }
+        if (decode_log_block_body(e.hdr, e.body) != ERR_OK) {
+            e.decode_err = error_s::make(ERR_INVALID_DATA, "failed to read log block");
+            return;
+        }
+
+        binary_reader reader(e.body);
+        int64_t end_offset = e.start_offset + sizeof(log_block_header);
+        if (e.is_first_block) {
+            e.file_header_size = e.log->read_file_header(reader);
+            if (!e.log->is_right_header()) {
+                e.decode_err = error_s::make(ERR_INVALID_DATA, "failed to read log file header");
+                return;
+            }
+            end_offset += e.file_header_size;
+        }
+
+        while (!reader.is_eof()) {
+            auto old_size = reader.get_remaining_size();
+            mutation_ptr mu = mutation::read_from(reader, nullptr);
+            dassert(nullptr != mu, "");
+            mu->set_logged();
+
+            int64_t expected_offset =
+                (e.hdr.magic == LOG_BLOCK_MAGIC_COMPRESSED ? e.start_offset : end_offset);
+            if (mu->data.header.log_offset != expected_offset) {
+                e.decode_err = FMT_ERR(ERR_INVALID_DATA,
+                                       "offset mismatch in log entry and mutation {} vs {}",
+                                       expected_offset,
+                                       mu->data.header.log_offset);
+                return;
+            }
+
+            int log_length = old_size - reader.get_remaining_size();
+            e.mutations.emplace_back(log_length, std::move(mu));
+            end_offset += log_length;
+        }
+    }
+
+private:
+    std::map<int, log_file_ptr> &_logs;
+    const uint32_t _max_blocks;
+
+    std::mutex _lock;
+    std::condition_variable _cond;
+    // blocks read but not consumed yet, in log order
+    std::deque<replay_block_entry_ptr> _window;
+    // blocks waiting to be decoded
+    std::deque<replay_block_entry_ptr> _decode_queue;
+    bool _read_done{false};
+    bool _stopped{false};
+
+    std::thread _reader;
+    std::vector<std::thread> _workers;
+};
+
+} // anonymous namespace
+
+/*static*/ error_code mutation_log::replay_pipelined(std::map<int, log_file_ptr> &logs,
+                                                     replay_callback &callback,
+                                                     /*inout*/ int64_t &end_offset)
+{
+    replay_pipeline pipeline(logs,
+                             FLAGS_mutation_log_replay_threads,
+                             FLAGS_mutation_log_replay_prefetch_blocks);
+
+    error_code err = ERR_OK;
+    replay_block_entry_ptr e;
+    while ((e = pipeline.next()) != nullptr) {
+        log_file_ptr &log = e->log;
+        if (e->is_first_block) {
+            if (log->start_offset() != end_offset) {
+                derror("offset mismatch in log file offset and global offset %" PRId64
+                       " vs %" PRId64,
+                       log->start_offset(),
+                       end_offset);
+                err = ERR_INVALID_DATA;
+                break;
+            }
+            ddebug("start to replay mutation log %s, offset = [%" PRId64 ", %" PRId64
+                   "), size = %" PRId64,
+                   log->path().c_str(),
+                   log->start_offset(),
+                   log->end_offset(),
+                   log->end_offset() - log->start_offset());
+        }
+
+        if (e->read_err != ERR_OK) {
+            // the last entry of the file, which is no longer read by the pipeline
+            err = e->read_err;
+            ddebug("finish to replay mutation log (%s) [err: %s]",
+                   log->path().c_str(),
+                   err.to_string());
+            log->close();
+
+            if (err == ERR_HANDLE_EOF) {
+                // do nothing
+            } else if (err == ERR_INCOMPLETE_DATA) {
+                dwarn("delay handling error: %s", err.to_string());
+            } else {
+                break;
+            }
+            continue;
+        }
+
+        end_offset += sizeof(log_block_header) + e->file_header_size;
+        for (auto &kv : e->mutations) {
+            callback(kv.first, kv.second);
+            end_offset += kv.first;
+        }
+
+        if (e->decode_err.is_ok()) {
+            // the block may be compressed, so the end offset is decided by its size in the file
+            end_offset = e->start_offset + sizeof(log_block_header) + e->hdr.length;
+        } else {
+            err = e->decode_err.code();
+            ddebug("finish to replay mutation log (%s) [err: %s]",
+                   log->path().c_str(),
+                   e->decode_err.description().c_str());
+
+            // the reader may still be reading this file
+            pipeline.stop();
+            log->close();
+            break;
+        }
     }
 
     return err;
@@ -0,0 +1,317 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <cstring>
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/cpp/serialization.h>
+#include <dsn/utility/flags.h>
+
+#include "prepare_coalescer.h"
+#include "replica_stub.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DEFINE_bool("replication",
+                prepare_coalesce_enabled,
+                false,
+                "whether to coalesce the prepares bound for the same node into one rpc, all the "
+                "replica servers must be able to receive the coalesced prepares");
+DSN_DEFINE_uint32("replication",
+                  prepare_coalesce_max_count,
+                  64,
+                  "a batch of coalesced prepares or acks is sent once it holds so many items");
+DSN_DEFINE_validator(prepare_coalesce_max_count, [](uint32_t value) -> bool { return value > 0; });
+DSN_DEFINE_uint32("replication",
+                  prepare_coalesce_max_bytes,
+                  256 * 1024,
+                  "a batch of coalesced prepares or acks is sent once it holds so many bytes");
+DSN_DEFINE_uint32("replication",
+                  prepare_coalesce_delay_us,
+                  200,
+                  "a batch of coalesced prepares or acks is sent at most so many microseconds "
+                  "after its first item");
+
+static const int TIMEOUT_CHECK_INTERVAL_MS = 100;
+
+prepare_coalescer::prepare_coalescer(replica_stub *stub) : _stub(stub) {}
+
+prepare_coalescer::~prepare_coalescer() { close(); }
+
+rpc_response_task_ptr prepare_coalescer::call(rpc_address node,
+                                              gpid pid,
+                                              message_ex *request,
+                                              task_tracker *tracker,
+                                              rpc_response_handler &&callback,
+                                              int reply_thread_hash)
+{
+    // the prepares of a partition are sent from its replication thread one by one, and the
+    // buffered items are only removed concurrently, so the check can't miss an earlier prepare
+    // of the same partition
+    bool coalesce = FLAGS_prepare_coalesce_enabled;
+    if (!coalesce && !has_buffered_items(RPC_PREPARE_BATCH, node)) {
+        return rpc::call(node, request, tracker, std::move(callback), reply_thread_hash);
+    }
+
+    // the request itself is never sent, fill in what rpc_engine would for the callback
+    request->to_address = node;
+    request->header->from_address = _stub->primary_address();
+    rpc_response_task_ptr t =
+        rpc::create_rpc_response_task(request, tracker, std::move(callback), reply_thread_hash);
+
+    coalesced_item item;
+    item.id = ++_next_id;
+    item.pid = pid;
+    get_body(request, item);
+    {
+        uint64_t deadline_ms = dsn_now_ms() + request->header->client.timeout_ms;
+        zauto_lock l(_pending_lock);
+        _pending.emplace(item.id, pending_prepare{t, deadline_ms});
+        _deadlines.emplace(deadline_ms, item.id);
+        if (_timeout_timer == nullptr) {
+            _timeout_timer =
+                tasking::enqueue_timer(LPC_PREPARE_COALESCE_TIMEOUT_CHECK,
+                                       &_tracker,
+                                       [this]() { check_timeout(); },
+                                       std::chrono::milliseconds(TIMEOUT_CHECK_INTERVAL_MS));
+        }
+    }
+
+    append(RPC_PREPARE_BATCH, node, std::move(item), !coalesce);
+    return t;
+}
+
+void prepare_coalescer::on_prepare_batch(message_ex *batch)
+{
+    std::vector<coalesced_item> items;
+    parse_batch(batch, items);
+
+    for (coalesced_item &item : items) {
+        message_ex *request = message_ex::create_receive_message_with_standalone_header(item.body);
+        request->local_rpc_code = RPC_PREPARE_BATCH;
+        message_header &hdr = *request->header;
+        strncpy(hdr.rpc_name, RPC_PREPARE_BATCH.to_string(), sizeof(hdr.rpc_name) - 1);
+        hdr.id = item.id;
+        hdr.from_address = batch->header->from_address;
+        hdr.gpid = item.pid;
+        hdr.client.thread_hash = item.pid.thread_hash();
+        hdr.context.u.is_request = true;
+        hdr.context.u.serialize_format = DSF_THRIFT_BINARY;
+
+        // enqueued in the order of the batch, so the prepares of a partition are handled in order
+        message_ptr holder(request);
+        tasking::enqueue(LPC_COALESCED_PREPARE,
+                         &_tracker,
+                         [this, holder]() { _stub->on_prepare(holder.get()); },
+                         item.pid.thread_hash());
+    }
+}
+
+void prepare_coalescer::reply(message_ex *request, const prepare_ack &ack)
+{
+    binary_writer writer;
+    marshall(writer, ack, DSF_THRIFT_BINARY);
+
+    coalesced_item item;
+    item.id = request->header->id;
+    item.pid = request->header->gpid;
+    item.body.emplace_back(writer.get_buffer());
+    item.size = item.body.back().length();
+    append(RPC_PREPARE_ACK_BATCH, request->header->from_address, std::move(item), false);
+}
+
+void prepare_coalescer::on_prepare_ack_batch(message_ex *batch)
+{
+    std::vector<coalesced_item> items;
+    parse_batch(batch, items);
+
+    for (coalesced_item &item : items) {
+        rpc_response_task_ptr t;
+        {
+            zauto_lock l(_pending_lock);
+            auto it = _pending.find(item.id);
+            if (it == _pending.end()) {
+                // already timed out
+                continue;
+            }
+            t = std::move(it->second.task);
+            _deadlines.erase(std::make_pair(it->second.deadline_ms, item.id));
+            _pending.erase(it);
+        }
+
+        message_ex *reply = message_ex::create_receive_message_with_standalone_header(item.body);
+        reply->header->gpid = item.pid;
+        reply->header->context.u.serialize_format = DSF_THRIFT_BINARY;
+        t->enqueue(ERR_OK, reply);
+    }
+}
+
+void prepare_coalescer::close()
+{
+    _tracker.cancel_outstanding_tasks();
+    for (batch_shard &shard : _shards) {
+        zauto_lock l(shard.lock);
+        shard.prepare_batches.clear();
+        shard.ack_batches.clear();
+    }
+    std::vector<rpc_response_task_ptr> closed;
+    {
+        zauto_lock l(_pending_lock);
+        for (auto &kv : _pending) {
+            if (kv.second.task->state() != TASK_STATE_CANCELLED) {
+                closed.emplace_back(std::move(kv.second.task));
+            }
+        }
+        _pending.clear();
+        _deadlines.clear();
+        _timeout_timer = nullptr;
+    }
+
+    for (const rpc_response_task_ptr &t : closed) {
+        t->enqueue(ERR_OBJECT_NOT_FOUND, nullptr);
+    }
+}
+
+void prepare_coalescer::append(task_code code,
+                               rpc_address node,
+                               coalesced_item &&item,
+                               bool flush_now)
+{
+    batch_shard &shard = shard_of(node);
+    zauto_lock l(shard.lock);
+    outgoing_batch &batch = shard.batches_of(code)[node];
+    batch.bytes += item.size;
+    batch.items.emplace_back(std::move(item));
+
+    if (flush_now || batch.items.size() >= FLAGS_prepare_coalesce_max_count ||
+        batch.bytes >= FLAGS_prepare_coalesce_max_bytes) {
+        send(code, node, batch);
+    } else if (!batch.flush_scheduled) {
+        batch.flush_scheduled = true;
+        // timers are in milliseconds, a delay shorter than that flushes the batch as soon as
+        // the flush task runs, which coalesces the items appended in the meantime
+        tasking::enqueue(LPC_PREPARE_COALESCE_FLUSH,
+                         &_tracker,
+                         [this, code, node]() { flush(code, node); },
+                         static_cast<int>(std::hash<rpc_address>()(node) & 0x7fffffff),
+                         std::chrono::milliseconds(FLAGS_prepare_coalesce_delay_us / 1000));
+    }
+}
+
+bool prepare_coalescer::has_buffered_items(task_code code, rpc_address node)
+{
+    batch_shard &shard = shard_of(node);
+    zauto_lock l(shard.lock);
+    outgoing_batches &batches = shard.batches_of(code);
+    auto it = batches.find(node);
+    return it != batches.end() && !it->second.items.empty();
+}
+
+void prepare_coalescer::flush(task_code code, rpc_address node)
+{
+    batch_shard &shard = shard_of(node);
+    zauto_lock l(shard.lock);
+    outgoing_batches &batches = shard.batches_of(code);
+    auto it = batches.find(node);
+    if (it == batches.end()) {
+        return;
+    }
+    it->second.flush_scheduled = false;
+    if (!it->second.items.empty()) {
+        send(code, node, it->second);
+    }
+}
+
+void prepare_coalescer::send(task_code code, rpc_address node, outgoing_batch &batch)
+{
+    // the batches from this node are handled by the same thread on the receiver, and they're
+    // sent under the lock of the shard, so the items of a partition are received in the order
+    // they're appended
+    int thread_hash =
+        static_cast<int>(std::hash<rpc_address>()(_stub->primary_address()) & 0x7fffffff);
+    message_ex *msg = create_batch(code, batch.items, thread_hash);
+    batch.items.clear();
+    batch.bytes = 0;
+    send_batch(node, msg);
+}
+
+void prepare_coalescer::send_batch(rpc_address node, message_ex *batch)
+{
+    dsn_rpc_call_one_way(node, batch);
+}
+
+void prepare_coalescer::check_timeout()
+{
+    std::vector<rpc_response_task_ptr> timeouts;
+    uint64_t now = dsn_now_ms();
+    {
+        zauto_lock l(_pending_lock);
+        // the cancelled prepares are also removed once they expire
+        while (!_deadlines.empty() && _deadlines.begin()->first <= now) {
+            auto it = _pending.find(_deadlines.begin()->second);
+            _deadlines.erase(_deadlines.begin());
+            if (it->second.task->state() != TASK_STATE_CANCELLED) {
+                timeouts.emplace_back(std::move(it->second.task));
+            }
+            _pending.erase(it);
+        }
+    }
+
+    for (const rpc_response_task_ptr &t : timeouts) {
+        t->enqueue(ERR_TIMEOUT, nullptr);
+    }
+}
+
+/*static*/ message_ex *prepare_coalescer::create_batch(task_code code,
+                                                       const std::vector<coalesced_item> &items,
+                                                       int thread_hash)
+{
+    message_ex *msg = message_ex::create_request(code, 0, thread_hash);
+    rpc_write_stream writer(msg);
+    writer.write(static_cast<int32_t>(items.size()));
+    for (const coalesced_item &item : items) {
+        writer.write(item.id);
+        writer.write(item.pid.value());
+        writer.write(static_cast<int32_t>(item.size));
+        for (const blob &bb : item.body) {
+            writer.write_data(bb);
+        }
+    }
+    return msg;
+}
+
+/*static*/ void prepare_coalescer::parse_batch(message_ex *batch,
+                                               /*out*/ std::vector<coalesced_item> &items)
+{
+    rpc_read_stream reader(batch);
+    int32_t count = 0;
+    reader.read(count);
+    items.resize(count);
+    for (coalesced_item &item : items) {
+        uint64_t pid = 0;
+        reader.read(item.id);
+        reader.read(pid);
+        item.pid.set_value(pid);
+        reader.read(item.size);
+        blob body;
+        reader.read(body, item.size);
+        item.body.emplace_back(std::move(body));
+    }
+}
+
+/*static*/ void prepare_coalescer::get_body(message_ex *request, /*out*/ coalesced_item &item)
+{
+    // the header is at the beginning of the first buffer
+    for (size_t i = 0; i < request->buffers.size(); i++) {
+        blob bb = i == 0 ? request->buffers[0].range(static_cast<int>(sizeof(message_header)))
+                         : request->buffers[i];
+        if (bb.length() > 0) {
+            item.body.emplace_back(std::move(bb));
+        }
+    }
+    item.size = request->header->body_length;
+}
+
+} // namespace replication
+} // namespace dsn
@@ -0,0 +1,150 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#pragma once
+
+#include <atomic>
+#include <set>
+#include <unordered_map>
+#include <dsn/tool-api/async_calls.h>
+#include <dsn/tool-api/zlocks.h>
+
+#include "dist/replication/common/replication_common.h"
+
+namespace dsn {
+namespace replication {
+
+class replica_stub;
+
+//
+// Coalesces the prepares bound for the same remote node into one RPC_PREPARE_BATCH, and the
+// acks of them into one RPC_PREPARE_ACK_BATCH back to the primary, so that a node hosting
+// many primaries sends a few larger messages instead of one small rpc per mutation per
+// secondary.
+//
+// A batch is sent once it holds `prepare_coalesce_max_count` items or
+// `prepare_coalesce_max_bytes` bytes, or `prepare_coalesce_delay_us` after its first item.
+// A prepare larger than that is still appended to the batch, which is then sent at once, as
+// a prepare sent alone may overtake the prepares of the same partition buffered before it.
+// Both batches are one-way, the primary matches the acks with the pending prepares by the id
+// of each item, and fails the prepares with ERR_TIMEOUT if they're not acked in time.
+//
+// The receiver dispatches each prepare to the replication thread of its gpid in the order of
+// the batch, and the batches from a node are handled in order, so the prepares of a partition
+// still arrive in order.
+//
+// Only the sender is controlled by `prepare_coalesce_enabled`, which should be enabled after
+// all the replica servers are able to receive batches. Once disabled, the prepares bound for a
+// node are still sent in batch until the items buffered for it are sent.
+//
+class prepare_coalescer
+{
+public:
+    explicit prepare_coalescer(replica_stub *stub);
+    virtual ~prepare_coalescer();
+
+    // Sends the prepare `request` of `pid` to `node` like rpc::call, in a batch if coalescing
+    // is enabled.
+    rpc_response_task_ptr call(rpc_address node,
+                               gpid pid,
+                               message_ex *request,
+                               task_tracker *tracker,
+                               rpc_response_handler &&callback,
+                               int reply_thread_hash);
+
+    // on secondary: splits the batch into prepares for replica_stub::on_prepare
+    void on_prepare_batch(message_ex *batch);
+
+    // on secondary: the prepares split from a batch are acked in batch
+    static bool is_coalesced(message_ex *request)
+    {
+        return request->local_rpc_code == RPC_PREPARE_BATCH;
+    }
+    void reply(message_ex *request, const prepare_ack &ack);
+
+    // on primary: completes the pending prepares with their acks
+    void on_prepare_ack_batch(message_ex *batch);
+
+    // the pending prepares are failed with ERR_OBJECT_NOT_FOUND
+    void close();
+
+protected:
+    // sends a batch as a one-way rpc
+    virtual void send_batch(rpc_address node, message_ex *batch);
+
+private:
+    struct coalesced_item
+    {
+        uint64_t id;
+        gpid pid;
+        std::vector<blob> body;
+        int size;
+    };
+
+    struct outgoing_batch
+    {
+        std::vector<coalesced_item> items;
+        int bytes{0};
+        bool flush_scheduled{false};
+    };
+    typedef std::unordered_map<rpc_address, outgoing_batch> outgoing_batches;
+
+    // the batches of a node are always in the same shard, so that the nodes in different
+    // shards are appended to and sent concurrently
+    struct batch_shard
+    {
+        zlock lock; // protects prepare_batches and ack_batches
+        outgoing_batches prepare_batches;
+        outgoing_batches ack_batches;
+
+        outgoing_batches &batches_of(task_code code)
+        {
+            return code == RPC_PREPARE_BATCH ? prepare_batches : ack_batches;
+        }
+    };
+    static const int BATCH_SHARD_COUNT = 16;
+
+    struct pending_prepare
+    {
+        rpc_response_task_ptr task;
+        uint64_t deadline_ms;
+    };
+
+    void append(task_code code, rpc_address node, coalesced_item &&item, bool flush_now);
+    bool has_buffered_items(task_code code, rpc_address node);
+    void flush(task_code code, rpc_address node);
+    // must be called with the lock of the shard of `node` locked
+    void send(task_code code, rpc_address node, outgoing_batch &batch);
+    batch_shard &shard_of(rpc_address node)
+    {
+        return _shards[std::hash<rpc_address>()(node) % BATCH_SHARD_COUNT];
+    }
+
+    void check_timeout();
+
+    static message_ex *
+    create_batch(task_code code, const std::vector<coalesced_item> &items, int thread_hash);
+    static void parse_batch(message_ex *batch, /*out*/ std::vector<coalesced_item> &items);
+    // the body of a request to send, without copying
+    static void get_body(message_ex *request, /*out*/ coalesced_item &item);
+
+private:
+    friend class prepare_coalescer_test;
+
+    replica_stub *_stub;
+
+    batch_shard _shards[BATCH_SHARD_COUNT];
+
+    zlock _pending_lock; // protects _pending, _deadlines and _timeout_timer
+    std::atomic<uint64_t> _next_id{0};
+    std::unordered_map<uint64_t, pending_prepare> _pending;
+    // <deadline_ms, id> of the pending prepares, so that only the expired ones are visited
+    std::set<std::pair<uint64_t, uint64_t>> _deadlines;
+    task_ptr _timeout_timer;
+
+    dsn::task_tracker _tracker;
+};
+
+} // namespace replication
+} // namespace dsn
@@ -35,6 +35,7 @@
 #include <dsn/cpp/json_helper.h>
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
+#include <dsn/utility/flags.h>
 #include <dsn/utility/rand.h>
 #include <dsn/utility/string_conv.h>
 #include <dsn/utility/strings.h>
@@ -43,6 +44,18 @@
 namespace dsn {
 namespace replication {
 
+DSN_DEFINE_uint32("replication",
+                  primary_read_lease_ms,
+                  0,
+                  "the primary serves consistent reads only within the lease renewed by each "
+                  "round of group check acknowledged by all the secondaries, it should be larger "
+                  "than group_check_interval_ms. 0 means the lease is not required");
+DSN_DEFINE_uint32("replication",
+                  secondary_read_max_staleness_ms,
+                  0,
+                  "a secondary serves stale reads only if it has caught up with the last committed "
+                  "decree the primary told it within this period. 0 means no staleness bound");
+
 replica::replica(
     replica_stub *stub, gpid gpid, const app_info &app, const char *dir, bool need_restore)
     : serverlet<replica>("replica"),
@@ -76,6 +89,11 @@ replica::replica(
     _counter_private_log_size.init_app_counter(
         "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
 
+    counter_str = fmt::format("2pc.depth@{}", gpid);
+    _counter_2pc_depth.init_app_counter(
+        "eon.replica", counter_str.c_str(), COUNTER_TYPE_NUMBER, counter_str.c_str());
+    _counter_2pc_depth->set(_primary_states.write_queue.max_concurrent_op());
+
     counter_str = fmt::format("recent.write.throttling.delay.count@{}", gpid);
     _counter_recent_write_throttling_delay_count.init_app_counter(
         "eon.replica", counter_str.c_str(), COUNTER_TYPE_VOLATILE_NUMBER, counter_str.c_str());
@@ -170,16 +188,19 @@ void replica::on_client_read(dsn::message_ex *request)
             return;
         }
 
-        // a small window where the state is not the latest yet
-        if (last_committed_decree() < _primary_states.last_prepare_decree_on_new_primary) {
-            derror_replica("last_committed_decree(%" PRId64
-                           ") < last_prepare_decree_on_new_primary(%" PRId64 ")",
-                           last_committed_decree(),
-                           _primary_states.last_prepare_decree_on_new_primary);
-            response_client_read(request, ERR_INVALID_STATE);
+        error_code err = check_primary_read();
+        if (err != ERR_OK) {
+            response_client_read(request, err);
             return;
         }
     } else {
+        if (status() == partition_status::PS_SECONDARY) {
+            error_code err = check_secondary_read();
+            if (err != ERR_OK) {
+                response_client_read(request, err);
+                return;
+            }
+        }
         _counter_backup_request_qps->increment();
     }
 
@@ -194,6 +215,41 @@ void replica::on_client_read(dsn::message_ex *request)
     }
 }
 
+error_code replica::check_primary_read() const
+{
+    // a small window where the state is not the latest yet
+    if (last_committed_decree() < _primary_states.last_prepare_decree_on_new_primary) {
+        derror_replica("last_committed_decree(%" PRId64
+                       ") < last_prepare_decree_on_new_primary(%" PRId64 ")",
+                       last_committed_decree(),
+                       _primary_states.last_prepare_decree_on_new_primary);
+        return ERR_INVALID_STATE;
+    }
+
+    // a new primary may have been elected after the lease expires
+    if (FLAGS_primary_read_lease_ms > 0 &&
+        dsn_now_ms() >= _primary_states.read_lease_expire_ms) {
+        return ERR_INVALID_STATE;
+    }
+    return ERR_OK;
+}
+
+error_code replica::check_secondary_read() const
+{
+    if (FLAGS_secondary_read_max_staleness_ms == 0) {
+        return ERR_OK;
+    }
+
+    const auto &states = _secondary_states;
+    if (states.primary_committed_decree == invalid_decree ||
+        last_committed_decree() < states.primary_committed_decree ||
+        dsn_now_ms() >
+            states.primary_committed_decree_ts_ms + FLAGS_secondary_read_max_staleness_ms) {
+        return ERR_INVALID_STATE;
+    }
+    return ERR_OK;
+}
+
 void replica::response_client_read(dsn::message_ex *request, error_code error)
 {
     _stub->response_client(get_gpid(), true, request, status(), error);
@@ -409,6 +465,7 @@ void replica::close()
     }
 
     _counter_private_log_size.clear();
+    _counter_2pc_depth.clear();
 
     // duplication_impl may have ongoing tasks.
     // release it before release replica.
@@ -304,6 +304,17 @@ private:
     void on_group_check_reply(error_code err,
                               const std::shared_ptr<group_check_request> &req,
                               const std::shared_ptr<group_check_response> &resp);
+    // Extends the read lease of primary when all the secondaries have acknowledged the
+    // current round of group check.
+    void renew_primary_read_lease();
+    // Records the last committed decree of the primary received by secondary.
+    void update_primary_committed_decree(decree primary_committed_decree);
+
+    // Returns ERR_OK if the consistent reads can be served by this primary.
+    error_code check_primary_read() const;
+    // Returns ERR_OK if the stale reads can be served by this secondary within the bound
+    // of staleness.
+    error_code check_secondary_read() const;
 
     /////////////////////////////////////////////////////////////////
     // check timer for gc, checkpointing etc.
@@ -550,6 +561,8 @@ private:
 
     // perf counters
     perf_counter_wrapper _counter_private_log_size;
+    // the max count of mutations in 2pc, see mutation_queue::on_2pc_round_completed
+    perf_counter_wrapper _counter_2pc_depth;
     perf_counter_wrapper _counter_recent_write_throttling_delay_count;
     perf_counter_wrapper _counter_recent_write_throttling_reject_count;
     std::vector<perf_counter *> _counters_table_level_latency;
@@ -28,6 +28,7 @@
 #include "mutation.h"
 #include "mutation_log.h"
 #include "replica_stub.h"
+#include "prepare_coalescer.h"
 #include <dsn/dist/replication/replication_app_base.h>
 #include <dsn/dist/fmt_logging.h>
 
@@ -238,14 +239,15 @@ void replica::send_prepare_message(::dsn::rpc_address addr,
         mu->write_to(writer, msg);
     }
 
-    mu->remote_tasks()[addr] =
-        rpc::call(addr,
-                  msg,
-                  &_tracker,
-                  [=](error_code err, dsn::message_ex *request, dsn::message_ex *reply) {
-                      on_prepare_reply(std::make_pair(mu, rconfig.status), err, request, reply);
-                  },
-                  get_gpid().thread_hash());
+    mu->remote_tasks()[addr] = _stub->_prepare_coalescer->call(
+        addr,
+        get_gpid(),
+        msg,
+        &_tracker,
+        [=](error_code err, dsn::message_ex *request, dsn::message_ex *reply) {
+            on_prepare_reply(std::make_pair(mu, rconfig.status), err, request, reply);
+        },
+        get_gpid().thread_hash());
 
     dinfo("%s: mutation %s send_prepare_message to %s as %s",
           name(),
@@ -265,6 +267,12 @@ void replica::do_possible_commit_on_primary(mutation_ptr &mu)
             enum_to_string(status()));
 
     if (mu->is_ready_for_commit()) {
+        // the reconciliation on the new primary doesn't tell the latency of 2pc
+        if (mu->data.header.decree > _primary_states.last_prepare_decree_on_new_primary) {
+            int depth = _primary_states.write_queue.on_2pc_round_completed(
+                (dsn_now_ns() - mu->prepare_ts_ns()) / 1000);
+            _counter_2pc_depth->set(depth);
+        }
         _prepare_list->commit(mu->data.header.decree, COMMIT_ALL_READY);
     }
 }
@@ -365,6 +373,9 @@ void replica::on_prepare(dsn::message_ex *request)
             "invalid status, %s VS %s",
             enum_to_string(rconfig.status),
             enum_to_string(status()));
+    if (partition_status::PS_SECONDARY == status()) {
+        update_primary_committed_decree(mu->data.header.last_committed_decree);
+    }
     if (decree <= last_committed_decree()) {
         ack_prepare_message(ERR_OK, mu);
         return;
@@ -654,7 +665,7 @@ void replica::ack_prepare_message(error_code err, mutation_ptr &mu)
     const std::vector<dsn::message_ex *> &prepare_requests = mu->prepare_requests();
     dassert(!prepare_requests.empty(), "mutation = %s", mu->name());
     for (auto &request : prepare_requests) {
-        reply(request, resp);
+        _stub->reply_prepare(request, resp);
     }
 
     if (err == ERR_OK) {
@@ -42,10 +42,13 @@
 
 #include <dsn/dist/fmt_logging.h>
 #include <dsn/dist/replication/replication_app_base.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(primary_read_lease_ms);
+
 void replica::init_group_check()
 {
     _checker.only_one_thread_access();
@@ -83,6 +86,8 @@ void replica::broadcast_group_check()
         }
         _primary_states.group_check_pending_replies.clear();
     }
+    _primary_states.group_check_round_start_ms = dsn_now_ms();
+    _primary_states.group_check_round_failed = false;
 
     for (auto it = _primary_states.statuses.begin(); it != _primary_states.statuses.end(); ++it) {
         if (it->first == _stub->_primary_address)
@@ -123,6 +128,10 @@ void replica::broadcast_group_check()
 
         _primary_states.group_check_pending_replies[addr] = callback_task;
     }
+    if (_primary_states.group_check_pending_replies.empty()) {
+        // no secondary
+        renew_primary_read_lease();
+    }
 
     // send empty prepare when necessary
     if (!_options->empty_write_disabled &&
@@ -170,6 +179,7 @@ void replica::on_group_check(const group_check_request &request,
         if (request.last_committed_decree > last_committed_decree()) {
             _prepare_list->commit(request.last_committed_decree, COMMIT_TO_DECREE_HARD);
         }
+        update_primary_committed_decree(request.last_committed_decree);
         break;
     case partition_status::PS_POTENTIAL_SECONDARY:
         init_learn(request.config.learner_signature);
@@ -207,6 +217,13 @@ void replica::on_group_check_reply(error_code err,
     auto r = _primary_states.group_check_pending_replies.erase(req->node);
     dassert(r == 1, "invalid node address, address = %s", req->node.to_string());
 
+    if (err != ERR_OK || resp->err != ERR_OK) {
+        // learners are not taken into account for the read lease
+        if (req->config.status == partition_status::PS_SECONDARY) {
+            _primary_states.group_check_round_failed = true;
+        }
+    }
+
     if (err != ERR_OK) {
         handle_remote_failure(req->config.status, req->node, err, "group check");
     } else {
@@ -219,6 +236,29 @@ void replica::on_group_check_reply(error_code err,
             handle_remote_failure(req->config.status, req->node, resp->err, "group check");
         }
     }
+
+    if (partition_status::PS_PRIMARY == status() &&
+        _primary_states.group_check_pending_replies.empty() &&
+        !_primary_states.group_check_round_failed) {
+        renew_primary_read_lease();
+    }
+}
+
+void replica::renew_primary_read_lease()
+{
+    // The lease starts from when this round is sent. It's also bounded by the lease from
+    // the meta server, after which another primary may be elected without knowing this one.
+    uint64_t lease_expire_ms =
+        std::min(_primary_states.group_check_round_start_ms + FLAGS_primary_read_lease_ms,
+                 _stub->get_meta_lease_expire_ms());
+    _primary_states.read_lease_expire_ms =
+        std::max(_primary_states.read_lease_expire_ms, lease_expire_ms);
+}
+
+void replica::update_primary_committed_decree(decree primary_committed_decree)
+{
+    _secondary_states.primary_committed_decree = primary_committed_decree;
+    _secondary_states.primary_committed_decree_ts_ms = dsn_now_ms();
 }
 
 void replica::inject_error(error_code err)
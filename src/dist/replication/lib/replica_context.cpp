@@ -60,6 +60,7 @@ void primary_context::cleanup(bool clean_pending_mutations)
     }
 
     group_check_pending_replies.clear();
+    read_lease_expire_ms = 0;
 
     // clean up reconfiguration
     CLEANUP_TASK_ALWAYS(reconfiguration_task)
@@ -176,6 +177,8 @@ bool secondary_context::cleanup(bool force)
     CLEANUP_TASK(catchup_with_private_log_task, force)
 
     checkpoint_is_running = false;
+    primary_committed_decree = invalid_decree;
+    primary_committed_decree_ts_ms = 0;
     return true;
 }
 
@@ -129,6 +129,12 @@ public:
 
     uint64_t last_prepare_ts_ms;
 
+    // read lease, which is renewed when a round of group check is acknowledged by all the
+    // secondaries, see replica::renew_primary_read_lease().
+    uint64_t group_check_round_start_ms{0};
+    bool group_check_round_failed{false};
+    uint64_t read_lease_expire_ms{0};
+
     // Used for partition split
     // child addresses who has been caught up with its parent
     std::unordered_set<dsn::rpc_address> caught_up_children;
@@ -168,6 +174,11 @@ public:
     ::dsn::task_ptr checkpoint_task;
     ::dsn::task_ptr checkpoint_completed_task;
     ::dsn::task_ptr catchup_with_private_log_task;
+
+    // the last committed decree of the primary known by this secondary, which is carried by
+    // prepare and group check, and the time it's received.
+    decree primary_committed_decree{invalid_decree};
+    uint64_t primary_committed_decree_ts_ms{0};
 };
 
 class potential_secondary_context
@@ -39,6 +39,7 @@
 #include "mutation.h"
 #include "bulk_load/replica_bulk_loader.h"
 #include "duplication/duplication_sync_timer.h"
+#include "prepare_coalescer.h"
 #include "dist/replication/lib/backup/replica_backup_manager.h"
 
 #include <dsn/cpp/json_helper.h>
@@ -49,6 +50,7 @@
 #include <dsn/dist/replication/replication_app_base.h>
 #include <vector>
 #include <deque>
+#include <limits>
 #include <dsn/dist/fmt_logging.h>
 #ifdef DSN_ENABLE_GPERF
 #include <gperftools/malloc_extension.h>
@@ -95,6 +97,7 @@ replica_stub::replica_stub(replica_state_subscriber subscriber /*= nullptr*/,
     _state = NS_Disconnected;
     _log = nullptr;
     _primary_address_str[0] = '\0';
+    _prepare_coalescer = dsn::make_unique<prepare_coalescer>(this);
     install_perf_counters();
 
     _max_allowed_write_size = dsn_config_get_value_uint64("replication",
@@ -640,6 +643,7 @@ void replica_stub::initialize(const replication_options &opts, bool clear /* = f
 
     // attach rps
     _replicas = std::move(rps);
+    publish_replicas();
     _counter_replicas_count->add((uint64_t)_replicas.size());
     for (const auto &kv : _replicas) {
         _fs_manager.add_replica(kv.first, kv.second->dir());
@@ -751,12 +755,18 @@ dsn::error_code replica_stub::on_kill_replica(gpid id)
 
 replica_ptr replica_stub::get_replica(gpid id)
 {
-    zauto_read_lock l(_replicas_lock);
-    auto it = _replicas.find(id);
-    if (it != _replicas.end())
-        return it->second;
-    else
-        return nullptr;
+    return _replicas_snapshot.read([id](const replicas &rs) -> replica_ptr {
+        auto it = rs.find(id);
+        if (it != rs.end())
+            return it->second;
+        else
+            return nullptr;
+    });
+}
+
+void replica_stub::publish_replicas()
+{
+    _replicas_snapshot.publish(std::make_shared<const replicas>(_replicas));
 }
 
 replica_stub::replica_life_cycle replica_stub::get_replica_life_cycle(gpid id)
@@ -1043,6 +1053,25 @@ void replica_stub::on_prepare(dsn::message_ex *request)
         prepare_ack resp;
         resp.pid = id;
         resp.err = ERR_OBJECT_NOT_FOUND;
+        reply_prepare(request, resp);
+    }
+}
+
+void replica_stub::on_prepare_batch(dsn::message_ex *batch)
+{
+    _prepare_coalescer->on_prepare_batch(batch);
+}
+
+void replica_stub::on_prepare_ack_batch(dsn::message_ex *batch)
+{
+    _prepare_coalescer->on_prepare_ack_batch(batch);
+}
+
+void replica_stub::reply_prepare(dsn::message_ex *request, const prepare_ack &resp)
+{
+    if (prepare_coalescer::is_coalesced(request)) {
+        _prepare_coalescer->reply(request, resp);
+    } else {
         reply(request, resp);
     }
 }
@@ -1336,6 +1365,15 @@ void replica_stub::on_node_query_reply(error_code err,
     }
 }
 
+uint64_t replica_stub::get_meta_lease_expire_ms() const
+{
+    if (_failure_detector == nullptr) {
+        // failure detection is disabled
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return _failure_detector->get_master_lease_expire_ms();
+}
+
 void replica_stub::set_meta_server_connected_for_test(
     const configuration_query_by_node_response &resp)
 {
@@ -1828,6 +1866,7 @@ void replica_stub::on_disk_stat()
             _counter_replicas_closing_count->decrement();
 
             _replicas.emplace(id, rep);
+            publish_replicas();
             _counter_replicas_count->increment();
 
             _closed_replicas.erase(id);
@@ -1927,6 +1966,7 @@ void replica_stub::open_replica(const app_info &app,
         auto it = _replicas.find(id);
         dassert(it == _replicas.end(), "replica %s is already in _replicas", id.to_string());
         _replicas.insert(replicas::value_type(rep->get_gpid(), rep));
+        publish_replicas();
         _counter_replicas_count->increment();
 
         _closed_replicas.erase(id);
@@ -1954,6 +1994,7 @@ void replica_stub::open_replica(const app_info &app,
     zauto_write_lock l(_replicas_lock);
 
     if (_replicas.erase(id) > 0) {
+        publish_replicas();
         _counter_replicas_count->decrement();
 
         int delay_ms = 0;
@@ -2036,6 +2077,9 @@ void replica_stub::open_service()
     register_rpc_handler(RPC_CONFIG_PROPOSAL, "ProposeConfig", &replica_stub::on_config_proposal);
 
     register_rpc_handler(RPC_PREPARE, "prepare", &replica_stub::on_prepare);
+    register_rpc_handler(RPC_PREPARE_BATCH, "prepare_batch", &replica_stub::on_prepare_batch);
+    register_rpc_handler(
+        RPC_PREPARE_ACK_BATCH, "prepare_ack_batch", &replica_stub::on_prepare_ack_batch);
     register_rpc_handler(RPC_LEARN, "Learn", &replica_stub::on_learn);
     register_rpc_handler(RPC_LEARN_COMPLETION_NOTIFY,
                          "LearnNotify",
@@ -2344,6 +2388,7 @@ replica_stub::exec_command_on_replica(const std::vector<std::string> &args,
 void replica_stub::close()
 {
     _tracker.cancel_outstanding_tasks();
+    _prepare_coalescer->close();
 
     // this replica may not be opened
     // or is already closed by calling tool_app::stop_all_apps()
@@ -2447,6 +2492,7 @@ void replica_stub::close()
             _counter_replicas_count->decrement();
             _replicas.erase(_replicas.begin());
         }
+        publish_replicas();
     }
 
     if (_failure_detector != nullptr) {
@@ -2585,6 +2631,7 @@ replica_ptr replica_stub::create_child_replica_if_not_found(gpid child_pid,
                             replica *rep = new replica(this, child_pid, *app, "./", false);
                             rep->_config.status = partition_status::PS_INACTIVE;
                             _replicas.insert(replicas::value_type(child_pid, rep));
+                            publish_replicas();
                             ddebug_f("mock create_child_replica_if_not_found succeed");
                             return rep;
                         });
@@ -2605,6 +2652,7 @@ replica_ptr replica_stub::create_child_replica_if_not_found(gpid child_pid,
             if (rep != nullptr) {
                 auto pr = _replicas.insert(replicas::value_type(child_pid, rep));
                 dassert_f(pr.second, "child replica {} has been existed", rep->name());
+                publish_replicas();
                 _counter_replicas_count->increment();
                 _closed_replicas.erase(child_pid);
             }
@@ -37,6 +37,7 @@
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 #include <dsn/dist/failure_detector_multimaster.h>
 #include <dsn/dist/nfs_node.h>
+#include <dsn/utility/rcu_snapshot.h>
 
 #include "dist/replication/common/replication_common.h"
 #include "dist/replication/common/fs_manager.h"
@@ -63,6 +64,7 @@ typedef dsn::ref_ptr<replica_stub> replica_stub_ptr;
 
 class duplication_sync_timer;
 class replica_bulk_loader;
+class prepare_coalescer;
 class replica_stub : public serverlet<replica_stub>, public ref_counter
 {
 public:
@@ -111,6 +113,8 @@ public:
     //        - bulk_load
     //
     void on_prepare(dsn::message_ex *request);
+    void on_prepare_batch(dsn::message_ex *batch);
+    void on_prepare_ack_batch(dsn::message_ex *batch);
     void on_learn(dsn::message_ex *msg);
     void on_learn_completion_notification(const group_check_response &report,
                                           /*out*/ learn_notify_response &response);
@@ -151,6 +155,9 @@ public:
     replica_ptr get_replica(gpid id);
     replication_options &options() { return _options; }
     bool is_connected() const { return NS_Connected == _state; }
+    // The time (in milliseconds) until which this node is regarded as alive by the meta server,
+    // which bounds how long a primary on this node is allowed to serve reads locally.
+    uint64_t get_meta_lease_expire_ms() const;
     virtual rpc_address get_meta_server_address() const { return _failure_detector->get_servers(); }
     rpc_address primary_address() const { return _primary_address; }
 
@@ -254,6 +261,12 @@ private:
                          partition_status::type status,
                          error_code error);
     void update_disk_holding_replicas();
+    // acks the prepare request, in batch if the request is split from a batch
+    void reply_prepare(dsn::message_ex *request, const prepare_ack &resp);
+
+    // publishes a copy of _replicas for get_replica, must be called with _replicas_lock
+    // write-locked after _replicas is changed
+    void publish_replicas();
 
     int get_app_id_from_replicas(std::string app_name)
     {
@@ -298,6 +311,8 @@ private:
 
     mutable zrwlock_nr _replicas_lock;
     replicas _replicas;
+    // immutable copy of _replicas, which is looked up by get_replica without _replicas_lock
+    utils::rcu_snapshot<replicas> _replicas_snapshot;
     opening_replicas _opening_replicas;
     closing_replicas _closing_replicas;
     closed_replicas _closed_replicas;
@@ -323,6 +338,7 @@ private:
     ::dsn::task_ptr _mem_release_timer_task;
 
     std::unique_ptr<duplication_sync_timer> _duplication_sync_timer;
+    std::unique_ptr<prepare_coalescer> _prepare_coalescer;
 
     // command_handlers
     dsn_handle_t _kill_partition_command;
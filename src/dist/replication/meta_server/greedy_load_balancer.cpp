@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <queue>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/utility/math.h>
@@ -35,21 +36,120 @@
 namespace dsn {
 namespace replication {
 
+namespace {
+
+// min-cost flow based on successive shortest paths. as the costs of all the arcs are
+// non-negative, dijkstra on the reduced costs is used to find the paths.
+class min_cost_flow
+{
+public:
+    explicit min_cost_flow(int vertices) : _out_arcs(vertices) {}
+
+    // return the id of the arc
+    int add_arc(int from, int to, int capacity, int64_t cost)
+    {
+        _out_arcs[from].push_back(_arcs.size());
+        _arcs.push_back({to, capacity, cost});
+        _out_arcs[to].push_back(_arcs.size());
+        _arcs.push_back({from, 0, -cost});
+        return _arcs.size() - 2;
+    }
+
+    // augment along the cheapest paths from source to sink until the cost of a unit of flow
+    // reaches max_path_cost, return the total flow
+    int run(int source, int sink, int64_t max_path_cost)
+    {
+        typedef std::pair<int64_t, int> dist_vertex;
+        const int64_t unreachable = std::numeric_limits<int64_t>::max();
+        int vertices = _out_arcs.size();
+        std::vector<int64_t> potential(vertices, 0);
+        std::vector<int64_t> dist(vertices);
+        std::vector<int> prev_arc(vertices);
+
+        int total_flow = 0;
+        while (true) {
+            std::fill(dist.begin(), dist.end(), unreachable);
+            std::fill(prev_arc.begin(), prev_arc.end(), -1);
+            std::priority_queue<dist_vertex, std::vector<dist_vertex>, std::greater<dist_vertex>>
+                q;
+            dist[source] = 0;
+            q.emplace(0, source);
+            while (!q.empty()) {
+                dist_vertex top = q.top();
+                q.pop();
+                int u = top.second;
+                if (top.first > dist[u])
+                    continue;
+                for (int id : _out_arcs[u]) {
+                    const arc &a = _arcs[id];
+                    if (a.capacity <= 0)
+                        continue;
+                    int64_t d = dist[u] + a.cost + potential[u] - potential[a.to];
+                    if (d < dist[a.to]) {
+                        dist[a.to] = d;
+                        prev_arc[a.to] = id;
+                        q.emplace(d, a.to);
+                    }
+                }
+            }
+            if (dist[sink] == unreachable)
+                break;
+
+            for (int v = 0; v < vertices; ++v) {
+                if (dist[v] != unreachable)
+                    potential[v] += dist[v];
+            }
+            // potential of the source is always 0, so this is the real cost of the path
+            if (potential[sink] >= max_path_cost)
+                break;
+
+            int bottleneck = std::numeric_limits<int>::max();
+            for (int v = sink; v != source; v = _arcs[prev_arc[v] ^ 1].to)
+                bottleneck = std::min(bottleneck, _arcs[prev_arc[v]].capacity);
+            for (int v = sink; v != source; v = _arcs[prev_arc[v] ^ 1].to) {
+                _arcs[prev_arc[v]].capacity -= bottleneck;
+                _arcs[prev_arc[v] ^ 1].capacity += bottleneck;
+            }
+            total_flow += bottleneck;
+        }
+        return total_flow;
+    }
+
+    int flow(int arc_id) const { return _arcs[arc_id ^ 1].capacity; }
+
+private:
+    struct arc
+    {
+        int to;
+        int capacity;
+        int64_t cost;
+    };
+    // the reverse arc of arc i is arc i^1
+    std::vector<arc> _arcs;
+    std::vector<std::vector<int>> _out_arcs;
+};
+
+} // anonymous namespace
+
 greedy_load_balancer::greedy_load_balancer(meta_service *_svc)
     : simple_load_balancer(_svc),
       _ctrl_balancer_in_turn(nullptr),
       _ctrl_only_primary_balancer(nullptr),
       _ctrl_only_move_primary(nullptr),
+      _ctrl_primary_balancer_globally(nullptr),
       _get_balance_operation_count(nullptr)
 {
     if (_svc != nullptr) {
         _balancer_in_turn = _svc->get_meta_options()._lb_opts.balancer_in_turn;
         _only_primary_balancer = _svc->get_meta_options()._lb_opts.only_primary_balancer;
         _only_move_primary = _svc->get_meta_options()._lb_opts.only_move_primary;
+        _primary_balancer_globally =
+            _svc->get_meta_options()._lb_opts.primary_balancer_globally;
     } else {
         _balancer_in_turn = false;
         _only_primary_balancer = false;
         _only_move_primary = false;
+        _primary_balancer_globally = false;
     }
 
     ::memset(t_operation_counters, 0, sizeof(t_operation_counters));
@@ -81,6 +181,7 @@ greedy_load_balancer::~greedy_load_balancer()
     UNREGISTER_VALID_HANDLER(_ctrl_balancer_in_turn);
     UNREGISTER_VALID_HANDLER(_ctrl_only_primary_balancer);
     UNREGISTER_VALID_HANDLER(_ctrl_only_move_primary);
+    UNREGISTER_VALID_HANDLER(_ctrl_primary_balancer_globally);
     UNREGISTER_VALID_HANDLER(_get_balance_operation_count);
 }
 
@@ -114,6 +215,15 @@ void greedy_load_balancer::register_ctrl_commands()
             return remote_command_set_bool_flag(_only_move_primary, "lb.only_move_primary", args);
         });
 
+    _ctrl_primary_balancer_globally = dsn::command_manager::instance().register_app_command(
+        {"lb.primary_balancer_globally"},
+        "lb.primary_balancer_globally <true|false>",
+        "control whether balance the total primaries of all apps on each node",
+        [this](const std::vector<std::string> &args) {
+            return remote_command_set_bool_flag(
+                _primary_balancer_globally, "lb.primary_balancer_globally", args);
+        });
+
     _get_balance_operation_count = dsn::command_manager::instance().register_app_command(
         {"lb.get_balance_operation_count"},
         "lb.get_balance_operation_count [total | move_pri | copy_pri | copy_sec | detail]",
@@ -126,6 +236,7 @@ void greedy_load_balancer::unregister_ctrl_commands()
     UNREGISTER_VALID_HANDLER(_ctrl_balancer_in_turn);
     UNREGISTER_VALID_HANDLER(_ctrl_only_primary_balancer);
     UNREGISTER_VALID_HANDLER(_ctrl_only_move_primary);
+    UNREGISTER_VALID_HANDLER(_ctrl_primary_balancer_globally);
     UNREGISTER_VALID_HANDLER(_get_balance_operation_count);
 
     simple_load_balancer::unregister_ctrl_commands();
@@ -787,6 +898,229 @@ bool greedy_load_balancer::primary_balancer_per_app(const std::shared_ptr<app_st
     return move_primary_based_on_flow_per_app(app, prev, flow);
 }
 
+// the network is made of the source, the servers and the sink:
+//   - source -> server: the primaries a server has more than the average
+//   - server -> sink: the primaries a server has less than the average
+//   - server -> server: the primaries which can be moved to the other server
+// the capacities of the first two are split into a mandatory part with cost 0 and an optional
+// part with a much higher cost, so that a server is filled up to the ceil of the average only
+// when the others can't get to the floor of it.
+void greedy_load_balancer::primary_balancer_globally()
+{
+    const app_mapper &apps = *(t_global_view->apps);
+    const node_mapper &nodes = *(t_global_view->nodes);
+    int graph_nodes = t_alive_nodes + 2;
+    int sink = graph_nodes - 1;
+
+    // future primaries of each app on each server
+    std::map<app_id, std::vector<int>> app_primaries;
+    std::vector<int> total_primaries(graph_nodes, 0);
+    std::vector<std::vector<gpid>> primaries_on(graph_nodes);
+    std::vector<disk_load> node_loads(graph_nodes);
+    int total = 0;
+    for (const auto &kv : apps) {
+        const std::shared_ptr<app_state> &app = kv.second;
+        if (app->status != app_status::AS_AVAILABLE)
+            continue;
+
+        std::vector<int> &primaries = app_primaries[app->app_id];
+        primaries.assign(graph_nodes, 0);
+        for (const auto &pair : nodes) {
+            int id = address_id[pair.first];
+            pair.second.for_each_primary(app->app_id, [&, this](const gpid &pid) {
+                primaries_on[id].push_back(pid);
+                node_loads[id][get_disk_tag(pair.first, pid)]++;
+                return true;
+            });
+            primaries[id] = pair.second.primary_count(app->app_id);
+            total_primaries[id] += primaries[id];
+            total += primaries[id];
+        }
+    }
+
+    int replicas_low = total / t_alive_nodes;
+    int replicas_high = (total + t_alive_nodes - 1) / t_alive_nodes;
+    bool balanced = true;
+    for (int id = 1; id <= t_alive_nodes; ++id) {
+        if (total_primaries[id] < replicas_low || total_primaries[id] > replicas_high) {
+            balanced = false;
+            break;
+        }
+    }
+    if (balanced) {
+        dinfo("the total primaries are balanced, low(%d), high(%d)", replicas_low, replicas_high);
+        return;
+    }
+    ddebug("start to balance the total primaries(%d) of all apps, low(%d), high(%d)",
+           total,
+           replicas_low,
+           replicas_high);
+
+    // the servers on a path cost at most 2 * (t_alive_nodes - 1) in total, so it costs
+    // [optional_cost, 2 * optional_cost) if one of the optional parts is used, and it's useless
+    // to use both of them
+    const int64_t optional_cost = 2 * graph_nodes;
+    min_cost_flow network(graph_nodes);
+    std::vector<std::vector<int>> source_arcs(graph_nodes), sink_arcs(graph_nodes);
+    auto add_arc = [&network](std::vector<int> &arcs, int from, int to, int cap, int64_t cost) {
+        if (cap > 0)
+            arcs.push_back(network.add_arc(from, to, cap, cost));
+    };
+    for (int id = 1; id <= t_alive_nodes; ++id) {
+        int c = total_primaries[id];
+        add_arc(source_arcs[id], 0, id, c - replicas_high, 0);
+        add_arc(source_arcs[id], 0, id, std::min(c, replicas_high) - replicas_low, optional_cost);
+        add_arc(sink_arcs[id], id, sink, replicas_low - c, 0);
+        add_arc(sink_arcs[id], id, sink, replicas_high - std::max(c, replicas_low), optional_cost);
+    }
+
+    // a primary can only be moved to a server with fewer primaries of the same app, and it
+    // costs less if the app becomes more balanced
+    std::vector<std::map<int, std::pair<int, int>>> movable(graph_nodes);
+    for (int id = 1; id <= t_alive_nodes; ++id) {
+        for (const gpid &pid : primaries_on[id]) {
+            if (t_migration_result->find(pid) != t_migration_result->end())
+                continue;
+            const std::vector<int> &primaries = app_primaries[pid.get_app_id()];
+            const partition_configuration &pc = *get_config(apps, pid);
+            for (const rpc_address &target : pc.secondaries) {
+                auto i = address_id.find(target);
+                if (i == address_id.end())
+                    continue;
+                int diff = primaries[id] - primaries[i->second];
+                if (diff >= 2)
+                    movable[id][i->second].first++;
+                else if (diff == 1)
+                    movable[id][i->second].second++;
+            }
+        }
+    }
+    std::vector<std::vector<std::pair<int, int>>> server_arcs(graph_nodes);
+    for (int id = 1; id <= t_alive_nodes; ++id) {
+        for (const auto &kv : movable[id]) {
+            if (kv.second.first > 0)
+                server_arcs[id].emplace_back(
+                    kv.first, network.add_arc(id, kv.first, kv.second.first, 1));
+            if (kv.second.second > 0)
+                server_arcs[id].emplace_back(
+                    kv.first, network.add_arc(id, kv.first, kv.second.second, 2));
+        }
+    }
+
+    int planned = network.run(0, sink, 2 * optional_cost);
+    if (planned == 0) {
+        ddebug("can't make the total primaries more balanced by moving primaries");
+        return;
+    }
+
+    // the flow of each arc
+    std::vector<int> source_flow(graph_nodes, 0), sink_flow(graph_nodes, 0);
+    std::vector<std::map<int, int>> server_flow(graph_nodes);
+    for (int id = 1; id <= t_alive_nodes; ++id) {
+        for (int arc_id : source_arcs[id])
+            source_flow[id] += network.flow(arc_id);
+        for (int arc_id : sink_arcs[id])
+            sink_flow[id] += network.flow(arc_id);
+        for (const auto &kv : server_arcs[id]) {
+            int f = network.flow(kv.second);
+            if (f > 0)
+                server_flow[id][kv.first] += f;
+        }
+    }
+
+    // select a primary on from which can be moved to to, the one that makes the app more
+    // balanced is preferred, and then the one on the disk with more primaries
+    typedef std::pair<int, int> move_score;
+    std::vector<gpid> moving;
+    auto select_primary = [&, this](int from, int to, /*out*/ gpid &selected) {
+        bool found = false;
+        move_score selected_score;
+        for (const gpid &pid : primaries_on[from]) {
+            if (t_migration_result->find(pid) != t_migration_result->end() ||
+                std::find(moving.begin(), moving.end(), pid) != moving.end())
+                continue;
+            const std::vector<int> &primaries = app_primaries[pid.get_app_id()];
+            int diff = primaries[from] - primaries[to];
+            if (diff < 1)
+                continue;
+            const partition_configuration &pc = *get_config(apps, pid);
+            if (!is_secondary(pc, address_vec[to]))
+                continue;
+
+            move_score score(std::min(diff, 2),
+                             node_loads[from][get_disk_tag(address_vec[from], pid)] -
+                                 node_loads[to][get_disk_tag(address_vec[to], pid)]);
+            if (!found || score > selected_score) {
+                found = true;
+                selected_score = score;
+                selected = pid;
+            }
+        }
+        return found;
+    };
+    auto apply_move = [&, this](const gpid &pid, int from, int to, int delta) {
+        std::vector<int> &primaries = app_primaries[pid.get_app_id()];
+        primaries[from] -= delta;
+        primaries[to] += delta;
+        node_loads[from][get_disk_tag(address_vec[from], pid)] -= delta;
+        node_loads[to][get_disk_tag(address_vec[to], pid)] += delta;
+    };
+
+    // decompose the flow into paths, and move a primary on each hop of a path or none of them,
+    // so the total primaries only change on both ends of the path
+    int moved_paths = 0;
+    for (int start = 1; start <= t_alive_nodes; ++start) {
+        while (source_flow[start] > 0) {
+            --source_flow[start];
+            std::vector<int> path(1, start);
+            int current = start;
+            while (sink_flow[current] == 0 && path.size() <= t_alive_nodes) {
+                int from = current;
+                auto next = server_flow[from].begin();
+                dassert(next != server_flow[from].end(),
+                        "flow of %s isn't conserved",
+                        address_vec[from].to_string());
+                current = next->first;
+                if (--next->second == 0)
+                    server_flow[from].erase(next);
+                path.push_back(current);
+            }
+            dassert(sink_flow[current] > 0, "there is a cycle in the flow");
+            --sink_flow[current];
+
+            moving.clear();
+            for (int i = 0; i + 1 < path.size(); ++i) {
+                gpid pid;
+                if (!select_primary(path[i], path[i + 1], pid))
+                    break;
+                moving.push_back(pid);
+                apply_move(pid, path[i], path[i + 1], 1);
+            }
+            if (moving.size() + 1 != path.size()) {
+                dinfo("can't find primaries to move from %s to %s, skip this path",
+                      address_vec[path.front()].to_string(),
+                      address_vec[path.back()].to_string());
+                for (int i = 0; i < moving.size(); ++i)
+                    apply_move(moving[i], path[i], path[i + 1], -1);
+                continue;
+            }
+
+            for (int i = 0; i < moving.size(); ++i) {
+                const gpid &pid = moving[i];
+                t_migration_result->emplace(
+                    pid,
+                    generate_balancer_request(*get_config(apps, pid),
+                                              balance_type::move_primary,
+                                              address_vec[path[i]],
+                                              address_vec[path[i + 1]]));
+            }
+            ++moved_paths;
+        }
+    }
+
+    ddebug("%d of the %d planned primaries are moved", moved_paths, planned);
+}
+
 bool greedy_load_balancer::all_replica_infos_collected(const node_state &ns)
 {
     dsn::rpc_address n = ns.addr();
@@ -840,9 +1174,9 @@ void greedy_load_balancer::greedy_balancer(const bool balance_checker)
         }
     }
 
-    // TODO: do primary_balancer_globally when we find a good approach to
-    // make decision according to disk load.
-    // primary_balancer_globally();
+    if (_primary_balancer_globally && t_migration_result->empty()) {
+        primary_balancer_globally();
+    }
 
     if (!balance_checker) {
         if (!t_migration_result->empty()) {
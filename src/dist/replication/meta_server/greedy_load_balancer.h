@@ -91,10 +91,12 @@ private:
     bool _balancer_in_turn;
     bool _only_primary_balancer;
     bool _only_move_primary;
+    bool _primary_balancer_globally;
 
     dsn_handle_t _ctrl_balancer_in_turn;
     dsn_handle_t _ctrl_only_primary_balancer;
     dsn_handle_t _ctrl_only_move_primary;
+    dsn_handle_t _ctrl_primary_balancer_globally;
     dsn_handle_t _get_balance_operation_count;
 
     // perf counters
@@ -104,6 +106,9 @@ private:
     perf_counter_wrapper _recent_balance_copy_secondary_count;
 
 private:
+    friend class meta_service_test_app;
+    friend class balancer_simulator;
+
     void number_nodes(const node_mapper &nodes);
     void shortest_path(std::vector<bool> &visit,
                        std::vector<int> &flow,
@@ -126,6 +131,11 @@ private:
                               int replicas_low);
     bool primary_balancer_per_app(const std::shared_ptr<app_state> &app);
 
+    // balance the total primaries of all the available apps on each node by a min-cost flow,
+    // in which a primary is only moved to a node that has fewer primaries of the same app.
+    // so it never makes an app less balanced, and should be done after primary_balancer_per_app.
+    void primary_balancer_globally();
+
     bool copy_secondary_per_app(const std::shared_ptr<app_state> &app);
 
     void greedy_balancer(bool balance_checker);
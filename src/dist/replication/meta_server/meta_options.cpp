@@ -115,6 +115,41 @@ void meta_options::initialize()
         10,
         "add secondary max count for one node when flow control enabled");
 
+    partition_config_sync_batch_max_count = dsn_config_get_value_uint64(
+        "meta_server",
+        "partition_config_sync_batch_max_count",
+        1,
+        "max count of partition configs written to remote storage in one transaction, 1 means "
+        "each config is written alone in json, otherwise they're written in thrift binary which "
+        "can't be read by the older meta servers");
+    partition_config_sync_batch_max_bytes = dsn_config_get_value_uint64(
+        "meta_server",
+        "partition_config_sync_batch_max_bytes",
+        256 * 1024,
+        "max bytes of partition configs written to remote storage in one transaction, the "
+        "transaction is about twice as large if apps_snapshot_enabled, and must be smaller than "
+        "the max request size of the remote storage, e.g. jute.maxbuffer of zookeeper");
+    partition_config_sync_batch_window_ms = dsn_config_get_value_uint64(
+        "meta_server",
+        "partition_config_sync_batch_window_ms",
+        5,
+        "the partition configs to write within so many milliseconds are written in one "
+        "transaction, only valid if partition_config_sync_batch_max_count > 1");
+
+    apps_snapshot_enabled = dsn_config_get_value_bool(
+        "meta_server",
+        "apps_snapshot_enabled",
+        false,
+        "whether to keep a snapshot of all the apps and partitions with a log of the partition "
+        "config changes in remote storage, which is loaded on becoming the leader instead of "
+        "reading every partition node; the partition configs are written in thrift binary if "
+        "enabled, and the snapshot must be removed before running the older meta servers");
+    apps_snapshot_interval_seconds =
+        dsn_config_get_value_uint64("meta_server",
+                                    "apps_snapshot_interval_seconds",
+                                    600,
+                                    "interval seconds to compact the log into the apps snapshot");
+
     /// failure detector options
     _fd_opts.distributed_lock_service_type =
         dsn_config_get_value_string("meta_server",
@@ -160,6 +195,12 @@ void meta_options::initialize()
         "meta_server", "only_primary_balancer", false, "only try to make the primary balanced");
     _lb_opts.only_move_primary = dsn_config_get_value_bool(
         "meta_server", "only_move_primary", false, "only try to make the primary balanced by move");
+    _lb_opts.primary_balancer_globally =
+        dsn_config_get_value_bool("meta_server",
+                                  "primary_balancer_globally",
+                                  false,
+                                  "balance the total primaries of all apps on each node after "
+                                  "the primaries of every app are balanced");
 
     cold_backup_disabled = dsn_config_get_value_bool(
         "meta_server", "cold_backup_disabled", true, "whether to disable cold backup");
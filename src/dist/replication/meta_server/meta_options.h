@@ -60,6 +60,7 @@ public:
     bool balancer_in_turn;
     bool only_primary_balancer;
     bool only_move_primary;
+    bool primary_balancer_globally;
 };
 
 class meta_options
@@ -78,6 +79,13 @@ public:
     bool add_secondary_enable_flow_control;
     int32_t add_secondary_max_count_for_one_node;
 
+    uint64_t partition_config_sync_batch_max_count;
+    uint64_t partition_config_sync_batch_max_bytes;
+    uint64_t partition_config_sync_batch_window_ms;
+
+    bool apps_snapshot_enabled;
+    uint64_t apps_snapshot_interval_seconds;
+
     fd_suboptions _fd_opts;
     lb_suboptions _lb_opts;
 
@@ -184,31 +184,15 @@ void meta_split_service::register_child_on_meta(register_child_rpc rpc)
 dsn::task_ptr meta_split_service::add_child_on_remote_storage(register_child_rpc rpc,
                                                               bool create_new)
 {
-    const auto &request = rpc.request();
-    const std::string &partition_path = _state->get_partition_path(request.child_config.pid);
-    blob value = dsn::json::json_forwarder<partition_configuration>::encode(request.child_config);
-    if (create_new) {
-        return _meta_svc->get_remote_storage()->create_node(
-            partition_path,
-            LPC_META_STATE_HIGH,
-            std::bind(&meta_split_service::on_add_child_on_remote_storage_reply,
-                      this,
-                      std::placeholders::_1,
-                      rpc,
-                      create_new),
-            value);
-    } else {
-        return _meta_svc->get_remote_storage()->set_data(
-            partition_path,
-            value,
-            LPC_META_STATE_HIGH,
-            std::bind(&meta_split_service::on_add_child_on_remote_storage_reply,
-                      this,
-                      std::placeholders::_1,
-                      rpc,
-                      create_new),
-            _meta_svc->tracker());
-    }
+    // written like the other partition configs, so that it's also in the config log
+    return _state->write_partition_config(
+        rpc.request().child_config,
+        create_new,
+        std::bind(&meta_split_service::on_add_child_on_remote_storage_reply,
+                  this,
+                  std::placeholders::_1,
+                  rpc,
+                  create_new));
 }
 
 void meta_split_service::on_add_child_on_remote_storage_reply(error_code ec,
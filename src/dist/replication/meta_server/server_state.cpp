@@ -39,6 +39,7 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/async_calls.h>
+#include <dsn/cpp/serialization.h>
 #include <sstream>
 #include <cinttypes>
 #include <string>
@@ -183,6 +184,11 @@ void server_state::initialize(meta_service *meta_svc, const std::string &apps_ro
                                                  "recent_update_config_count",
                                                  COUNTER_TYPE_VOLATILE_NUMBER,
                                                  "update configuration count in the recent period");
+    _recent_config_sync_transaction_count.init_app_counter(
+        "eon.server_state",
+        "recent_config_sync_transaction_count",
+        COUNTER_TYPE_VOLATILE_NUMBER,
+        "transactions that write partition configs to remote storage in the recent period");
     _recent_partition_change_unwritable_count.init_app_counter(
         "eon.server_state",
         "recent_partition_change_unwritable_count",
@@ -479,9 +485,21 @@ error_code server_state::sync_apps_to_remote_storage()
         }
     }
 
+    // the apps are written from scratch, so the snapshot and the config log of the former apps
+    // are stale, and they're not under _apps_root
+    error_code err = remove_apps_snapshot();
+    if (err == ERR_OK && _meta_svc->get_meta_options().apps_snapshot_enabled) {
+        // prepares the remote storage for the config log of the partitions written below
+        snapshot_apps apps_in_snapshot;
+        err = load_apps_snapshot(apps_in_snapshot);
+    }
+    if (err != ERR_OK) {
+        _exist_apps.clear();
+        return err;
+    }
+
     // create cluster_root/apps node
     std::string &apps_path = _apps_root;
-    error_code err;
     dist::meta_state_service *storage = _meta_svc->get_remote_storage();
 
     auto t = storage->create_node(apps_path,
@@ -553,6 +571,26 @@ error_code server_state::sync_apps_to_remote_storage()
     }
 }
 
+void server_state::load_partition_config(std::shared_ptr<app_state> &app,
+                                         int partition_id,
+                                         const partition_configuration &pc)
+{
+    dassert(pc.pid.get_app_id() == app->app_id && pc.pid.get_partition_index() == partition_id,
+            "invalid partition config");
+    app->partitions[partition_id] = pc;
+    for (const dsn::rpc_address &addr : pc.last_drops) {
+        app->helpers->contexts[partition_id].record_drop_history(addr);
+    }
+
+    if (app->status == app_status::AS_CREATING && (pc.partition_flags & pc_flags::dropped) != 0) {
+        recall_partition(app, partition_id);
+    } else if (app->status == app_status::AS_DROPPING &&
+               (pc.partition_flags & pc_flags::dropped) == 0) {
+        drop_partition(app, partition_id);
+    } else
+        process_one_partition(app);
+}
+
 dsn::error_code server_state::sync_apps_from_remote_storage()
 {
     dsn::error_code err;
@@ -568,27 +606,10 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
                                                             const blob &value) mutable {
                 if (ec == ERR_OK) {
                     partition_configuration pc;
-                    dsn::json::json_forwarder<partition_configuration>::decode(value, pc);
+                    decode_partition_config(value, pc);
 
-                    dassert(pc.pid.get_app_id() == app->app_id &&
-                                pc.pid.get_partition_index() == partition_id,
-                            "invalid partition config");
-                    {
-                        zauto_write_lock l(_lock);
-                        app->partitions[partition_id] = pc;
-                        for (const dsn::rpc_address &addr : pc.last_drops) {
-                            app->helpers->contexts[partition_id].record_drop_history(addr);
-                        }
-
-                        if (app->status == app_status::AS_CREATING &&
-                            (pc.partition_flags & pc_flags::dropped) != 0) {
-                            recall_partition(app, partition_id);
-                        } else if (app->status == app_status::AS_DROPPING &&
-                                   (pc.partition_flags & pc_flags::dropped) == 0) {
-                            drop_partition(app, partition_id);
-                        } else
-                            process_one_partition(app);
-                    }
+                    zauto_write_lock l(_lock);
+                    load_partition_config(app, partition_id, pc);
                 } else if (ec == ERR_OBJECT_NOT_FOUND) {
                     dwarn("partition node %s not exist on remote storage, may half create before",
                           partition_path.c_str());
@@ -601,11 +622,13 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
             &tracker);
     };
 
+    snapshot_apps apps_in_snapshot;
     auto sync_app = [&](const std::string &app_path) {
         storage->get_data(
             app_path,
             LPC_META_CALLBACK,
-            [this, app_path, &err, &sync_partition](error_code ec, const blob &value) {
+            [this, app_path, &err, &sync_partition, &apps_in_snapshot](error_code ec,
+                                                                      const blob &value) {
                 if (ec == ERR_OK) {
                     app_info info;
                     dassert(dsn::json::json_forwarder<app_info>::decode(value, info),
@@ -627,6 +650,21 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
                         }
                     }
 
+                    // the partitions of the app unchanged since the snapshot are loaded from it,
+                    // and validated against their nodes later
+                    auto iter = apps_in_snapshot.find(app->app_id);
+                    if (iter != apps_in_snapshot.end() && iter->second.info.status == info.status &&
+                        iter->second.info.app_name == info.app_name &&
+                        iter->second.info.create_second == info.create_second &&
+                        iter->second.info.partition_count == info.partition_count) {
+                        zauto_write_lock l(_lock);
+                        for (int i = 0; i < app->partition_count; i++) {
+                            load_partition_config(app, i, iter->second.partitions[i]);
+                            _apps_snapshot_unvalidated.emplace_back(app->app_id, i);
+                        }
+                        return;
+                    }
+
                     for (int i = 0; i < app->partition_count; i++) {
                         std::string partition_path =
                             app_path + "/" + boost::lexical_cast<std::string>(i);
@@ -644,6 +682,15 @@ dsn::error_code server_state::sync_apps_from_remote_storage()
 
     _all_apps.clear();
     _exist_apps.clear();
+    _apps_snapshot_unvalidated.clear();
+    _apps_snapshot_mismatch_count = 0;
+
+    err = _meta_svc->get_meta_options().apps_snapshot_enabled
+              ? load_apps_snapshot(apps_in_snapshot)
+              : remove_apps_snapshot();
+    if (err != ERR_OK) {
+        return err;
+    }
 
     std::string transaction_state;
     storage
@@ -736,6 +783,9 @@ error_code server_state::initialize_data_structure()
             initialize_node_state();
         }
     }
+    if (err == ERR_OK) {
+        start_apps_snapshot();
+    }
     return err;
 }
 
@@ -1535,21 +1585,195 @@ task_ptr server_state::update_configuration_on_remote(
             std::chrono::seconds(1));
     }
 
-    partition_configuration &pc = config_request->config;
+    return write_partition_config(
+        config_request->config, false, [this, config_request](error_code ec) mutable {
+            on_update_configuration_on_remote_reply(ec, config_request);
+        });
+}
+
+task_ptr server_state::write_partition_config(const partition_configuration &pc,
+                                              bool create_node,
+                                              err_callback &&callback)
+{
     std::string storage_path = get_partition_path(pc.pid);
 
-    blob json_config = dsn::json::json_forwarder<partition_configuration>::encode(pc);
-    return _meta_svc->get_remote_storage()->set_data(
-        storage_path,
-        json_config,
+    const meta_options &opts = _meta_svc->get_meta_options();
+    if (opts.partition_config_sync_batch_max_count <= 1 && !opts.apps_snapshot_enabled) {
+        blob json_config = dsn::json::json_forwarder<partition_configuration>::encode(pc);
+        if (create_node) {
+            return _meta_svc->get_remote_storage()->create_node(
+                storage_path, LPC_META_STATE_HIGH, callback, json_config, tracker());
+        }
+        return _meta_svc->get_remote_storage()->set_data(
+            storage_path, json_config, LPC_META_STATE_HIGH, callback, tracker());
+    }
+
+    // the callback is returned as the pending_sync_task, so that it can be cancelled as before,
+    // and it holds the pin of the config log until it's executed or cancelled
+    std::shared_ptr<config_log_pin> pin;
+    if (opts.apps_snapshot_enabled) {
+        pin = std::make_shared<config_log_pin>(this);
+    }
+    error_code_future_ptr future(new error_code_future(
+        LPC_META_STATE_HIGH,
+        [callback = std::move(callback), pin](error_code ec) mutable { callback(ec); },
+        0));
+    future->set_tracker(tracker());
+    append_config_sync_batch(config_sync_item{std::move(storage_path),
+                                              binary_encode_partition_config(pc),
+                                              create_node,
+                                              future,
+                                              std::move(pin)});
+    return future;
+}
+
+void server_state::append_config_sync_batch(config_sync_item &&item)
+{
+    // the creation may fail if the node exists, which would fail the whole batch, so it's
+    // written in a transaction of its own
+    if (item.create_node) {
+        std::vector<config_sync_item> batch;
+        batch.emplace_back(std::move(item));
+        submit_config_sync_batch(std::move(batch));
+        return;
+    }
+
+    const meta_options &opts = _meta_svc->get_meta_options();
+    std::vector<config_sync_item> full_batch;
+    {
+        zauto_lock l(_config_sync_batch_lock);
+        _config_sync_batch_bytes += item.path.size() + item.value.length();
+        _config_sync_batch.emplace_back(std::move(item));
+        if (_config_sync_batch.size() >= opts.partition_config_sync_batch_max_count ||
+            _config_sync_batch_bytes >= opts.partition_config_sync_batch_max_bytes) {
+            full_batch.swap(_config_sync_batch);
+            _config_sync_batch_bytes = 0;
+        } else if (!_config_sync_flush_scheduled) {
+            _config_sync_flush_scheduled = true;
+            tasking::enqueue(
+                LPC_META_STATE_HIGH,
+                tracker(),
+                [this]() { flush_config_sync_batch(); },
+                0,
+                std::chrono::milliseconds(opts.partition_config_sync_batch_window_ms));
+        }
+    }
+    if (!full_batch.empty()) {
+        submit_config_sync_batch(std::move(full_batch));
+    }
+}
+
+void server_state::flush_config_sync_batch()
+{
+    std::vector<config_sync_item> batch;
+    {
+        zauto_lock l(_config_sync_batch_lock);
+        _config_sync_flush_scheduled = false;
+        batch.swap(_config_sync_batch);
+        _config_sync_batch_bytes = 0;
+    }
+    submit_config_sync_batch(std::move(batch));
+}
+
+void server_state::submit_config_sync_batch(std::vector<config_sync_item> &&batch)
+{
+    // the configs whose sync are cancelled (e.g. the app is dropped) are not written
+    batch.erase(std::remove_if(batch.begin(),
+                               batch.end(),
+                               [](const config_sync_item &item) {
+                                   return item.callback->state() == TASK_STATE_CANCELLED;
+                               }),
+                batch.end());
+    if (batch.empty()) {
+        return;
+    }
+
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    std::shared_ptr<dist::meta_state_service::transaction_entries> entries =
+        storage->new_transaction_entries(batch.size() + 1);
+    for (const config_sync_item &item : batch) {
+        if (item.create_node) {
+            entries->create_node(item.path, item.value);
+        } else {
+            entries->set_data(item.path, item.value);
+        }
+    }
+    if (batch.front().pin != nullptr) {
+        int64_t seq;
+        {
+            zauto_lock l(_config_sync_batch_lock);
+            seq = _config_log_next_seq++;
+            _config_log_pins[seq] = static_cast<int>(batch.size());
+            for (const config_sync_item &item : batch) {
+                item.pin->seq = seq;
+            }
+        }
+        entries->create_node(get_config_log_path() + "/" + std::to_string(seq),
+                             encode_config_log_entry(batch));
+    }
+
+    dinfo("write %d partition configs to remote storage in one transaction",
+          static_cast<int>(batch.size()));
+    _recent_config_sync_transaction_count->increment();
+    // the transaction is all-or-nothing, so each request gets the error of the whole batch,
+    // and is retried or replied by its callback as if written alone, except that a creation,
+    // which is always alone, gets the error of its own entry
+    storage->submit_transaction(
+        entries,
         LPC_META_STATE_HIGH,
-        std::bind(&server_state::on_update_configuration_on_remote_reply,
-                  this,
-                  std::placeholders::_1,
-                  config_request),
+        [this, batch = std::move(batch), entries](error_code ec) mutable {
+            if (ec != ERR_OK && ec != ERR_TIMEOUT && batch.size() > 1) {
+                // the error may be caused by any of the entries, which are written alone again
+                // to find out the error of each
+                derror("write %d partition configs to remote storage in one transaction failed, "
+                       "write them one by one, err = %s",
+                       static_cast<int>(batch.size()),
+                       ec.to_string());
+                for (config_sync_item &item : batch) {
+                    if (item.pin != nullptr) {
+                        // the log entry isn't written, a new one is pinned on resubmitting
+                        unpin_config_log(item.pin->seq);
+                        item.pin->seq = -1;
+                    }
+                    std::vector<config_sync_item> single;
+                    single.emplace_back(std::move(item));
+                    submit_config_sync_batch(std::move(single));
+                }
+                return;
+            }
+            if (ec != ERR_OK && ec != ERR_TIMEOUT && batch.front().create_node) {
+                ec = entries->get_result(0);
+            }
+            for (const config_sync_item &item : batch) {
+                item.callback->enqueue_with(ec);
+            }
+        },
         tracker());
 }
 
+// the first byte of a json config is '{'
+static const uint8_t PARTITION_CONFIG_BINARY_MAGIC = 0;
+
+/*static*/ blob server_state::binary_encode_partition_config(const partition_configuration &pc)
+{
+    binary_writer writer;
+    writer.write(PARTITION_CONFIG_BINARY_MAGIC);
+    marshall(writer, pc, DSF_THRIFT_BINARY);
+    return writer.get_buffer();
+}
+
+/*static*/ bool server_state::decode_partition_config(const blob &value,
+                                                      /*out*/ partition_configuration &pc)
+{
+    if (value.length() > 0 &&
+        static_cast<uint8_t>(value.data()[0]) == PARTITION_CONFIG_BINARY_MAGIC) {
+        binary_reader reader(value.range(1));
+        unmarshall(reader, pc, DSF_THRIFT_BINARY);
+        return true;
+    }
+    return dsn::json::json_forwarder<partition_configuration>::decode(value, pc);
+}
+
 void server_state::on_update_configuration_on_remote_reply(
     error_code ec, std::shared_ptr<configuration_update_request> &config_request)
 {
@@ -1631,10 +1855,7 @@ void server_state::recall_partition(std::shared_ptr<app_state> &app, int pidx)
     dassert((pc.partition_flags & pc_flags::dropped), "");
 
     pc.partition_flags = 0;
-    blob json_partition = dsn::json::json_forwarder<partition_configuration>::encode(pc);
-    std::string partition_path = get_partition_path(pc.pid);
-    _meta_svc->get_remote_storage()->set_data(
-        partition_path, json_partition, LPC_META_STATE_HIGH, on_recall_partition);
+    write_partition_config(pc, false, on_recall_partition);
 }
 
 void server_state::drop_partition(std::shared_ptr<app_state> &app, int pidx)
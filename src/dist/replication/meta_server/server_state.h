@@ -35,12 +35,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <unordered_map>
 #include <boost/lexical_cast.hpp>
 
 #include <dsn/dist/replication/replication_other_types.h>
 #include <dsn/dist/block_service.h>
 #include <dsn/tool-api/task_tracker.h>
+#include <dsn/tool-api/future_types.h>
+#include <dsn/tool-api/zlocks.h>
 #include <dsn/perf_counter/perf_counter_wrapper.h>
 
 #include "dist/replication/common/replication_common.h"
@@ -244,6 +248,74 @@ private:
     void
     on_update_configuration_on_remote_reply(error_code ec,
                                             std::shared_ptr<configuration_update_request> &request);
+    // the partition configs to write within a short window are written to remote storage in
+    // one transaction, and each request is replied by its own callback
+    //
+    // if the apps snapshot is enabled, each batch also creates an entry of the config log in the
+    // same transaction, which is pinned until all the configs in it are applied locally or
+    // abandoned, so that the pinned entries are replayed after the snapshot
+    struct config_log_pin
+    {
+        explicit config_log_pin(server_state *ss) : state(ss) {}
+        ~config_log_pin()
+        {
+            if (seq >= 0) {
+                state->unpin_config_log(seq);
+            }
+        }
+        server_state *state;
+        int64_t seq{-1};
+    };
+    struct config_sync_item
+    {
+        std::string path;
+        blob value;
+        bool create_node;
+        error_code_future_ptr callback;
+        std::shared_ptr<config_log_pin> pin;
+    };
+    // all the writers of the partition nodes go through it, so that every write is logged
+    task_ptr write_partition_config(const partition_configuration &pc,
+                                    bool create_node,
+                                    err_callback &&callback);
+    void append_config_sync_batch(config_sync_item &&item);
+    void flush_config_sync_batch();
+    void submit_config_sync_batch(std::vector<config_sync_item> &&batch);
+
+    // the partition configs written in batch are encoded in thrift binary after a magic byte,
+    // which is distinguished from the json ones on decoding
+    static blob binary_encode_partition_config(const partition_configuration &pc);
+    static bool decode_partition_config(const blob &value, /*out*/ partition_configuration &pc);
+
+    // apps snapshot, see server_state_snapshot.cpp
+    struct snapshot_app
+    {
+        app_info info;
+        std::vector<partition_configuration> partitions;
+    };
+    typedef std::map<int32_t, snapshot_app> snapshot_apps;
+    std::string get_apps_snapshot_path() const { return _apps_root + "_snapshot"; }
+    std::string get_config_log_path() const { return _apps_root + "_log"; }
+    // loads the apps from the snapshot and replays the config log on them, and prepares the
+    // remote storage for the config log, `apps` is empty if there's no snapshot
+    error_code load_apps_snapshot(/*out*/ snapshot_apps &apps);
+    // removes the snapshot and the config log, which are not maintained if the snapshot is
+    // disabled, or are stale once the apps are written from scratch
+    error_code remove_apps_snapshot();
+    void start_apps_snapshot();
+    void compact_apps_snapshot();
+    void on_apps_snapshot_written(int64_t gen, int64_t log_start);
+    // checks the partitions loaded from the snapshot against their nodes in background
+    void validate_apps_snapshot();
+    void validate_partition_config(const gpid &pid, const blob &value);
+    void unpin_config_log(int64_t seq);
+    blob encode_config_log_entry(const std::vector<config_sync_item> &batch);
+
+    // user should lock it first
+    void load_partition_config(std::shared_ptr<app_state> &app,
+                               int partition_id,
+                               const partition_configuration &pc);
+
     void
     update_configuration_locally(app_state &app,
                                  std::shared_ptr<configuration_update_request> &config_request);
@@ -306,6 +378,7 @@ private:
     friend class meta_split_service;
     friend class bulk_load_service;
     friend class bulk_load_service_test;
+    friend class meta_apps_snapshot_test;
 
     dsn::task_tracker _tracker;
 
@@ -339,8 +412,25 @@ private:
     perf_counter_wrapper _writable_ill_partition_count;
     perf_counter_wrapper _healthy_partition_count;
     perf_counter_wrapper _recent_update_config_count;
+    perf_counter_wrapper _recent_config_sync_transaction_count;
     perf_counter_wrapper _recent_partition_change_unwritable_count;
     perf_counter_wrapper _recent_partition_change_writable_count;
+
+    zlock _config_sync_batch_lock; // protects the following 6 fields
+    std::vector<config_sync_item> _config_sync_batch;
+    uint64_t _config_sync_batch_bytes{0};
+    bool _config_sync_flush_scheduled{false};
+    int64_t _config_log_next_seq{0};
+    std::map<int64_t, int> _config_log_pins; // seq -> count of the pins
+
+    // the log entries before _apps_snapshot_log_start are compacted into the snapshot
+    int64_t _apps_snapshot_gen{0};
+    int64_t _apps_snapshot_log_start{0};
+    std::atomic<bool> _apps_snapshot_compacting{false};
+    task_ptr _apps_snapshot_timer;
+    // the partitions loaded from the snapshot but not validated yet, protected by _lock
+    std::deque<gpid> _apps_snapshot_unvalidated;
+    int _apps_snapshot_mismatch_count{0};
 };
 
 } // namespace replication
@@ -0,0 +1,485 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <dsn/cpp/serialization.h>
+#include <dsn/utility/string_conv.h>
+
+#include "meta_state_service_utils.h"
+#include "server_state.h"
+
+namespace dsn {
+namespace replication {
+
+//
+// The apps snapshot lets a new leader load all the apps in a few reads, instead of reading
+// every partition node and handling each of them under _lock:
+//
+//   <apps_root>_snapshot            the header: the generation of the snapshot, the first log
+//                                   entry not compacted into it, and the count of its chunks
+//   <apps_root>_snapshot/<gen>/<i>  the i-th chunk of the snapshot, the app_info of each app
+//                                   followed by the configs of its partitions in thrift binary
+//   <apps_root>_log/<seq>           the partition configs written by a transaction, created in
+//                                   the same transaction as the partition nodes
+//
+// The snapshot is compacted from the local state every `apps_snapshot_interval_seconds`. On
+// loading, the apps whose info in remote storage matches the snapshot take their partitions
+// from it with the log entries after it replayed in order, and the others are read from the
+// partition nodes as before. The partitions taken from the snapshot are checked against their
+// nodes in background after the leader starts serving.
+//
+
+static const uint32_t APPS_SNAPSHOT_VERSION = 1;
+// a node of zookeeper holds at most 1MB by default
+static const int APPS_SNAPSHOT_CHUNK_BYTES = 512 * 1024;
+static const int APPS_SNAPSHOT_VALIDATE_BATCH_SIZE = 256;
+
+error_code server_state::load_apps_snapshot(/*out*/ snapshot_apps &apps)
+{
+    uint64_t start_ms = dsn_now_ms();
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    std::string snapshot_path = get_apps_snapshot_path();
+    std::string log_path = get_config_log_path();
+    error_code err;
+
+    blob header;
+    storage
+        ->get_data(snapshot_path,
+                   LPC_META_CALLBACK,
+                   [&err, &header](error_code ec, const blob &value) {
+                       err = ec;
+                       header = value;
+                   })
+        ->wait();
+    std::vector<std::string> log_entries;
+    if (err == ERR_OK) {
+        storage
+            ->get_children(log_path,
+                           LPC_META_CALLBACK,
+                           [&err, &log_entries](error_code ec,
+                                                const std::vector<std::string> &children) {
+                               err = ec;
+                               log_entries = children;
+                           })
+            ->wait();
+    }
+    if (err == ERR_OBJECT_NOT_FOUND) {
+        // the first time the snapshot is enabled
+        for (const std::string &path : {snapshot_path, log_path}) {
+            storage
+                ->create_node(path,
+                              LPC_META_CALLBACK,
+                              [&err](error_code ec) {
+                                  err = (ec == ERR_NODE_ALREADY_EXIST ? ERR_OK : ec);
+                              })
+                ->wait();
+            if (err != ERR_OK) {
+                break;
+            }
+        }
+    }
+    if (err != ERR_OK) {
+        derror("prepare apps snapshot in remote storage failed, err = %s", err.to_string());
+        return err;
+    }
+
+    int64_t gen = 0;
+    int64_t log_start = 0;
+    int32_t chunk_count = 0;
+    if (header.length() > 0) {
+        binary_reader reader(header);
+        uint32_t version = 0;
+        reader.read(version);
+        dassert(version == APPS_SNAPSHOT_VERSION, "invalid apps snapshot version(%u)", version);
+        reader.read(gen);
+        reader.read(log_start);
+        reader.read(chunk_count);
+    }
+
+    std::vector<int64_t> log_seqs;
+    for (const std::string &name : log_entries) {
+        int64_t seq = 0;
+        dassert(buf2int64(name, seq), "invalid config log entry %s", name.c_str());
+        log_seqs.push_back(seq);
+    }
+    std::sort(log_seqs.begin(), log_seqs.end());
+    {
+        zauto_lock l(_config_sync_batch_lock);
+        _config_log_next_seq =
+            log_seqs.empty() ? log_start : std::max(log_start, log_seqs.back() + 1);
+    }
+    _apps_snapshot_gen = gen;
+    _apps_snapshot_log_start = log_start;
+    if (gen == 0) {
+        ddebug("no apps snapshot in remote storage, load the apps from the partition nodes");
+        return ERR_OK;
+    }
+
+    // read the chunks of the snapshot and the log entries after it at once
+    dsn::task_tracker tracker;
+    std::vector<blob> chunks(chunk_count);
+    for (int i = 0; i < chunk_count; i++) {
+        storage->get_data(
+            snapshot_path + "/" + std::to_string(gen) + "/" + std::to_string(i),
+            LPC_META_CALLBACK,
+            [&err, &chunks, i](error_code ec, const blob &value) {
+                if (ec == ERR_OK) {
+                    chunks[i] = value;
+                } else {
+                    err = ec;
+                }
+            },
+            &tracker);
+    }
+    log_seqs.erase(log_seqs.begin(),
+                   std::lower_bound(log_seqs.begin(), log_seqs.end(), log_start));
+    std::vector<blob> log_values(log_seqs.size());
+    for (size_t i = 0; i < log_seqs.size(); i++) {
+        storage->get_data(log_path + "/" + std::to_string(log_seqs[i]),
+                          LPC_META_CALLBACK,
+                          [&err, &log_values, i](error_code ec, const blob &value) {
+                              if (ec == ERR_OK) {
+                                  log_values[i] = value;
+                              } else {
+                                  err = ec;
+                              }
+                          },
+                          &tracker);
+    }
+    tracker.wait_outstanding_tasks();
+    if (err != ERR_OK) {
+        derror("read apps snapshot(%" PRId64 ") from remote storage failed, err = %s",
+               gen,
+               err.to_string());
+        return err;
+    }
+
+    binary_reader reader;
+    reader.init(std::move(chunks));
+    int32_t app_count = 0;
+    reader.read(app_count);
+    int partition_count = 0;
+    for (int i = 0; i < app_count; i++) {
+        snapshot_app app;
+        unmarshall(reader, app.info, DSF_THRIFT_BINARY);
+        int32_t count = 0;
+        reader.read(count);
+        app.partitions.resize(count);
+        for (partition_configuration &pc : app.partitions) {
+            unmarshall(reader, pc, DSF_THRIFT_BINARY);
+        }
+        partition_count += count;
+        int32_t app_id = app.info.app_id;
+        apps.emplace(app_id, std::move(app));
+    }
+
+    // the partitions of a log entry are applied in a transaction, and the next config of a
+    // partition is written after the last one is applied, so replaying in order is enough
+    int replayed_count = 0;
+    for (const blob &value : log_values) {
+        binary_reader entry(value);
+        int32_t count = 0;
+        entry.read(count);
+        for (int i = 0; i < count; i++) {
+            blob config;
+            entry.read(config);
+            partition_configuration pc;
+            decode_partition_config(config, pc);
+            auto iter = apps.find(pc.pid.get_app_id());
+            if (iter != apps.end() &&
+                pc.pid.get_partition_index() < iter->second.partitions.size()) {
+                iter->second.partitions[pc.pid.get_partition_index()] = pc;
+                ++replayed_count;
+            }
+        }
+    }
+
+    ddebug("load apps snapshot(%" PRId64 ") of %d apps and %d partitions from %d chunks, replay "
+           "%d partition configs from %d log entries, time used %" PRIu64 " ms",
+           gen,
+           app_count,
+           partition_count,
+           chunk_count,
+           replayed_count,
+           static_cast<int>(log_values.size()),
+           dsn_now_ms() - start_ms);
+    return ERR_OK;
+}
+
+error_code server_state::remove_apps_snapshot()
+{
+    // the partition nodes are written without the config log, so the snapshot is stale
+    dist::meta_state_service *storage = _meta_svc->get_remote_storage();
+    error_code err;
+    for (const std::string &path : {get_apps_snapshot_path(), get_config_log_path()}) {
+        storage
+            ->delete_node(path,
+                          true,
+                          LPC_META_CALLBACK,
+                          [&err](error_code ec) {
+                              err = (ec == ERR_OBJECT_NOT_FOUND ? ERR_OK : ec);
+                          })
+            ->wait();
+        if (err != ERR_OK) {
+            derror("remove %s from remote storage failed, err = %s",
+                   path.c_str(),
+                   err.to_string());
+            return err;
+        }
+    }
+
+    {
+        zauto_lock l(_config_sync_batch_lock);
+        _config_log_next_seq = 0;
+    }
+    _apps_snapshot_gen = 0;
+    _apps_snapshot_log_start = 0;
+    return ERR_OK;
+}
+
+void server_state::start_apps_snapshot()
+{
+    if (!_meta_svc->get_meta_options().apps_snapshot_enabled) {
+        return;
+    }
+    // the apps are loaded again each time the meta server is promoted, so they're validated
+    // again, while the compaction timer is kept
+    if (_apps_snapshot_timer == nullptr) {
+        _apps_snapshot_timer = tasking::enqueue_timer(
+            LPC_META_STATE_NORMAL,
+            tracker(),
+            [this]() { compact_apps_snapshot(); },
+            std::chrono::seconds(_meta_svc->get_meta_options().apps_snapshot_interval_seconds));
+    }
+    tasking::enqueue(LPC_META_STATE_NORMAL, tracker(), [this]() { validate_apps_snapshot(); });
+}
+
+void server_state::compact_apps_snapshot()
+{
+    if (_apps_snapshot_compacting.exchange(true)) {
+        return;
+    }
+
+    binary_writer writer;
+    int64_t log_start;
+    {
+        zauto_read_lock l(_lock);
+        {
+            // the configs of the pinned entries may not be applied locally yet
+            zauto_lock l2(_config_sync_batch_lock);
+            log_start = _config_log_pins.empty() ? _config_log_next_seq
+                                                 : _config_log_pins.begin()->first;
+        }
+        if (_apps_snapshot_gen > 0 && log_start == _apps_snapshot_log_start) {
+            _apps_snapshot_compacting = false;
+            return;
+        }
+        // the status of the staging apps in remote storage differs from the local one
+        if (count_staging_app() > 0) {
+            ddebug("delay compacting apps snapshot as some apps are staging");
+            _apps_snapshot_compacting = false;
+            return;
+        }
+
+        writer.write(static_cast<int32_t>(_all_apps.size()));
+        for (const auto &kv : _all_apps) {
+            const app_state &app = *kv.second;
+            marshall(writer, static_cast<const app_info &>(app), DSF_THRIFT_BINARY);
+            writer.write(static_cast<int32_t>(app.partitions.size()));
+            for (const partition_configuration &pc : app.partitions) {
+                marshall(writer, pc, DSF_THRIFT_BINARY);
+            }
+        }
+    }
+
+    blob data = writer.get_buffer();
+    int64_t gen = _apps_snapshot_gen + 1;
+    int32_t chunk_count =
+        (data.length() + APPS_SNAPSHOT_CHUNK_BYTES - 1) / APPS_SNAPSHOT_CHUNK_BYTES;
+    std::string gen_path = get_apps_snapshot_path() + "/" + std::to_string(gen);
+    mss::meta_storage *storage = _meta_svc->get_meta_storage();
+
+    auto write_header = [this, storage, gen, log_start, chunk_count]() {
+        binary_writer header;
+        header.write(APPS_SNAPSHOT_VERSION);
+        header.write(gen);
+        header.write(log_start);
+        header.write(chunk_count);
+        storage->set_data(get_apps_snapshot_path(),
+                          header.get_buffer(),
+                          [this, gen, log_start]() { on_apps_snapshot_written(gen, log_start); });
+    };
+    auto write_chunks = [storage, data, gen_path, chunk_count, write_header]() {
+        auto remaining = std::make_shared<std::atomic<int>>(chunk_count);
+        for (int i = 0; i < chunk_count; i++) {
+            int offset = i * APPS_SNAPSHOT_CHUNK_BYTES;
+            int length =
+                std::min(APPS_SNAPSHOT_CHUNK_BYTES, static_cast<int>(data.length()) - offset);
+            storage->create_node(
+                gen_path + "/" + std::to_string(i),
+                data.range(offset, length),
+                [remaining, write_header]() {
+                    if (--(*remaining) == 0) {
+                        write_header();
+                    }
+                });
+        }
+    };
+    // the chunks of this generation may be left by an interrupted compaction
+    storage->delete_node_recursively(std::string(gen_path), [storage, gen_path, write_chunks]() {
+        storage->create_node(std::string(gen_path), blob(), std::function<void()>(write_chunks));
+    });
+}
+
+void server_state::on_apps_snapshot_written(int64_t gen, int64_t log_start)
+{
+    ddebug("apps snapshot(%" PRId64 ") is written, the log entries before %" PRId64
+           " are compacted into it",
+           gen,
+           log_start);
+    mss::meta_storage *storage = _meta_svc->get_meta_storage();
+    if (_apps_snapshot_gen > 0) {
+        storage->delete_node_recursively(
+            get_apps_snapshot_path() + "/" + std::to_string(_apps_snapshot_gen), []() {});
+    }
+    std::string log_path = get_config_log_path();
+    storage->get_children(
+        std::string(log_path),
+        [storage, log_path, log_start](bool, const std::vector<std::string> &children) {
+            for (const std::string &name : children) {
+                int64_t seq = 0;
+                if (buf2int64(name, seq) && seq < log_start) {
+                    storage->delete_node(log_path + "/" + name, []() {});
+                }
+            }
+        });
+
+    _apps_snapshot_gen = gen;
+    _apps_snapshot_log_start = log_start;
+    _apps_snapshot_compacting = false;
+}
+
+void server_state::validate_apps_snapshot()
+{
+    std::vector<gpid> pids;
+    {
+        zauto_write_lock l(_lock);
+        while (!_apps_snapshot_unvalidated.empty() &&
+               pids.size() < APPS_SNAPSHOT_VALIDATE_BATCH_SIZE) {
+            pids.push_back(_apps_snapshot_unvalidated.front());
+            _apps_snapshot_unvalidated.pop_front();
+        }
+        if (pids.empty()) {
+            if (_apps_snapshot_mismatch_count > 0) {
+                derror("%d partitions loaded from the apps snapshot are inconsistent with the "
+                       "partition nodes",
+                       _apps_snapshot_mismatch_count);
+            }
+            return;
+        }
+    }
+
+    auto remaining = std::make_shared<std::atomic<int>>(static_cast<int>(pids.size()));
+    for (const gpid &pid : pids) {
+        _meta_svc->get_meta_storage()->get_data(
+            get_partition_path(pid), [this, pid, remaining](const blob &value) {
+                validate_partition_config(pid, value);
+                if (--(*remaining) == 0) {
+                    tasking::enqueue(LPC_META_STATE_NORMAL, tracker(), [this]() {
+                        validate_apps_snapshot();
+                    });
+                }
+            });
+    }
+}
+
+void server_state::validate_partition_config(const gpid &pid, const blob &value)
+{
+    partition_configuration remote;
+    bool decoded = value.length() > 0 && decode_partition_config(value, remote);
+
+    zauto_write_lock l(_lock);
+    std::shared_ptr<app_state> app = get_app(pid.get_app_id());
+    // the configs of the stateless apps are changed without increasing the ballot
+    if (app == nullptr || !app->is_stateful || pid.get_partition_index() >= app->partition_count) {
+        return;
+    }
+    if (!decoded) {
+        derror("invalid node of partition(%d.%d) in remote storage",
+               pid.get_app_id(),
+               pid.get_partition_index());
+        ++_apps_snapshot_mismatch_count;
+        return;
+    }
+
+    partition_configuration &local = app->partitions[pid.get_partition_index()];
+    if (remote == local) {
+        return;
+    }
+    // the node may be read before a sync of the partition completes, which increases the ballot
+    if (remote.ballot <= local.ballot) {
+        if (remote.ballot == local.ballot) {
+            derror("partition(%d.%d) loaded from the apps snapshot differs from the partition "
+                   "node with the same ballot(%" PRId64 ")",
+                   pid.get_app_id(),
+                   pid.get_partition_index(),
+                   local.ballot);
+            ++_apps_snapshot_mismatch_count;
+        }
+        return;
+    }
+    // the node may be synced but not applied locally yet
+    if (app->helpers->contexts[pid.get_partition_index()].stage != config_status::not_pending) {
+        return;
+    }
+
+    derror("partition(%d.%d) loaded from the apps snapshot is stale, ballot(%" PRId64
+           ") vs remote ballot(%" PRId64 "), take the remote one",
+           pid.get_app_id(),
+           pid.get_partition_index(),
+           local.ballot,
+           remote.ballot);
+    ++_apps_snapshot_mismatch_count;
+    if (!local.primary.is_invalid()) {
+        node_state *ns = get_node_state(_nodes, local.primary, false);
+        if (ns != nullptr) {
+            ns->remove_partition(pid, false);
+        }
+    }
+    for (const rpc_address &node : local.secondaries) {
+        node_state *ns = get_node_state(_nodes, node, false);
+        if (ns != nullptr) {
+            ns->remove_partition(pid, false);
+        }
+    }
+    local = remote;
+    if (!local.primary.is_invalid()) {
+        get_node_state(_nodes, local.primary, true)->put_partition(pid, true);
+    }
+    for (const rpc_address &node : local.secondaries) {
+        get_node_state(_nodes, node, true)->put_partition(pid, false);
+    }
+}
+
+void server_state::unpin_config_log(int64_t seq)
+{
+    zauto_lock l(_config_sync_batch_lock);
+    auto iter = _config_log_pins.find(seq);
+    dassert(iter != _config_log_pins.end(), "config log entry %" PRId64 " not pinned", seq);
+    if (--iter->second == 0) {
+        _config_log_pins.erase(iter);
+    }
+}
+
+blob server_state::encode_config_log_entry(const std::vector<config_sync_item> &batch)
+{
+    binary_writer writer;
+    writer.write(static_cast<int32_t>(batch.size()));
+    for (const config_sync_item &item : batch) {
+        writer.write(item.value);
+    }
+    return writer.get_buffer();
+}
+
+} // namespace replication
+} // namespace dsn
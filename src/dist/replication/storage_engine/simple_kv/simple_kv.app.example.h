@@ -34,6 +34,7 @@
  */
 
 #pragma once
+#include <atomic>
 #include "simple_kv.client.h"
 #include "simple_kv.server.h"
 
@@ -125,6 +126,111 @@ private:
     std::unique_ptr<simple_kv_client> _simple_kv_client;
     dsn::task_tracker _tracker;
 };
+
+// write throughput benchmark, which writes values of different sizes in turn
+class simple_kv_perf_client_app : public ::dsn::service_app
+{
+public:
+    simple_kv_perf_client_app(const service_app_info *info) : ::dsn::service_app(info) {}
+
+    virtual ~simple_kv_perf_client_app() override { stop(); }
+
+    // args: <cluster> <meta> <app> [seconds per value size] [concurrent writes]
+    virtual ::dsn::error_code start(const std::vector<std::string> &args)
+    {
+        if (args.size() < 4)
+            return ::dsn::ERR_INVALID_PARAMETERS;
+
+        dsn::rpc_address meta;
+        meta.from_string_ipv4(args[2].c_str());
+        _simple_kv_client.reset(new simple_kv_client(args[1].c_str(), {meta}, args[3].c_str()));
+        _seconds_per_round = args.size() > 4 ? atoi(args[4].c_str()) : 10;
+        _concurrency = args.size() > 5 ? atoi(args[5].c_str()) : 16;
+
+        // wait for the partitions to be ready
+        ::dsn::tasking::enqueue(LPC_SIMPLE_KV_TEST_TIMER,
+                                &_tracker,
+                                [this] { start_round(); },
+                                0,
+                                std::chrono::seconds(5));
+        return ::dsn::ERR_OK;
+    }
+
+    virtual ::dsn::error_code stop(bool cleanup = false)
+    {
+        _tracker.cancel_outstanding_tasks();
+        _simple_kv_client.reset();
+        return ::dsn::ERR_OK;
+    }
+
+private:
+    void start_round()
+    {
+        static const int value_sizes[] = {1024, 4 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024};
+        if (_round >= sizeof(value_sizes) / sizeof(value_sizes[0])) {
+            std::cout << "write benchmark done" << std::endl;
+            return;
+        }
+
+        _value = std::string(value_sizes[_round], 'v');
+        _succeed = 0;
+        _failed = 0;
+        _running = _concurrency;
+        _start_ns = dsn_now_ns();
+        _end_ns = _start_ns + _seconds_per_round * 1000000000ULL;
+        for (int i = 0; i < _concurrency; ++i) {
+            write(i);
+        }
+    }
+
+    void write(int id)
+    {
+        if (dsn_now_ns() >= _end_ns) {
+            if (--_running == 0) {
+                finish_round();
+            }
+            return;
+        }
+
+        kv_pair req;
+        req.key = "perf_" + std::to_string(id);
+        req.value = _value;
+        _simple_kv_client->write(req,
+                                 [this, id](error_code err, int32_t) {
+                                     if (err == ERR_OK)
+                                         ++_succeed;
+                                     else
+                                         ++_failed;
+                                     write(id);
+                                 },
+                                 std::chrono::seconds(10));
+    }
+
+    void finish_round()
+    {
+        double seconds = (dsn_now_ns() - _start_ns) / 1e9;
+        std::cout << "value size " << _value.size() << ": " << _succeed / seconds << " writes/s, "
+                  << _succeed * _value.size() / seconds / 1024 / 1024 << " MB/s, " << _failed
+                  << " failed" << std::endl;
+
+        ++_round;
+        ::dsn::tasking::enqueue(LPC_SIMPLE_KV_TEST_TIMER, &_tracker, [this] { start_round(); });
+    }
+
+    std::unique_ptr<simple_kv_client> _simple_kv_client;
+    dsn::task_tracker _tracker;
+    int _seconds_per_round{0};
+    int _concurrency{0};
+
+    // the current round, which are only changed when no write is running
+    size_t _round{0};
+    std::string _value;
+    uint64_t _start_ns{0};
+    uint64_t _end_ns{0};
+    std::atomic<uint64_t> _succeed{0};
+    std::atomic<uint64_t> _failed{0};
+    std::atomic<int> _running{0};
+};
 } // namespace application
 } // namespace replication
 } // namespace dsn
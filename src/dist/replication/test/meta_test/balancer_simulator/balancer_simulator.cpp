@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <gtest/gtest.h>
 
 #include "dist/replication/meta_server/meta_data.h"
@@ -166,9 +168,76 @@ void greedy_balancer_perfect_move_primary()
     }
 }
 
+namespace dsn {
+namespace replication {
+
+class balancer_simulator
+{
+public:
+    // compare the primary balancer per app with the global one on a large cluster
+    static void primary_balancer_globally_benchmark()
+    {
+        const int disk_on_node = 8;
+        uint32_t seed = random32(1, 100000);
+        std::vector<dsn::rpc_address> node_list = generate_node_list(600);
+
+        for (int globally = 0; globally < 2; ++globally) {
+            srand(seed);
+            app_mapper apps;
+            node_mapper nodes;
+            nodes_fs_manager manager;
+            generate_apps(apps,
+                          node_list,
+                          200,
+                          disk_on_node,
+                          std::pair<uint32_t, uint32_t>(8, 1024),
+                          true);
+            generate_node_mapper(nodes, apps, node_list);
+            generate_node_fs_manager(apps, nodes, manager, disk_on_node);
+
+            greedy_load_balancer glb(nullptr);
+            glb._only_primary_balancer = true;
+            glb._primary_balancer_globally = (globally == 1);
+
+            migration_list ml;
+            int rounds = 0;
+            size_t operations = 0;
+            std::chrono::duration<double> elapsed(0);
+            while (true) {
+                auto start = std::chrono::steady_clock::now();
+                bool has_actions = glb.balance({&apps, &nodes}, ml);
+                elapsed += std::chrono::steady_clock::now() - start;
+                if (!has_actions)
+                    break;
+                operations += ml.size();
+                migration_check_and_apply(apps, nodes, ml, &manager);
+                ++rounds;
+            }
+
+            double primary_stddev, total_stddev;
+            glb.score({&apps, &nodes}, primary_stddev, total_stddev);
+            unsigned min_primaries = std::numeric_limits<unsigned>::max(), max_primaries = 0;
+            for (const auto &kv : nodes) {
+                min_primaries = std::min(min_primaries, kv.second.primary_count());
+                max_primaries = std::max(max_primaries, kv.second.primary_count());
+            }
+            std::cout << "primary balancer " << (globally ? "globally" : "per app") << " on "
+                      << node_list.size() << " nodes and " << apps.size() << " apps: " << rounds
+                      << " rounds, " << operations << " operations, "
+                      << elapsed.count() * 1000 / std::max(rounds, 1) << " ms per round, "
+                      << "primaries per node in [" << min_primaries << ", " << max_primaries
+                      << "], primary stddev " << primary_stddev << std::endl;
+        }
+    }
+};
+
+} // namespace replication
+} // namespace dsn
+
 int main(int, char **)
 {
     dsn_run_config("config.ini", false);
     greedy_balancer_perfect_move_primary();
+    balancer_simulator::primary_balancer_globally_benchmark();
     return 0;
 }
@@ -6,6 +6,7 @@
 #include <dsn/cpp/serialization_helper/dsn.layer2_types.h>
 
 #include <fstream>
+#include <limits>
 
 #include "dist/replication/meta_server/meta_data.h"
 #include "dist/replication/meta_server/server_load_balancer.h"
@@ -261,6 +262,79 @@ void meta_service_test_app::balancer_validator()
     }
 }
 
+static int balance_primaries(greedy_load_balancer &glb,
+                             app_mapper &apps,
+                             node_mapper &nodes,
+                             nodes_fs_manager &manager)
+{
+    migration_list ml;
+    int rounds = 0;
+    for (; rounds < 1000 && glb.balance({&apps, &nodes}, ml); ++rounds) {
+        migration_check_and_apply(apps, nodes, ml, &manager);
+    }
+    return rounds;
+}
+
+static unsigned total_primary_spread(const node_mapper &nodes)
+{
+    unsigned min_primaries = std::numeric_limits<unsigned>::max(), max_primaries = 0;
+    for (const auto &kv : nodes) {
+        min_primaries = std::min(min_primaries, kv.second.primary_count());
+        max_primaries = std::max(max_primaries, kv.second.primary_count());
+    }
+    return max_primaries - min_primaries;
+}
+
+void meta_service_test_app::primary_balancer_globally_test()
+{
+    int disk_on_node = 4;
+    uint32_t seed = random32(1, 100000);
+    std::vector<dsn::rpc_address> node_list;
+    app_mapper apps;
+    node_mapper nodes;
+    nodes_fs_manager manager;
+
+    // balance the primaries of every app, and then the total primaries on the same cluster
+    unsigned spread[2];
+    double primary_stddev[2], total_stddev;
+    for (int globally = 0; globally < 2; ++globally) {
+        srand(seed);
+        generate_node_list(node_list, 20, 50);
+        generate_apps(
+            apps, node_list, 20, disk_on_node, std::pair<uint32_t, uint32_t>(8, 200), true);
+        generate_node_mapper(nodes, apps, node_list);
+        generate_node_fs_manager(apps, nodes, manager, disk_on_node);
+
+        greedy_load_balancer glb(nullptr);
+        glb._only_primary_balancer = true;
+        glb._primary_balancer_globally = (globally == 1);
+        int rounds = balance_primaries(glb, apps, nodes, manager);
+        ASSERT_TRUE(rounds < 1000);
+
+        glb.score({&apps, &nodes}, primary_stddev[globally], total_stddev);
+        spread[globally] = total_primary_spread(nodes);
+        std::cerr << "primary balancer " << (globally ? "globally" : "per app") << ": " << rounds
+                  << " rounds, primary stddev " << primary_stddev[globally]
+                  << ", max - min of total primaries " << spread[globally] << std::endl;
+
+        if (globally == 1) {
+            // the primaries of every app are still balanced
+            for (const auto &kv : apps) {
+                const std::shared_ptr<app_state> &app = kv.second;
+                int low = app->partition_count / node_list.size();
+                int high = (app->partition_count + node_list.size() - 1) / node_list.size();
+                for (const auto &n : nodes) {
+                    int c = n.second.primary_count(app->app_id);
+                    ASSERT_TRUE(c >= low && c <= high);
+                }
+            }
+        }
+    }
+
+    ASSERT_TRUE(primary_stddev[1] <= primary_stddev[0]);
+    ASSERT_TRUE(spread[1] <= spread[0]);
+}
+
 dsn::rpc_address get_rpc_address(const std::string &ip_port)
 {
     int splitter = ip_port.find_first_of(':');
@@ -37,6 +37,8 @@ TEST(meta, data_definition) { g_app->data_definition_op_test(); }
 
 TEST(meta, update_configuration) { g_app->update_configuration_test(); }
 
+TEST(meta, partition_config_sync_batch) { g_app->partition_config_sync_batch_test(); }
+
 TEST(meta, balancer_validator) { g_app->balancer_validator(); }
 
 TEST(meta, apply_balancer) { g_app->apply_balancer_test(); }
@@ -47,6 +49,8 @@ TEST(meta, construct_apps_test) { g_app->construct_apps_test(); }
 
 TEST(meta, balance_config_file) { g_app->balance_config_file(); }
 
+TEST(meta, primary_balancer_globally) { g_app->primary_balancer_globally_test(); }
+
 TEST(meta, json_compacity) { g_app->json_compacity(); }
 
 TEST(meta, adjust_dropped_size) { g_app->adjust_dropped_size(); }
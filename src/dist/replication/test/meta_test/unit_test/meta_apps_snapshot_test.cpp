@@ -0,0 +1,287 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <chrono>
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "meta_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+class meta_apps_snapshot_test : public meta_test_base
+{
+public:
+    void SetUp() override
+    {
+        meta_test_base::SetUp();
+        // no proposals are sent to the fake nodes
+        _ss->_add_secondary_enable_flow_control = true;
+        enable_snapshot(true);
+    }
+
+    void enable_snapshot(bool enabled)
+    {
+        _ms->_meta_opts.apps_snapshot_enabled = enabled;
+        server_state::snapshot_apps apps;
+        ASSERT_EQ(ERR_OK, enabled ? _ss->load_apps_snapshot(apps) : _ss->remove_apps_snapshot());
+    }
+
+    void compact_snapshot()
+    {
+        _ss->compact_apps_snapshot();
+        wait_all();
+    }
+
+    // assigns the primary of the partition, whose config is written with the config log
+    void assign_primary(const std::shared_ptr<app_state> &app, int pidx, rpc_address node)
+    {
+        auto request = std::make_shared<configuration_update_request>();
+        request->info = *app;
+        request->type = config_type::CT_ASSIGN_PRIMARY;
+        request->node = node;
+        request->config = app->partitions[pidx];
+        request->config.primary = node;
+        request->config.ballot++;
+        tasking::enqueue(LPC_META_STATE_HIGH,
+                         nullptr,
+                         [this, app, pidx, request]() mutable {
+                             zauto_write_lock l(_ss->_lock);
+                             get_node_state(_ss->_nodes, request->node, true);
+                             config_context &cc = app->helpers->contexts[pidx];
+                             cc.stage = config_status::pending_remote_sync;
+                             cc.pending_sync_request = request;
+                             cc.pending_sync_task = _ss->update_configuration_on_remote(request);
+                         },
+                         server_state::sStateHash)
+            ->wait();
+        _ss->wait_all_task();
+    }
+
+    // loads the apps into a new server_state like a new leader, and validates the partitions
+    // loaded from the snapshot
+    std::shared_ptr<server_state> recover(/*out*/ double &elapsed_ms)
+    {
+        auto ss = std::make_shared<server_state>();
+        ss->initialize(_ms.get(), _ms->_cluster_root + "/apps");
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(ERR_OK, ss->sync_apps_from_remote_storage());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        elapsed_ms = elapsed.count() * 1000;
+        EXPECT_TRUE(ss->spin_wait_staging(30));
+        ss->initialize_node_state();
+
+        ss->validate_apps_snapshot();
+        wait_validated(ss.get());
+        return ss;
+    }
+
+    // reloads the apps like the meta server is promoted again, which validates them
+    void promote_again(server_state *ss)
+    {
+        ASSERT_EQ(ERR_OK, ss->sync_apps_from_remote_storage());
+        wait_validated(ss);
+    }
+
+    void wait_validated(server_state *ss)
+    {
+        while (true) {
+            wait_all();
+            ss->wait_all_task();
+            zauto_read_lock l(ss->_lock);
+            if (ss->_apps_snapshot_unvalidated.empty()) {
+                break;
+            }
+        }
+        wait_all();
+        ss->wait_all_task();
+    }
+
+    void check_partitions(server_state *ss)
+    {
+        zauto_read_lock l(_ss->_lock);
+        ASSERT_EQ(_ss->_all_apps.size(), ss->_all_apps.size());
+        for (const auto &kv : _ss->_all_apps) {
+            std::shared_ptr<app_state> app = ss->get_app(kv.first);
+            ASSERT_NE(nullptr, app);
+            ASSERT_EQ(kv.second->status, app->status);
+            ASSERT_EQ(kv.second->partitions, app->partitions);
+        }
+    }
+
+    int snapshot_mismatch_count(server_state *ss)
+    {
+        zauto_read_lock l(ss->_lock);
+        return ss->_apps_snapshot_mismatch_count;
+    }
+
+    int64_t snapshot_gen() const { return _ss->_apps_snapshot_gen; }
+    int64_t snapshot_log_start() const { return _ss->_apps_snapshot_log_start; }
+    bool config_log_pinned()
+    {
+        zauto_lock l(_ss->_config_sync_batch_lock);
+        return !_ss->_config_log_pins.empty();
+    }
+
+    void write_partition_node_without_log(const partition_configuration &pc)
+    {
+        _ms->get_remote_storage()
+            ->set_data(_ss->get_partition_path(pc.pid),
+                       server_state::binary_encode_partition_config(pc),
+                       LPC_META_CALLBACK,
+                       [](error_code ec) { ASSERT_EQ(ERR_OK, ec); })
+            ->wait();
+    }
+
+    void check_partition(server_state *ss, const partition_configuration &pc)
+    {
+        zauto_read_lock l(ss->_lock);
+        ASSERT_EQ(pc, ss->get_app(pc.pid.get_app_id())->partitions[pc.pid.get_partition_index()]);
+        const node_state *ns = get_node_state(ss->_nodes, pc.primary, false);
+        ASSERT_NE(nullptr, ns);
+        ASSERT_EQ(1, ns->primary_count());
+    }
+
+    // writes the apps from scratch like restoring them, with no apps in this test
+    error_code sync_no_apps_to_remote_storage()
+    {
+        _ss->_all_apps.clear();
+        return _ss->sync_apps_to_remote_storage();
+    }
+
+    size_t config_log_count()
+    {
+        size_t count = 0;
+        _ms->get_meta_storage()->get_children(
+            _ss->get_config_log_path(),
+            [&count](bool, const std::vector<std::string> &children) { count = children.size(); });
+        wait_all();
+        return count;
+    }
+};
+
+TEST_F(meta_apps_snapshot_test, load_from_snapshot_and_log)
+{
+    create_app("snapshot_test", 8);
+    std::shared_ptr<app_state> app = _ss->get_app("snapshot_test");
+    compact_snapshot();
+    ASSERT_EQ(1, snapshot_gen());
+
+    // the configs written after the snapshot are in the log
+    rpc_address node("127.0.0.1", 34801);
+    for (int i = 0; i < 4; i++) {
+        assign_primary(app, i, node);
+        ASSERT_EQ(node, app->partitions[i].primary);
+    }
+    ASSERT_EQ(4, config_log_count());
+    ASSERT_FALSE(config_log_pinned());
+
+    double elapsed_ms;
+    std::shared_ptr<server_state> ss = recover(elapsed_ms);
+    check_partitions(ss.get());
+    ASSERT_EQ(0, snapshot_mismatch_count(ss.get()));
+
+    // the log is compacted into the next snapshot
+    compact_snapshot();
+    ASSERT_EQ(2, snapshot_gen());
+    ASSERT_EQ(4, snapshot_log_start());
+    ASSERT_EQ(0, config_log_count());
+    ss = recover(elapsed_ms);
+    check_partitions(ss.get());
+
+    // nothing to compact
+    compact_snapshot();
+    ASSERT_EQ(2, snapshot_gen());
+}
+
+TEST_F(meta_apps_snapshot_test, reset_on_sync_apps_to_remote_storage)
+{
+    create_app("snapshot_test", 4);
+    std::shared_ptr<app_state> app = _ss->get_app("snapshot_test");
+    compact_snapshot();
+    assign_primary(app, 0, rpc_address("127.0.0.1", 34801));
+    ASSERT_EQ(1, snapshot_gen());
+    ASSERT_EQ(1, config_log_count());
+
+    // the snapshot and the log of the former apps are removed, and compacted again from scratch
+    ASSERT_EQ(ERR_OK, sync_no_apps_to_remote_storage());
+    ASSERT_EQ(0, snapshot_gen());
+    ASSERT_EQ(0, snapshot_log_start());
+    ASSERT_EQ(0, config_log_count());
+    compact_snapshot();
+    ASSERT_EQ(1, snapshot_gen());
+}
+
+TEST_F(meta_apps_snapshot_test, validate_stale_snapshot)
+{
+    create_app("snapshot_test", 4);
+    std::shared_ptr<app_state> app = _ss->get_app("snapshot_test");
+    compact_snapshot();
+
+    // the partition node is written without the log
+    partition_configuration pc = app->partitions[1];
+    pc.primary = rpc_address("127.0.0.1", 34801);
+    pc.ballot++;
+    write_partition_node_without_log(pc);
+
+    // the stale partition is replaced by the remote one on validation
+    double elapsed_ms;
+    std::shared_ptr<server_state> ss = recover(elapsed_ms);
+    ASSERT_EQ(1, snapshot_mismatch_count(ss.get()));
+    check_partition(ss.get(), pc);
+}
+
+TEST_F(meta_apps_snapshot_test, validate_after_second_promotion)
+{
+    create_app("snapshot_test", 4);
+    std::shared_ptr<app_state> app = _ss->get_app("snapshot_test");
+    compact_snapshot();
+
+    double elapsed_ms;
+    std::shared_ptr<server_state> ss = recover(elapsed_ms);
+    ASSERT_EQ(0, snapshot_mismatch_count(ss.get()));
+
+    partition_configuration pc = app->partitions[2];
+    pc.primary = rpc_address("127.0.0.1", 34801);
+    pc.ballot++;
+    write_partition_node_without_log(pc);
+
+    // promoted again in the same process, the apps are validated without being asked to
+    promote_again(ss.get());
+    ASSERT_EQ(1, snapshot_mismatch_count(ss.get()));
+    check_partition(ss.get(), pc);
+}
+
+// loads the same apps from the partition nodes and from the snapshot, and compares the time used
+TEST_F(meta_apps_snapshot_test, failover_benchmark)
+{
+    const int app_count = 4;
+    const int partition_count = 2048;
+    for (int i = 0; i < app_count; i++) {
+        create_app("snapshot_benchmark_" + std::to_string(i), partition_count);
+    }
+
+    double nodes_ms, snapshot_ms;
+    enable_snapshot(false);
+    std::shared_ptr<server_state> ss = recover(nodes_ms);
+    check_partitions(ss.get());
+
+    enable_snapshot(true);
+    compact_snapshot();
+    std::shared_ptr<app_state> app = _ss->get_app("snapshot_benchmark_0");
+    for (int i = 0; i < 16; i++) {
+        assign_primary(app, i, rpc_address("127.0.0.1", 34801));
+    }
+    ss = recover(snapshot_ms);
+    check_partitions(ss.get());
+    ASSERT_EQ(0, snapshot_mismatch_count(ss.get()));
+
+    std::cout << "load " << app_count * partition_count
+              << " partitions from the partition nodes: " << nodes_ms
+              << " ms, from the apps snapshot: " << snapshot_ms << " ms" << std::endl;
+}
+
+} // namespace replication
+} // namespace dsn
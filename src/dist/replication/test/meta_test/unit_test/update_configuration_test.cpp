@@ -250,6 +250,102 @@ void meta_service_test_app::update_configuration_test()
     ASSERT_TRUE(wait_state(ss, validator3, 10));
 }
 
+void meta_service_test_app::partition_config_sync_batch_test()
+{
+    // binary configs are distinguished from the json ones on decoding
+    dsn::partition_configuration pc;
+    pc.pid = dsn::gpid(1, 2);
+    pc.ballot = 5;
+    pc.primary = dsn::rpc_address("127.0.0.1", 34801);
+    pc.secondaries.push_back(dsn::rpc_address("127.0.0.1", 34802));
+    pc.last_committed_decree = 100;
+    dsn::partition_configuration decoded;
+    ASSERT_TRUE(server_state::decode_partition_config(
+        server_state::binary_encode_partition_config(pc), decoded));
+    ASSERT_EQ(pc, decoded);
+    decoded = dsn::partition_configuration();
+    ASSERT_TRUE(server_state::decode_partition_config(
+        dsn::json::json_forwarder<dsn::partition_configuration>::encode(pc), decoded));
+    ASSERT_EQ(pc, decoded);
+
+    dsn::error_code ec;
+    std::shared_ptr<fake_sender_meta_service> svc(new fake_sender_meta_service(this));
+    svc->_failure_detector.reset(new dsn::replication::meta_server_failure_detector(svc.get()));
+    ec = svc->remote_storage_initialize();
+    ASSERT_EQ(ec, dsn::ERR_OK);
+    svc->_balancer.reset(new simple_load_balancer(svc.get()));
+    svc->_meta_opts.partition_config_sync_batch_max_count = 4;
+    svc->_meta_opts.partition_config_sync_batch_window_ms = 10;
+
+    server_state *ss = svc->_state.get();
+    ss->initialize(svc.get(), meta_options::concat_path_unix_style(svc->_cluster_root, "apps"));
+    dsn::app_info info;
+    info.is_stateful = true;
+    info.status = dsn::app_status::AS_CREATING;
+    info.app_id = 1;
+    info.app_name = "simple_kv.instance0";
+    info.app_type = "simple_kv";
+    info.max_replica_count = 3;
+    info.partition_count = 10;
+    std::shared_ptr<app_state> app = app_state::create(info);
+
+    ss->_all_apps.emplace(1, app);
+
+    std::vector<dsn::rpc_address> nodes;
+    generate_node_list(nodes, 3, 3);
+    for (int i = 0; i < info.partition_count; i++) {
+        dsn::partition_configuration &p = app->partitions[i];
+        p.primary = nodes[i % 3];
+        p.secondaries.push_back(nodes[(i + 1) % 3]);
+        p.secondaries.push_back(nodes[(i + 2) % 3]);
+        p.ballot = 3;
+    }
+
+    ss->sync_apps_to_remote_storage();
+    ASSERT_TRUE(ss->spin_wait_staging(30));
+    ss->initialize_node_state();
+    svc->set_node_state(nodes, true);
+    svc->_started = true;
+
+    // all the partitions are reconfigured at once, and written in several transactions
+    dsn::rpc_address dead = nodes[0];
+    state_validator validator = [dead](const app_mapper &apps) {
+        for (const dsn::partition_configuration &p : apps.at(1)->partitions) {
+            if (p.primary.is_invalid() || p.primary == dead || p.secondaries.size() != 1 ||
+                p.secondaries.front() == dead) {
+                return false;
+            }
+        }
+        return true;
+    };
+    // the volatile counters are reset on reading
+    ss->_recent_update_config_count->get_integer_value();
+    ss->_recent_config_sync_transaction_count->get_integer_value();
+    svc->set_node_state({dead}, false);
+    ASSERT_TRUE(wait_state(ss, validator, 30));
+
+    int64_t update_count = ss->_recent_update_config_count->get_integer_value();
+    int64_t transaction_count = ss->_recent_config_sync_transaction_count->get_integer_value();
+    ASSERT_GE(update_count, info.partition_count);
+    ASSERT_GT(transaction_count, 0);
+    ASSERT_LT(transaction_count, update_count);
+
+    // the configs in remote storage are the same as the local ones
+    for (int i = 0; i < info.partition_count; i++) {
+        dsn::partition_configuration remote;
+        svc->get_remote_storage()
+            ->get_data(ss->get_partition_path(*app, i),
+                       LPC_META_CALLBACK,
+                       [&remote](dsn::error_code ec, const dsn::blob &value) {
+                           ASSERT_EQ(dsn::ERR_OK, ec);
+                           ASSERT_TRUE(server_state::decode_partition_config(value, remote));
+                       })
+            ->wait();
+        dsn::zauto_read_lock l(ss->_lock);
+        ASSERT_EQ(app->partitions[i], remote);
+    }
+}
+
 void meta_service_test_app::adjust_dropped_size()
 {
     dsn::error_code ec;
@@ -25,11 +25,26 @@ TEST_F(log_block_test, log_block_header)
 {
     log_block block(10);
     auto hdr = (log_block_header *)block.front().data();
-    ASSERT_EQ(hdr->magic, 0xdeadbeef);
+    ASSERT_EQ(hdr->magic, LOG_BLOCK_MAGIC);
     ASSERT_EQ(hdr->length, 0);
     ASSERT_EQ(hdr->body_crc, 0);
 }
 
+TEST_F(log_block_test, crc)
+{
+    log_block block(10);
+    ASSERT_EQ(block.crc(), 0);
+
+    std::string body;
+    for (int i = 0; i < 10; i++) {
+        std::string data(i + 1, 'a' + i);
+        block.add(blob::create_from_bytes(std::string(data)));
+        body += data;
+    }
+    // the crc covers the body only, and starts from 0
+    ASSERT_EQ(block.crc(), dsn::utils::crc32_calc(body.data(), body.size(), 0));
+}
+
 class log_appender_test : public replica_test_base
 {
 };
@@ -62,6 +77,24 @@ TEST_F(log_appender_test, append_mutation)
     ASSERT_EQ(appender.blob_count(), 1 + 5 * 2);
 }
 
+TEST_F(log_appender_test, crc_with_payload_crc)
+{
+    std::string data(500, 'a');
+    log_appender appender(10);
+    for (int i = 0; i < 5; i++) {
+        mutation_ptr mu = create_test_mutation(1 + i, string_view(data.data(), i * 100));
+        appender.append_mutation(mu, nullptr, log_appender::payload_crc(mu));
+    }
+
+    // the same as checksumming the whole body
+    const log_block &blk = appender.all_blocks().front();
+    uint32_t crc = 0;
+    for (size_t i = 1; i < blk.data().size(); i++) {
+        crc = dsn::utils::crc32_calc(blk.data()[i].data(), blk.data()[i].length(), crc);
+    }
+    ASSERT_EQ(crc, blk.crc());
+}
+
 TEST_F(log_appender_test, log_block_not_full)
 {
     log_appender appender(10);
@@ -153,5 +186,83 @@ TEST_F(log_appender_test, read_log_block)
     ASSERT_EQ(mutation_idx, 1024);
 }
 
+// the codecs are only built with ENABLE_COMPRESSION, see bin/dsn.cmake
+#ifdef DSN_ENABLE_COMPRESSION
+TEST_F(log_appender_test, compressed_blocks)
+{
+    for (auto type : {utils::compression_type::LZ4, utils::compression_type::ZSTD}) {
+        ASSERT_TRUE(utils::compression_supported(type));
+
+        log_appender appender(10, type);
+        for (int i = 0; i < 1024; i++) { // more than DEFAULT_MAX_BLOCK_BYTES
+            appender.append_mutation(create_test_mutation(1 + i, std::string(1024, 'a')),
+                                     nullptr);
+        }
+        appender.seal();
+        ASSERT_EQ(appender.all_blocks().size(), 2);
+
+        size_t sz = 0;
+        int64_t start_offset = 10;
+        int mutation_idx = 0;
+        for (const log_block &blk : appender.all_blocks()) {
+            ASSERT_EQ(start_offset, blk.start_offset());
+            // the repeated data is well compressed
+            ASSERT_LT(blk.size(), 100 * 1024);
+
+            std::string buffer;
+            for (const blob &bb : blk.data()) {
+                buffer += bb.to_string();
+            }
+            auto hdr = *reinterpret_cast<const log_block_header *>(buffer.data());
+            ASSERT_EQ(LOG_BLOCK_MAGIC_COMPRESSED, hdr.magic);
+
+            blob body = blob::create_from_bytes(buffer.substr(sizeof(log_block_header)));
+            ASSERT_EQ(blk.crc(), dsn::utils::crc32_calc(body.data(), body.length(), 0));
+            ASSERT_EQ(ERR_OK, decode_log_block_body(hdr, body));
+
+            binary_reader reader(body);
+            while (!reader.is_eof()) {
+                mutation_ptr mu = mutation::read_from(reader, nullptr);
+                ASSERT_EQ(1 + mutation_idx, mu->data.header.decree);
+                ASSERT_EQ(blk.start_offset(), mu->data.header.log_offset);
+                mutation_idx++;
+            }
+
+            sz += blk.size();
+            start_offset += blk.size();
+        }
+        ASSERT_EQ(sz, appender.size());
+        ASSERT_EQ(mutation_idx, 1024);
+    }
+}
+
+TEST_F(log_appender_test, deferred_compressed_blocks)
+{
+    log_appender expected(10, utils::compression_type::LZ4);
+    log_appender deferred(utils::compression_type::LZ4);
+    for (int i = 0; i < 1024; i++) { // more than DEFAULT_MAX_BLOCK_BYTES
+        mutation_ptr mu = create_test_mutation(1 + i, std::string(1024, 'a'));
+        expected.append_mutation(mu, nullptr);
+        deferred.append_mutation(mu, nullptr);
+    }
+    expected.seal();
+
+    // nothing is serialized before the deferred appender is sealed
+    ASSERT_TRUE(deferred.is_deferred());
+    ASSERT_EQ(1, deferred.blob_count());
+    ASSERT_GT(deferred.size(), 1024 * 1024);
+
+    deferred.seal(10);
+    ASSERT_EQ(expected.size(), deferred.size());
+    ASSERT_EQ(expected.blob_count(), deferred.blob_count());
+    ASSERT_EQ(expected.all_blocks().size(), deferred.all_blocks().size());
+    for (size_t i = 0; i < expected.all_blocks().size(); i++) {
+        const log_block &blk = deferred.all_blocks()[i];
+        ASSERT_EQ(expected.all_blocks()[i].start_offset(), blk.start_offset());
+        ASSERT_EQ(expected.all_blocks()[i].crc(), blk.crc());
+    }
+}
+#endif
+
 } // namespace replication
 } // namespace dsn
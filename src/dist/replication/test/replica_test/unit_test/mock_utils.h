@@ -137,6 +137,11 @@ public:
     void set_init_child_ballot(ballot b) { _child_init_ballot = b; }
     void set_last_committed_decree(decree d) { _prepare_list->reset(d); }
     prepare_list *get_plist() { return _prepare_list; }
+    void set_plist(prepare_list *plist)
+    {
+        delete _prepare_list;
+        _prepare_list = plist;
+    }
     void prepare_list_truncate(decree d) { _prepare_list->truncate(d); }
     void prepare_list_commit_hard(decree d) { _prepare_list->commit(d, COMMIT_TO_DECREE_HARD); }
     decree get_app_last_committed_decree() { return _app->last_committed_decree(); }
@@ -176,7 +181,11 @@ public:
 
     ~mock_replica_stub() override = default;
 
-    void add_replica(replica *r) { _replicas[r->get_gpid()] = replica_ptr(r); }
+    void add_replica(replica *r)
+    {
+        _replicas[r->get_gpid()] = replica_ptr(r);
+        publish_replicas();
+    }
 
     mock_replica *add_primary_replica(int appid, int part_index = 1)
     {
@@ -218,6 +227,7 @@ public:
         mock_replica_ptr rep = new mock_replica(this, pid, std::move(info), "./");
         rep->set_replica_config(config);
         _replicas[pid] = rep;
+        publish_replicas();
 
         return rep;
     }
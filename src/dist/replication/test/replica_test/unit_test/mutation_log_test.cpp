@@ -28,7 +28,9 @@
 #include "dist/replication/test/replica_test/unit_test/replica_test_base.h"
 
 #include <dsn/utility/filesystem.h>
+#include <dsn/utility/flags.h>
 #include <gtest/gtest.h>
+#include <chrono>
 
 using namespace ::dsn;
 using namespace ::dsn::replication;
@@ -69,6 +71,37 @@ static void overwrite_file(const char *file, int offset, const void *buf, int si
     ASSERT_EQ(0, r);
 }
 
+// rewrites the log file, where the crc of each block is chained from the previous block,
+// into the format written if mutation_log_independent_block_crc is enabled
+static void convert_to_independent_crc(const char *file)
+{
+    std::string data;
+    {
+        int64_t size;
+        ASSERT_TRUE(dsn::utils::filesystem::file_size(file, size));
+        data.resize(size);
+        FILE *f = fopen(file, "rb");
+        ASSERT_TRUE(f != nullptr);
+        ASSERT_EQ(size, fread(&data[0], 1, size, f));
+        ASSERT_EQ(0, fclose(f));
+    }
+
+    uint32_t crc = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        auto hdr = reinterpret_cast<log_block_header *>(&data[pos]);
+        const char *body = &data[pos + sizeof(log_block_header)];
+        ASSERT_EQ(LOG_BLOCK_MAGIC_CHAINED_CRC, hdr->magic);
+        crc = dsn::utils::crc32_calc(body, hdr->length, crc);
+        ASSERT_EQ(crc, hdr->body_crc);
+        hdr->magic = LOG_BLOCK_MAGIC;
+        hdr->body_crc = dsn::utils::crc32_calc(body, hdr->length, 0);
+        pos += sizeof(log_block_header) + hdr->length;
+    }
+    ASSERT_EQ(data.size(), pos);
+    overwrite_file(file, 0, data.data(), static_cast<int>(data.size()));
+}
+
 TEST(replication, log_file)
 {
     replica_log_info_map mdecrees;
@@ -259,12 +292,36 @@ TEST(replication, log_file)
 
     lf = nullptr;
 
+    // the log file with independent crc is readable too
+    convert_to_independent_crc(fpath.c_str());
+    lf = log_file::open_read(fpath.c_str(), err);
+    ASSERT_NE(nullptr, lf);
+    ASSERT_EQ(ERR_OK, err);
+    lf->reset_stream();
+    for (int i = 0; i < 100; i++) {
+        blob bb;
+        ASSERT_EQ(ERR_OK, lf->read_next_log_block(bb));
+        binary_reader reader(bb);
+        if (i == 0) {
+            lf->read_file_header(reader);
+            ASSERT_TRUE(lf->is_right_header());
+        }
+        std::string ss;
+        reader.read(ss);
+        ASSERT_EQ(str, ss);
+    }
+    ASSERT_EQ(ERR_HANDLE_EOF, lf->read_next_log_block(bb));
+    lf = nullptr;
+
     utils::filesystem::remove_path(fpath);
 }
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(mutation_log_replay_threads);
+DSN_DECLARE_string(mutation_log_compression_type);
+
 class mutation_log_test : public replica_test_base
 {
 public:
@@ -482,6 +539,72 @@ TEST_F(mutation_log_test, replay_multiple_files_20000_1mb) { test_replay_multipl
 
 TEST_F(mutation_log_test, replay_multiple_files_50000_1mb) { test_replay_multiple_files(50000, 1); }
 
+// replays the same log files sequentially and in a pipeline, and compares the time used
+TEST_F(mutation_log_test, replay_benchmark)
+{
+    const int num_entries = 50000;
+    { // writing logs
+        mutation_log_ptr mlog = create_private_log(4);
+        for (int i = 0; i < num_entries; i++) {
+            mutation_ptr mu = create_test_mutation("hello!", 2 + i);
+            mlog->append(mu, LPC_AIO_IMMEDIATE_CALLBACK, nullptr, nullptr, 0);
+        }
+        mlog->tracker()->wait_outstanding_tasks();
+        mlog->close();
+    }
+
+    std::vector<std::string> log_files;
+    ASSERT_TRUE(utils::filesystem::get_subfiles(_log_dir, log_files, false));
+
+    uint32_t old_replay_threads = FLAGS_mutation_log_replay_threads;
+    for (uint32_t threads : {0, 1, 2, 4}) {
+        FLAGS_mutation_log_replay_threads = threads;
+
+        decree last_decree = 1;
+        int64_t end_offset;
+        auto start = std::chrono::steady_clock::now();
+        error_code err = mutation_log::replay(
+            log_files,
+            [&last_decree](int log_length, mutation_ptr &mu) -> bool {
+                EXPECT_EQ(last_decree + 1, mu->data.header.decree);
+                last_decree = mu->data.header.decree;
+                return true;
+            },
+            end_offset);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        ASSERT_EQ(ERR_OK, err);
+        ASSERT_EQ(1 + num_entries, last_decree);
+
+        std::cout << "replay " << log_files.size() << " log files with " << threads
+                  << " threads: " << elapsed.count() * 1000 << " ms" << std::endl;
+    }
+    FLAGS_mutation_log_replay_threads = old_replay_threads;
+}
+
+// the codecs are only built with ENABLE_COMPRESSION, see bin/dsn.cmake
+#ifdef DSN_ENABLE_COMPRESSION
+TEST_F(mutation_log_test, replay_compressed_files)
+{
+    for (const char *type : {"lz4", "zstd"}) {
+        utils::compression_type t;
+        ASSERT_TRUE(utils::compression_type_from_string(type, t));
+        ASSERT_TRUE(utils::compression_supported(t));
+
+        const char *old_type = FLAGS_mutation_log_compression_type;
+        FLAGS_mutation_log_compression_type = type;
+        for (uint32_t threads : {0, 4}) {
+            uint32_t old_replay_threads = FLAGS_mutation_log_replay_threads;
+            FLAGS_mutation_log_replay_threads = threads;
+            test_replay_multiple_files(10000, 1);
+            FLAGS_mutation_log_replay_threads = old_replay_threads;
+            TearDown();
+            SetUp();
+        }
+        FLAGS_mutation_log_compression_type = old_type;
+    }
+}
+#endif
+
 TEST_F(mutation_log_test, replay_start_decree)
 {
     // decree ranges from [1, 30)
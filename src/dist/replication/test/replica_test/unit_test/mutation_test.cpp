@@ -0,0 +1,160 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/utility/flags.h>
+
+#include "replica_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(mutation_2pc_adaptive_depth);
+DSN_DECLARE_uint32(mutation_2pc_min_depth);
+
+class mutation_test : public replica_test_base
+{
+public:
+    mutation_ptr create_mutation_with_updates(const std::vector<blob> &updates)
+    {
+        mutation_ptr mu = create_test_mutation(1, "");
+        mu->data.updates.clear();
+        mu->client_requests.clear();
+        for (const blob &bb : updates) {
+            mu->data.updates.emplace_back(mutation_update());
+            mu->data.updates.back().code = RPC_COLD_BACKUP;
+            mu->data.updates.back().data = bb;
+            mu->client_requests.push_back(nullptr);
+        }
+        return mu;
+    }
+
+    message_ptr create_prepare_message(const mutation_ptr &mu)
+    {
+        message_ptr msg = message_ex::create_request(RPC_PREPARE, 0, 0);
+        rpc_write_stream writer(msg);
+        marshall(writer, get_gpid(), DSF_THRIFT_BINARY);
+        mu->write_to(writer, msg);
+        return msg;
+    }
+};
+
+TEST_F(mutation_test, write_shared_payload)
+{
+    blob small1 = blob::create_from_bytes(std::string(100, 'a'));
+    blob small2 = blob::create_from_bytes(std::string(200, 'b'));
+    blob large = blob::create_from_bytes(
+        std::string(mutation::SHARED_PAYLOAD_REFERENCE_MIN_BYTES * 10, 'c'));
+    blob small3 = blob::create_from_bytes(std::string(300, 'd'));
+    mutation_ptr mu = create_mutation_with_updates({small1, small2, large, small3});
+
+    // small updates are merged, and the large one is referenced
+    const std::vector<blob> &payload = mu->shared_payload();
+    ASSERT_EQ(3, payload.size());
+    ASSERT_EQ(small1.to_string() + small2.to_string(), payload[0].to_string());
+    ASSERT_EQ(large.data(), payload[1].data());
+    ASSERT_EQ(small3.to_string(), payload[2].to_string());
+
+    // the payload is shared by all the prepare messages
+    message_ptr msg1 = create_prepare_message(mu);
+    message_ptr msg2 = create_prepare_message(mu);
+    for (const blob &bb : payload) {
+        for (const message_ptr &msg : {msg1, msg2}) {
+            ASSERT_EQ(1,
+                      std::count_if(msg->buffers.begin(),
+                                    msg->buffers.end(),
+                                    [&bb](const blob &b) { return b.data() == bb.data(); }));
+        }
+    }
+
+    // the message is the same as the one with the copied payload
+    binary_writer writer;
+    marshall(writer, get_gpid(), DSF_THRIFT_BINARY);
+    mu->write_to(writer, nullptr);
+    ASSERT_EQ(writer.total_size(), msg1->header->body_length);
+
+    message_ptr receive = msg1->copy(true, true);
+    rpc_read_stream reader(receive);
+    gpid pid;
+    unmarshall(reader, pid, DSF_THRIFT_BINARY);
+    ASSERT_EQ(get_gpid(), pid);
+    mutation_ptr mu2 = mutation::read_from(reader, nullptr);
+    ASSERT_EQ(mu->data.header.decree, mu2->data.header.decree);
+    ASSERT_EQ(4, mu2->data.updates.size());
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(mu->data.updates[i].data.to_string(), mu2->data.updates[i].data.to_string());
+    }
+}
+
+class mutation_queue_test : public replica_test_base
+{
+public:
+    mutation_queue_test()
+    {
+        _old_adaptive_depth = FLAGS_mutation_2pc_adaptive_depth;
+        _old_min_depth = FLAGS_mutation_2pc_min_depth;
+        FLAGS_mutation_2pc_adaptive_depth = true;
+        FLAGS_mutation_2pc_min_depth = 2;
+        _queue = make_unique<mutation_queue>(_replica->get_gpid(), 16, false);
+    }
+
+    ~mutation_queue_test()
+    {
+        _queue.reset();
+        FLAGS_mutation_2pc_adaptive_depth = _old_adaptive_depth;
+        FLAGS_mutation_2pc_min_depth = _old_min_depth;
+    }
+
+    // feeds `rounds` rounds of the latency, with `running` operations in 2pc
+    int complete_rounds(int rounds, uint64_t latency_us, int running)
+    {
+        int depth = 0;
+        for (int i = 0; i < rounds; i++) {
+            _queue->_current_op_count = running;
+            depth = _queue->on_2pc_round_completed(latency_us);
+        }
+        return depth;
+    }
+
+    void set_waiting(bool waiting)
+    {
+        _queue->_pending_mutation = waiting ? mutation_ptr(new mutation()) : nullptr;
+    }
+
+    bool _old_adaptive_depth;
+    uint32_t _old_min_depth;
+    std::unique_ptr<mutation_queue> _queue;
+};
+
+TEST_F(mutation_queue_test, adaptive_depth)
+{
+    // not increased beyond the depth given on construction
+    set_waiting(true);
+    ASSERT_EQ(16, complete_rounds(10, 100, 16));
+
+    // halved once for the mutations prepared with the same depth
+    ASSERT_EQ(8, complete_rounds(1, 1000, 16));
+    ASSERT_EQ(8, complete_rounds(15, 1000, 16));
+    ASSERT_EQ(4, complete_rounds(1, 1000, 8));
+
+    // increased by 1 per round of all the concurrent operations
+    ASSERT_EQ(4, complete_rounds(4, 100, 4));
+    ASSERT_EQ(5, complete_rounds(1, 100, 4));
+
+    // not increased if there're no mutations waiting
+    set_waiting(false);
+    ASSERT_EQ(5, complete_rounds(20, 100, 5));
+
+    // not decreased below the min depth
+    ASSERT_EQ(2, complete_rounds(100, 1000, 1));
+
+    // the base latency follows the latency of the recent windows
+    set_waiting(true);
+    ASSERT_LT(2, complete_rounds(mutation_queue::ADAPTIVE_DEPTH_WINDOW_ROUNDS * 2, 1000, 2));
+    set_waiting(false);
+}
+
+} // namespace replication
+} // namespace dsn
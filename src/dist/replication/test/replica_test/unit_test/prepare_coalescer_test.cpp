@@ -0,0 +1,204 @@
+// Copyright (c) 2019, Xiaomi, Inc.  All rights reserved.
+// This source code is licensed under the Apache License Version 2.0, which
+// can be found in the LICENSE file in the root directory of this source tree.
+
+#include <gtest/gtest.h>
+#include <dsn/cpp/rpc_stream.h>
+#include <dsn/utility/flags.h>
+
+#include "dist/replication/lib/prepare_coalescer.h"
+#include "replica_test_base.h"
+
+namespace dsn {
+namespace replication {
+
+DSN_DECLARE_bool(prepare_coalesce_enabled);
+DSN_DECLARE_uint32(prepare_coalesce_max_bytes);
+DSN_DECLARE_uint32(prepare_coalesce_delay_us);
+
+class mock_prepare_coalescer : public prepare_coalescer
+{
+public:
+    explicit mock_prepare_coalescer(replica_stub *stub) : prepare_coalescer(stub) {}
+
+    void send_batch(rpc_address node, message_ex *batch) override
+    {
+        message_ptr holder(batch);
+        sent.emplace_back(batch->copy(true, true));
+    }
+
+    std::vector<message_ptr> sent;
+};
+
+class prepare_coalescer_test : public replica_test_base
+{
+public:
+    message_ptr create_prepare_message(gpid pid, decree d, const std::string &data)
+    {
+        mutation_ptr mu = create_test_mutation(d, data);
+        message_ptr msg = message_ex::create_request(RPC_PREPARE, 0, pid.thread_hash());
+        rpc_write_stream writer(msg);
+        marshall(writer, pid, DSF_THRIFT_BINARY);
+        mu->write_to(writer, msg);
+        return msg;
+    }
+
+    // encodes the prepares into a batch, and decodes the received batch
+    std::vector<prepare_coalescer::coalesced_item>
+    transfer(const std::vector<std::pair<gpid, message_ptr>> &prepares)
+    {
+        std::vector<prepare_coalescer::coalesced_item> items(prepares.size());
+        for (size_t i = 0; i < prepares.size(); i++) {
+            items[i].id = i + 100;
+            items[i].pid = prepares[i].first;
+            prepare_coalescer::get_body(prepares[i].second.get(), items[i]);
+        }
+        message_ptr batch = prepare_coalescer::create_batch(RPC_PREPARE_BATCH, items, 1);
+        message_ptr receive = batch->copy(true, true);
+
+        std::vector<prepare_coalescer::coalesced_item> received;
+        prepare_coalescer::parse_batch(receive.get(), received);
+        return received;
+    }
+
+    // the decrees of the prepares in the batches sent so far, in the order they're received
+    std::vector<decree> take_sent_decrees()
+    {
+        std::vector<decree> decrees;
+        for (const message_ptr &batch : _coalescer->sent) {
+            std::vector<prepare_coalescer::coalesced_item> items;
+            prepare_coalescer::parse_batch(batch.get(), items);
+            for (const auto &item : items) {
+                message_ptr request =
+                    message_ex::create_receive_message_with_standalone_header(item.body);
+                rpc_read_stream reader(request);
+                gpid pid;
+                unmarshall(reader, pid, DSF_THRIFT_BINARY);
+                mutation_ptr mu = mutation::read_from(reader, nullptr);
+                decrees.push_back(mu->data.header.decree);
+            }
+        }
+        _coalescer->sent.clear();
+        return decrees;
+    }
+
+    size_t buffered_acks(rpc_address node)
+    {
+        auto &shard = _coalescer->shard_of(node);
+        zauto_lock l(shard.lock);
+        auto it = shard.ack_batches.find(node);
+        return it == shard.ack_batches.end() ? 0 : it->second.items.size();
+    }
+
+    std::unique_ptr<mock_prepare_coalescer> _coalescer{new mock_prepare_coalescer(stub.get())};
+};
+
+TEST_F(prepare_coalescer_test, batch_round_trip)
+{
+    gpid pid1(1, 1), pid2(2, 3);
+    std::vector<std::pair<gpid, message_ptr>> prepares = {
+        {pid1, create_prepare_message(pid1, 1, "hello")},
+        {pid2, create_prepare_message(pid2, 1, std::string(100 * 1024, 'x'))},
+        {pid1, create_prepare_message(pid1, 2, "world")},
+    };
+
+    auto received = transfer(prepares);
+    ASSERT_EQ(prepares.size(), received.size());
+    for (size_t i = 0; i < prepares.size(); i++) {
+        ASSERT_EQ(i + 100, received[i].id);
+        ASSERT_EQ(prepares[i].first, received[i].pid);
+        ASSERT_EQ(prepares[i].second->header->body_length, received[i].size);
+
+        // the body is read as a prepare message
+        message_ptr request =
+            message_ex::create_receive_message_with_standalone_header(received[i].body);
+        rpc_read_stream reader(request);
+        gpid pid;
+        unmarshall(reader, pid, DSF_THRIFT_BINARY);
+        ASSERT_EQ(prepares[i].first, pid);
+        mutation_ptr mu = mutation::read_from(reader, nullptr);
+        ASSERT_EQ(i == 2 ? 2 : 1, mu->data.header.decree);
+    }
+}
+
+TEST_F(prepare_coalescer_test, large_prepares_in_order)
+{
+    bool old_enabled = FLAGS_prepare_coalesce_enabled;
+    uint32_t old_max_bytes = FLAGS_prepare_coalesce_max_bytes;
+    uint32_t old_delay = FLAGS_prepare_coalesce_delay_us;
+    FLAGS_prepare_coalesce_enabled = true;
+    FLAGS_prepare_coalesce_max_bytes = 1024;
+    FLAGS_prepare_coalesce_delay_us = 10 * 1000 * 1000;
+
+    rpc_address secondary("127.0.0.1", 34802);
+    gpid pid(1, 1);
+    std::vector<message_ptr> requests;
+    std::vector<rpc_response_task_ptr> tasks;
+    auto send_prepare = [&](decree d, size_t size) {
+        requests.push_back(create_prepare_message(pid, d, std::string(size, 'x')));
+        tasks.push_back(_coalescer->call(secondary,
+                                         pid,
+                                         requests.back().get(),
+                                         nullptr,
+                                         [](error_code, message_ex *, message_ex *) {},
+                                         pid.thread_hash()));
+    };
+
+    // a large prepare is sent after the small ones buffered before it
+    send_prepare(1, 10);
+    send_prepare(2, 10);
+    ASSERT_TRUE(take_sent_decrees().empty());
+    send_prepare(3, 2048);
+    ASSERT_EQ(std::vector<decree>({1, 2, 3}), take_sent_decrees());
+
+    // so is a prepare sent after coalescing is disabled
+    send_prepare(4, 10);
+    FLAGS_prepare_coalesce_enabled = false;
+    send_prepare(5, 2048);
+    ASSERT_EQ(std::vector<decree>({4, 5}), take_sent_decrees());
+
+    // the prepares not acked are failed on close
+    _coalescer->close();
+    for (const rpc_response_task_ptr &t : tasks) {
+        t->wait();
+        ASSERT_EQ(ERR_OBJECT_NOT_FOUND, t->error());
+    }
+
+    FLAGS_prepare_coalesce_enabled = old_enabled;
+    FLAGS_prepare_coalesce_max_bytes = old_max_bytes;
+    FLAGS_prepare_coalesce_delay_us = old_delay;
+}
+
+TEST_F(prepare_coalescer_test, reply_in_batch)
+{
+    uint32_t old_delay = FLAGS_prepare_coalesce_delay_us;
+    FLAGS_prepare_coalesce_delay_us = 10 * 1000 * 1000;
+
+    rpc_address primary("127.0.0.1", 34801);
+    message_ptr request = message_ex::create_receive_message_with_standalone_header(blob());
+    request->header->from_address = primary;
+
+    // the requests not split from a batch are replied as usual
+    ASSERT_FALSE(prepare_coalescer::is_coalesced(request.get()));
+
+    request->local_rpc_code = RPC_PREPARE_BATCH;
+    request->header->id = 7;
+    request->header->gpid = gpid(1, 1);
+    ASSERT_TRUE(prepare_coalescer::is_coalesced(request.get()));
+
+    prepare_ack ack;
+    ack.pid = gpid(1, 1);
+    ack.err = ERR_OK;
+    ack.ballot = 3;
+    ack.decree = 5;
+    _coalescer->reply(request.get(), ack);
+    _coalescer->reply(request.get(), ack);
+    ASSERT_EQ(2, buffered_acks(primary));
+
+    _coalescer->close();
+    ASSERT_EQ(0, buffered_acks(primary));
+    FLAGS_prepare_coalesce_delay_us = old_delay;
+}
+
+} // namespace replication
+} // namespace dsn
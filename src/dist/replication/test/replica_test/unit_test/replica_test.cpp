@@ -7,10 +7,14 @@
 #include <dsn/utility/fail_point.h>
 #include "replica_test_base.h"
 #include <dsn/utility/defer.h>
+#include <dsn/utility/flags.h>
 
 namespace dsn {
 namespace replication {
 
+DSN_DECLARE_uint32(primary_read_lease_ms);
+DSN_DECLARE_uint32(secondary_read_max_staleness_ms);
+
 class replica_test : public replica_test_base
 {
 public:
@@ -45,6 +49,55 @@ public:
         _app_info.max_replica_count = 3;
         _app_info.partition_count = 8;
     }
+
+    void test_primary_read_lease()
+    {
+        auto &states = _mock_replica->_primary_states;
+        ASSERT_EQ(_mock_replica->check_primary_read(), ERR_OK);
+
+        FLAGS_primary_read_lease_ms = 10000;
+        auto cleanup = dsn::defer([]() { FLAGS_primary_read_lease_ms = 0; });
+        ASSERT_EQ(_mock_replica->check_primary_read(), ERR_INVALID_STATE);
+
+        // all the secondaries have acknowledged the group check
+        states.group_check_round_start_ms = dsn_now_ms();
+        _mock_replica->renew_primary_read_lease();
+        ASSERT_EQ(_mock_replica->check_primary_read(), ERR_OK);
+
+        // the lease expires
+        states.read_lease_expire_ms = dsn_now_ms() - 1;
+        ASSERT_EQ(_mock_replica->check_primary_read(), ERR_INVALID_STATE);
+
+        // the lease starts from when the round of group check is sent
+        states.group_check_round_start_ms = dsn_now_ms() - FLAGS_primary_read_lease_ms;
+        _mock_replica->renew_primary_read_lease();
+        ASSERT_EQ(_mock_replica->check_primary_read(), ERR_INVALID_STATE);
+    }
+
+    void test_secondary_read_staleness()
+    {
+        _mock_replica->as_secondary();
+        _mock_replica->set_last_committed_decree(10);
+        ASSERT_EQ(_mock_replica->check_secondary_read(), ERR_OK);
+
+        FLAGS_secondary_read_max_staleness_ms = 10000;
+        auto cleanup = dsn::defer([]() { FLAGS_secondary_read_max_staleness_ms = 0; });
+        // never heard from primary
+        ASSERT_EQ(_mock_replica->check_secondary_read(), ERR_INVALID_STATE);
+
+        _mock_replica->update_primary_committed_decree(10);
+        ASSERT_EQ(_mock_replica->check_secondary_read(), ERR_OK);
+
+        // lags behind the primary
+        _mock_replica->update_primary_committed_decree(11);
+        ASSERT_EQ(_mock_replica->check_secondary_read(), ERR_INVALID_STATE);
+
+        // hasn't heard from primary for too long
+        _mock_replica->update_primary_committed_decree(10);
+        _mock_replica->_secondary_states.primary_committed_decree_ts_ms =
+            dsn_now_ms() - FLAGS_secondary_read_max_staleness_ms - 1;
+        ASSERT_EQ(_mock_replica->check_secondary_read(), ERR_INVALID_STATE);
+    }
 };
 
 TEST_F(replica_test, write_size_limited)
@@ -81,5 +134,9 @@ TEST_F(replica_test, backup_request_qps)
     ASSERT_GT(get_table_level_backup_request_qps(), 0);
 }
 
+TEST_F(replica_test, primary_read_lease) { test_primary_read_lease(); }
+
+TEST_F(replica_test, secondary_read_staleness) { test_secondary_read_staleness(); }
+
 } // namespace replication
 } // namespace dsn